@@ -0,0 +1,278 @@
+"""
+Search scx_mlfq's slices on the live system.
+
+The simulator (sim/) and the in-kernel -T controller tune against models
+or a single p99 target; neither sees every hardware effect. This runs a
+scenario repeatedly under a running scx_mlfq, retunes it between trials
+through the pinned tunables map (scx_tune), and searches rr_slice_ns and
+fifo_slice_ns for the best value of an objective computed from the
+scenario's log.
+
+Search methods:
+  - halving: successive halving. --candidates log-uniform configurations
+    get --repeats runs each; the best 1/--eta are kept and get --eta times
+    more runs, until one is left.
+  - bo: Bayesian optimisation. A Gaussian process (RBF kernel on the log
+    slices, noise from the spread of the repeats) picks each next
+    configuration by expected improvement, after --init random ones.
+
+Repeat r of every configuration runs with seed --seed + r, so all
+configurations see the same jobs (common random numbers) and the
+comparison is paired. Every run is appended to --results as one CSV row,
+and the best configuration is written back at the end (--no-apply: the
+original tunables are restored instead).
+
+The scheduler must already run (make autotune starts one):
+
+    sudo scx_mlfq &
+    python3 autotune.py --method bo --trials 20 --objective p99_wait
+    python3 autotune.py --scenario "bin/loadtest -N 40 -a exp:5 -z lognorm:15:0.5 -W 20000000 -s {seed} -o {log}"
+
+The scenario is a command template: {seed} and {log} are substituted and
+the log must be a loadtest-style CSV (arrive_ns, start_ns, end_ns,
+duration_ns, work_iters), as loadtest writes; loadtest_barrier's log has
+other columns.
+"""
+import argparse
+import csv
+import math
+import os
+import shlex
+import subprocess
+import sys
+import time
+
+import numpy as np
+
+import fastlog
+
+OBJECTIVES = ("p99_wait", "mean_wait", "mean_turnaround", "p99_turnaround",
+              "makespan", "mean_slowdown")
+
+RESULT_FIELDS = ("time", "method", "trial", "rung", "rr_us", "fifo_us", "repeat", "seed",
+                 "objective", "value") + OBJECTIVES + ("jobs", "log")
+
+
+def log_metrics(path):
+    """All objectives of one scenario log, in ms (slowdown: ratio)."""
+    df = fastlog.read_frame(path)
+    arrive = df["arrive_ns"].astype(float).to_numpy()
+    start = df["start_ns"].astype(float).to_numpy()
+    end = df["end_ns"].astype(float).to_numpy()
+    wait = (start - arrive) / 1e6
+    turn = (end - arrive) / 1e6
+    # undisturbed speed: preemption only ever stretches a job
+    dur, iters = df["duration_ns"].astype(float).to_numpy(), df["work_iters"].astype(float).to_numpy()
+    ns_per_iter = float(np.percentile(dur / iters, 10))
+    return {"p99_wait": float(np.percentile(wait, 99)),
+            "mean_wait": float(wait.mean()),
+            "mean_turnaround": float(turn.mean()),
+            "p99_turnaround": float(np.percentile(turn, 99)),
+            "makespan": float((end.max() - arrive.min()) / 1e6),
+            "mean_slowdown": float(np.mean(turn * 1e6 / (iters * ns_per_iter))),
+            "jobs": len(df)}
+
+
+class Tuner:
+    def __init__(self, args):
+        self.args = args
+        self.tune = shlex.split(args.tune_cmd) + ["-p", str(args.part)]
+        self.trial = 0
+        self.stamp = time.strftime("%Y%m%d_%H%M%S")
+        self.seen = {}      # (rr_us, fifo_us) -> list of objective values, by repeat
+        new = not os.path.exists(args.results)
+        self.out = open(args.results, "a", newline="")
+        self.csv = csv.writer(self.out)
+        if new:
+            self.csv.writerow(RESULT_FIELDS)
+
+    def read_tunables(self):
+        out = subprocess.run(self.tune, check=True, capture_output=True, text=True).stdout
+        vals = dict(line.split(None, 1) for line in out.splitlines()[1:])
+        return {k: vals[k].strip() for k in ("rr_ns", "fifo_ns")}
+
+    def set_slices(self, rr_us, fifo_us):
+        subprocess.run(self.tune + [f"rr_us={rr_us}", f"fifo_us={fifo_us}"], check=True)
+
+    def restore(self, saved):
+        kv = [f"{k}={0 if v == 'default' else v}" for k, v in saved.items()]
+        subprocess.run(self.tune + kv, check=True)
+
+    def run(self, cfg, repeats, rung=0):
+        """Mean objective of cfg over repeats 0..repeats-1, running the missing ones."""
+        vals = self.seen.setdefault(cfg, [])
+        if len(vals) < repeats:
+            self.set_slices(*cfg)
+            # let tasks queued under the old slices drain
+            time.sleep(self.args.settle)
+        while len(vals) < repeats:
+            r = len(vals)
+            seed = self.args.seed + r
+            log = os.path.join(self.args.log_dir, f"tune_{self.stamp}_{self.trial:04d}.csv")
+            cmd = self.args.scenario.format(seed=seed, log=log)
+            subprocess.run(shlex.split(cmd), check=True, stdout=subprocess.DEVNULL)
+            m = log_metrics(log)
+            vals.append(m[self.args.objective])
+            self.csv.writerow([f"{time.time():.3f}", self.args.method, self.trial, rung,
+                               cfg[0], cfg[1], r, seed, self.args.objective,
+                               f"{vals[-1]:.6g}"] + [f"{m[o]:.6g}" for o in OBJECTIVES] +
+                              [m["jobs"], log])
+            self.out.flush()
+            self.trial += 1
+        mean = float(np.mean(vals[:repeats]))
+        print(f"  rr_us={cfg[0]:<7} fifo_us={cfg[1]:<7} x{repeats:<3} "
+              f"{self.args.objective}={mean:.4g}")
+        return mean
+
+
+def sample_configs(rng, n, bounds):
+    """n log-uniform (rr_us, fifo_us), rounded to whole microseconds."""
+    return [to_cfg(p, bounds) for p in rng.uniform(size=(n, 2))]
+
+
+def to_cfg(unit, bounds):
+    lo, hi = np.log(bounds[:, 0]), np.log(bounds[:, 1])
+    v = np.exp(lo + np.clip(unit, 0, 1) * (hi - lo))
+    return int(round(v[0])), int(round(v[1]))
+
+
+def to_unit(cfg, bounds):
+    lo, hi = np.log(bounds[:, 0]), np.log(bounds[:, 1])
+    return (np.log(np.array(cfg, dtype=float)) - lo) / (hi - lo)
+
+
+def successive_halving(t, rng, bounds, args):
+    cands = list(dict.fromkeys(sample_configs(rng, args.candidates, bounds)))
+    repeats, rung = args.repeats, 0
+    while True:
+        print(f"rung {rung}: {len(cands)} configurations x {repeats} runs")
+        scores = sorted((t.run(c, repeats, rung), c) for c in cands)
+        if len(cands) == 1:
+            return scores[0][1], scores[0][0]
+        cands = [c for _, c in scores[:max(1, len(cands) // args.eta)]]
+        repeats *= args.eta
+        rung += 1
+
+
+def gp_posterior(X, y, noise, Xs, length=0.25):
+    """GP mean and sd at Xs; RBF kernel, signal variance from y."""
+    def k(a, b):
+        d = ((a[:, None, :] - b[None, :, :]) ** 2).sum(-1)
+        return np.exp(-0.5 * d / length ** 2)
+
+    mu0, s2 = y.mean(), max(y.var(), 1e-12)
+    K = s2 * k(X, X) + np.diag(noise + 1e-9 * s2)
+    L = np.linalg.cholesky(K)
+    alpha = np.linalg.solve(L.T, np.linalg.solve(L, y - mu0))
+    Ks = s2 * k(Xs, X)
+    v = np.linalg.solve(L, Ks.T)
+    mean = mu0 + Ks @ alpha
+    var = np.maximum(s2 - (v ** 2).sum(0), 1e-12)
+    return mean, np.sqrt(var)
+
+
+def expected_improvement(mean, sd, best):
+    """EI for minimization."""
+    z = (best - mean) / sd
+    cdf = 0.5 * (1.0 + np.vectorize(math.erf)(z / math.sqrt(2)))
+    pdf = np.exp(-0.5 * z * z) / math.sqrt(2 * math.pi)
+    return (best - mean) * cdf + sd * pdf
+
+
+def bayes_opt(t, rng, bounds, args):
+    cfgs = list(dict.fromkeys(sample_configs(rng, args.init, bounds)))
+    for c in cfgs:
+        t.run(c, args.repeats)
+    while len(cfgs) < args.trials:
+        X = np.array([to_unit(c, bounds) for c in cfgs])
+        y = np.array([np.mean(t.seen[c][:args.repeats]) for c in cfgs])
+        # noise of a mean of the repeats, pooled: a single run says little
+        spread = [np.var(t.seen[c][:args.repeats], ddof=1) for c in cfgs if args.repeats > 1]
+        noise = np.full(len(cfgs), (np.mean(spread) if spread else 0.01 * y.var()) / args.repeats)
+        Xs = rng.uniform(size=(2000, 2))
+        mean, sd = gp_posterior(X, y, noise, Xs)
+        order = np.argsort(-expected_improvement(mean, sd, y.min()))
+        nxt = next((to_cfg(Xs[i], bounds) for i in order
+                    if to_cfg(Xs[i], bounds) not in t.seen), None)
+        if nxt is None:
+            break
+        print(f"trial {len(cfgs)}: predicted {mean[order[0]]:.4g} +- {sd[order[0]]:.3g}")
+        t.run(nxt, args.repeats)
+        cfgs.append(nxt)
+    # confirm the model's best guess among the measured ones with more runs
+    y = {c: np.mean(t.seen[c][:args.repeats]) for c in cfgs}
+    top = sorted(cfgs, key=y.get)[:3]
+    print(f"confirming the best {len(top)} with {args.repeats * 2} runs")
+    scores = sorted((t.run(c, args.repeats * 2), c) for c in top)
+    return scores[0][1], scores[0][0]
+
+
+def parse_range(s):
+    lo, hi = (float(v) for v in s.split(":"))
+    if not 0 < lo <= hi:
+        raise argparse.ArgumentTypeError(f"invalid range {s}, expected LO:HI with 0 < LO <= HI")
+    return lo, hi
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    ap = argparse.ArgumentParser(description="Tune scx_mlfq slices on the live system")
+    ap.add_argument("--method", choices=("halving", "bo"), default="halving")
+    ap.add_argument("--objective", choices=OBJECTIVES, default="p99_wait",
+                    help="minimized (default: p99_wait)")
+    ap.add_argument("--scenario",
+                    default=f"{here}/bin/loadtest -m 20 -c 0 -d 200 -w 8000000 -W 40000000 "
+                            "-s {seed} -o {log}",
+                    help="command template with {seed} and {log}")
+    ap.add_argument("--rr-us", type=parse_range, default=(500, 200000),
+                    help="rr_slice range in us (default: 500:200000)")
+    ap.add_argument("--fifo-us", type=parse_range, default=(1000, 1000000),
+                    help="fifo_slice range in us (default: 1000:1000000)")
+    ap.add_argument("--repeats", type=int, default=3, help="runs per configuration (first rung)")
+    ap.add_argument("--candidates", type=int, default=16, help="halving: initial configurations")
+    ap.add_argument("--eta", type=int, default=2, help="halving: keep 1/eta per rung")
+    ap.add_argument("--init", type=int, default=6, help="bo: random configurations first")
+    ap.add_argument("--trials", type=int, default=20, help="bo: configurations in total")
+    ap.add_argument("--seed", type=int, default=1, help="scenario seed of repeat 0")
+    ap.add_argument("--search-seed", type=int, default=0, help="seed of the search itself")
+    ap.add_argument("--settle", type=float, default=0.5, help="seconds after retuning")
+    ap.add_argument("--part", type=int, default=0, help="scx_mlfq partition (A/B mode)")
+    ap.add_argument("--tune-cmd",
+                    default=f"{'' if os.geteuid() == 0 else 'sudo '}{here}/bin/scx_tune")
+    ap.add_argument("--results", default="log/autotune.csv", help="appended, one row per run")
+    ap.add_argument("--log-dir", default="log/autotune", help="scenario logs")
+    ap.add_argument("--no-apply", action="store_true",
+                    help="restore the original tunables instead of applying the best")
+    args = ap.parse_args()
+    if args.repeats < 1 or args.eta < 2:
+        ap.error("--repeats must be >= 1 and --eta >= 2")
+
+    os.makedirs(args.log_dir, exist_ok=True)
+    bounds = np.array([args.rr_us, args.fifo_us])
+    rng = np.random.default_rng(args.search_seed)
+    t = Tuner(args)
+    saved = t.read_tunables()
+    print(f"tuning {args.objective} with {args.method}, results in {args.results}")
+
+    best = None
+    try:
+        if args.method == "halving":
+            best = successive_halving(t, rng, bounds, args)
+        else:
+            best = bayes_opt(t, rng, bounds, args)
+    finally:
+        t.out.close()
+        if best and not args.no_apply:
+            t.set_slices(*best[0])
+        else:
+            t.restore(saved)
+
+    (rr_us, fifo_us), value = best
+    print(f"best: rr_us={rr_us} fifo_us={fifo_us} {args.objective}={value:.4g} "
+          f"({t.trial} runs){'' if args.no_apply else ', applied'}")
+    print(f"  scx_tune -p {args.part} rr_us={rr_us} fifo_us={fifo_us}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,171 @@
+"""
+Join a loadtest CSV log with scheduler-side data on one timeline.
+
+The generators log CLOCK_MONOTONIC_RAW relative to begin_ns; the BPF side
+(scx_fifo_capture -t trace, bpf_ktime_get_ns) is CLOCK_MONOTONIC. The two
+drift apart while NTP slews, so both sides record paired samples of the
+two clocks (loadtest -C, scx_fifo_capture -C; format in loadtest_clock.h).
+Here the samples of a run are merged and interpolated piecewise-linearly
+to map RAW <-> MONOTONIC.
+
+Error bound per run: the worst sample bracket (err_ns) plus the worst
+leave-one-out interpolation residual, i.e. how far a sample lies from the
+line through its neighbours. The latter covers slew changes between
+samples, as long as they are sampled at least as densely as the slew
+changes (loadtest -I).
+
+    python3 clockjoin.py --log log/out.csv --clk log/out.csv.clk \\
+        --sched-clk log/trace.bin.clk --trace log/trace.bin --output log/joined.csv
+
+Writes the log with arrive/start/end also in CLOCK_MONOTONIC (*_mono_ns,
+the trace's clock) and, with --trace, the trace events with rel_ns on the
+log's run-relative timeline (--trace-output).
+"""
+import argparse
+import sys
+
+import numpy as np
+import pandas as pd
+
+import fastlog
+
+
+def read_clk(path):
+    """Sidecar rows, with a run index (each begin row starts a run)."""
+    df = pd.read_csv(path, comment="#")
+    df = df[df["src"] != "src"]  # headers repeated by concatenated sidecars
+    for col in ("raw_ns", "mono_ns", "err_ns"):
+        df[col] = pd.to_numeric(df[col]).astype(np.int64)
+    df["run"] = (df["tag"] == "begin").cumsum() - 1
+    return df.reset_index(drop=True)
+
+
+class ClockMap:
+    """Piecewise-linear RAW <-> MONOTONIC map over a set of paired samples."""
+
+    def __init__(self, raw, mono, err):
+        order = np.argsort(raw, kind="stable")
+        raw, mono, err = raw[order], mono[order], err[order]
+        keep = np.concatenate(([True], np.diff(raw) > 0))
+        self.raw = raw[keep].astype(np.float64)
+        self.mono = mono[keep].astype(np.float64)
+        self.err = err[keep].astype(np.float64)
+        if len(self.raw) < 2:
+            raise ValueError("need at least two clock samples")
+        # offsets from the first sample keep float64 exact to well below 1ns
+        self.raw0, self.mono0 = self.raw[0], self.mono[0]
+
+    def _extrap(self, x, xs, ys):
+        y = np.interp(x, xs, ys)
+        lo, hi = x < xs[0], x > xs[-1]
+        if lo.any():
+            s = (ys[1] - ys[0]) / (xs[1] - xs[0])
+            y[lo] = ys[0] + (x[lo] - xs[0]) * s
+        if hi.any():
+            s = (ys[-1] - ys[-2]) / (xs[-1] - xs[-2])
+            y[hi] = ys[-1] + (x[hi] - xs[-1]) * s
+        return y
+
+    def to_mono(self, raw):
+        x = np.asarray(raw, dtype=np.float64) - self.raw0
+        return self._extrap(x, self.raw - self.raw0, self.mono - self.mono0) + self.mono0
+
+    def to_raw(self, mono):
+        x = np.asarray(mono, dtype=np.float64) - self.mono0
+        return self._extrap(x, self.mono - self.mono0, self.raw - self.raw0) + self.raw0
+
+    def drift_ppm(self):
+        return ((self.mono[-1] - self.mono[0]) / (self.raw[-1] - self.raw[0]) - 1.0) * 1e6
+
+    def interp_residual(self):
+        """Worst leave-one-out residual of the interior samples (ns), or nan."""
+        if len(self.raw) < 3:
+            return float("nan")
+        r, m = self.raw - self.raw0, self.mono - self.mono0
+        t = (r[1:-1] - r[:-2]) / (r[2:] - r[:-2])
+        pred = m[:-2] + t * (m[2:] - m[:-2])
+        return float(np.max(np.abs(pred - m[1:-1])))
+
+    def bound_ns(self):
+        res = self.interp_residual()
+        return float(self.err.max()) + (0.0 if np.isnan(res) else res)
+
+
+def run_samples(gen, sched, run):
+    """Generator samples of run plus scheduler samples inside its span."""
+    g = gen[gen["run"] == run]
+    begin = int(g.loc[g["tag"] == "begin", "raw_ns"].iloc[0])
+    lo, hi = g["raw_ns"].min(), g["raw_ns"].max()
+    parts = [g]
+    if sched is not None:
+        # one scheduler session may cover many runs; take what overlaps
+        # (plus the nearest sample on each side so the ends are bracketed)
+        s = sched.sort_values("raw_ns")
+        inside = s[(s["raw_ns"] >= lo) & (s["raw_ns"] <= hi)]
+        before = s[s["raw_ns"] < lo].tail(1)
+        after = s[s["raw_ns"] > hi].head(1)
+        parts += [before, inside, after]
+    df = pd.concat(parts)
+    return begin, df
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Map a loadtest log and a scheduler trace onto one timeline")
+    ap.add_argument("--log", required=True, help="loadtest CSV")
+    ap.add_argument("--clk", required=True, help="loadtest -C sidecar")
+    ap.add_argument("--sched-clk", help="scx_fifo_capture -C sidecar")
+    ap.add_argument("--trace", help="scx_fifo_capture -t trace")
+    ap.add_argument("--run", type=int, help="only this run (default: all)")
+    ap.add_argument("--output", help="log with *_mono_ns columns")
+    ap.add_argument("--trace-output", help="trace events with rel_ns (CSV)")
+    args = ap.parse_args()
+
+    gen = read_clk(args.clk)
+    sched = read_clk(args.sched_clk) if args.sched_clk else None
+    runs = sorted(gen["run"].unique()) if args.run is None else [args.run]
+
+    frames, maps = [], {}
+    print(f"{'run':>4} {'samples':>8} {'span_s':>8} {'drift_ppm':>10} "
+          f"{'max_err_ns':>11} {'interp_ns':>10} {'bound_ns':>9}")
+    for run in runs:
+        begin, samples = run_samples(gen, sched, run)
+        cmap = ClockMap(samples["raw_ns"].to_numpy(), samples["mono_ns"].to_numpy(),
+                        samples["err_ns"].to_numpy())
+        maps[run] = (begin, cmap)
+        span = (cmap.raw[-1] - cmap.raw[0]) / 1e9
+        res = cmap.interp_residual()
+        print(f"{run:>4} {len(cmap.raw):>8} {span:>8.3f} {cmap.drift_ppm():>10.3f} "
+              f"{cmap.err.max():>11.0f} {res:>10.0f} {cmap.bound_ns():>9.0f}")
+
+        df = fastlog.read_frame(args.log, run=run)
+        for col in ("arrive_ns", "start_ns", "end_ns"):
+            if col in df:
+                df[col.replace("_ns", "_mono_ns")] = np.rint(
+                    cmap.to_mono(df[col].to_numpy() + begin)).astype(np.int64)
+        df["run"] = run
+        frames.append(df)
+
+    if args.output:
+        pd.concat(frames, ignore_index=True).to_csv(args.output, index=False)
+
+    if args.trace:
+        import scxtrace
+
+        ev = pd.DataFrame(scxtrace.read(args.trace)[["ts_ns", "pid", "type", "cpu"]])
+        ev["type"] = ev["type"].map(lambda t: scxtrace.TYPE_NAMES.get(int(t), str(int(t))))
+        # each event goes to the run whose span contains it
+        ev["run"] = -1
+        ev["rel_ns"] = np.int64(-1)
+        for run, (begin, cmap) in maps.items():
+            raw = cmap.to_raw(ev["ts_ns"].to_numpy())
+            inside = (raw >= cmap.raw[0]) & (raw <= cmap.raw[-1])
+            ev.loc[inside, "run"] = run
+            ev.loc[inside, "rel_ns"] = np.rint(raw[inside] - begin).astype(np.int64)
+        print(f"trace: {int((ev['run'] >= 0).sum())} of {len(ev)} events inside a run")
+        if args.trace_output:
+            ev.to_csv(args.trace_output, index=False)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
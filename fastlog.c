@@ -0,0 +1,287 @@
+/*
+ * fastlog.c
+ *
+ * Build:
+ *   gcc -O2 -std=gnu11 -Wall -Wextra -D_GNU_SOURCE -fPIC -shared -o bin/libfastlog.so fastlog.c
+ *
+ * Small native loader for the loadtest CSV logs, used by plot.py and
+ * plot_micro.py through ctypes (see fastlog.py).
+ *
+ * The log is memory-mapped and parsed in place with a hand-written integer
+ * parser. Loading is done in two passes over the mapping:
+ *   1. fastlog_count() counts the rows matching a (run, pid) filter,
+ *   2. fastlog_fill() writes the matching rows straight into caller-owned
+ *      column arrays (numpy arrays allocated by fastlog.py).
+ * Nothing is materialised for rows that do not match the filter.
+ *
+ * A "run" is a section of the file that starts with a CSV header line. The
+ * Makefile appends every run's log to runlog.csv including its header, so
+ * run N is simply the rows after the (N+1)-th header. Rows before the first
+ * header belong to run 0.
+ *
+ * Each header is parsed, so old logs without arrive_ns (log_fifo.csv) still
+ * load; missing columns are filled with -1 and reported through the column
+ * mask. Lines that do not parse as a full row (WARN:/ERR: lines written by
+ * the children) are skipped.
+ */
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+enum {
+    COL_PID,
+    COL_CHILD_INDEX,
+    COL_ARRIVE_NS,
+    COL_START_NS,
+    COL_END_NS,
+    COL_DURATION_NS,
+    COL_WORK_ITERS,
+    NR_COLS,
+};
+
+static const char *const col_names[NR_COLS] = {
+    "pid", "child_index", "arrive_ns", "start_ns",
+    "end_ns", "duration_ns", "work_iters",
+};
+
+/* upper bound of fields looked at in one line */
+#define MAX_FIELDS 16
+
+struct fastlog {
+    const char *base;
+    size_t size;
+    int nr_runs;
+    uint32_t col_mask;  /* columns seen in any header */
+};
+
+/* Parse a signed decimal integer in [p, end); stop at ',' or end of line. */
+static inline const char *parse_i64(const char *p, const char *end, int64_t *out, int *ok)
+{
+    int neg = 0;
+    int64_t v = 0;
+    const char *start;
+
+    if (p < end && *p == '-') {
+        neg = 1;
+        ++p;
+    }
+    start = p;
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        v = v * 10 + (*p - '0');
+        ++p;
+    }
+    *ok = (p != start) && (p == end || *p == ',' || *p == '\n' || *p == '\r');
+    *out = neg ? -v : v;
+    return p;
+}
+
+static inline const char *line_end(const char *p, const char *end)
+{
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    return nl ? nl : end;
+}
+
+/* A header is any line starting with a letter (data rows start with a digit). */
+static inline int is_header(const char *p, const char *eol)
+{
+    return p < eol && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) &&
+           memchr(p, ',', (size_t)(eol - p)) != NULL &&
+           strncmp(p, "WARN", 4) != 0 && strncmp(p, "ERR", 3) != 0;
+}
+
+/* Map each field position in a header line to a column id (-1 = ignored). */
+static int parse_header(const char *p, const char *eol, int field_col[MAX_FIELDS], uint32_t *mask)
+{
+    int nfields = 0;
+
+    while (p <= eol && nfields < MAX_FIELDS) {
+        const char *comma = memchr(p, ',', (size_t)(eol - p));
+        const char *fend = comma ? comma : eol;
+        size_t len = (size_t)(fend - p);
+
+        if (len > 0 && fend[-1] == '\r')
+            --len;
+        field_col[nfields] = -1;
+        for (int c = 0; c < NR_COLS; ++c) {
+            if (strlen(col_names[c]) == len && memcmp(p, col_names[c], len) == 0) {
+                field_col[nfields] = c;
+                *mask |= 1u << c;
+                break;
+            }
+        }
+        ++nfields;
+        if (!comma)
+            break;
+        p = comma + 1;
+    }
+    return nfields;
+}
+
+/* Default layout used until the first header is seen. */
+static int default_layout(int field_col[MAX_FIELDS])
+{
+    for (int c = 0; c < NR_COLS; ++c)
+        field_col[c] = c;
+    return NR_COLS;
+}
+
+/*
+ * Parse one data row into vals[]. Returns 1 if every field parsed,
+ * 0 for malformed lines.
+ */
+static int parse_row(const char *p, const char *eol, const int field_col[MAX_FIELDS],
+                     int nfields, int64_t vals[NR_COLS])
+{
+    for (int c = 0; c < NR_COLS; ++c)
+        vals[c] = -1;
+
+    for (int f = 0; f < nfields; ++f) {
+        int64_t v;
+        int ok;
+
+        p = parse_i64(p, eol, &v, &ok);
+        if (!ok)
+            return 0;
+        if (field_col[f] >= 0)
+            vals[field_col[f]] = v;
+        if (f + 1 < nfields) {
+            if (p >= eol || *p != ',')
+                return 0;
+            ++p;
+        }
+    }
+    /* extra fields mean the line does not follow this header */
+    return p == eol || *p == '\r';
+}
+
+/*
+ * Walk the mapping and call back for rows that pass the filter.
+ * run < 0 or pid < 0 disables that part of the filter.
+ * If cols is NULL the rows are only counted.
+ */
+static long scan(struct fastlog *fl, int run, long pid, int64_t *const *cols, long cap)
+{
+    const char *p = fl->base;
+    const char *end = fl->base + fl->size;
+    int field_col[MAX_FIELDS];
+    int nfields = default_layout(field_col);
+    int cur_run = 0;
+    int seen_header = 0;
+    long n = 0;
+
+    while (p < end) {
+        const char *eol = line_end(p, end);
+
+        if (is_header(p, eol)) {
+            if (seen_header)
+                ++cur_run;
+            seen_header = 1;
+            nfields = parse_header(p, eol, field_col, &fl->col_mask);
+        } else if (run < 0 || cur_run == run) {
+            int64_t vals[NR_COLS];
+
+            if (parse_row(p, eol, field_col, nfields, vals) &&
+                (pid < 0 || vals[COL_PID] == pid)) {
+                if (cols) {
+                    if (n >= cap)
+                        return n;
+                    for (int c = 0; c < NR_COLS; ++c) {
+                        if (cols[c])
+                            cols[c][n] = vals[c];
+                    }
+                }
+                ++n;
+            }
+        }
+        /* past the run, keep walking: nr_runs counts every header */
+        p = eol + 1;
+    }
+
+    if (run < 0 || !cols)
+        fl->nr_runs = cur_run + 1;
+    return n;
+}
+
+struct fastlog *fastlog_open(const char *path)
+{
+    struct fastlog *fl;
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    fl = calloc(1, sizeof(*fl));
+    if (!fl) {
+        close(fd);
+        return NULL;
+    }
+    fl->size = (size_t)st.st_size;
+    if (fl->size > 0) {
+        void *m = mmap(NULL, fl->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            free(fl);
+            errno = err;
+            return NULL;
+        }
+        madvise(m, fl->size, MADV_SEQUENTIAL);
+        fl->base = m;
+    }
+    close(fd);
+    return fl;
+}
+
+void fastlog_close(struct fastlog *fl)
+{
+    if (!fl)
+        return;
+    if (fl->base)
+        munmap((void *)fl->base, fl->size);
+    free(fl);
+}
+
+/* Number of rows matching the filter. Also refreshes nr_runs / col_mask. */
+long fastlog_count(struct fastlog *fl, int run, long pid)
+{
+    if (!fl || !fl->base)
+        return 0;
+    return scan(fl, run, pid, NULL, 0);
+}
+
+/*
+ * Fill up to cap matching rows into cols[0..NR_COLS-1]. NULL entries in
+ * cols skip that column. Returns the number of rows written.
+ */
+long fastlog_fill(struct fastlog *fl, int run, long pid, int64_t *const *cols, long cap)
+{
+    if (!fl || !fl->base || !cols)
+        return 0;
+    return scan(fl, run, pid, cols, cap);
+}
+
+int fastlog_nr_runs(const struct fastlog *fl)
+{
+    return fl ? fl->nr_runs : 0;
+}
+
+/* Bit i set if column i appeared in at least one header. */
+unsigned int fastlog_col_mask(const struct fastlog *fl)
+{
+    return fl ? fl->col_mask : 0;
+}
@@ -0,0 +1,133 @@
+"""
+ctypes front-end for bin/libfastlog.so (see fastlog.c).
+
+Loads the loadtest CSV logs into numpy int64 columns without going through
+pd.read_csv + pd.to_numeric. The C side writes directly into the numpy
+arrays allocated here, so there is no intermediate copy. If the library has
+not been built (make fastlog), read_frame() falls back to pandas.
+"""
+import ctypes
+import os
+
+import numpy as np
+
+COLUMNS = ("pid", "child_index", "arrive_ns", "start_ns",
+           "end_ns", "duration_ns", "work_iters")
+
+_LIB_PATH = os.environ.get(
+    "FASTLOG_LIB",
+    os.path.join(os.path.dirname(os.path.abspath(__file__)), "bin", "libfastlog.so"),
+)
+_lib = None
+
+
+def _load_lib():
+    global _lib
+    if _lib is not None:
+        return _lib
+    if not os.path.exists(_LIB_PATH):
+        return None
+    lib = ctypes.CDLL(_LIB_PATH, use_errno=True)
+    lib.fastlog_open.argtypes = [ctypes.c_char_p]
+    lib.fastlog_open.restype = ctypes.c_void_p
+    lib.fastlog_close.argtypes = [ctypes.c_void_p]
+    lib.fastlog_close.restype = None
+    lib.fastlog_count.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_long]
+    lib.fastlog_count.restype = ctypes.c_long
+    lib.fastlog_fill.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_long,
+                                 ctypes.POINTER(ctypes.c_void_p), ctypes.c_long]
+    lib.fastlog_fill.restype = ctypes.c_long
+    lib.fastlog_nr_runs.argtypes = [ctypes.c_void_p]
+    lib.fastlog_nr_runs.restype = ctypes.c_int
+    lib.fastlog_col_mask.argtypes = [ctypes.c_void_p]
+    lib.fastlog_col_mask.restype = ctypes.c_uint
+    _lib = lib
+    return lib
+
+
+def available():
+    return _load_lib() is not None
+
+
+def load(file_path, run=None, pid=None):
+    """
+    Load matching rows as a dict of numpy int64 arrays keyed by column name.
+    run: index of the header-delimited run inside the file (None = all runs).
+    pid: keep only rows of this pid (None = all).
+    Columns never present in any header are left out. Values of columns
+    missing from some runs only are -1.
+    Returns (columns, nr_runs).
+    """
+    lib = _load_lib()
+    if lib is None:
+        raise RuntimeError(f"fastlog library not found at {_LIB_PATH} (run 'make fastlog')")
+
+    h = lib.fastlog_open(os.fsencode(file_path))
+    if not h:
+        raise OSError(ctypes.get_errno(), f"cannot open {file_path}")
+    try:
+        crun = -1 if run is None else int(run)
+        cpid = -1 if pid is None else int(pid)
+
+        n = lib.fastlog_count(h, crun, cpid)
+        nr_runs = lib.fastlog_nr_runs(h)
+        mask = lib.fastlog_col_mask(h)
+        if mask == 0:
+            # headerless file: default layout
+            mask = (1 << len(COLUMNS)) - 1
+
+        cols = {}
+        ptrs = (ctypes.c_void_p * len(COLUMNS))()
+        for i, name in enumerate(COLUMNS):
+            if mask & (1 << i):
+                arr = np.empty(n, dtype=np.int64)
+                cols[name] = arr
+                ptrs[i] = arr.ctypes.data
+            else:
+                ptrs[i] = None
+
+        got = lib.fastlog_fill(h, crun, cpid, ptrs, n) if n > 0 else 0
+        if got != n:
+            # file changed between the passes; keep what was parsed
+            cols = {k: v[:got] for k, v in cols.items()}
+        return cols, nr_runs
+    finally:
+        lib.fastlog_close(h)
+
+
+def _read_frame_pandas(file_path, run=None, pid=None):
+    import pandas as pd
+
+    df = pd.read_csv(file_path)
+    # rows repeating the header start a new run (see Makefile: cat >> runlog)
+    hdr = df.iloc[:, 0].astype(str) == df.columns[0]
+    if run is not None:
+        df = df[(hdr.cumsum() == int(run)) & ~hdr]
+    else:
+        df = df[~hdr]
+    for col in ("pid", "child_index", "arrive_ns", "start_ns",
+                "end_ns", "duration_ns", "work_iters"):
+        if col in df.columns:
+            df[col] = pd.to_numeric(df[col], errors="coerce").astype("Int64")
+    if pid is not None:
+        df = df[df["pid"] == int(pid)]
+    return df.reset_index(drop=True)
+
+
+def read_frame(file_path, run=None, pid=None):
+    """
+    Load a log as a pandas DataFrame, using the native loader when it is
+    built and pd.read_csv otherwise.
+    """
+    import pandas as pd
+
+    if not available():
+        return _read_frame_pandas(file_path, run=run, pid=pid)
+
+    cols, _ = load(file_path, run=run, pid=pid)
+    df = pd.DataFrame(cols, copy=False)
+    for name in ("arrive_ns",):
+        # logs mixing old (no arrive_ns) and new runs: -1 means missing
+        if name in df.columns and (df[name] < 0).any():
+            df[name] = df[name].astype("Int64").mask(df[name] < 0)
+    return df
@@ -0,0 +1,358 @@
+"""
+Fit a loadtest workload model to recorded job logs.
+
+The generator's defaults (uniform 0..DELAY ms between arrivals, uniform
+MIN_ITERS..MAX_ITERS per job) are guesses. This reads recorded logs,
+loadtest CSVs or imported production traces, and fits:
+
+  - inter-arrival gaps (ms) and job sizes (work iterations): exponential,
+    lognormal, Weibull and uniform by maximum likelihood, ranked by AIC,
+    with the Kolmogorov-Smirnov distance of each. The KS p-value is the
+    plain asymptotic one; with parameters fitted from the same data it is
+    optimistic, so read it as a ranking aid, not a test.
+  - burstiness: coefficient of variation of the gaps (1 for Poisson), the
+    burstiness parameter B = (sd - mean) / (sd + mean) (0 Poisson, -1
+    periodic, towards 1 bursty), the lag-1 autocorrelation of the gaps and
+    the index of dispersion of arrival counts at a few window sizes.
+  - periodicity: the strongest peak of the periodogram of binned arrival
+    counts, kept when Fisher's g test finds it significant (p < 0.01) and
+    the run covers at least 3 periods.
+
+Gaps and sizes are pooled over all runs of the logs; counts, dispersion
+and periodicity use the longest run, since they need one timeline.
+
+The model is written as a make include for the run targets (loadtest -N,
+-a, -z and -P, see loadtest.c):
+
+    python3 fitload.py log/runlog.csv --output log/model.mk
+    make run_fifo WORKLOAD=log/model.mk
+    python3 fitload.py log/runlog.csv --compare log/out.csv
+
+--compare checks a synthetic run against the recorded one (two-sample KS
+of gaps and sizes). Imported traces without work_iters need the size
+column and a conversion, e.g. from a loadtest log of the same host:
+
+    python3 fitload.py prod.csv --arrive-col submit_ns --size-col runtime_ns \\
+        --calibrate log/runlog.csv --output log/prod.mk
+"""
+import argparse
+import math
+import sys
+
+import numpy as np
+import pandas as pd
+
+import fastlog
+
+# Gaps below this (ms) are taken as simultaneous arrivals; logs have 1us
+# resolution at best and log() of 0 is undefined
+MIN_GAP_MS = 1e-3
+
+
+def read_runs(path, arrive_col="arrive_ns", size_col="work_iters", ns_per_iter=None):
+    """List of (arrive_ns, size_iters) numpy arrays, one pair per run, one entry per job."""
+    df = pd.read_csv(path, low_memory=False)
+    # rows repeating the header start a new run (see Makefile: cat >> runlog)
+    hdr = df.iloc[:, 0].astype(str) == df.columns[0]
+    frames = [g for _, g in df[~hdr].groupby(hdr.cumsum()[~hdr], sort=True)]
+
+    runs = []
+    for df in frames:
+        if arrive_col not in df.columns:
+            raise SystemExit(f"{path}: no {arrive_col} column (--arrive-col)")
+        arrive = pd.to_numeric(df[arrive_col], errors="coerce")
+        if size_col in df.columns and size_col == "work_iters":
+            size = pd.to_numeric(df[size_col], errors="coerce")
+        elif size_col in df.columns:
+            if not ns_per_iter:
+                raise SystemExit(f"{size_col} is not in iterations: need --ns-per-iter or --calibrate")
+            size = pd.to_numeric(df[size_col], errors="coerce") / ns_per_iter
+        elif "duration_ns" in df.columns and ns_per_iter:
+            size = pd.to_numeric(df["duration_ns"], errors="coerce") / ns_per_iter
+        else:
+            raise SystemExit(f"{path}: no {size_col} column (--size-col)")
+        if "child_index" in df.columns:
+            # divided/microslice logs have one row per slice: one job is its
+            # earliest arrival and the work of all its slices (plot.py
+            # job_summary)
+            jobs = pd.DataFrame({"arrive": arrive, "size": size,
+                                 "job": pd.to_numeric(df["child_index"], errors="coerce")})
+            jobs = jobs.groupby("job").agg(arrive=("arrive", "min"), size=("size", "sum"))
+            arrive, size = jobs["arrive"], jobs["size"]
+        ok = (arrive >= 0) & (size > 0)
+        if ok.sum() < 2:
+            continue
+        order = np.argsort(arrive[ok].to_numpy(np.float64), kind="stable")
+        runs.append((arrive[ok].to_numpy(np.float64)[order],
+                     size[ok].to_numpy(np.float64)[order]))
+    if not runs:
+        raise SystemExit(f"{path}: no run with two or more usable jobs")
+    return runs
+
+
+def calibrate(path):
+    """ns per work iteration, from the least disturbed jobs of a loadtest log."""
+    df = fastlog.read_frame(path)
+    ok = (df["work_iters"] > 0) & (df["duration_ns"] > 0)
+    ratio = (df["duration_ns"][ok] / df["work_iters"][ok]).astype(float)
+    # preemption only ever stretches a job: the low end is the undisturbed speed
+    return float(np.percentile(ratio, 10))
+
+
+def gaps_ms(arrive_ns):
+    return np.maximum(np.diff(arrive_ns) / 1e6, MIN_GAP_MS)
+
+
+########################################
+# Distribution fits (MLE, numpy only)
+########################################
+
+def fit_exp(x):
+    mean = float(x.mean())
+    return {"name": "exp", "params": (mean,), "k": 1,
+            "logpdf": lambda v: -np.log(mean) - v / mean,
+            "cdf": lambda v: 1.0 - np.exp(-v / mean)}
+
+
+def fit_lognorm(x):
+    lx = np.log(x)
+    mu, sigma = float(lx.mean()), max(float(lx.std()), 1e-9)
+    erf = np.vectorize(math.erf)
+    return {"name": "lognorm", "params": (mu, sigma), "k": 2,
+            "logpdf": lambda v: -np.log(v * sigma * math.sqrt(2 * math.pi))
+                                - (np.log(v) - mu) ** 2 / (2 * sigma ** 2),
+            "cdf": lambda v: 0.5 * (1.0 + erf((np.log(v) - mu) / (sigma * math.sqrt(2))))}
+
+
+def fit_weibull(x):
+    lx = np.log(x)
+    mlx = lx.mean()
+
+    def score(k):
+        xk = np.exp(k * (lx - lx.max()))  # scaled to avoid overflow
+        return (xk * lx).sum() / xk.sum() - 1.0 / k - mlx
+
+    # score() is increasing in k: bisect
+    lo, hi = 0.02, 50.0
+    for _ in range(100):
+        mid = math.sqrt(lo * hi)
+        if score(mid) < 0:
+            lo = mid
+        else:
+            hi = mid
+    k = math.sqrt(lo * hi)
+    lam = float(np.exp(np.log(np.mean(np.exp(k * (lx - lx.max())))) / k + lx.max()))
+    return {"name": "weibull", "params": (k, lam), "k": 2,
+            "logpdf": lambda v: math.log(k / lam) + (k - 1) * np.log(v / lam) - (v / lam) ** k,
+            "cdf": lambda v: 1.0 - np.exp(-(v / lam) ** k)}
+
+
+def fit_uniform(x):
+    lo, hi = float(x.min()), float(x.max())
+    width = max(hi - lo, 1e-12)
+    return {"name": "uniform", "params": (lo, hi), "k": 2,
+            "logpdf": lambda v: np.full(len(v), -math.log(width)),
+            "cdf": lambda v: np.clip((v - lo) / width, 0.0, 1.0)}
+
+
+FITS = (fit_exp, fit_lognorm, fit_weibull, fit_uniform)
+
+
+def kolmogorov_p(d, n):
+    """Asymptotic P(D > d) for a sample of n (or an effective n)."""
+    if n <= 0 or d <= 0:
+        return 1.0
+    lam = (math.sqrt(n) + 0.12 + 0.11 / math.sqrt(n)) * d
+    p = 2.0 * sum((-1) ** (j - 1) * math.exp(-2.0 * j * j * lam * lam) for j in range(1, 101))
+    return min(max(p, 0.0), 1.0)
+
+
+def ks_1samp(x, cdf):
+    xs = np.sort(x)
+    n = len(xs)
+    c = cdf(xs)
+    d = max(float((np.arange(1, n + 1) / n - c).max()), float((c - np.arange(n) / n).max()))
+    return d, kolmogorov_p(d, n)
+
+
+def ks_2samp(a, b):
+    a, b = np.sort(a), np.sort(b)
+    allv = np.concatenate([a, b])
+    d = float(np.abs(np.searchsorted(a, allv, side="right") / len(a)
+                     - np.searchsorted(b, allv, side="right") / len(b)).max())
+    return d, kolmogorov_p(d, len(a) * len(b) / (len(a) + len(b)))
+
+
+def fit_all(x):
+    """All candidate fits of x, best (lowest AIC) first."""
+    out = []
+    for fit in FITS:
+        f = fit(x)
+        ll = float(np.sum(f["logpdf"](x)))
+        f["aic"] = 2 * f["k"] - 2 * ll if math.isfinite(ll) else math.inf
+        f["ks_d"], f["ks_p"] = ks_1samp(x, f["cdf"])
+        out.append(f)
+    return sorted(out, key=lambda f: f["aic"])
+
+
+def dist_arg(f, scale=1.0):
+    """loadtest -a/-z argument; scale converts the fit's unit to loadtest's."""
+    p = f["params"]
+    if f["name"] == "exp":
+        return f"exp:{p[0] * scale:.6g}"
+    if f["name"] == "lognorm":
+        return f"lognorm:{p[0] + math.log(scale):.6g}:{p[1]:.6g}"
+    if f["name"] == "weibull":
+        return f"weibull:{p[0]:.6g}:{p[1] * scale:.6g}"
+    return f"uniform:{p[0] * scale:.6g}:{p[1] * scale:.6g}"
+
+
+########################################
+# Burstiness and periodicity
+########################################
+
+def burstiness(gaps, arrive_ns):
+    mean, sd = float(gaps.mean()), float(gaps.std())
+    ac1 = float(np.corrcoef(gaps[:-1], gaps[1:])[0, 1]) if len(gaps) > 2 and sd > 0 else 0.0
+    span_ms = (arrive_ns[-1] - arrive_ns[0]) / 1e6
+    disp = []
+    for mult in (1, 10, 100):
+        win = mean * mult
+        nbins = int(span_ms // win) if win > 0 else 0
+        if nbins < 8:
+            continue
+        counts = np.histogram((arrive_ns - arrive_ns[0]) / 1e6, bins=nbins,
+                              range=(0, nbins * win))[0]
+        if counts.mean() > 0:
+            disp.append((win, float(counts.var() / counts.mean())))
+    return {"cv": sd / mean if mean > 0 else 0.0,
+            "B": (sd - mean) / (sd + mean) if sd + mean > 0 else 0.0,
+            "ac1": ac1 if math.isfinite(ac1) else 0.0,
+            "dispersion": disp}
+
+
+def periodicity(arrive_ns, mean_gap_ms):
+    """(period_ms, amplitude, p) of the strongest arrival rate cycle, or None."""
+    t = (arrive_ns - arrive_ns[0]) / 1e6
+    span = float(t[-1])
+    bin_ms = max(mean_gap_ms / 2.0, span / 4096.0)
+    nbins = int(span // bin_ms)
+    if nbins < 32:
+        return None
+    counts = np.histogram(t, bins=nbins, range=(0, nbins * bin_ms))[0].astype(np.float64)
+    spec = np.fft.rfft(counts)
+    power = np.abs(spec[1:]) ** 2
+    # at least 3 cycles in the run
+    power[:2] = 0
+    m = len(power)
+    if m < 4 or power.sum() <= 0:
+        return None
+    k = int(power.argmax())
+    g = power[k] / power.sum()
+    # Fisher's g test, first term (tight for small p)
+    p = min(1.0, m * (1.0 - g) ** (m - 1))
+    amp = min(2.0 * abs(spec[k + 1]) / counts.sum(), 0.95)
+    return nbins * bin_ms / (k + 1), float(amp), float(p)
+
+
+########################################
+# Report and model
+########################################
+
+def print_fits(title, fits, unit):
+    print(f"\n{title}:")
+    print(f"  {'DIST':<9} {'PARAMS':<30} {'AIC':>14} {'KS_D':>7} {'KS_P':>9}")
+    for f in fits:
+        params = ", ".join(f"{v:.4g}" for v in f["params"])
+        print(f"  {f['name']:<9} {params:<30} {f['aic']:>14.1f} {f['ks_d']:>7.4f} {f['ks_p']:>9.3g}")
+    print(f"  best: {fits[0]['name']} ({unit})")
+
+
+def model_flags(jobs, gap_fit, size_fit, period):
+    flags = f"-N {jobs} -a {dist_arg(gap_fit)} -z {dist_arg(size_fit, 1e6)}"
+    if period:
+        flags += f" -P {period[0]:.6g}:{period[1]:.3g}"
+    return flags
+
+
+def write_model(path, src, runs, jobs, flags, gap_fit, size_fit, sizes):
+    with open(path, "w") as f:
+        f.write(f"# Workload model fitted by fitload.py from {src}\n"
+                f"# {sum(len(a) for a, _ in runs)} jobs in {len(runs)} runs\n"
+                f"# gaps: {gap_fit['name']} KS D={gap_fit['ks_d']:.4f}, "
+                f"sizes: {size_fit['name']} KS D={size_fit['ks_d']:.4f}\n"
+                f"MAX_PROCS = {jobs}\n"
+                f"MIN_ITERS = {int(sizes.min())}\n"
+                f"MAX_ITERS = {int(math.ceil(sizes.max()))}\n"
+                f"GEN_FLAGS = {flags}\n")
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Fit arrival and job size models to recorded runs")
+    ap.add_argument("logs", nargs="+", help="loadtest CSV logs or imported traces")
+    ap.add_argument("--arrive-col", default="arrive_ns", help="arrival time column, ns")
+    ap.add_argument("--size-col", default="work_iters",
+                    help="job size column (default: work_iters; others need a conversion)")
+    ap.add_argument("--ns-per-iter", type=float, help="ns per work iteration for --size-col")
+    ap.add_argument("--calibrate", help="loadtest log to derive --ns-per-iter from")
+    ap.add_argument("--output", help="write the model as a make include (WORKLOAD=)")
+    ap.add_argument("--compare", help="synthetic log to check against the recorded one")
+    args = ap.parse_args()
+
+    ns_per_iter = args.ns_per_iter
+    if args.calibrate:
+        ns_per_iter = calibrate(args.calibrate)
+        print(f"calibration: {ns_per_iter:.3f} ns/iteration ({args.calibrate})")
+
+    runs = []
+    for path in args.logs:
+        runs += read_runs(path, args.arrive_col, args.size_col, ns_per_iter)
+    gaps = np.concatenate([gaps_ms(a) for a, _ in runs])
+    sizes = np.concatenate([s for _, s in runs])
+    longest = max(runs, key=lambda r: len(r[0]))[0]
+    print(f"{len(sizes)} jobs in {len(runs)} runs, {len(gaps)} gaps")
+
+    gap_fits = fit_all(gaps)
+    # sizes are fitted in millions of iterations to keep the parameters readable
+    size_fits = fit_all(sizes / 1e6)
+    print_fits("inter-arrival gaps", gap_fits, "ms")
+    print_fits("job sizes", size_fits, "Miters")
+
+    b = burstiness(gaps, longest)
+    print(f"\nburstiness: CV={b['cv']:.3f} B={b['B']:.3f} lag-1 autocorrelation={b['ac1']:.3f}")
+    for win, d in b["dispersion"]:
+        print(f"  dispersion of counts over {win:.3g}ms windows: {d:.3f} (Poisson: 1)")
+    if b["cv"] > 1.5 or any(d > 2 for _, d in b["dispersion"]):
+        print("  arrivals are bursty")
+    if abs(b["ac1"]) > 0.2:
+        print("  consecutive gaps are correlated; the model draws them independently")
+
+    period = periodicity(longest, float(gaps.mean()))
+    if period and period[2] < 0.01:
+        print(f"\nperiodic: period={period[0]:.3f}ms amplitude={period[1]:.3f} (p={period[2]:.2g})")
+    else:
+        if period:
+            print(f"\nno significant period (strongest {period[0]:.3f}ms, p={period[2]:.2g})")
+        period = None
+
+    jobs = int(round(np.mean([len(a) for a, _ in runs])))
+    flags = model_flags(jobs, gap_fits[0], size_fits[0], period)
+    if args.output:
+        write_model(args.output, " ".join(args.logs), runs, jobs, flags,
+                    gap_fits[0], size_fits[0], sizes)
+        print(f"\nmodel written to {args.output}")
+    print(f"loadtest flags: {flags} -w {int(sizes.min())} -W {int(math.ceil(sizes.max()))}")
+
+    if args.compare:
+        syn = read_runs(args.compare)
+        sg = np.concatenate([gaps_ms(a) for a, _ in syn])
+        ss = np.concatenate([s for _, s in syn])
+        print(f"\n{args.compare} vs recorded (two-sample KS):")
+        for name, a, c in (("gaps", gaps, sg), ("sizes", sizes, ss)):
+            d, p = ks_2samp(a, c)
+            print(f"  {name:<6} D={d:.4f} p={p:.3g} mean {a.mean():.4g} vs {c.mean():.4g}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,349 @@
+"""
+Live metrics of a run in progress.
+
+plot.py and friends read a log once the run is over. This follows a
+growing loadtest CSV log or scx_fifo_capture trace (like tail -f) and
+keeps rolling statistics over the last --window seconds and since the
+start, refreshed every --interval seconds:
+
+  - CSV log: jobs/s completed, wait (start - arrive) and response
+    (end - arrive) percentiles. Rows are bucketed by end_ns, on the run's
+    own timeline; a repeated header (a new run appended) starts over.
+  - trace: wait from enqueue to running, response from the job_release
+    to the job_end probe of the same pid, and job_end/s. Records arrive
+    in per-CPU batches, so one older than the window is only counted in
+    the totals.
+
+Memory is constant: each window bucket holds a log-scale histogram per
+metric (LOG_SUB bins per power of two, about 9% relative error on the
+percentiles), and the trace's open enqueues and releases are capped at
+MAX_PENDING pids.
+
+    python3 livestat.py log/out.csv
+    python3 livestat.py log/trace.bin --window 30 --socket /tmp/livestat.sock
+    python3 livestat.py log/out.csv --fail-p99-ms 500 --fail-after 3 || sudo pkill -INT scx_mlfq
+
+--socket serves the latest snapshot as one JSON line to every client
+that connects (e.g. socat - UNIX-CONNECT:/tmp/livestat.sock). With
+--fail-p99-ms, the analyzer exits with status 2 once the windowed p99 of
+--fail-metric stayed above the limit for --fail-after refreshes, so a
+wrapper can stop a bad configuration early. It exits with 0 after the
+file stopped growing for --idle-exit seconds.
+"""
+import argparse
+import json
+import os
+import select
+import socket
+import sys
+import time
+
+import numpy as np
+
+import scxtrace
+
+LOG_SUB = 8            # histogram bins per power of two
+MIN_NS = 1000          # lowest bin: 1us
+NR_BINS = LOG_SUB * 40  # up to ~1e12 ns past MIN_NS
+MAX_PENDING = 1 << 16
+
+METRICS = ("wait", "response")
+
+
+def bin_of(ns):
+    """Histogram bin of each value in ns (numpy array)."""
+    v = np.maximum(np.asarray(ns, dtype=np.float64), MIN_NS) / MIN_NS
+    return np.minimum((np.log2(v) * LOG_SUB).astype(np.int64), NR_BINS - 1)
+
+
+def quantile(hist, q):
+    """q-quantile in ns of a bin histogram; None when empty."""
+    total = hist.sum()
+    if not total:
+        return None
+    k = int(np.searchsorted(np.cumsum(hist), q * total))
+    # geometric middle of the bin
+    return MIN_NS * 2.0 ** ((k + 0.5) / LOG_SUB)
+
+
+class Rolling:
+    """Histograms per time bucket over a sliding window, plus totals."""
+
+    def __init__(self, window_s, bucket_s):
+        self.bucket_ns = int(bucket_s * 1e9)
+        self.nr = max(1, int(round(window_s / bucket_s)))
+        self.reset()
+
+    def reset(self):
+        self.hist = np.zeros((self.nr, len(METRICS), NR_BINS), dtype=np.int64)
+        self.done = np.zeros(self.nr, dtype=np.int64)
+        self.slot_of = np.full(self.nr, -1, dtype=np.int64)  # bucket index held
+        self.total = np.zeros((len(METRICS), NR_BINS), dtype=np.int64)
+        self.total_done = 0
+        self.now = 0          # newest timestamp seen, ns
+        self.first = None     # oldest bucket seen
+        self.late = 0         # records older than the window
+
+    def _slot(self, b):
+        s = b % self.nr
+        if self.slot_of[s] != b:
+            self.hist[s] = 0
+            self.done[s] = 0
+            self.slot_of[s] = b
+        return s
+
+    def add(self, metric, ts_ns, vals_ns, completions=False):
+        """vals_ns observed at ts_ns (arrays); completions counts them as jobs done."""
+        if not len(ts_ns):
+            return
+        m = METRICS.index(metric) if metric else None
+        bins = bin_of(vals_ns) if m is not None else None
+        self.now = max(self.now, int(ts_ns.max()))
+        oldest = int(ts_ns.min()) // self.bucket_ns
+        self.first = oldest if self.first is None else min(self.first, oldest)
+        newest = self.now // self.bucket_ns
+        if m is not None:
+            np.add.at(self.total[m], bins, 1)
+        if completions:
+            self.total_done += len(ts_ns)
+        bk = ts_ns.astype(np.int64) // self.bucket_ns
+        keep = bk > newest - self.nr
+        self.late += int((~keep).sum())
+        for b in np.unique(bk[keep]):
+            s = self._slot(int(b))
+            sel = bk == b
+            if m is not None:
+                np.add.at(self.hist[s, m], bins[sel], 1)
+            if completions:
+                self.done[s] += int(sel.sum())
+
+    def window(self):
+        """(per-metric histograms, jobs done, span s) of the last window."""
+        newest = self.now // self.bucket_ns
+        live = self.slot_of > newest - self.nr
+        span = min(self.nr, newest - (self.first or 0) + 1) * self.bucket_ns / 1e9
+        return self.hist[live].sum(axis=0), int(self.done[live].sum()), span
+
+
+class CsvSource:
+    """New rows of a loadtest log: (wait, response) samples at end_ns."""
+
+    def __init__(self, path):
+        self.path = path
+        self.pos = 0
+        self.rest = b""
+        self.cols = None
+        self.run = -1
+
+    def poll(self, stats):
+        grew = read_new(self, stats)
+        if not grew:
+            return False
+        lines = (self.rest + grew).split(b"\n")
+        self.rest = lines.pop()
+        rows = []
+        for line in lines:
+            if not line:
+                continue
+            if not line[:1].isdigit():
+                if line.startswith(b"pid,"):
+                    self._flush(stats, rows)
+                    rows = []
+                    self.cols = line.decode().split(",")
+                    self.run += 1
+                    stats.reset()
+                continue  # WARN/ERR lines from children
+            rows.append(line)
+        self._flush(stats, rows)
+        return True
+
+    def _flush(self, stats, rows):
+        if not rows or not self.cols or "arrive_ns" not in self.cols:
+            return
+        ia, ist, ie = (self.cols.index(c) for c in ("arrive_ns", "start_ns", "end_ns"))
+        a = np.array([[int(f) for f in (r.split(b",")[i] for i in (ia, ist, ie))]
+                      for r in rows if r.count(b",") >= len(self.cols) - 1], dtype=np.int64)
+        if not len(a):
+            return
+        stats.add("wait", a[:, 2], a[:, 1] - a[:, 0])
+        stats.add("response", a[:, 2], a[:, 2] - a[:, 0], completions=True)
+
+
+class TraceSource:
+    """New records of an scx_fifo_capture trace."""
+
+    def __init__(self, path):
+        self.path = path
+        self.pos = 0
+        self.rest = b""
+        self.hdr_ok = False
+        self.run = 0
+        self.enq = {}   # pid -> enqueue ts
+        self.rel = {}   # pid -> job_release ts
+        self.dropped = 0
+
+    def poll(self, stats):
+        grew = read_new(self, stats)
+        if not grew:
+            return False
+        buf = self.rest + grew
+        if not self.hdr_ok:
+            if len(buf) < scxtrace.HEADER.itemsize:
+                self.rest = buf
+                return True
+            hdr = np.frombuffer(buf, dtype=scxtrace.HEADER, count=1)[0]
+            if hdr["magic"] != scxtrace.MAGIC or hdr["rec_size"] != scxtrace.EVENT.itemsize:
+                raise SystemExit(f"{self.path}: not a version {scxtrace.VERSION} trace")
+            buf = buf[scxtrace.HEADER.itemsize:]
+            self.hdr_ok = True
+        nr = len(buf) // scxtrace.EVENT.itemsize
+        self.rest = buf[nr * scxtrace.EVENT.itemsize:]
+        ev = np.frombuffer(buf, dtype=scxtrace.EVENT, count=nr)
+        ev = ev[np.argsort(ev["ts_ns"], kind="stable")]
+        self._pairs(stats, ev, scxtrace.ENQUEUE, scxtrace.RUNNING, self.enq, "wait", False)
+        self._pairs(stats, ev, scxtrace.JOB_RELEASE, scxtrace.JOB_END, self.rel, "response", True)
+        return True
+
+    def _pairs(self, stats, ev, t_open, t_close, pending, metric, completions):
+        ts, out = [], []
+        sel = ev[(ev["type"] == t_open) | (ev["type"] == t_close)]
+        for t, pid, typ in zip(sel["ts_ns"].tolist(), sel["pid"].tolist(), sel["type"].tolist()):
+            if typ == t_open:
+                if len(pending) >= MAX_PENDING:
+                    # tasks that never ran again, or lost records: start over
+                    self.dropped += len(pending)
+                    pending.clear()
+                pending[pid] = t
+            elif pid in pending:
+                t0 = pending.pop(pid)
+                ts.append(t)
+                out.append(t - t0)
+        stats.add(metric, np.array(ts, dtype=np.int64), np.array(out, dtype=np.int64),
+                  completions=completions)
+
+
+def read_new(src, stats):
+    """Bytes appended to src.path since the last call; restarts on truncation."""
+    try:
+        size = os.path.getsize(src.path)
+    except OSError:
+        return b""
+    if size < src.pos:
+        src.__init__(src.path)
+        stats.reset()
+    if size == src.pos:
+        return b""
+    with open(src.path, "rb") as f:
+        f.seek(src.pos)
+        data = f.read(size - src.pos)
+    src.pos += len(data)
+    return data
+
+
+def snapshot(stats, src):
+    """Metrics of the window as a JSON-safe dict; quantiles of no jobs are None."""
+    def ms(ns):
+        return None if ns is None else ns / 1e6
+
+    hist, done, span = stats.window()
+    snap = {"time": time.time(), "run": src.run, "jobs": stats.total_done,
+            "window_s": round(span, 3), "jobs_per_s": done / span if span else 0.0,
+            "late": stats.late}
+    for i, m in enumerate(METRICS):
+        for q in (50, 90, 99):
+            snap[f"{m}_p{q}_ms"] = ms(quantile(hist[i], q / 100))
+        snap[f"{m}_all_p99_ms"] = ms(quantile(stats.total[i], 0.99))
+        snap[f"{m}_n"] = int(hist[i].sum())
+    return snap
+
+
+def dashboard(s):
+    def ms(v):
+        return "-" if v is None else f"{v:.3g}"
+    return (f"{time.strftime('%H:%M:%S')} run {s['run']} jobs {s['jobs']} | "
+            f"last {s['window_s']:.0f}s: {s['jobs_per_s']:.2f} jobs/s "
+            f"wait p50/p90/p99 {ms(s['wait_p50_ms'])}/{ms(s['wait_p90_ms'])}/{ms(s['wait_p99_ms'])}ms "
+            f"resp {ms(s['response_p50_ms'])}/{ms(s['response_p90_ms'])}/{ms(s['response_p99_ms'])}ms | "
+            f"all p99 wait {ms(s['wait_all_p99_ms'])}ms resp {ms(s['response_all_p99_ms'])}ms")
+
+
+def serve(path):
+    if os.path.exists(path):
+        os.unlink(path)
+    srv = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    srv.bind(path)
+    srv.listen(8)
+    srv.setblocking(False)
+    return srv
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Rolling metrics of a growing job log or trace")
+    ap.add_argument("file", help="loadtest CSV log or scx_fifo_capture trace")
+    ap.add_argument("--window", type=float, default=10.0, help="rolling window, s (default: 10)")
+    ap.add_argument("--interval", type=float, default=1.0, help="refresh period, s (default: 1)")
+    ap.add_argument("--socket", help="serve the latest snapshot as JSON on this unix socket")
+    ap.add_argument("--json", action="store_true", help="print JSON lines instead of a dashboard")
+    ap.add_argument("--fail-p99-ms", type=float, help="exit 2 when the windowed p99 exceeds this")
+    ap.add_argument("--fail-metric", choices=METRICS, default="wait")
+    ap.add_argument("--fail-after", type=int, default=3,
+                    help="consecutive refreshes over the limit before failing (default: 3)")
+    ap.add_argument("--idle-exit", type=float, default=0,
+                    help="exit once the file has not grown for this many s (0: never)")
+    args = ap.parse_args()
+
+    with open(args.file, "rb") as f:
+        is_trace = f.read(len(scxtrace.MAGIC)) == scxtrace.MAGIC
+    src = TraceSource(args.file) if is_trace else CsvSource(args.file)
+    # ten buckets per window keeps the window edge within 10%
+    stats = Rolling(args.window, args.window / 10)
+    srv = serve(args.socket) if args.socket else None
+    tty = sys.stdout.isatty() and not args.json
+    over, last_growth, snap = 0, time.monotonic(), None
+
+    try:
+        while True:
+            if src.poll(stats):
+                last_growth = time.monotonic()
+            snap = snapshot(stats, src)
+            if args.json:
+                print(json.dumps(snap, allow_nan=False), flush=True)
+            else:
+                print(("\r\033[K" if tty else "") + dashboard(snap), end="" if tty else "\n",
+                      flush=True)
+
+            if args.fail_p99_ms is not None:
+                p99 = snap[f"{args.fail_metric}_p99_ms"]
+                over = over + 1 if p99 is not None and p99 > args.fail_p99_ms else 0
+                if over >= args.fail_after:
+                    print(f"\n{args.fail_metric} p99 {p99:.3g}ms > {args.fail_p99_ms:g}ms "
+                          f"for {over} refreshes, giving up", file=sys.stderr)
+                    return 2
+            if args.idle_exit and time.monotonic() - last_growth > args.idle_exit:
+                break
+
+            deadline = time.monotonic() + args.interval
+            while (left := deadline - time.monotonic()) > 0:
+                if not srv:
+                    time.sleep(left)
+                    break
+                if select.select([srv], [], [], left)[0]:
+                    try:
+                        conn, _ = srv.accept()
+                    except BlockingIOError:
+                        continue
+                    with conn:
+                        conn.sendall((json.dumps(snap, allow_nan=False) + "\n").encode())
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if srv:
+            srv.close()
+            os.unlink(args.socket)
+        if tty:
+            print()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
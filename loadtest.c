@@ -2,7 +2,7 @@
  * sched_ext_loadtest.c
  *
  * Build:
- *   gcc -O2 -std=gnu11 -Wall -Wextra -o sched_ext_loadtest sched_ext_loadtest.c
+ *   gcc -O2 -std=gnu11 -Wall -Wextra -o sched_ext_loadtest sched_ext_loadtest.c -lm
  *
  * Example run:
  *   ./sched_ext_loadtest -m 30 -s 12345 -c 0 -o runlog.csv
@@ -10,6 +10,26 @@
  * The program writes CSV lines to the log file (append mode):
  * pid,child_index,start_ns,end_ns,duration_ns,work_iters
  *
+ * A/B mirror mode (-O A_CPUS:B_CPUS, e.g. -O 0-3:4-7): every job is forked
+ * twice with the same arrival and work, one copy pinned to each CPU set.
+ * The A copies log to -o, the B copies to -b (default: <logfile>.b), so
+ * plot.py --mode pair can pair them by child_index. Meant for scx_mlfq -X,
+ * which runs a separate policy configuration on each partition. Both
+ * copies block on a pipe once set up and are released together when the
+ * parent closes it, so neither is favoured by the fork order.
+ *
+ * Fitted workloads (fitload.py): -a draws the gaps between arrivals and -z
+ * the job sizes from a distribution instead of uniform 0..-d ms and -w..-W
+ * iterations; sizes stay clamped to -w..-W. -P modulates the arrival rate
+ * with a sine of the given period, -N fixes the number of jobs. DIST is one
+ * of uniform:LO:HI, exp:MEAN, lognorm:MU:SIGMA (of the log) or
+ * weibull:SHAPE:SCALE, in ms for -a and iterations for -z.
+ *
+ * The parent runs an event loop (loadtest_loop.h): jobs are released on an
+ * absolute schedule and children are reaped as they exit, so arrive_ns is
+ * the scheduled release time and fork or reap work never pushes later
+ * arrivals back. The lateness of the actual releases is printed at exit.
+ *
  * Notes:
  * - Requires a kernel with sched_ext support to actually use the sched_ext scheduler.
  * - If SCHED_EXT is not available in your headers, we fall back to defining it as 7
@@ -34,6 +54,11 @@
 #include <fcntl.h>
 #include <stdarg.h>
 #include <sys/stat.h>
+#include <math.h>
+
+#include "loadtest_usdt.h"
+#include "loadtest_clock.h"
+#include "loadtest_loop.h"
 
 #ifndef SCHED_EXT
     #define SCHED_EXT 7
@@ -64,20 +89,101 @@ static void die(const char *fmt, ...) {
     exit(EXIT_FAILURE);
 }
 
+/* Parse a CPU list like "0-3,8" up to the end or stop char; returns the end or NULL. */
+static const char *parse_cpulist(const char *s, char stop, cpu_set_t *set) {
+    CPU_ZERO(set);
+    while (*s && *s != stop) {
+        char *end;
+        long lo = strtol(s, &end, 10), hi = lo;
+        if (end == s || lo < 0) return NULL;
+        if (*end == '-') {
+            s = end + 1;
+            hi = strtol(s, &end, 10);
+            if (end == s || hi < lo) return NULL;
+        }
+        if (hi >= CPU_SETSIZE) return NULL;
+        for (long c = lo; c <= hi; c++) CPU_SET((int)c, set);
+        s = end;
+        if (*s == ',') s++;
+        else if (*s && *s != stop) return NULL;
+    }
+    return CPU_COUNT(set) ? s : NULL;
+}
+
+enum dist_kind { DIST_NONE, DIST_UNIFORM, DIST_EXP, DIST_LOGNORM, DIST_WEIBULL };
+
+struct dist {
+    enum dist_kind kind;
+    double p1, p2;
+};
+
+static int parse_dist(const char *s, struct dist *d) {
+    static const struct { const char *name; enum dist_kind kind; int nr; } kinds[] = {
+        { "uniform", DIST_UNIFORM, 2 }, { "exp", DIST_EXP, 1 },
+        { "lognorm", DIST_LOGNORM, 2 }, { "weibull", DIST_WEIBULL, 2 },
+    };
+    char name[16];
+    int n = 0;
+    d->p2 = 0;
+    if (sscanf(s, "%15[a-z]:%lf%n:%lf%n", name, &d->p1, &n, &d->p2, &n) < 2 || s[n])
+        return -1;
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        if (strcmp(name, kinds[k].name)) continue;
+        /* count the parameters given: one ':' per parameter */
+        int nr = 0;
+        for (const char *c = s; *c; c++) nr += *c == ':';
+        if (nr != kinds[k].nr || d->p1 < 0 || d->p2 < 0) return -1;
+        if (kinds[k].kind == DIST_WEIBULL && (d->p1 <= 0 || d->p2 <= 0)) return -1;
+        d->kind = kinds[k].kind;
+        return 0;
+    }
+    return -1;
+}
+
+/* Uniform in (0, 1) from rand(), so runs stay reproducible with -s */
+static double rand_unit(void) {
+    return ((double)rand() + 0.5) / ((double)RAND_MAX + 1.0);
+}
+
+static double draw_dist(const struct dist *d) {
+    switch (d->kind) {
+        case DIST_UNIFORM: return d->p1 + (d->p2 - d->p1) * rand_unit();
+        case DIST_EXP:     return -d->p1 * log(rand_unit());
+        case DIST_LOGNORM: {
+            /* Box-Muller */
+            double u1 = rand_unit(), u2 = rand_unit();
+            return exp(d->p1 + d->p2 * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2));
+        }
+        case DIST_WEIBULL: return d->p2 * pow(-log(rand_unit()), 1.0 / d->p1);
+        default:           return 0;
+    }
+}
+
 int main(int argc, char **argv) {
     /* Configurable parameters with reasonable defaults */
     int max_procs = 20;
     unsigned int seed = (unsigned int)time(NULL);
     int cpu_core = 0;
     const char *log_path = "sched_ext_runlog.csv";
+    const char *clk_path = NULL; /* -C: paired RAW/MONOTONIC samples, see loadtest_clock.h */
+    int clk_interval_ms = 100;
     int max_start_delay_ms = 2000; /* max random delay before starting a child */
+    int use_sched_ext = 1; /* -n: stay on SCHED_OTHER (reference runs for sim/schedsim) */
+    int mirror = 0;        /* -O: A/B mirror mode, one copy of each job per CPU set */
+    cpu_set_t part_cpus[2];
+    const char *log_b_path = NULL;
+    char log_b_buf[4096];
     uint64_t min_work_iters = 1000000ULL;
     uint64_t max_work_iters = 5000000ULL;
+    struct dist gap_dist = { DIST_NONE, 0, 0 };  /* -a: ms between arrivals */
+    struct dist size_dist = { DIST_NONE, 0, 0 }; /* -z: work iterations */
+    double period_ms = 0, period_amp = 0;        /* -P: arrival rate modulation */
+    int nr_jobs = 0;                             /* -N: fixed job count */
     // min_work_iters = 0ULL;
     // max_work_iters = 100000ULL;
     
     int opt;
-    while ((opt = getopt(argc, argv, "m:s:c:o:d:w:W:")) != -1) {
+    while ((opt = getopt(argc, argv, "m:s:c:o:d:w:W:nC:I:O:b:a:z:P:N:")) != -1) {
         switch (opt) {
             case 'm': max_procs = atoi(optarg); break;
             case 's': seed = (unsigned int)strtoul(optarg, NULL, 10); break;
@@ -86,11 +192,43 @@ int main(int argc, char **argv) {
             case 'd': max_start_delay_ms = atoi(optarg); break;
             case 'w': min_work_iters = strtoull(optarg, NULL, 10); break;
             case 'W': max_work_iters = strtoull(optarg, NULL, 10); break;
+            case 'n': use_sched_ext = 0; break;
+            case 'C': clk_path = optarg; break;
+            case 'I': clk_interval_ms = atoi(optarg); break;
+            case 'O': {
+                const char *p = parse_cpulist(optarg, ':', &part_cpus[0]);
+                if (!p || *p != ':' || !parse_cpulist(p + 1, '\0', &part_cpus[1]))
+                    die("invalid -O %s, expected A_CPUS:B_CPUS (e.g. 0-3:4-7)\n", optarg);
+                mirror = 1;
+                break;
+            }
+            case 'b': log_b_path = optarg; break;
+            case 'a':
+                if (parse_dist(optarg, &gap_dist)) die("invalid -a %s\n", optarg);
+                break;
+            case 'z':
+                if (parse_dist(optarg, &size_dist)) die("invalid -z %s\n", optarg);
+                break;
+            case 'P':
+                if (sscanf(optarg, "%lf:%lf", &period_ms, &period_amp) != 2 ||
+                    period_ms <= 0 || period_amp < 0 || period_amp >= 1)
+                    die("invalid -P %s, expected PERIOD_MS:AMPLITUDE with 0 <= AMPLITUDE < 1\n", optarg);
+                break;
+            case 'N': nr_jobs = atoi(optarg); break;
             default:
-            fprintf(stderr, "Usage: %s [-m max_procs] [-s seed] [-c cpu_core] [-o logfile] [-d max_start_delay_ms] [-w min_iters] [-W max_iters]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-m max_procs | -N jobs] [-s seed] [-c cpu_core] [-o logfile] [-d max_start_delay_ms] [-w min_iters] [-W max_iters] [-a DIST] [-z DIST] [-P period_ms:amplitude] [-n] [-C clock_sidecar [-I interval_ms]] [-O A_CPUS:B_CPUS [-b logfile_b]]\n", argv[0]);
             return 1;
         }
     }
+    if (mirror) {
+        cpu_set_t both;
+        CPU_AND(&both, &part_cpus[0], &part_cpus[1]);
+        if (CPU_COUNT(&both)) die("-O: the two CPU sets overlap\n");
+        if (!log_b_path) {
+            snprintf(log_b_buf, sizeof(log_b_buf), "%s.b", log_path);
+            log_b_path = log_b_buf;
+        }
+    }
     
     if (max_procs < 1) max_procs = 1;
     if (min_work_iters == 0) min_work_iters = 1;
@@ -99,6 +237,16 @@ int main(int argc, char **argv) {
     /* open log file (replace) -- child processes inherit this FD */
     int logfd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
     if (logfd < 0) die("open(%s): %s\n", log_path, strerror(errno));
+    int logfds[2] = { logfd, -1 };
+    if (mirror) {
+        logfds[1] = open(log_b_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (logfds[1] < 0) die("open(%s): %s\n", log_b_path, strerror(errno));
+    }
+    int clkfd = -1;
+    if (clk_path) {
+        clkfd = open(clk_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (clkfd < 0) die("open(%s): %s\n", clk_path, strerror(errno));
+    }
     
     /* write CSV header (only once per run) */
     {
@@ -106,6 +254,9 @@ int main(int argc, char **argv) {
         if (write(logfd, header, sizeof(header)-1) < 0) {
             /* not fatal; continue */
         }
+        if (mirror && write(logfds[1], header, sizeof(header)-1) < 0) {
+            /* not fatal; continue */
+        }
     }
     
     /* deterministic RNG */
@@ -113,9 +264,14 @@ int main(int argc, char **argv) {
     
     /* random number of processes between 1..max_procs */
     int nprocs = 1 + (rand() % max_procs);
-    printf("Seed=%u, creating %d child processes, cpu_core=%d\n", seed, nprocs, cpu_core);
+    if (nr_jobs > 0) nprocs = nr_jobs;
+    int ncopies = mirror ? 2 : 1;
+    if (mirror)
+        printf("Seed=%u, creating %d child processes per partition (A/B mirror)\n", seed, nprocs);
+    else
+        printf("Seed=%u, creating %d child processes, cpu_core=%d\n", seed, nprocs, cpu_core);
     
-    pid_t *children = calloc(nprocs, sizeof(pid_t));
+    pid_t *children = calloc((size_t)nprocs * ncopies, sizeof(pid_t));
     if (!children) die("calloc failed\n");
     
     struct timespec ts_begin;
@@ -124,120 +280,170 @@ int main(int argc, char **argv) {
         _exit(1);
     }
     uint64_t begin_ns = timespec_to_ns(&ts_begin);
+    if (clkfd >= 0) begin_ns = clk_begin(clkfd);
+
+    struct lt_loop loop;
+    if (lt_loop_init(&loop, begin_ns, clkfd, clk_interval_ms, nprocs) != 0)
+        die("event loop setup failed: %s\n", strerror(errno));
+    uint64_t release_ns = 0; /* scheduled release, relative to begin_ns */
     
     for (int i = 0; i < nprocs; ++i) {
         
-        struct timespec ts_arrive;
-        if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts_arrive)!= 0) {
-            dprintf(logfd, "ERR: pid=%d clock_gettime start failed: %s\n", getpid(), strerror(errno));
-            _exit(1);
-        } 
         /* random delay (so children start at random times) */
-        int delay_ms = (max_start_delay_ms > 0) ? (rand() % (max_start_delay_ms + 1)) : 0;
-        uint64_t arrive_ns = timespec_to_ns(&ts_arrive) + delay_ms * 1000000ULL;
-        if (delay_ms > 0) {
-            usleep((useconds_t)delay_ms * 1000);
-        }
-        pid_t pid = fork();
-        if (pid < 0) {
-            die("fork failed: %s\n", strerror(errno));
-        } else if (pid == 0) {
-            /* child */
-            
-            /* set scheduling policy to SCHED_EXT (if supported) */
-            struct sched_param sp;
-            sp.sched_priority = 0; /* sched_ext uses its own semantics (priority ignored here) */
-            if (sched_setscheduler(0, SCHED_EXT, &sp) != 0) {
-                /* Not fatal — if kernel doesn't have SCHED_EXT this will fail.
-                * We log the error and proceed; scheduling will remain normal (CFS).
-                */
-               dprintf(logfd, "WARN: pid=%d sched_setscheduler(SCHED_EXT) failed: %s\n", getpid(), strerror(errno));
-            }
-            /* set CPU affinity to the chosen core */
-            cpu_set_t cpuset;
-            CPU_ZERO(&cpuset);
-            CPU_SET(cpu_core, &cpuset);
-            if (sched_setaffinity(0, sizeof(cpuset), &cpuset) != 0) {
-                /* affinity failure is non-fatal; we continue but warn */
-                dprintf(logfd, "WARN: pid=%d failed to set affinity to cpu %d: %s\n", getpid(), cpu_core, strerror(errno));
+        uint64_t delay_us;
+        if (gap_dist.kind != DIST_NONE) {
+            double gap_ms = draw_dist(&gap_dist);
+            /* time warp: gaps shrink where the modulated rate is high */
+            if (period_ms > 0) {
+                double t_ms = release_ns / 1e6;
+                gap_ms /= 1.0 + period_amp * sin(2.0 * M_PI * t_ms / period_ms);
             }
+            delay_us = (uint64_t)(gap_ms * 1000.0);
+        } else {
+            int delay_ms = (max_start_delay_ms > 0) ? (rand() % (max_start_delay_ms + 1)) : 0;
+            delay_us = (uint64_t)delay_ms * 1000;
+        }
+        release_ns += delay_us * 1000ULL;
+        uint64_t arrive_ns = begin_ns + release_ns;
+        /* reaps exited children and takes clock samples meanwhile */
+        lt_loop_wait(&loop, release_ns);
+        /* mirror mode: the copies block on this pipe until both are forked */
+        int gate[2] = { -1, -1 };
+        if (mirror && pipe(gate) != 0)
+            die("pipe failed: %s\n", strerror(errno));
+        /* copy 0 is the A copy in mirror mode; rand() state is the same for both */
+        for (int copy = 0; copy < ncopies; ++copy) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                die("fork failed: %s\n", strerror(errno));
+            } else if (pid == 0) {
+                /* child */
+                logfd = logfds[copy];
+
+                /* mirrored copies are pinned before switching class, so they
+                 * never get queued in the other partition */
+                if (mirror && sched_setaffinity(0, sizeof(part_cpus[copy]), &part_cpus[copy]) != 0) {
+                    dprintf(logfd, "WARN: pid=%d failed to set affinity to partition %c: %s\n", getpid(), 'A' + copy, strerror(errno));
+                }
+                
+                /* set scheduling policy to SCHED_EXT (if supported) */
+                struct sched_param sp;
+                sp.sched_priority = 0; /* sched_ext uses its own semantics (priority ignored here) */
+                if (use_sched_ext && sched_setscheduler(0, SCHED_EXT, &sp) != 0) {
+                    /* Not fatal — if kernel doesn't have SCHED_EXT this will fail.
+                    * We log the error and proceed; scheduling will remain normal (CFS).
+                    */
+                   dprintf(logfd, "WARN: pid=%d sched_setscheduler(SCHED_EXT) failed: %s\n", getpid(), strerror(errno));
+                }
+                /* set CPU affinity to the chosen core */
+                cpu_set_t cpuset;
+                CPU_ZERO(&cpuset);
+                CPU_SET(cpu_core, &cpuset);
+                if (!mirror && sched_setaffinity(0, sizeof(cpuset), &cpuset) != 0) {
+                    /* affinity failure is non-fatal; we continue but warn */
+                    dprintf(logfd, "WARN: pid=%d failed to set affinity to cpu %d: %s\n", getpid(), cpu_core, strerror(errno));
+                }
             
-            /* compute work iterations (random) */
-            /* Use rand() inherited from parent; fork copies RNG state so deterministic */
-            uint64_t work_iters = min_work_iters;
-            if (max_work_iters > min_work_iters) {
-                work_iters = min_work_iters + (uint64_t)(rand() % (1 + (int)(max_work_iters - min_work_iters)));
-            }
+                /* compute work iterations (random) */
+                /* Use rand() inherited from parent; fork copies RNG state so deterministic */
+                uint64_t work_iters = min_work_iters;
+                if (size_dist.kind != DIST_NONE) {
+                    double it = draw_dist(&size_dist);
+                    if (it > (double)max_work_iters) it = (double)max_work_iters;
+                    if (it > (double)min_work_iters) work_iters = (uint64_t)it;
+                } else if (max_work_iters > min_work_iters) {
+                    work_iters = min_work_iters + (uint64_t)(rand() % (1 + (int)(max_work_iters - min_work_iters)));
+                }
+                if (mirror) {
+                    char c;
+                    close(gate[1]);
+                    while (read(gate[0], &c, 1) < 0 && errno == EINTR)
+                        ;
+                    close(gate[0]);
+                }
+                LT_PROBE2(job_release, i, work_iters);
             
 
-            /* Memory to store timestamps (captured while the process is actually running) */
-            struct timespec ts_start, ts_end;
-
-            /* IMPORTANT:
-             * The first clock_gettime() and the following busy-loop happen while the
-             * process is actually running on CPU (i.e., the measurement marks the time
-             * when the process first executes the busy loop). We avoid syscalls
-             * in between to prevent voluntary context switches during measured interval.
-             */
-            if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts_start) != 0) {
-                dprintf(logfd, "ERR: pid=%d clock_gettime start failed: %s\n", getpid(), strerror(errno));
-                _exit(1);
-            }
+                /* Memory to store timestamps (captured while the process is actually running) */
+                struct timespec ts_start, ts_end;
 
-            /* Busy work: never perform syscalls or sleeps while measuring */
-            do_busy_work(work_iters);
+                /* IMPORTANT:
+                 * The first clock_gettime() and the following busy-loop happen while the
+                 * process is actually running on CPU (i.e., the measurement marks the time
+                 * when the process first executes the busy loop). We avoid syscalls
+                 * in between to prevent voluntary context switches during measured interval.
+                 */
+                if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts_start) != 0) {
+                    dprintf(logfd, "ERR: pid=%d clock_gettime start failed: %s\n", getpid(), strerror(errno));
+                    _exit(1);
+                }
 
-            if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts_end) != 0) {
-                dprintf(logfd, "ERR: pid=%d clock_gettime end failed: %s\n", getpid(), strerror(errno));
-                _exit(1);
-            }
+                /* Busy work: never perform syscalls or sleeps while measuring */
+                LT_PROBE2(loop_start, i, work_iters);
+                do_busy_work(work_iters);
+                LT_PROBE2(job_end, i, work_iters);
 
-            uint64_t start_ns = timespec_to_ns(&ts_start);
-            uint64_t end_ns   = timespec_to_ns(&ts_end);
-            uint64_t dur_ns   = (end_ns >= start_ns) ? (end_ns - start_ns) : 0;
-
-            /* Format the CSV line in a stack buffer and write via single write() call
-             * to avoid interleaving between processes (atomic for small writes).
-             * The write happens *after* measurements, so it does not change timing.
-             */
-            char buf[256];
-            int len = snprintf(buf, sizeof(buf), "%d,%d,%llu,%llu,%llu,%llu,%llu\n",
-                    (int)getpid(), i,
-                    (unsigned long long)arrive_ns - begin_ns,
-                    (unsigned long long)start_ns - begin_ns,
-                    (unsigned long long)end_ns - begin_ns,
-                    (unsigned long long)dur_ns,
-                    (unsigned long long)work_iters);
-            if (len > 0) {
-                /* Single write call is safer from an atomicity perspective */
-                ssize_t w = write(logfd, buf, (size_t)len);
-                (void)w;
-            }
+                if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts_end) != 0) {
+                    dprintf(logfd, "ERR: pid=%d clock_gettime end failed: %s\n", getpid(), strerror(errno));
+                    _exit(1);
+                }
 
-            _exit(0);
-        } else {
-            /* parent */
-            children[i] = pid;
-        }
-    }
+                uint64_t start_ns = timespec_to_ns(&ts_start);
+                uint64_t end_ns   = timespec_to_ns(&ts_end);
+                uint64_t dur_ns   = (end_ns >= start_ns) ? (end_ns - start_ns) : 0;
 
-    /* parent waits for all children */
-    for (int i = 0; i < nprocs; ++i) {
-        if (children[i] > 0) {
-            int status = 0;
-            waitpid(children[i], &status, 0);
+                /* Format the CSV line in a stack buffer and write via single write() call
+                 * to avoid interleaving between processes (atomic for small writes).
+                 * The write happens *after* measurements, so it does not change timing.
+                 */
+                char buf[256];
+                int len = snprintf(buf, sizeof(buf), "%d,%d,%llu,%llu,%llu,%llu,%llu\n",
+                        (int)getpid(), i,
+                        (unsigned long long)arrive_ns - begin_ns,
+                        (unsigned long long)start_ns - begin_ns,
+                        (unsigned long long)end_ns - begin_ns,
+                        (unsigned long long)dur_ns,
+                        (unsigned long long)work_iters);
+                if (len > 0) {
+                    /* Single write call is safer from an atomicity perspective */
+                    ssize_t w = write(logfd, buf, (size_t)len);
+                    (void)w;
+                }
+
+                _exit(0);
+            } else {
+                /* parent */
+                children[i * ncopies + copy] = pid;
+                lt_loop_watch(&loop, pid);
+                clk_sample(clkfd, "fork");
+            }
+        }
+        if (mirror) {
+            /* EOF releases both copies */
+            close(gate[1]);
+            close(gate[0]);
         }
     }
 
+    /* parent waits for all children (sampling the clocks meanwhile with -C) */
+    lt_loop_drain(&loop);
+    clk_sample(clkfd, "end");
+
     printf("All children finished, log appended to %s\n", log_path);
+    lt_loop_report(&loop);
+    lt_loop_close(&loop);
+    if (mirror)
+        printf("B copies logged to %s\n", log_b_path);
     // print pids
     printf("Child PIDs in order:\n");
-    for (int i = 0; i < nprocs; i++)
+    for (int i = 0; i < nprocs * ncopies; i++)
     {
         printf("\t%d\n", children[i]);
     }
     
     close(logfd);
+    if (mirror) close(logfds[1]);
+    if (clkfd >= 0) close(clkfd);
     free(children);
     return 0;
 }
\ No newline at end of file
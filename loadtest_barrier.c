@@ -0,0 +1,400 @@
+/*
+ * loadtest_barrier.c
+ *
+ * Build:
+ *   gcc -O2 -std=gnu11 -Wall -Wextra -pthread -o loadtest_barrier loadtest_barrier.c
+ *
+ * Example run:
+ *   ./loadtest_barrier -m 4 -T 4 -i 200 -w 200000 -b 50 -s 12345 -c 0 -o barrier.csv
+ *
+ * Fork-join workload: each job is a process with T threads that run
+ * iterations of compute followed by a barrier wait, like an HPC code with
+ * a sync step per time step. An iteration lasts as long as its slowest
+ * thread, so a policy that slices or queues the threads unevenly loses
+ * throughput even when total CPU time is the same.
+ *
+ * Per-iteration imbalance (-b PCT): every thread's compute in every
+ * iteration is w * (1 + PCT/100 * r), r uniform in [0, 1), drawn from a
+ * per-(job, thread) RNG so runs with the same seed are comparable across
+ * policies. The barrier is a pthread_barrier (-B pthread, default) or a
+ * plain futex barrier (-B futex).
+ *
+ * The program writes CSV lines to the log file (replace mode), one per
+ * thread and iteration, all of a thread's lines in one write() at exit:
+ * pid,job,thread,iter,start_ns,compute_ns,wait_ns,work_iters
+ * start_ns is relative to the run's begin (CLOCK_MONOTONIC_RAW), wait_ns
+ * is the time from leaving compute to leaving the barrier.
+ *
+ * At the end the parent reads the log back and prints iterations per
+ * second and the barrier wait distribution; run once per policy to
+ * compare.
+ */
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <linux/futex.h>
+#include <sys/stat.h>
+
+#include "loadtest_usdt.h"
+#include "loadtest_clock.h"
+#include "loadtest_loop.h"
+
+#ifndef SCHED_EXT
+    #define SCHED_EXT 7
+#endif
+
+static inline uint64_t timespec_to_ns(const struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * 1000000000ULL + (uint64_t)ts->tv_nsec;
+}
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return timespec_to_ns(&ts);
+}
+
+/* Busy work function that cannot be optimized away */
+static void do_busy_work(uint64_t iters) {
+    volatile uint64_t sink = 0;
+    for (uint64_t i = 0; i < iters; ++i) {
+        /* some cheap ops to burn CPU without system calls */
+        sink += (i ^ (sink << 1));
+        /* prevent the compiler from optimizing this whole loop out */
+        if ((i & 0x7ffff) == 0) asm volatile("" ::: "memory");
+    }
+    /* use sink in a way the compiler cannot remove */
+    asm volatile("" : : "r"(sink) : "memory");
+}
+
+static void die(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Futex barrier: the last thread to arrive resets the count, bumps the
+ * generation and wakes everyone sleeping on it. gen is read before
+ * arriving so a wakeup for this generation cannot be missed.
+ */
+struct futex_barrier {
+    atomic_uint count;
+    atomic_uint gen;
+    unsigned int n;
+};
+
+static long futex(atomic_uint *uaddr, int op, unsigned int val) {
+    return syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+static void futex_barrier_wait(struct futex_barrier *b) {
+    unsigned int gen = atomic_load(&b->gen);
+    if (atomic_fetch_add(&b->count, 1) + 1 == b->n) {
+        atomic_store(&b->count, 0);
+        atomic_fetch_add(&b->gen, 1);
+        futex(&b->gen, FUTEX_WAKE_PRIVATE, INT_MAX);
+        return;
+    }
+    while (atomic_load(&b->gen) == gen)
+        futex(&b->gen, FUTEX_WAIT_PRIVATE, gen);
+}
+
+struct job {
+    int idx;
+    int use_futex;
+    int iters;
+    uint64_t work_iters;
+    int imbalance_pct;
+    unsigned int seed;
+    uint64_t begin_ns;
+    int logfd;
+    pthread_barrier_t pbar;
+    struct futex_barrier fbar;
+};
+
+struct worker {
+    struct job *job;
+    int thread;
+    pthread_t tid;
+};
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    struct job *job = w->job;
+    unsigned int rs = job->seed ^ (0x9e3779b9u * (unsigned int)(job->idx * 1024 + w->thread + 1));
+    /* one CSV line per iteration, written after the last one */
+    size_t cap = (size_t)job->iters * 128 + 1;
+    char *buf = malloc(cap);
+    size_t len = 0;
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+
+    for (int it = 0; it < job->iters; ++it) {
+        double r = (double)rand_r(&rs) / ((double)RAND_MAX + 1.0);
+        uint64_t work = job->work_iters + (uint64_t)(job->work_iters * (job->imbalance_pct / 100.0) * r);
+
+        uint64_t start_ns = now_ns();
+        do_busy_work(work);
+        uint64_t done_ns = now_ns();
+        if (job->use_futex)
+            futex_barrier_wait(&job->fbar);
+        else
+            pthread_barrier_wait(&job->pbar);
+        uint64_t leave_ns = now_ns();
+
+        if (buf && len < cap) {
+            int n = snprintf(buf + len, cap - len, "%d,%d,%d,%d,%llu,%llu,%llu,%llu\n",
+                    (int)tid, job->idx, w->thread, it,
+                    (unsigned long long)(start_ns - job->begin_ns),
+                    (unsigned long long)(done_ns - start_ns),
+                    (unsigned long long)(leave_ns - done_ns),
+                    (unsigned long long)work);
+            if (n > 0) len += (size_t)n;
+        }
+    }
+
+    if (buf) {
+        ssize_t wr = write(job->logfd, buf, len < cap ? len : cap - 1);
+        (void)wr;
+        free(buf);
+    }
+    return NULL;
+}
+
+static void run_job(struct job *job, int nthreads) {
+    struct worker *ws = calloc(nthreads, sizeof(*ws));
+    if (!ws) die("calloc failed\n");
+
+    if (job->use_futex) {
+        atomic_init(&job->fbar.count, 0);
+        atomic_init(&job->fbar.gen, 0);
+        job->fbar.n = (unsigned int)nthreads;
+    } else if (pthread_barrier_init(&job->pbar, NULL, (unsigned int)nthreads) != 0) {
+        die("pthread_barrier_init failed\n");
+    }
+
+    LT_PROBE2(job_release, job->idx, job->work_iters);
+    /* threads inherit the policy and affinity set on this one */
+    for (int t = 0; t < nthreads; ++t) {
+        ws[t].job = job;
+        ws[t].thread = t;
+        if (pthread_create(&ws[t].tid, NULL, worker_main, &ws[t]) != 0)
+            die("pthread_create failed\n");
+    }
+    for (int t = 0; t < nthreads; ++t)
+        pthread_join(ws[t].tid, NULL);
+    LT_PROBE2(job_end, job->idx, job->work_iters);
+
+    if (!job->use_futex)
+        pthread_barrier_destroy(&job->pbar);
+    free(ws);
+}
+
+/* Iterations/s per job and the barrier wait distribution, from the log */
+static void report(const char *log_path, int njobs, int nthreads, int iters) {
+    FILE *f = fopen(log_path, "r");
+    if (!f) {
+        fprintf(stderr, "reopen(%s): %s\n", log_path, strerror(errno));
+        return;
+    }
+    uint64_t *first = calloc(njobs, sizeof(uint64_t));
+    uint64_t *last = calloc(njobs, sizeof(uint64_t));
+    size_t cap = (size_t)njobs * nthreads * iters, n = 0;
+    uint64_t *waits = malloc(cap * sizeof(uint64_t));
+    if (!first || !last || !waits) die("calloc failed\n");
+    for (int j = 0; j < njobs; ++j) first[j] = UINT64_MAX;
+
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        int pid, job, thread, it;
+        unsigned long long start, compute, wait, work;
+        if (sscanf(line, "%d,%d,%d,%d,%llu,%llu,%llu,%llu", &pid, &job, &thread, &it,
+                   &start, &compute, &wait, &work) != 8)
+            continue;
+        if (job < 0 || job >= njobs) continue;
+        if (start < first[job]) first[job] = start;
+        if (start + compute + wait > last[job]) last[job] = start + compute + wait;
+        if (n < cap) waits[n++] = wait;
+    }
+    fclose(f);
+
+    double sum_rate = 0.0;
+    int nrates = 0;
+    printf("%-6s %12s %12s\n", "JOB", "SPAN(ms)", "ITERS/s");
+    for (int j = 0; j < njobs; ++j) {
+        if (first[j] == UINT64_MAX || last[j] <= first[j]) continue;
+        double span_s = (double)(last[j] - first[j]) / 1e9;
+        double rate = iters / span_s;
+        printf("%-6d %12.3f %12.1f\n", j, span_s * 1e3, rate);
+        sum_rate += rate;
+        ++nrates;
+    }
+    if (nrates)
+        printf("mean iters/s per job: %.1f\n", sum_rate / nrates);
+    if (n) {
+        /* nearest-rank, as loadtest's lateness report */
+        qsort(waits, n, sizeof(uint64_t), lt_cmp_u64);
+        printf("barrier wait (us, %zu waits): p50=%.1f p90=%.1f p99=%.1f max=%.1f\n", n,
+               lt_pct(waits, (int)n, 0.50) / 1e3, lt_pct(waits, (int)n, 0.90) / 1e3,
+               lt_pct(waits, (int)n, 0.99) / 1e3, waits[n - 1] / 1e3);
+    }
+    free(first);
+    free(last);
+    free(waits);
+}
+
+int main(int argc, char **argv) {
+    /* Configurable parameters with reasonable defaults */
+    int max_procs = 4;
+    int nthreads = 4;
+    int iters = 200;
+    unsigned int seed = (unsigned int)time(NULL);
+    int cpu_core = 0;
+    const char *log_path = "sched_ext_barrier.csv";
+    const char *clk_path = NULL; /* -C: paired RAW/MONOTONIC samples, see loadtest_clock.h */
+    int clk_interval_ms = 100;
+    int max_start_delay_ms = 0; /* max random delay before starting a job */
+    int use_sched_ext = 1; /* -n: stay on SCHED_OTHER */
+    uint64_t work_iters = 200000ULL;
+    int imbalance_pct = 0;
+    int use_futex = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:T:i:s:c:o:d:w:b:B:nC:I:")) != -1) {
+        switch (opt) {
+            case 'm': max_procs = atoi(optarg); break;
+            case 'T': nthreads = atoi(optarg); break;
+            case 'i': iters = atoi(optarg); break;
+            case 's': seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'c': cpu_core = atoi(optarg); break;
+            case 'o': log_path = optarg; break;
+            case 'd': max_start_delay_ms = atoi(optarg); break;
+            case 'w': work_iters = strtoull(optarg, NULL, 10); break;
+            case 'b': imbalance_pct = atoi(optarg); break;
+            case 'B':
+                if (!strcmp(optarg, "futex")) use_futex = 1;
+                else if (!strcmp(optarg, "pthread")) use_futex = 0;
+                else die("-B: pthread or futex\n");
+                break;
+            case 'n': use_sched_ext = 0; break;
+            case 'C': clk_path = optarg; break;
+            case 'I': clk_interval_ms = atoi(optarg); break;
+            default:
+            fprintf(stderr, "Usage: %s [-m max_jobs] [-T threads] [-i iterations] [-s seed] [-c cpu_core|-1] [-o logfile] [-d max_start_delay_ms] [-w iters_per_iteration] [-b imbalance_pct] [-B pthread|futex] [-n] [-C clock_sidecar [-I interval_ms]]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (max_procs < 1) max_procs = 1;
+    if (nthreads < 1) nthreads = 1;
+    if (iters < 1) iters = 1;
+    if (work_iters == 0) work_iters = 1;
+    if (imbalance_pct < 0) imbalance_pct = 0;
+
+    /* open log file (replace) -- child processes inherit this FD */
+    int logfd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (logfd < 0) die("open(%s): %s\n", log_path, strerror(errno));
+    int clkfd = -1;
+    if (clk_path) {
+        clkfd = open(clk_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (clkfd < 0) die("open(%s): %s\n", clk_path, strerror(errno));
+    }
+
+    /* write CSV header (only once per run) */
+    {
+        char header[] = "pid,job,thread,iter,start_ns,compute_ns,wait_ns,work_iters\n";
+        if (write(logfd, header, sizeof(header)-1) < 0) {
+            /* not fatal; continue */
+        }
+    }
+
+    /* deterministic RNG */
+    srand(seed);
+
+    /* random number of jobs between 1..max_procs */
+    int njobs = 1 + (rand() % max_procs);
+    printf("Seed=%u, creating %d jobs x %d threads, %d iterations, imbalance=%d%%, barrier=%s, cpu_core=%d\n",
+           seed, njobs, nthreads, iters, imbalance_pct, use_futex ? "futex" : "pthread", cpu_core);
+
+    uint64_t begin_ns = now_ns();
+    if (clkfd >= 0) begin_ns = clk_begin(clkfd);
+
+    /* jobs are released on an absolute schedule, see loadtest_loop.h */
+    struct lt_loop loop;
+    if (lt_loop_init(&loop, begin_ns, clkfd, clk_interval_ms, njobs) != 0)
+        die("event loop setup failed: %s\n", strerror(errno));
+    uint64_t release_ns = 0;
+
+    for (int i = 0; i < njobs; ++i) {
+        int delay_ms = (max_start_delay_ms > 0) ? (rand() % (max_start_delay_ms + 1)) : 0;
+        release_ns += (uint64_t)delay_ms * 1000000ULL;
+        lt_loop_wait(&loop, release_ns);
+        pid_t pid = fork();
+        if (pid < 0) {
+            die("fork failed: %s\n", strerror(errno));
+        } else if (pid == 0) {
+            /* child: one job */
+            struct sched_param sp;
+            sp.sched_priority = 0;
+            if (use_sched_ext && sched_setscheduler(0, SCHED_EXT, &sp) != 0) {
+                dprintf(logfd, "WARN: pid=%d sched_setscheduler(SCHED_EXT) failed: %s\n", getpid(), strerror(errno));
+            }
+            if (cpu_core >= 0) {
+                cpu_set_t cpuset;
+                CPU_ZERO(&cpuset);
+                CPU_SET(cpu_core, &cpuset);
+                if (sched_setaffinity(0, sizeof(cpuset), &cpuset) != 0) {
+                    dprintf(logfd, "WARN: pid=%d failed to set affinity to cpu %d: %s\n", getpid(), cpu_core, strerror(errno));
+                }
+            }
+
+            struct job job = {
+                .idx = i,
+                .use_futex = use_futex,
+                .iters = iters,
+                .work_iters = work_iters,
+                .imbalance_pct = imbalance_pct,
+                .seed = seed,
+                .begin_ns = begin_ns,
+                .logfd = logfd,
+            };
+            run_job(&job, nthreads);
+            _exit(0);
+        } else {
+            /* parent */
+            lt_loop_watch(&loop, pid);
+            clk_sample(clkfd, "fork");
+        }
+    }
+
+    /* parent waits for all children (sampling the clocks meanwhile with -C) */
+    lt_loop_drain(&loop);
+    clk_sample(clkfd, "end");
+
+    printf("All jobs finished, log written to %s\n", log_path);
+    lt_loop_report(&loop);
+    lt_loop_close(&loop);
+    close(logfd);
+    if (clkfd >= 0) close(clkfd);
+
+    report(log_path, njobs, nthreads, iters);
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * loadtest_clock.h
+ *
+ * Clock sidecar of the load generators (-C FILE).
+ *
+ * The CSV log is in CLOCK_MONOTONIC_RAW relative to begin_ns, the BPF
+ * schedulers stamp with bpf_ktime_get_ns() (CLOCK_MONOTONIC). The two run
+ * at different rates while NTP slews, so the generator records paired
+ * samples of both clocks at run start, periodically while children run,
+ * and at run end. clockjoin.py interpolates between them to put the log
+ * on the scheduler's timeline.
+ *
+ * Sidecar format, one CSV row per sample:
+ *   src,tag,raw_ns,mono_ns,err_ns
+ * src is "gen" here ("sched" for the scheduler loaders), tag is begin,
+ * fork, periodic or end; the begin row's raw_ns is the log's begin_ns.
+ * err_ns bounds |mono(raw_ns) - mono_ns| for that sample.
+ */
+#ifndef LOADTEST_CLOCK_H
+#define LOADTEST_CLOCK_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Reads per sample; the tightest bracket wins (filters out preemption). */
+#define CLK_TRIES 8
+
+static inline uint64_t clk_read(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * One paired sample: MONOTONIC read between two MONOTONIC_RAW reads,
+ * taken at the bracket midpoint. The error is half the bracket width.
+ */
+static inline void clk_pair(uint64_t *raw, uint64_t *mono, uint64_t *err) {
+    uint64_t best = UINT64_MAX;
+    *raw = *mono = 0;
+    for (int t = 0; t < CLK_TRIES; ++t) {
+        uint64_t r0 = clk_read(CLOCK_MONOTONIC_RAW);
+        uint64_t m  = clk_read(CLOCK_MONOTONIC);
+        uint64_t r1 = clk_read(CLOCK_MONOTONIC_RAW);
+        if (r1 - r0 < best) {
+            best  = r1 - r0;
+            *raw  = r0 + best / 2;
+            *mono = m;
+        }
+    }
+    *err = best / 2 + 1;
+}
+
+static inline void clk_write(int fd, const char *tag, uint64_t raw, uint64_t mono, uint64_t err) {
+    if (fd < 0) return;
+    dprintf(fd, "gen,%s,%llu,%llu,%llu\n", tag,
+            (unsigned long long)raw, (unsigned long long)mono, (unsigned long long)err);
+}
+
+static inline void clk_sample(int fd, const char *tag) {
+    uint64_t raw, mono, err;
+    if (fd < 0) return;
+    clk_pair(&raw, &mono, &err);
+    clk_write(fd, tag, raw, mono, err);
+}
+
+/*
+ * The begin row: sampled around the caller's begin_ns read, so begin_ns
+ * itself gets a MONOTONIC value. Replaces the plain clock_gettime() of
+ * begin_ns when the sidecar is on.
+ */
+static inline uint64_t clk_begin(int fd) {
+    uint64_t raw, mono, err;
+    if (fd < 0) return clk_read(CLOCK_MONOTONIC_RAW);
+    dprintf(fd, "src,tag,raw_ns,mono_ns,err_ns\n");
+    clk_pair(&raw, &mono, &err);
+    clk_write(fd, "begin", raw, mono, err);
+    return raw;
+}
+
+#endif /* LOADTEST_CLOCK_H */
@@ -34,6 +34,10 @@
 #include <stdarg.h>
 #include <sys/stat.h>
 
+#include "loadtest_usdt.h"
+#include "loadtest_clock.h"
+#include "loadtest_loop.h"
+
 #ifndef SCHED_EXT
     #define SCHED_EXT 7
 #endif
@@ -69,13 +73,15 @@ int main(int argc, char **argv) {
     unsigned int seed = (unsigned int)time(NULL);
     int cpu_core = 0;
     const char *log_path = "sched_ext_runlog.csv";
+    const char *clk_path = NULL; /* -C: paired RAW/MONOTONIC samples, see loadtest_clock.h */
+    int clk_interval_ms = 100;
     int max_start_delay_ms = 2000; /* max random delay before starting a child */
     uint64_t min_work_iters = 1000000ULL;
     uint64_t max_work_iters = 5000000ULL;
     uint64_t unit_iters = 10000ULL; /* iterations per measured slice */
 
     int opt;
-    while ((opt = getopt(argc, argv, "m:s:c:o:d:w:W:u:")) != -1) {
+    while ((opt = getopt(argc, argv, "m:s:c:o:d:w:W:u:C:I:")) != -1) {
         switch (opt) {
             case 'm': max_procs = atoi(optarg); break;
             case 's': seed = (unsigned int)strtoul(optarg, NULL, 10); break;
@@ -85,8 +91,10 @@ int main(int argc, char **argv) {
             case 'w': min_work_iters = strtoull(optarg, NULL, 10); break;
             case 'W': max_work_iters = strtoull(optarg, NULL, 10); break;
             case 'u': unit_iters = strtoull(optarg, NULL, 10); break;
+            case 'C': clk_path = optarg; break;
+            case 'I': clk_interval_ms = atoi(optarg); break;
             default:
-            fprintf(stderr, "Usage: %s [-m max_procs] [-s seed] [-c cpu_core] [-o logfile] [-d max_start_delay_ms] [-w min_iters] [-W max_iters] [-u unit_iters]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-m max_procs] [-s seed] [-c cpu_core] [-o logfile] [-d max_start_delay_ms] [-w min_iters] [-W max_iters] [-u unit_iters] [-C clock_sidecar [-I interval_ms]]\n", argv[0]);
             return 1;
         }
     }
@@ -99,6 +107,11 @@ int main(int argc, char **argv) {
     /* open log file (replace) -- child processes inherit this FD */
     int logfd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
     if (logfd < 0) die("open(%s): %s\n", log_path, strerror(errno));
+    int clkfd = -1;
+    if (clk_path) {
+        clkfd = open(clk_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (clkfd < 0) die("open(%s): %s\n", clk_path, strerror(errno));
+    }
     
     /* write CSV header (only once per run) */
     {
@@ -124,17 +137,20 @@ int main(int argc, char **argv) {
         _exit(1);
     }
     uint64_t begin_ns = timespec_to_ns(&ts_begin);
+    if (clkfd >= 0) begin_ns = clk_begin(clkfd);
+
+    /* jobs are released on an absolute schedule, see loadtest_loop.h */
+    struct lt_loop loop;
+    if (lt_loop_init(&loop, begin_ns, clkfd, clk_interval_ms, nprocs) != 0)
+        die("event loop setup failed: %s\n", strerror(errno));
+    uint64_t release_ns = 0; /* scheduled release, relative to begin_ns */
     
     for (int i = 0; i < nprocs; ++i) {
         
-        struct timespec ts_arrive;
-        if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts_arrive)!= 0) {
-            dprintf(logfd, "ERR: pid=%d clock_gettime start failed: %s\n", getpid(), strerror(errno));
-            _exit(1);
-        } 
         /* random delay (so children start at random times) */
         int delay_ms = (max_start_delay_ms > 0) ? (rand() % (max_start_delay_ms + 1)) : 0;
-        uint64_t arrive_ns = timespec_to_ns(&ts_arrive) + delay_ms * 1000000ULL;
+        release_ns += (uint64_t)delay_ms * 1000000ULL;
+        uint64_t arrive_ns = begin_ns + release_ns;
         /* compute work iterations (random) */
         /* Use rand() inherited from parent; fork copies RNG state so deterministic */
         uint64_t work_iters = min_work_iters;
@@ -152,9 +168,8 @@ int main(int argc, char **argv) {
             dprintf(logfd, "ERR: pid=%d failed to allocate timestamp arrays\n", getpid());
             _exit(1);
         }
-        if (delay_ms > 0) {
-            usleep((useconds_t)delay_ms * 1000);
-        }
+        /* reaps exited children and takes clock samples meanwhile */
+        lt_loop_wait(&loop, release_ns);
         pid_t pid = fork();
         if (pid < 0) {
             die("fork failed: %s\n", strerror(errno));
@@ -164,6 +179,8 @@ int main(int argc, char **argv) {
             struct timespec ts_start, ts_end;
             uint64_t remaining = work_iters;
             uint64_t idx = 0;
+            LT_PROBE2(job_release, i, work_iters);
+            LT_PROBE2(loop_start, i, work_iters);
             while (remaining > 0 && idx < slices) {
                 uint64_t cur = (remaining > unit_iters) ? unit_iters : remaining;
 
@@ -182,10 +199,12 @@ int main(int argc, char **argv) {
 
                 start_ns_arr[idx] = timespec_to_ns(&ts_start);
                 end_ns_arr[idx]   = timespec_to_ns(&ts_end);
+                LT_PROBE3(slice, i, idx, cur);
 
                 remaining -= cur;
                 ++idx;
             }
+            LT_PROBE2(job_end, i, work_iters);
 
             /* Format all slice CSV lines into a single buffer, then write once. */
             size_t estimated_per_line = 120;
@@ -273,6 +292,8 @@ int main(int argc, char **argv) {
         } else {
             /* parent */
             children[i] = pid;
+            lt_loop_watch(&loop, pid);
+            clk_sample(clkfd, "fork");
              /* set scheduling policy to SCHED_EXT (if supported) */
             struct sched_param sp;
             sp.sched_priority = 0; /* sched_ext uses its own semantics (priority ignored here) */
@@ -294,15 +315,13 @@ int main(int argc, char **argv) {
         }
     }
 
-    /* parent waits for all children */
-    for (int i = 0; i < nprocs; ++i) {
-        if (children[i] > 0) {
-            int status = 0;
-            waitpid(children[i], &status, 0);
-        }
-    }
+    /* parent waits for all children (sampling the clocks meanwhile with -C) */
+    lt_loop_drain(&loop);
+    clk_sample(clkfd, "end");
 
     printf("All children finished, log appended to %s\n", log_path);
+    lt_loop_report(&loop);
+    lt_loop_close(&loop);
     // print pids
     printf("Child PIDs in order:\n");
     for (int i = 0; i < nprocs; i++)
@@ -311,6 +330,7 @@ int main(int argc, char **argv) {
     }
     
     close(logfd);
+    if (clkfd >= 0) close(clkfd);
     free(children);
     return 0;
 }
\ No newline at end of file
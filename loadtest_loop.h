@@ -0,0 +1,231 @@
+/*
+ * loadtest_loop.h
+ *
+ * Event loop of the generator parents. The parent only ever blocks in
+ * epoll_wait() on:
+ *   - a timerfd armed at the absolute release time of the next job,
+ *   - one pidfd per child, readable once it exits, so children are reaped
+ *     in exit order instead of one blocking waitpid() each in fork order,
+ *   - a periodic timerfd for the clock sidecar samples (-C, see
+ *     loadtest_clock.h).
+ *
+ * Release times are offsets from the log's begin_ns on one absolute
+ * schedule, so time spent forking and reaping can make one release late
+ * but never shifts the ones after it, unlike a usleep() per gap. The
+ * timers run on CLOCK_MONOTONIC (timerfd has no MONOTONIC_RAW):
+ * lt_loop_init() maps begin_ns onto it with one paired sample, so offset
+ * 0 is begin_ns on both clocks and they only drift apart by the NTP
+ * slew, a few ppm over a run. lt_loop_report() prints how late the
+ * releases were.
+ *
+ * Without pidfd_open() (kernels before 5.3), or once out of descriptors,
+ * children are reaped by waitpid(-1, WNOHANG) sweeps on every wakeup and
+ * at least every LT_SWEEP_MS.
+ */
+#ifndef LOADTEST_LOOP_H
+#define LOADTEST_LOOP_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "loadtest_clock.h"
+
+#ifndef __NR_pidfd_open
+    #define __NR_pidfd_open 434
+#endif
+
+#define LT_SWEEP_MS 10
+#define LT_TAG_RELEASE UINT64_MAX
+#define LT_TAG_CLOCK (UINT64_MAX - 1)
+
+struct lt_loop {
+    int epfd;
+    int rel_tfd;         /* release timer, absolute */
+    int clk_tfd;         /* sidecar samples, periodic; -1: none */
+    int clkfd;
+    uint64_t t0_mono;    /* begin_ns on CLOCK_MONOTONIC, release offset 0 */
+    int left;            /* children not reaped yet */
+    int sweep;           /* some children have no pidfd */
+    uint64_t *late_ns;   /* lateness of each release */
+    int nr_late, max_late;
+};
+
+/* Reap what has exited without blocking; for children without a pidfd. */
+static inline void lt_loop_sweep(struct lt_loop *l) {
+    int status;
+    pid_t pid;
+    while (l->left > 0 && (pid = waitpid(-1, &status, WNOHANG)) != 0) {
+        if (pid < 0) {
+            if (errno == ECHILD) l->left = 0;
+            if (errno != EINTR) break;
+            continue;
+        }
+        --l->left;
+    }
+}
+
+/*
+ * begin_ns is the CLOCK_MONOTONIC_RAW base of the log; release offsets
+ * count from it. max_releases sizes the lateness record. Returns 0, or -1
+ * with errno set if epoll or the timers cannot be created.
+ */
+static inline int lt_loop_init(struct lt_loop *l, uint64_t begin_ns, int clkfd,
+                               int clk_interval_ms, int max_releases) {
+    struct epoll_event ev = { .events = EPOLLIN };
+    uint64_t raw, mono, err;
+    struct rlimit rl;
+
+    memset(l, 0, sizeof(*l));
+    l->clk_tfd = -1;
+    l->clkfd = clkfd;
+
+    /* one pidfd per live child: allow as many as the hard limit does */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    l->epfd = epoll_create1(EPOLL_CLOEXEC);
+    l->rel_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (l->epfd < 0 || l->rel_tfd < 0) return -1;
+    ev.data.u64 = LT_TAG_RELEASE;
+    if (epoll_ctl(l->epfd, EPOLL_CTL_ADD, l->rel_tfd, &ev)) return -1;
+
+    if (clkfd >= 0 && clk_interval_ms > 0) {
+        struct itimerspec its = {
+            .it_interval = { clk_interval_ms / 1000, (long)(clk_interval_ms % 1000) * 1000000L },
+        };
+        its.it_value = its.it_interval;
+        l->clk_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (l->clk_tfd < 0 || timerfd_settime(l->clk_tfd, 0, &its, NULL)) return -1;
+        ev.data.u64 = LT_TAG_CLOCK;
+        if (epoll_ctl(l->epfd, EPOLL_CTL_ADD, l->clk_tfd, &ev)) return -1;
+    }
+
+    l->max_late = max_releases > 0 ? max_releases : 0;
+    l->late_ns = calloc((size_t)l->max_late + 1, sizeof(*l->late_ns));
+    if (!l->late_ns) return -1;
+    clk_pair(&raw, &mono, &err);
+    l->t0_mono = mono - (raw - begin_ns);
+    return 0;
+}
+
+/* Track a forked child; it is reaped by the loop once it exits. */
+static inline void lt_loop_watch(struct lt_loop *l, pid_t pid) {
+    int fd = (int)syscall(__NR_pidfd_open, pid, 0);
+    ++l->left;
+    if (fd >= 0) {
+        struct epoll_event ev = { .events = EPOLLIN };
+        ev.data.u64 = (uint64_t)(uint32_t)pid << 32 | (uint32_t)fd;
+        if (epoll_ctl(l->epfd, EPOLL_CTL_ADD, fd, &ev) == 0) return;
+        close(fd);
+    }
+    l->sweep = 1;
+}
+
+/*
+ * Handle the events of one epoll_wait(). Returns 1 if the release timer
+ * fired. A child reaped by a sweep before its pidfd was seen is counted
+ * by the sweep; its pidfd then finds nothing to wait for.
+ */
+static inline int lt_loop_dispatch(struct lt_loop *l, int timeout_ms) {
+    struct epoll_event evs[64];
+    uint64_t ticks;
+    int released = 0;
+
+    if (l->sweep && (timeout_ms < 0 || timeout_ms > LT_SWEEP_MS)) timeout_ms = LT_SWEEP_MS;
+    int n = epoll_wait(l->epfd, evs, 64, timeout_ms);
+    for (int i = 0; i < n; ++i) {
+        uint64_t tag = evs[i].data.u64;
+        if (tag == LT_TAG_RELEASE) {
+            if (read(l->rel_tfd, &ticks, sizeof(ticks)) > 0) released = 1;
+        } else if (tag == LT_TAG_CLOCK) {
+            if (read(l->clk_tfd, &ticks, sizeof(ticks)) > 0) clk_sample(l->clkfd, "periodic");
+        } else {
+            /* a pidfd that reports the exit before the zombie is waitable
+             * stays readable: keep it until the child is reaped */
+            pid_t pid = (pid_t)(tag >> 32), ret;
+            int status;
+            ret = waitpid(pid, &status, WNOHANG);
+            if (ret == 0 || (ret < 0 && errno == EINTR)) continue;
+            if (ret == pid) --l->left;
+            /* children forked later hold copies of this pidfd, so close()
+             * alone would leave it registered */
+            epoll_ctl(l->epfd, EPOLL_CTL_DEL, (int)(uint32_t)tag, NULL);
+            close((int)(uint32_t)tag);
+        }
+    }
+    if (l->sweep) lt_loop_sweep(l);
+    return released;
+}
+
+/*
+ * Serve children and samples until offset_ns after begin_ns, the release
+ * time of the next job. Returns at once if that is already past.
+ */
+static inline void lt_loop_wait(struct lt_loop *l, uint64_t offset_ns) {
+    uint64_t target = l->t0_mono + offset_ns;
+    uint64_t now = clk_read(CLOCK_MONOTONIC);
+
+    if (now < target) {
+        struct itimerspec its = {
+            .it_value = { (time_t)(target / 1000000000ULL), (long)(target % 1000000000ULL) },
+        };
+        timerfd_settime(l->rel_tfd, TFD_TIMER_ABSTIME, &its, NULL);
+        while (!lt_loop_dispatch(l, -1))
+            ;
+        now = clk_read(CLOCK_MONOTONIC);
+    } else {
+        /* behind schedule: still reap what is ready, without waiting */
+        lt_loop_dispatch(l, 0);
+    }
+    if (l->nr_late < l->max_late) l->late_ns[l->nr_late++] = now - target;
+}
+
+/* Serve children and samples until every watched child is reaped. */
+static inline void lt_loop_drain(struct lt_loop *l) {
+    while (l->left > 0)
+        lt_loop_dispatch(l, -1);
+}
+
+static inline int lt_cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Nearest-rank percentile (0 < q <= 1) of n > 0 sorted values. */
+static inline uint64_t lt_pct(const uint64_t *sorted, int n, double q) {
+    int rank = (int)(q * n);
+    if (rank < q * n) ++rank;
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return sorted[rank - 1];
+}
+
+static inline void lt_loop_report(struct lt_loop *l) {
+    if (!l->nr_late) return;
+    qsort(l->late_ns, (size_t)l->nr_late, sizeof(*l->late_ns), lt_cmp_u64);
+    printf("Release lateness over %d jobs: p50=%.1fus p99=%.1fus max=%.1fus\n", l->nr_late,
+           lt_pct(l->late_ns, l->nr_late, 0.50) / 1e3,
+           lt_pct(l->late_ns, l->nr_late, 0.99) / 1e3,
+           lt_pct(l->late_ns, l->nr_late, 1.0) / 1e3);
+}
+
+static inline void lt_loop_close(struct lt_loop *l) {
+    if (l->clk_tfd >= 0) close(l->clk_tfd);
+    close(l->rel_tfd);
+    close(l->epfd);
+    free(l->late_ns);
+}
+
+#endif /* LOADTEST_LOOP_H */
@@ -35,6 +35,10 @@
 #include <stdarg.h>
 #include <sys/stat.h>
 
+#include "loadtest_usdt.h"
+#include "loadtest_clock.h"
+#include "loadtest_loop.h"
+
 #ifndef SCHED_EXT
     #define SCHED_EXT 7
 #endif
@@ -70,6 +74,8 @@ int main(int argc, char **argv) {
     unsigned int seed = (unsigned int)time(NULL);
     int cpu_core = 0;
     const char *log_path = "sched_ext_runlog.csv";
+    const char *clk_path = NULL; /* -C: paired RAW/MONOTONIC samples, see loadtest_clock.h */
+    int clk_interval_ms = 100;
     int max_start_delay_ms = 2000; /* max random delay before starting a child */
     uint64_t min_work_iters = 1000000ULL;
     uint64_t max_work_iters = 5000000ULL;
@@ -77,7 +83,7 @@ int main(int argc, char **argv) {
     // max_work_iters = 100000ULL;
     
     int opt;
-    while ((opt = getopt(argc, argv, "m:s:c:o:d:w:W:")) != -1) {
+    while ((opt = getopt(argc, argv, "m:s:c:o:d:w:W:C:I:")) != -1) {
         switch (opt) {
             case 'm': max_procs = atoi(optarg); break;
             case 's': seed = (unsigned int)strtoul(optarg, NULL, 10); break;
@@ -86,8 +92,10 @@ int main(int argc, char **argv) {
             case 'd': max_start_delay_ms = atoi(optarg); break;
             case 'w': min_work_iters = strtoull(optarg, NULL, 10); break;
             case 'W': max_work_iters = strtoull(optarg, NULL, 10); break;
+            case 'C': clk_path = optarg; break;
+            case 'I': clk_interval_ms = atoi(optarg); break;
             default:
-            fprintf(stderr, "Usage: %s [-m max_procs] [-s seed] [-c cpu_core] [-o logfile] [-d max_start_delay_ms] [-w min_iters] [-W max_iters]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-m max_procs] [-s seed] [-c cpu_core] [-o logfile] [-d max_start_delay_ms] [-w min_iters] [-W max_iters] [-C clock_sidecar [-I interval_ms]]\n", argv[0]);
             return 1;
         }
     }
@@ -99,6 +107,11 @@ int main(int argc, char **argv) {
     /* open log file (replace) -- child processes inherit this FD */
     int logfd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
     if (logfd < 0) die("open(%s): %s\n", log_path, strerror(errno));
+    int clkfd = -1;
+    if (clk_path) {
+        clkfd = open(clk_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (clkfd < 0) die("open(%s): %s\n", clk_path, strerror(errno));
+    }
     
     /* write CSV header (only once per run) */
     {
@@ -124,6 +137,18 @@ int main(int argc, char **argv) {
         _exit(1);
     }
     uint64_t begin_ns = timespec_to_ns(&ts_begin);
+    if (clkfd >= 0) begin_ns = clk_begin(clkfd);
+
+    /*
+     * Only reaping goes through the event loop. The release delay stays in
+     * the children: sleeping after switching to SCHED_EXT, so that the
+     * release is a wakeup inside the scheduler, is what this generator
+     * tests. Each delay counts from the child's own fork, so one late
+     * fork does not shift the others.
+     */
+    struct lt_loop loop;
+    if (lt_loop_init(&loop, begin_ns, clkfd, clk_interval_ms, 0) != 0)
+        die("event loop setup failed: %s\n", strerror(errno));
     
     for (int i = 0; i < nprocs; ++i) {
         
@@ -168,6 +193,7 @@ int main(int argc, char **argv) {
             if (delay_ms > 0) {
                 usleep((useconds_t)delay_ms * 1000);
             }
+            LT_PROBE2(job_release, i, work_iters);
             
             
             /* Memory to store timestamps (captured while the process is actually running) */
@@ -185,7 +211,9 @@ int main(int argc, char **argv) {
             }
 
             /* Busy work: never perform syscalls or sleeps while measuring */
+            LT_PROBE2(loop_start, i, work_iters);
             do_busy_work(work_iters);
+            LT_PROBE2(job_end, i, work_iters);
 
             if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts_end) != 0) {
                 dprintf(logfd, "ERR: pid=%d clock_gettime end failed: %s\n", getpid(), strerror(errno));
@@ -218,16 +246,15 @@ int main(int argc, char **argv) {
         } else {
             /* parent */
             children[i] = pid;
+            lt_loop_watch(&loop, pid);
+            clk_sample(clkfd, "fork");
         }
     }
 
-    /* parent waits for all children */
-    for (int i = 0; i < nprocs; ++i) {
-        if (children[i] > 0) {
-            int status = 0;
-            waitpid(children[i], &status, 0);
-        }
-    }
+    /* parent waits for all children (sampling the clocks meanwhile with -C) */
+    lt_loop_drain(&loop);
+    clk_sample(clkfd, "end");
+    lt_loop_close(&loop);
 
     printf("All children finished, log appended to %s\n", log_path);
     // print pids
@@ -238,6 +265,7 @@ int main(int argc, char **argv) {
     }
     
     close(logfd);
+    if (clkfd >= 0) close(clkfd);
     free(children);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,441 @@
+/*
+ * loadtest_storm.c
+ *
+ * Build:
+ *   gcc -O2 -std=gnu11 -Wall -Wextra -pthread -o loadtest_storm loadtest_storm.c
+ *
+ * Example run:
+ *   ./loadtest_storm -N 4000 -b 20 -r 5 -M futex -o storm.csv
+ *
+ * Wakeup storm (thundering herd): N threads sleep until a release point
+ * and are all woken at once, -b times at -r releases per second. This is
+ * where the enqueue path and the shared DSQ lock take the most load.
+ *
+ *   -M futex  the main thread bumps a generation word and FUTEX_WAKEs all
+ *             waiters in one call (a broadcast)
+ *   -M timer  every thread sleeps to the same absolute CLOCK_MONOTONIC
+ *             deadline (clock_nanosleep TIMER_ABSTIME), so N hrtimers
+ *             expire together
+ *
+ * A thread that has not gone back to sleep by the next release (the
+ * previous herd is still draining) handles that release as soon as it
+ * gets there, so its latency includes the backlog.
+ *
+ * Per release the program reports the drain time (release until the last
+ * woken thread has run) and the wake-to-run latency distribution; N over
+ * the drain time is the rate at which the policy got woken tasks onto
+ * CPUs, its enqueue throughput limit at this herd size. With -S (default:
+ * the scheds/scx_stats.h pin, when present) the scheduler's stats counters
+ * are read before and after and their deltas printed per wakeup.
+ *
+ * The program writes CSV lines to the log file (replace mode), one per
+ * thread and release, after the last release:
+ * burst,thread,tid,cpu,release_ns,latency_ns
+ * release_ns is relative to the run's begin (CLOCK_MONOTONIC), cpu is
+ * where the thread ran after waking.
+ */
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <linux/futex.h>
+#include <linux/bpf.h>
+#include <sys/stat.h>
+
+#ifndef SCHED_EXT
+    #define SCHED_EXT 7
+#endif
+
+/* scheds/scx_stats.h */
+#define SCX_STATS_PIN "/sys/fs/bpf/scx_stats"
+
+/*
+ * Release times and wakeups are all on CLOCK_MONOTONIC: the timer mode
+ * sleeps on it, and the futex mode uses the same so both are comparable.
+ */
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline struct timespec ns_to_timespec(uint64_t ns) {
+    struct timespec ts = { (time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL) };
+    return ts;
+}
+
+/* Busy work function that cannot be optimized away */
+static void do_busy_work(uint64_t iters) {
+    volatile uint64_t sink = 0;
+    for (uint64_t i = 0; i < iters; ++i) {
+        /* some cheap ops to burn CPU without system calls */
+        sink += (i ^ (sink << 1));
+        /* prevent the compiler from optimizing this whole loop out */
+        if ((i & 0x7ffff) == 0) asm volatile("" ::: "memory");
+    }
+    /* use sink in a way the compiler cannot remove */
+    asm volatile("" : : "r"(sink) : "memory");
+}
+
+static void die(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Pinned per-cpu stats array, read with the bpf(2) syscall directly so
+ * the generators keep building without libbpf.
+ */
+struct pinned_stats {
+    int fd;
+    uint32_t nr;            /* max_entries */
+    uint32_t stride;        /* per-cpu value size, 8 byte aligned */
+    int nr_cpus;            /* possible CPUs */
+};
+
+static long sys_bpf(int cmd, union bpf_attr *attr) {
+    return syscall(SYS_bpf, cmd, attr, sizeof(*attr));
+}
+
+static int nr_possible_cpus(void) {
+    FILE *f = fopen("/sys/devices/system/cpu/possible", "r");
+    int max = -1, a, b;
+    char sep;
+    if (!f) return -1;
+    /* "0-7" or "0,2-5,8" */
+    while (fscanf(f, "%d", &a) == 1) {
+        b = a;
+        if (fscanf(f, "%c", &sep) == 1 && sep == '-') {
+            if (fscanf(f, "%d", &b) != 1) break;
+            if (fscanf(f, "%c", &sep) != 1) sep = '\n';
+        }
+        if (b > max) max = b;
+        if (sep != ',') break;
+    }
+    fclose(f);
+    return max + 1;
+}
+
+static int stats_open(struct pinned_stats *ps, const char *path) {
+    union bpf_attr attr;
+    struct bpf_map_info info;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.pathname = (uint64_t)(uintptr_t)path;
+    ps->fd = (int)sys_bpf(BPF_OBJ_GET, &attr);
+    if (ps->fd < 0) return -errno;
+
+    memset(&info, 0, sizeof(info));
+    memset(&attr, 0, sizeof(attr));
+    attr.info.bpf_fd = (uint32_t)ps->fd;
+    attr.info.info_len = sizeof(info);
+    attr.info.info = (uint64_t)(uintptr_t)&info;
+    if (sys_bpf(BPF_OBJ_GET_INFO_BY_FD, &attr) < 0 ||
+        info.type != BPF_MAP_TYPE_PERCPU_ARRAY) {
+        close(ps->fd);
+        ps->fd = -1;
+        return -EINVAL;
+    }
+    ps->nr = info.max_entries;
+    ps->stride = (info.value_size + 7) & ~7u;
+    ps->nr_cpus = nr_possible_cpus();
+    if (ps->nr_cpus <= 0 || info.value_size != sizeof(uint64_t)) {
+        close(ps->fd);
+        ps->fd = -1;
+        return -EINVAL;
+    }
+    return 0;
+}
+
+/* Sum over CPUs of every entry into out[ps->nr] */
+static void stats_read(const struct pinned_stats *ps, uint64_t *out) {
+    uint64_t *vals = calloc((size_t)ps->nr_cpus, ps->stride);
+    if (!vals) die("calloc failed\n");
+    for (uint32_t i = 0; i < ps->nr; ++i) {
+        union bpf_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.map_fd = (uint32_t)ps->fd;
+        attr.key = (uint64_t)(uintptr_t)&i;
+        attr.value = (uint64_t)(uintptr_t)vals;
+        out[i] = 0;
+        if (sys_bpf(BPF_MAP_LOOKUP_ELEM, &attr) < 0) continue;
+        for (int c = 0; c < ps->nr_cpus; ++c)
+            out[i] += vals[c * (ps->stride / sizeof(uint64_t))];
+    }
+    free(vals);
+}
+
+struct storm {
+    int use_timer;
+    int nthreads;
+    int nbursts;
+    uint64_t work_iters;
+    uint64_t *release_ns;       /* [nbursts], absolute */
+    atomic_uint gen;            /* futex mode: number of releases so far */
+    atomic_int ready;           /* threads started */
+    /* [nbursts * nthreads], absolute wake-to-run end points */
+    uint64_t *run_ns;
+    int *run_cpu;
+    pid_t *tids;
+};
+
+struct worker {
+    struct storm *s;
+    int idx;
+};
+
+static long futex(atomic_uint *uaddr, int op, unsigned int val) {
+    return syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    struct storm *s = w->s;
+
+    s->tids[w->idx] = (pid_t)syscall(SYS_gettid);
+    atomic_fetch_add(&s->ready, 1);
+
+    for (int b = 0; b < s->nbursts; ++b) {
+        if (s->use_timer) {
+            struct timespec ts = ns_to_timespec(s->release_ns[b]);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+                ;
+        } else {
+            unsigned int g;
+            while ((g = atomic_load(&s->gen)) <= (unsigned int)b)
+                futex(&s->gen, FUTEX_WAIT_PRIVATE, g);
+        }
+        size_t k = (size_t)b * s->nthreads + w->idx;
+        s->run_ns[k] = now_ns();
+        s->run_cpu[k] = sched_getcpu();
+        if (s->work_iters) do_busy_work(s->work_iters);
+    }
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t pct(const uint64_t *v, size_t n, double p) {
+    size_t i = (size_t)(p * (double)(n - 1) + 0.5);
+    return v[i < n ? i : n - 1];
+}
+
+int main(int argc, char **argv) {
+    /* Configurable parameters with reasonable defaults */
+    int nthreads = 2000;
+    int nbursts = 20;
+    double rate = 5.0;          /* releases per second */
+    int cpu_core = -1;          /* -1: no affinity, the herd spreads over all CPUs */
+    const char *log_path = "sched_ext_storm.csv";
+    const char *stats_path = NULL;
+    int use_sched_ext = 1;
+    int use_timer = 0;
+    uint64_t work_iters = 10000ULL;
+    size_t stack_kb = 64;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "N:b:r:M:c:o:w:S:k:n")) != -1) {
+        switch (opt) {
+            case 'N': nthreads = atoi(optarg); break;
+            case 'b': nbursts = atoi(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'M':
+                if (!strcmp(optarg, "timer")) use_timer = 1;
+                else if (!strcmp(optarg, "futex")) use_timer = 0;
+                else die("-M: futex or timer\n");
+                break;
+            case 'c': cpu_core = atoi(optarg); break;
+            case 'o': log_path = optarg; break;
+            case 'w': work_iters = strtoull(optarg, NULL, 10); break;
+            case 'S': stats_path = optarg; break;
+            case 'k': stack_kb = strtoull(optarg, NULL, 10); break;
+            case 'n': use_sched_ext = 0; break;
+            default:
+            fprintf(stderr, "Usage: %s [-N threads] [-b bursts] [-r bursts_per_s] [-M futex|timer] [-c cpu_core|-1] [-o logfile] [-w iters_after_wake] [-S stats_pin] [-k stack_kb] [-n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (nthreads < 1) nthreads = 1;
+    if (nbursts < 1) nbursts = 1;
+    if (rate <= 0.0) rate = 1.0;
+    if (stack_kb < 16) stack_kb = 16;
+
+    FILE *log = fopen(log_path, "w");
+    if (!log) die("open(%s): %s\n", log_path, strerror(errno));
+
+    /* scheduler counters: -S, else the shared pin if a scheduler left one */
+    struct pinned_stats ps = { .fd = -1 };
+    uint64_t *st0 = NULL, *st1 = NULL;
+    {
+        const char *path = stats_path ? stats_path : SCX_STATS_PIN;
+        int ret = stats_open(&ps, path);
+        if (ret && stats_path) die("stats %s: %s\n", path, strerror(-ret));
+        if (!ret) {
+            st0 = calloc(ps.nr, sizeof(uint64_t));
+            st1 = calloc(ps.nr, sizeof(uint64_t));
+            if (!st0 || !st1) die("calloc failed\n");
+        }
+    }
+
+    /* threads inherit the policy and affinity of the main thread */
+    struct sched_param sp;
+    sp.sched_priority = 0;
+    if (use_sched_ext && sched_setscheduler(0, SCHED_EXT, &sp) != 0) {
+        fprintf(stderr, "WARN: sched_setscheduler(SCHED_EXT) failed: %s\n", strerror(errno));
+    }
+    if (cpu_core >= 0) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu_core, &cpuset);
+        if (sched_setaffinity(0, sizeof(cpuset), &cpuset) != 0) {
+            fprintf(stderr, "WARN: failed to set affinity to cpu %d: %s\n", cpu_core, strerror(errno));
+        }
+    }
+
+    struct storm s = {
+        .use_timer = use_timer,
+        .nthreads = nthreads,
+        .nbursts = nbursts,
+        .work_iters = work_iters,
+    };
+    s.release_ns = calloc(nbursts, sizeof(uint64_t));
+    s.run_ns = calloc((size_t)nbursts * nthreads, sizeof(uint64_t));
+    s.run_cpu = calloc((size_t)nbursts * nthreads, sizeof(int));
+    s.tids = calloc(nthreads, sizeof(pid_t));
+    pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+    struct worker *ws = calloc(nthreads, sizeof(*ws));
+    if (!s.release_ns || !s.run_ns || !s.run_cpu || !s.tids || !threads || !ws)
+        die("calloc failed\n");
+    atomic_init(&s.gen, 0);
+    atomic_init(&s.ready, 0);
+
+    /*
+     * Release schedule, fixed up front: timer mode threads sleep on it,
+     * and the first release leaves time for all threads to start.
+     */
+    uint64_t period_ns = (uint64_t)(1e9 / rate);
+    uint64_t begin_ns = now_ns();
+    uint64_t first_ns = begin_ns + 500ULL * 1000000ULL + (uint64_t)nthreads * 50000ULL;
+    for (int b = 0; b < nbursts; ++b)
+        s.release_ns[b] = first_ns + (uint64_t)b * period_ns;
+
+    printf("Storm: %d threads x %d releases at %.2f/s, mode=%s, cpu_core=%d\n",
+           nthreads, nbursts, rate, use_timer ? "timer" : "futex", cpu_core);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, stack_kb * 1024);
+    for (int t = 0; t < nthreads; ++t) {
+        ws[t].s = &s;
+        ws[t].idx = t;
+        int ret = pthread_create(&threads[t], &attr, worker_main, &ws[t]);
+        if (ret) die("pthread_create(%d): %s\n", t, strerror(ret));
+    }
+    pthread_attr_destroy(&attr);
+    while (atomic_load(&s.ready) < nthreads)
+        usleep(1000);
+    if (now_ns() > first_ns)
+        fprintf(stderr, "WARN: threads started after the first release\n");
+
+    if (ps.fd >= 0) stats_read(&ps, st0);
+
+    if (!use_timer) {
+        for (int b = 0; b < nbursts; ++b) {
+            struct timespec ts = ns_to_timespec(s.release_ns[b]);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+                ;
+            /* the actual release, not the planned one */
+            s.release_ns[b] = now_ns();
+            atomic_fetch_add(&s.gen, 1);
+            futex(&s.gen, FUTEX_WAKE_PRIVATE, INT_MAX);
+        }
+    }
+    for (int t = 0; t < nthreads; ++t)
+        pthread_join(threads[t], NULL);
+
+    if (ps.fd >= 0) stats_read(&ps, st1);
+
+    /* per release: drain time and latency distribution */
+    uint64_t *lat = malloc((size_t)nthreads * sizeof(uint64_t));
+    uint64_t *all = malloc((size_t)nbursts * nthreads * sizeof(uint64_t));
+    uint64_t *drains = malloc((size_t)nbursts * sizeof(uint64_t));
+    if (!lat || !all || !drains) die("malloc failed\n");
+    size_t nall = 0;
+
+    fprintf(log, "burst,thread,tid,cpu,release_ns,latency_ns\n");
+    printf("%-6s %12s %12s %10s %10s %10s %10s\n",
+           "BURST", "DRAIN(us)", "WAKES/s", "p50(us)", "p90(us)", "p99(us)", "max(us)");
+    for (int b = 0; b < nbursts; ++b) {
+        for (int t = 0; t < nthreads; ++t) {
+            size_t k = (size_t)b * nthreads + t;
+            uint64_t r = s.run_ns[k];
+            lat[t] = r > s.release_ns[b] ? r - s.release_ns[b] : 0;
+            all[nall++] = lat[t];
+            fprintf(log, "%d,%d,%d,%d,%llu,%llu\n", b, t, (int)s.tids[t], s.run_cpu[k],
+                    (unsigned long long)(s.release_ns[b] - begin_ns),
+                    (unsigned long long)lat[t]);
+        }
+        qsort(lat, nthreads, sizeof(uint64_t), cmp_u64);
+        drains[b] = lat[nthreads - 1];
+        printf("%-6d %12.1f %12.0f %10.1f %10.1f %10.1f %10.1f\n", b,
+               drains[b] / 1e3, drains[b] ? nthreads / (drains[b] / 1e9) : 0.0,
+               pct(lat, nthreads, 0.50) / 1e3, pct(lat, nthreads, 0.90) / 1e3,
+               pct(lat, nthreads, 0.99) / 1e3, lat[nthreads - 1] / 1e3);
+    }
+    fclose(log);
+
+    qsort(all, nall, sizeof(uint64_t), cmp_u64);
+    qsort(drains, nbursts, sizeof(uint64_t), cmp_u64);
+    uint64_t drain_p50 = pct(drains, nbursts, 0.50);
+    printf("wake-to-run (us, %zu wakeups): p50=%.1f p90=%.1f p99=%.1f max=%.1f\n", nall,
+           pct(all, nall, 0.50) / 1e3, pct(all, nall, 0.90) / 1e3,
+           pct(all, nall, 0.99) / 1e3, all[nall - 1] / 1e3);
+    printf("drain (us): p50=%.1f max=%.1f -> enqueue throughput %.0f wakeups/s\n",
+           drain_p50 / 1e3, drains[nbursts - 1] / 1e3,
+           drain_p50 ? nthreads / (drain_p50 / 1e9) : 0.0);
+
+    if (ps.fd >= 0) {
+        printf("scheduler stats (%s), delta and per wakeup:\n", stats_path ? stats_path : SCX_STATS_PIN);
+        for (uint32_t i = 0; i < ps.nr; ++i) {
+            uint64_t d = st1[i] - st0[i];
+            if (!d) continue;
+            printf("  [%u] %llu (%.3f)\n", i, (unsigned long long)d, (double)d / nall);
+        }
+        close(ps.fd);
+    }
+    printf("Log written to %s\n", log_path);
+
+    free(lat);
+    free(all);
+    free(drains);
+    free(st0);
+    free(st1);
+    free(s.release_ns);
+    free(s.run_ns);
+    free(s.run_cpu);
+    free(s.tids);
+    free(threads);
+    free(ws);
+    return 0;
+}
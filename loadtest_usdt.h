@@ -0,0 +1,37 @@
+/*
+ * loadtest_usdt.h
+ *
+ * USDT probes of the load generators (provider "loadtest"), so workload
+ * phases can be lined up with scheduler events on the tracer's clock:
+ *
+ *   job_release(job, work_iters)        child is runnable (after its delay)
+ *   loop_start(job, work_iters)         first instruction of the busy loop
+ *   slice(job, slice_idx, slice_iters)  end of one micro-slice (divided)
+ *   job_end(job, work_iters)            busy loop done
+ *
+ * job is the child_index of the CSV log. scheds/scx_fifo_capture -u attaches
+ * to these and merges them into its trace.
+ *
+ * A probe is a single nop plus an ELF note; arguments are left in
+ * registers and nothing runs unless a uprobe is attached. Builds without
+ * <sys/sdt.h> (systemtap-sdt-dev) or with -DLOADTEST_NO_USDT get no probes.
+ */
+#ifndef LOADTEST_USDT_H
+#define LOADTEST_USDT_H
+
+#if !defined(LOADTEST_NO_USDT) && defined(__has_include)
+    #if __has_include(<sys/sdt.h>)
+        #include <sys/sdt.h>
+        #define LOADTEST_HAVE_USDT 1
+    #endif
+#endif
+
+#ifdef LOADTEST_HAVE_USDT
+    #define LT_PROBE2(name, a, b)       DTRACE_PROBE2(loadtest, name, a, b)
+    #define LT_PROBE3(name, a, b, c)    DTRACE_PROBE3(loadtest, name, a, b, c)
+#else
+    #define LT_PROBE2(name, a, b)       do { (void)(a); (void)(b); } while (0)
+    #define LT_PROBE3(name, a, b, c)    do { (void)(a); (void)(b); (void)(c); } while (0)
+#endif
+
+#endif /* LOADTEST_USDT_H */
@@ -1,5 +1,6 @@
 import argparse
 import pandas as pd
+import fastlog
 import matplotlib.pyplot as plt
 from matplotlib.lines import Line2D
 from matplotlib import transforms
@@ -10,17 +11,12 @@ STEP = 0.15            # how much lower each next stack goes (in axes fraction)
 MIN_BOTTOM = -3      # don't go lower than this (axes fraction)
 LABEL_PAD = 0.01        # extra gap below the line for the label (axes fraction)
 
-def prepare_data(file_path):
+def prepare_data(file_path, run=None):
     """
-    Read CSV, coerce numeric types, sort and build a color map for child_index.
+    Read CSV (native loader when built), sort and build a color map for child_index.
     Returns: df, id_to_color
     """
-    df = pd.read_csv(file_path)
-
-    # ensure numeric types and reset index
-    for col in ("arrive_ns", "start_ns", "end_ns", "duration_ns"):
-        if col in df.columns:
-            df[col] = pd.to_numeric(df[col], errors="coerce").astype("Int64")
+    df = fastlog.read_frame(file_path, run=run)
 
     df = df.sort_values("start_ns").reset_index(drop=True)
 
@@ -34,8 +30,8 @@ def prepare_data(file_path):
     return df, id_to_color
 
 
-def plot_2d_gantt(file_path):
-    df = pd.read_csv(file_path)
+def plot_2d_gantt(file_path, run=None):
+    df = fastlog.read_frame(file_path, run=run)
     df = df.sort_values(by="start_ns")
 
     fig, ax = plt.subplots(figsize=(12, 6))
@@ -56,8 +52,8 @@ def plot_2d_gantt(file_path):
     return fig
 
 
-def plot_1d_gantt(file_path):
-    df, id_to_color = prepare_data(file_path)
+def plot_1d_gantt(file_path, run=None):
+    df, id_to_color = prepare_data(file_path, run=run)
 
     # figure a bit taller to give room for stacked arrival labels
     fig, ax = plt.subplots(figsize=(9, 1.6))
@@ -173,6 +169,141 @@ def plot_1d_gantt(file_path):
 
     return fig
 
+def job_summary(df):
+    """
+    Collapse a log to one row per job (child_index).
+    Works for both one-line-per-job logs and microslice logs: arrival is the
+    earliest arrive_ns, first run the earliest start_ns and completion the
+    latest end_ns of the job, and work_iters the sum over its slices. Adds
+    wait_ns (arrival -> first run) and turnaround_ns (arrival -> completion).
+    """
+    df = df.copy()
+    if "arrive_ns" not in df.columns:
+        df["arrive_ns"] = df["start_ns"]
+    df["arrive_ns"] = df["arrive_ns"].where(df["arrive_ns"].notna(), df["start_ns"])
+
+    jobs = df.groupby("child_index", as_index=False).agg(
+        arrive_ns=("arrive_ns", "min"),
+        start_ns=("start_ns", "min"),
+        end_ns=("end_ns", "max"),
+        work_iters=("work_iters", "sum"),
+    )
+    for col in ("arrive_ns", "start_ns", "end_ns"):
+        jobs[col] = jobs[col].astype("int64")
+    jobs["wait_ns"] = jobs["start_ns"] - jobs["arrive_ns"]
+    jobs["turnaround_ns"] = jobs["end_ns"] - jobs["arrive_ns"]
+    return jobs
+
+
+def pair_jobs(file_a, file_b, run_a=None, run_b=None):
+    """
+    Join two runs on (child_index, work_iters). The generators are
+    deterministic per seed, so the same job appears in both runs.
+    Returns a DataFrame with _a/_b columns and per-job deltas (b - a).
+    """
+    jobs_a = job_summary(fastlog.read_frame(file_a, run=run_a))
+    jobs_b = job_summary(fastlog.read_frame(file_b, run=run_b))
+    paired = jobs_a.merge(jobs_b, on=["child_index", "work_iters"], suffixes=("_a", "_b"))
+
+    unmatched = len(jobs_a) + len(jobs_b) - 2 * len(paired)
+    if unmatched:
+        print(f"Warning: {unmatched} job(s) only present in one run (different seed or params?)")
+
+    paired["wait_delta_ns"] = paired["wait_ns_b"] - paired["wait_ns_a"]
+    paired["turnaround_delta_ns"] = paired["turnaround_ns_b"] - paired["turnaround_ns_a"]
+    return paired.sort_values("child_index").reset_index(drop=True)
+
+
+def print_pair_summary(paired, labels):
+    la, lb = labels
+    n = len(paired)
+    print(f"Paired jobs: {n} ({la} vs {lb}, delta = {lb} - {la})")
+    if n == 0:
+        return
+    for metric in ("wait", "turnaround"):
+        d = paired[f"{metric}_delta_ns"] / 1e6
+        helped = int((d < 0).sum())
+        hurt = int((d > 0).sum())
+        print(f"  {metric:<10} mean {la}={paired[f'{metric}_ns_a'].mean() / 1e6:.3f} ms"
+              f"  {lb}={paired[f'{metric}_ns_b'].mean() / 1e6:.3f} ms"
+              f"  delta mean={d.mean():+.3f} ms median={d.median():+.3f} ms"
+              f"  {lb} helps {helped} / hurts {hurt} job(s)")
+
+
+def plot_pair(file_a, file_b, labels=("FIFO", "MLFQ"), run_a=None, run_b=None):
+    """
+    Paired per-job comparison of two runs of the same job list:
+      - per-job wait and turnaround deltas,
+      - ranked waterfall of the turnaround delta,
+      - scatter of response (wait) and turnaround times, a vs b.
+    Negative deltas mean the second policy helped that job.
+    """
+    paired = pair_jobs(file_a, file_b, run_a=run_a, run_b=run_b)
+    print_pair_summary(paired, labels)
+    la, lb = labels
+
+    fig, axes = plt.subplots(2, 2, figsize=(13, 9))
+    ax_delta, ax_fall, ax_wait, ax_tat = axes.flat
+
+    if paired.empty:
+        for ax in axes.flat:
+            ax.text(0.5, 0.5, "No matching jobs", ha="center", va="center")
+        return fig
+
+    ms = 1e6
+    x = range(len(paired))
+    width = 0.4
+
+    # per-job deltas, in job order
+    ax_delta.bar([i - width / 2 for i in x], paired["wait_delta_ns"] / ms,
+                 width=width, label="wait delta")
+    ax_delta.bar([i + width / 2 for i in x], paired["turnaround_delta_ns"] / ms,
+                 width=width, label="turnaround delta")
+    ax_delta.axhline(0, color="black", linewidth=0.8)
+    ax_delta.set_xticks(list(x))
+    ax_delta.set_xticklabels([str(c) for c in paired["child_index"]], fontsize=7)
+    ax_delta.set_xlabel("child_index")
+    ax_delta.set_ylabel(f"{lb} - {la} (ms)")
+    ax_delta.set_title("Per-job deltas")
+    ax_delta.legend(fontsize=8)
+
+    # ranked waterfall: jobs sorted by turnaround delta, running sum on top
+    ranked = paired.sort_values("turnaround_delta_ns").reset_index(drop=True)
+    deltas = ranked["turnaround_delta_ns"] / ms
+    bottoms = deltas.cumsum() - deltas
+    colors = ["tab:green" if d < 0 else "tab:red" for d in deltas]
+    ax_fall.bar(range(len(ranked)), deltas, bottom=bottoms, color=colors)
+    ax_fall.plot(range(len(ranked)), deltas.cumsum(), color="black",
+                 linewidth=0.8, marker=".", label="cumulative")
+    ax_fall.axhline(0, color="black", linewidth=0.8)
+    ax_fall.set_xticks(range(len(ranked)))
+    ax_fall.set_xticklabels([str(c) for c in ranked["child_index"]], fontsize=7)
+    ax_fall.set_xlabel("child_index (ranked)")
+    ax_fall.set_ylabel(f"turnaround {lb} - {la} (ms)")
+    ax_fall.set_title(f"Ranked waterfall (green: {lb} helps, red: {lb} hurts)")
+    ax_fall.legend(fontsize=8)
+
+    # scatter plots with y = x reference
+    for ax, metric, title in ((ax_wait, "wait", "Response time (arrival -> first run)"),
+                              (ax_tat, "turnaround", "Turnaround time")):
+        a = paired[f"{metric}_ns_a"] / ms
+        b = paired[f"{metric}_ns_b"] / ms
+        ax.scatter(a, b, s=18)
+        for cid, xa, yb in zip(paired["child_index"], a, b):
+            ax.annotate(str(cid), (xa, yb), fontsize=6, xytext=(2, 2), textcoords="offset points")
+        hi = max(a.max(), b.max()) * 1.05 if len(a) else 1
+        ax.plot([0, hi], [0, hi], linestyle="--", color="gray", linewidth=1)
+        ax.set_xlim(0, hi)
+        ax.set_ylim(0, hi)
+        ax.set_xlabel(f"{la} (ms)")
+        ax.set_ylabel(f"{lb} (ms)")
+        ax.set_title(f"{title}: below the line = {lb} faster")
+        ax.grid(True, linestyle="--", alpha=0.4)
+
+    fig.suptitle(f"Paired per-job comparison: {la} vs {lb} ({len(paired)} jobs)")
+    plt.tight_layout()
+    return fig
+
 def main():
     parser = argparse.ArgumentParser(description="Plot Gantt charts from scheduling CSV data.")
     parser.add_argument("--input", "-i", default="test.csv",
@@ -181,16 +312,29 @@ def main():
                         help="Output image file (e.g. output.png). If omitted, no file is saved.")
     parser.add_argument("--no-gui", action="store_true",
                         help="Do not launch the GUI display.")
-    parser.add_argument("--mode", choices=["1d", "2d"], default="1d",
-                        help="Select plot type: 1d or 2d (default: 1d)")
+    parser.add_argument("--mode", choices=["1d", "2d", "pair"], default="1d",
+                        help="Select plot type: 1d, 2d or pair (default: 1d)")
+    parser.add_argument("--run", type=int, default=None,
+                        help="Only plot the N-th run of an appended log such as runlog.csv (default: all rows)")
+    parser.add_argument("--compare", "-c",
+                        help="pair mode: second run to compare against --input (same seed/params)")
+    parser.add_argument("--compare-run", type=int, default=None,
+                        help="pair mode: run index inside the --compare file (default: all rows)")
+    parser.add_argument("--labels", nargs=2, default=["FIFO", "MLFQ"], metavar=("A", "B"),
+                        help="pair mode: names of the --input and --compare policies (default: FIFO MLFQ)")
 
     args = parser.parse_args()
 
     # Generate plot
-    if args.mode == "1d":
-        fig = plot_1d_gantt(args.input)
+    if args.mode == "pair":
+        if not args.compare:
+            parser.error("--mode pair requires --compare FILE")
+        fig = plot_pair(args.input, args.compare, labels=tuple(args.labels),
+                        run_a=args.run, run_b=args.compare_run)
+    elif args.mode == "1d":
+        fig = plot_1d_gantt(args.input, run=args.run)
     else:
-        fig = plot_2d_gantt(args.input)
+        fig = plot_2d_gantt(args.input, run=args.run)
 
     # Save if requested
     if args.output:
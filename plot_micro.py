@@ -1,5 +1,6 @@
 import argparse
 import pandas as pd
+import fastlog
 import matplotlib.pyplot as plt
 from matplotlib.lines import Line2D
 from matplotlib import transforms
@@ -15,17 +16,12 @@ DEFAULT_MERGE_GAP_NS = 1_000_000    # merge microslices separated by <= this gap
 DEFAULT_MAX_DURATION_NS = 100_000     # if set (int), ignore slices longer than this
 
 
-def read_and_coerce(file_path):
+def read_and_coerce(file_path, run=None):
     """
-    Read CSV and coerce numeric time columns to integer (or Int64).
+    Read CSV with numeric time columns (native loader when built, see fastlog.py).
     Returns a DataFrame.
     """
-    df = pd.read_csv(file_path)
-
-    # ensure numeric types where present
-    for col in ("arrive_ns", "start_ns", "end_ns", "duration_ns"):
-        if col in df.columns:
-            df[col] = pd.to_numeric(df[col], errors="coerce")
+    df = fastlog.read_frame(file_path, run=run)
 
     # if duration_ns is missing but start/end exist, compute it
     if "duration_ns" not in df.columns and ("start_ns" in df.columns and "end_ns" in df.columns):
@@ -189,13 +185,13 @@ def merge_slices(df, merge_gap_ns=DEFAULT_MERGE_GAP_NS, max_duration_ns=DEFAULT_
     return merged_df
 
 
-def prepare_data(file_path, merge_gap_ns=DEFAULT_MERGE_GAP_NS, max_duration_ns=DEFAULT_MAX_DURATION_NS):
+def prepare_data(file_path, merge_gap_ns=DEFAULT_MERGE_GAP_NS, max_duration_ns=DEFAULT_MAX_DURATION_NS, run=None):
     """
     Read CSV, coerce numeric types, REMOVE oversized raw rows,
     then merge microslices, and build a color map.
     Returns: merged_df, id_to_color
     """
-    df = read_and_coerce(file_path)
+    df = read_and_coerce(file_path, run=run)
 
     # -------------------------------------------------
     # 🔥 REMOVE large rows BEFORE merging (your request)
@@ -230,7 +226,7 @@ def prepare_data(file_path, merge_gap_ns=DEFAULT_MERGE_GAP_NS, max_duration_ns=D
 
     return df_merged, id_to_color
 
-def plot_2d_gantt(file_path, merge_gap_ns=DEFAULT_MERGE_GAP_NS, max_duration_ns=DEFAULT_MAX_DURATION_NS):
+def plot_2d_gantt(file_path, merge_gap_ns=DEFAULT_MERGE_GAP_NS, max_duration_ns=DEFAULT_MAX_DURATION_NS, run=None):
     """
     2D Gantt: horizontal bars per pid.
     Ensures all rectangles of the same PID have the same color.
@@ -240,7 +236,8 @@ def plot_2d_gantt(file_path, merge_gap_ns=DEFAULT_MERGE_GAP_NS, max_duration_ns=
     df_merged, _ = prepare_data(
         file_path,
         merge_gap_ns=merge_gap_ns,
-        max_duration_ns=max_duration_ns
+        max_duration_ns=max_duration_ns,
+        run=run
     )
 
     fig, ax = plt.subplots(figsize=(12, 6))
@@ -325,11 +322,11 @@ def plot_2d_gantt(file_path, merge_gap_ns=DEFAULT_MERGE_GAP_NS, max_duration_ns=
 
     plt.tight_layout()
     return fig
-def plot_1d_gantt(file_path, merge_gap_ns=DEFAULT_MERGE_GAP_NS, max_duration_ns=DEFAULT_MAX_DURATION_NS):
+def plot_1d_gantt(file_path, merge_gap_ns=DEFAULT_MERGE_GAP_NS, max_duration_ns=DEFAULT_MAX_DURATION_NS, run=None):
     """
     1D timeline with stacked arrival labels. Uses merged slices.
     """
-    df, id_to_color = prepare_data(file_path, merge_gap_ns=merge_gap_ns, max_duration_ns=max_duration_ns)
+    df, id_to_color = prepare_data(file_path, merge_gap_ns=merge_gap_ns, max_duration_ns=max_duration_ns, run=run)
 
     # figure a bit taller to give room for stacked arrival labels
     fig, ax = plt.subplots(figsize=(9, 1.6))
@@ -488,14 +485,16 @@ def main():
                         help=f"Merge microslices separated by <= this gap (ns). Default: {DEFAULT_MERGE_GAP_NS}")
     parser.add_argument("--max-duration", type=int, default=DEFAULT_MAX_DURATION_NS,
                         help="Ignore merged slices whose duration (ns) is greater than this value. Default: None (don't drop)")
+    parser.add_argument("--run", type=int, default=None,
+                        help="Only plot the N-th run of an appended log such as runlog.csv (default: all rows)")
 
     args = parser.parse_args()
 
     # Generate plot
     if args.mode == "1d":
-        fig = plot_1d_gantt(args.input, merge_gap_ns=args.merge_gap, max_duration_ns=args.max_duration)
+        fig = plot_1d_gantt(args.input, merge_gap_ns=args.merge_gap, max_duration_ns=args.max_duration, run=args.run)
     else:
-        fig = plot_2d_gantt(args.input, merge_gap_ns=args.merge_gap, max_duration_ns=args.max_duration)
+        fig = plot_2d_gantt(args.input, merge_gap_ns=args.merge_gap, max_duration_ns=args.max_duration, run=args.run)
 
     # Save if requested
     if args.output:
@@ -23,12 +23,16 @@ UEI_DEFINE(uei);
  */
 #define FIFO_DSQ 0
 
-/* Optional stats: [0]=local dispatches, [1]=global FIFO queue dispatches */
+/*
+ * Optional stats: [0]=local dispatches, [1]=global FIFO queue dispatches,
+ * [2]=idle CPUs kicked for a queued task, [3]=queued with no idle CPU,
+ * [4]=dispatch found nothing and prev kept the CPU (no switch)
+ */
 struct {
 	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
 	__uint(key_size, sizeof(u32));
 	__uint(value_size, sizeof(u64));
-	__uint(max_entries, 2);
+	__uint(max_entries, 5);
 } stats SEC(".maps");
 
 static __always_inline void stat_inc(u32 idx)
@@ -38,6 +42,23 @@ static __always_inline void stat_inc(u32 idx)
 		(*cnt_p)++;
 }
 
+/*
+ * A task queued on the shared DSQ only runs once some CPU enters dispatch.
+ * If a CPU is sitting idle, claim and kick it so it comes to fetch the
+ * work instead of waiting for its next wakeup.
+ */
+static __always_inline void kick_idle_cpu(struct task_struct *p)
+{
+	s32 cpu = scx_bpf_pick_idle_cpu(p->cpus_ptr, 0);
+
+	if (cpu >= 0) {
+		stat_inc(2);
+		scx_bpf_kick_cpu(cpu, SCX_KICK_IDLE);
+	} else {
+		stat_inc(3);
+	}
+}
+
 s32 BPF_STRUCT_OPS(fifo_select_cpu, struct task_struct *p, s32 prev_cpu,
 		   u64 wake_flags)
 {
@@ -63,12 +84,21 @@ void BPF_STRUCT_OPS(fifo_enqueue, struct task_struct *p, u64 enq_flags)
 	stat_inc(1);
 	/* Enqueue to the tail of the shared DSQ -> FIFO order. */
 	scx_bpf_dispatch(p, FIFO_DSQ, SCX_SLICE_DFL, enq_flags);
+	kick_idle_cpu(p);
 }
 
 void BPF_STRUCT_OPS(fifo_dispatch, s32 cpu, struct task_struct *prev)
 {
 	/* Consume from shared FIFO DSQ whenever this CPU needs a task. */
-	scx_bpf_consume(FIFO_DSQ);
+	if (scx_bpf_consume(FIFO_DSQ))
+		return;
+
+	/*
+	 * Queue empty: without SCX_OPS_ENQ_LAST the kernel keeps a
+	 * still-runnable prev on the CPU with a SCX_SLICE_DFL refill.
+	 */
+	if (prev && (prev->scx.flags & SCX_TASK_QUEUED))
+		stat_inc(4);
 }
 
 s32 BPF_STRUCT_OPS_SLEEPABLE(fifo_init)
@@ -9,6 +9,7 @@
 #include <stdarg.h>
 #include <bpf/bpf.h>
 #include <scx/common.h>
+#include "scx_stats.h"
 #include "scx_fifo.bpf.skel.h"
 
 const char help_fmt[] =
@@ -35,17 +36,20 @@ static void sigint_handler(int dummy)
 	exit_req = 1;
 }
 
+/* Entries of the per-cpu stats array, see the .bpf.c */
+#define NR_STATS 5
+
 static void read_stats(struct scx_fifo *skel, __u64 *out)
 {
 	int nr_cpus = libbpf_num_possible_cpus();
-	__u64 cnts[2][nr_cpus];
+	__u64 cnts[NR_STATS][nr_cpus];
 	__u32 idx;
 
-	out[0] = out[1] = 0;
-
-	for (idx = 0; idx < 2; idx++) {
+	for (idx = 0; idx < NR_STATS; idx++) {
 		int ret, cpu;
 
+		out[idx] = 0;
+
 		ret = bpf_map_lookup_elem(bpf_map__fd(skel->maps.stats),
 					  &idx, cnts[idx]);
 		if (ret < 0)
@@ -81,15 +85,18 @@ restart:
 
 	SCX_OPS_LOAD(skel, fifo_ops, scx_fifo, uei);
 	link = SCX_OPS_ATTACH(skel, fifo_ops, scx_fifo);
+	scx_stats_pin(skel->maps.stats);
 
 	while (!exit_req && !UEI_EXITED(skel, uei)) {
-		__u64 stats[2];
+		__u64 stats[NR_STATS];
 		read_stats(skel, stats);
-		printf("local=%llu global=%llu\n", stats[0], stats[1]);
+		printf("local=%llu global=%llu idle_kicks=%llu no_idle=%llu keep=%llu\n",
+		       stats[0], stats[1], stats[2], stats[3], stats[4]);
 		fflush(stdout);
 		sleep(1);
 	}
 
+	scx_stats_unpin();
 	bpf_link__destroy(link);
 	ecode = UEI_REPORT(skel, uei);
 	scx_fifo__destroy(skel);
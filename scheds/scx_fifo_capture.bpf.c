@@ -10,8 +10,16 @@
  *   - This is intentionally simple and mirrors the structure of the sample
  *     schedulers (scx_simple / scx_central).
  *   - No priority / vruntime / time accounting beyond the default slice.
+ *   - With trace_enabled, enqueue/running/stopping and the load generators'
+ *     USDT probes (attached by userspace) are streamed through one ring
+ *     buffer, see scx_fifo_capture.h. Events are sampled per type as
+ *     trace_ctl says, and scheduler events are batched per CPU so a
+ *     context switch does not cost a ring buffer reservation of its own.
  */
 #include <scx/common.bpf.h>
+#include <bpf/usdt.bpf.h>
+
+#include "scx_fifo_capture.h"
 
 char _license[] SEC("license") = "GPL";
 
@@ -23,10 +31,14 @@ UEI_DEFINE(uei);
  */
 #define FIFO_DSQ 0
 
+/* Set by userspace (-t) before load; no events are produced otherwise. */
+const volatile bool trace_enabled;
+
 /* Per-task runtime state for instrumentation */
 struct task_ctx {
 	u64 enq_ts;	/* when task was enqueued (ready) */
 	u64 run_ts;	/* when task started running */
+	u8  queued;	/* enq_ts is from the shared DSQ, not a direct dispatch */
 };
 
 struct {
@@ -37,13 +49,22 @@ struct {
 } task_ctx_stor SEC(".maps");
 
 /* Per-process (tgid) FIFO statistics */
+#define PROC_WAIT_BUCKETS 32
+
 struct proc_stats_val {
 	u64 total_wait_ns;	/* sum of (run_start - enq) */
 	u64 wait_events;	/* number of wait samples */
 	u64 cs;			/* context switches into the task */
 	u64 cpu_ns;		/* CPU time while running */
+	/* waits by log2(ns), bucket i = [2^i, 2^(i+1)), the last one open-ended */
+	u64 wait_hist[PROC_WAIT_BUCKETS];
+	/* comm of the first thread seen running, kept after the process exits */
+	char comm[16];
 };
 
+/* Too big for the BPF stack next to everything else in running. */
+static const struct proc_stats_val pstats_zero;
+
 struct {
 	__uint(type, BPF_MAP_TYPE_HASH);
 	__uint(max_entries, 16384);
@@ -51,19 +72,236 @@ struct {
 	__type(value, struct proc_stats_val);
 } proc_stats SEC(".maps");
 
-/* Optional stats: [0]=local dispatches, [1]=global FIFO queue dispatches */
+/*
+ * Optional stats: [0]=local dispatches, [1]=global FIFO queue dispatches,
+ * [2]=idle CPUs kicked for a queued task, [3]=queued with no idle CPU,
+ * [4]=total ns spent on the shared DSQ, [5]=number of such waits,
+ * [6]=dispatch found nothing and prev kept the CPU (no switch),
+ * [7]=trace events dropped (ring buffer full)
+ */
 struct {
 	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
 	__uint(key_size, sizeof(u32));
 	__uint(value_size, sizeof(u64));
-	__uint(max_entries, 2);
+	__uint(max_entries, 8);
 } stats SEC(".maps");
 
-static __always_inline void stat_inc(u32 idx)
+/* Trace stream, drained by userspace */
+struct {
+	__uint(type, BPF_MAP_TYPE_RINGBUF);
+	__uint(max_entries, 1 << 22);
+} events SEC(".maps");
+
+/* Sampling and batching knobs, written by userspace */
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, u32);
+	__type(value, struct capture_trace_ctl);
+} trace_ctl SEC(".maps");
+
+/*
+ * Pending scheduler events of each CPU. Only the sched_ext ops append
+ * here; they run with IRQs disabled and never nest on a CPU. The USDT
+ * programs can be preempted by a context switch, so they bypass it.
+ */
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, u32);
+	__type(value, struct capture_batch);
+} batches SEC(".maps");
+
+/* Per event type, see struct capture_type_cnt */
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, CAP_EV_MAX);
+	__type(key, u32);
+	__type(value, struct capture_type_cnt);
+} trace_cnt SEC(".maps");
+
+static __always_inline void stat_add(u32 idx, u64 v)
 {
 	u64 *cnt_p = bpf_map_lookup_elem(&stats, &idx);
 	if (cnt_p)
-		(*cnt_p)++;
+		(*cnt_p) += v;
+}
+
+static __always_inline void stat_inc(u32 idx)
+{
+	stat_add(idx, 1);
+}
+
+/*
+ * A task queued on the shared DSQ only runs once some CPU enters dispatch.
+ * If a CPU is sitting idle, claim and kick it so it comes to fetch the
+ * work instead of waiting for its next wakeup.
+ */
+static __always_inline void kick_idle_cpu(struct task_struct *p)
+{
+	s32 cpu = scx_bpf_pick_idle_cpu(p->cpus_ptr, 0);
+
+	if (cpu >= 0) {
+		stat_inc(2);
+		scx_bpf_kick_cpu(cpu, SCX_KICK_IDLE);
+	} else {
+		stat_inc(3);
+	}
+}
+
+static __always_inline struct capture_type_cnt *type_cnt(u16 type)
+{
+	u32 idx = type;
+
+	return bpf_map_lookup_elem(&trace_cnt, &idx);
+}
+
+/*
+ * Keep 1 in 2^shift of the events of a type: by a hash of the thread id,
+ * so the kept tasks have all their events, or, for pid 0, by the per-CPU
+ * sequence in seq (no batch: always kept).
+ */
+static __always_inline bool trace_sampled(struct capture_trace_ctl *ctl, u32 pid,
+					  u16 type, struct capture_batch *b)
+{
+	u32 shift, key;
+
+	if (!ctl || type >= CAP_EV_MAX || !ctl->sample_shift[type])
+		return true;
+	shift = ctl->sample_shift[type];
+	if (shift > CAP_MAX_SHIFT)
+		shift = CAP_MAX_SHIFT;
+	if (pid)
+		key = (pid * 0x9E3779B1U) >> 16;
+	else if (b)
+		key = b->seq[type]++;
+	else
+		return true;
+	return !(key & ((1U << shift) - 1));
+}
+
+static __always_inline void fill_event(struct capture_event *ev, u64 now, u32 pid,
+				       u16 type, u64 a0, u64 a1, u64 a2)
+{
+	ev->ts_ns = now;
+	ev->pid = pid;
+	ev->type = type;
+	ev->cpu = bpf_get_smp_processor_id();
+	ev->arg[0] = a0;
+	ev->arg[1] = a1;
+	ev->arg[2] = a2;
+}
+
+/* Drops are counted in stats[7] and per type. */
+static __always_inline void batch_flush(struct capture_batch *b)
+{
+	u32 nr = b->nr, i;
+
+	if (nr > CAP_BATCH)
+		nr = CAP_BATCH;
+	b->nr = 0;
+	if (!nr || !bpf_ringbuf_output(&events, b->ev, nr * sizeof(b->ev[0]), 0))
+		return;
+	stat_add(7, nr);
+	bpf_for(i, 0, nr) {
+		struct capture_type_cnt *cnt;
+
+		if (i >= CAP_BATCH)
+			break;
+		cnt = type_cnt(b->ev[i].type);
+		if (cnt)
+			cnt->dropped++;
+	}
+}
+
+/*
+ * Scheduler events: appended to this CPU's batch, which goes out when it
+ * is full or its oldest event is flush_ns old. A quiet CPU's last events
+ * wait for its next one (userspace drains the rest at exit).
+ */
+static __always_inline void trace_event(u32 pid, u16 type, u64 a0, u64 a1, u64 a2)
+{
+	struct capture_trace_ctl *ctl;
+	struct capture_type_cnt *cnt;
+	struct capture_batch *b;
+	u32 zero = 0, idx;
+	u64 now;
+
+	b = bpf_map_lookup_elem(&batches, &zero);
+	if (!b)
+		return;
+	ctl = bpf_map_lookup_elem(&trace_ctl, &zero);
+	cnt = type_cnt(type);
+	if (!trace_sampled(ctl, pid, type, b)) {
+		if (cnt)
+			cnt->sampled_out++;
+		return;
+	}
+
+	now = bpf_ktime_get_ns();
+	idx = b->nr;
+	if (idx >= CAP_BATCH) {
+		batch_flush(b);
+		idx = 0;
+	}
+	if (!idx)
+		b->first_ts = now;
+	fill_event(&b->ev[idx], now, pid, type, a0, a1, a2);
+	b->nr = idx + 1;
+	if (cnt)
+		cnt->emitted++;
+
+	if (b->nr == CAP_BATCH || !ctl || now - b->first_ts >= ctl->flush_ns)
+		batch_flush(b);
+}
+
+/* USDT events: one record each; dropped when the ring buffer is full. */
+static __always_inline void trace_direct(u32 pid, u16 type, u64 a0, u64 a1, u64 a2)
+{
+	struct capture_trace_ctl *ctl;
+	struct capture_type_cnt *cnt;
+	struct capture_event *ev;
+	u32 zero = 0;
+
+	ctl = bpf_map_lookup_elem(&trace_ctl, &zero);
+	cnt = type_cnt(type);
+	if (!trace_sampled(ctl, pid, type, NULL)) {
+		if (cnt)
+			cnt->sampled_out++;
+		return;
+	}
+	if (cnt)
+		cnt->emitted++;
+
+	ev = bpf_ringbuf_reserve(&events, sizeof(*ev), 0);
+	if (!ev) {
+		stat_inc(7);
+		if (cnt)
+			cnt->dropped++;
+		return;
+	}
+	fill_event(ev, bpf_ktime_get_ns(), pid, type, a0, a1, a2);
+	bpf_ringbuf_submit(ev, 0);
+}
+
+static __always_inline void trace_sched(struct task_struct *p, u16 type, u64 arg)
+{
+	if (trace_enabled)
+		trace_event(p->pid, type, arg, 0, 0);
+}
+
+/* The cpumask words past the first are not recorded, see capture_event_type. */
+static __always_inline void trace_enqueue(struct task_struct *p, u64 enq_flags)
+{
+	if (trace_enabled)
+		trace_event(p->pid, CAP_EV_ENQUEUE, enq_flags, p->nr_cpus_allowed,
+			    p->cpus_ptr->bits[0]);
+}
+
+static __always_inline void trace_usdt(u16 type, u64 a0, u64 a1, u64 a2)
+{
+	if (trace_enabled)
+		trace_direct((u32)bpf_get_current_pid_tgid(), type, a0, a1, a2);
 }
 
 static __always_inline struct task_ctx *get_tctx(struct task_struct *p)
@@ -79,15 +317,28 @@ static __always_inline u32 get_tgid(struct task_struct *p)
 static __always_inline struct proc_stats_val *get_pstats(u32 tgid)
 {
 	struct proc_stats_val *ps;
-	struct proc_stats_val zero = {};
 
 	ps = bpf_map_lookup_elem(&proc_stats, &tgid);
 	if (ps)
 		return ps;
-	bpf_map_update_elem(&proc_stats, &tgid, &zero, BPF_NOEXIST);
+	bpf_map_update_elem(&proc_stats, &tgid, &pstats_zero, BPF_NOEXIST);
 	return bpf_map_lookup_elem(&proc_stats, &tgid);
 }
 
+static __always_inline u32 wait_bucket(u64 v)
+{
+	u32 r = 0, shift;
+
+	/* log2 by binary search: shifts of 32, 16, 8, 4, 2, 1 */
+	for (shift = 32; shift; shift >>= 1) {
+		if (v >> shift) {
+			v >>= shift;
+			r += shift;
+		}
+	}
+	return r < PROC_WAIT_BUCKETS ? r : PROC_WAIT_BUCKETS - 1;
+}
+
 s32 BPF_STRUCT_OPS(fifo_select_cpu, struct task_struct *p, s32 prev_cpu,
 		   u64 wake_flags)
 {
@@ -114,17 +365,36 @@ s32 BPF_STRUCT_OPS(fifo_select_cpu, struct task_struct *p, s32 prev_cpu,
 void BPF_STRUCT_OPS(fifo_enqueue, struct task_struct *p, u64 enq_flags)
 {
 	struct task_ctx *tctx = get_tctx(p);
-	if (tctx)
+
+	trace_enqueue(p, enq_flags);
+	if (tctx) {
 		tctx->enq_ts = bpf_ktime_get_ns();
+		tctx->queued = 1;
+	}
 	stat_inc(1);
 	/* Enqueue to the tail of the shared DSQ -> FIFO order. */
 	scx_bpf_dispatch(p, FIFO_DSQ, SCX_SLICE_DFL, enq_flags);
+	kick_idle_cpu(p);
 }
 
 void BPF_STRUCT_OPS(fifo_dispatch, s32 cpu, struct task_struct *prev)
 {
+	s32 depth = trace_enabled ? scx_bpf_dsq_nr_queued(FIFO_DSQ) : 0;
+	bool consumed;
+
 	/* Consume from shared FIFO DSQ whenever this CPU needs a task. */
-	scx_bpf_consume(FIFO_DSQ);
+	consumed = scx_bpf_consume(FIFO_DSQ);
+	if (trace_enabled)
+		trace_event(0, CAP_EV_DISPATCH, depth, consumed, 0);
+	if (consumed)
+		return;
+
+	/*
+	 * Queue empty: without SCX_OPS_ENQ_LAST the kernel keeps a
+	 * still-runnable prev on the CPU with a SCX_SLICE_DFL refill.
+	 */
+	if (prev && (prev->scx.flags & SCX_TASK_QUEUED))
+		stat_inc(6);
 }
 
 void BPF_STRUCT_OPS(fifo_running, struct task_struct *p)
@@ -134,6 +404,8 @@ void BPF_STRUCT_OPS(fifo_running, struct task_struct *p)
 	u64 now;
 	u32 tgid;
 
+	trace_sched(p, CAP_EV_RUNNING, 0);
+
 	if (!tctx)
 		return;
 
@@ -141,13 +413,22 @@ void BPF_STRUCT_OPS(fifo_running, struct task_struct *p)
 	tgid = get_tgid(p);
 	ps = get_pstats(tgid);
 	if (ps) {
+		/* p, not current: running is called before the switch */
+		if (!ps->comm[0])
+			bpf_probe_read_kernel_str(ps->comm, sizeof(ps->comm), p->comm);
 		ps->cs++;
 		if (tctx->enq_ts) {
 			ps->total_wait_ns += now - tctx->enq_ts;
 			ps->wait_events++;
-			tctx->enq_ts = 0;
+			ps->wait_hist[wait_bucket(now - tctx->enq_ts)]++;
 		}
 	}
+	if (tctx->enq_ts && tctx->queued) {
+		stat_add(4, now - tctx->enq_ts);
+		stat_inc(5);
+	}
+	tctx->enq_ts = 0;
+	tctx->queued = 0;
 	tctx->run_ts = now;
 }
 
@@ -158,6 +439,8 @@ void BPF_STRUCT_OPS(fifo_stopping, struct task_struct *p, bool runnable)
 	u64 now;
 	u32 tgid;
 
+	trace_sched(p, CAP_EV_STOPPING, runnable);
+
 	if (!tctx || !tctx->run_ts)
 		return;
 
@@ -169,12 +452,24 @@ void BPF_STRUCT_OPS(fifo_stopping, struct task_struct *p, bool runnable)
 	tctx->run_ts = 0;
 }
 
+/*
+ * Idle transitions for the work-conservation check (workcons.py). The
+ * built-in idle tracking stays on (SCX_OPS_KEEP_BUILTIN_IDLE), this only
+ * observes it.
+ */
+void BPF_STRUCT_OPS(fifo_update_idle, s32 cpu, bool idle)
+{
+	if (trace_enabled)
+		trace_event(0, CAP_EV_IDLE, idle, 0, 0);
+}
+
 void BPF_STRUCT_OPS(fifo_enable, struct task_struct *p)
 {
 	struct task_ctx *tctx = get_tctx(p);
 	if (tctx) {
 		tctx->enq_ts = 0;
 		tctx->run_ts = 0;
+		tctx->queued = 0;
 	}
 }
 
@@ -187,6 +482,35 @@ s32 BPF_STRUCT_OPS(fifo_init_task, struct task_struct *p,
 	return -ENOMEM;
 }
 
+/* loadtest_usdt.h probes; attached per generator binary by userspace. */
+SEC("usdt")
+int BPF_USDT(lt_job_release, int job, u64 work)
+{
+	trace_usdt(CAP_EV_JOB_RELEASE, job, work, 0);
+	return 0;
+}
+
+SEC("usdt")
+int BPF_USDT(lt_loop_start, int job, u64 work)
+{
+	trace_usdt(CAP_EV_LOOP_START, job, work, 0);
+	return 0;
+}
+
+SEC("usdt")
+int BPF_USDT(lt_slice, int job, u64 idx, u64 iters)
+{
+	trace_usdt(CAP_EV_SLICE, job, idx, iters);
+	return 0;
+}
+
+SEC("usdt")
+int BPF_USDT(lt_job_end, int job, u64 work)
+{
+	trace_usdt(CAP_EV_JOB_END, job, work, 0);
+	return 0;
+}
+
 s32 BPF_STRUCT_OPS_SLEEPABLE(fifo_init)
 {
 	return scx_bpf_create_dsq(FIFO_DSQ, -1);
@@ -198,12 +522,14 @@ void BPF_STRUCT_OPS(fifo_exit, struct scx_exit_info *ei)
 }
 
 SCX_OPS_DEFINE(fifo_ops,
-	       .flags			= SCX_OPS_SWITCH_PARTIAL,
+	       .flags			= SCX_OPS_SWITCH_PARTIAL |
+					  SCX_OPS_KEEP_BUILTIN_IDLE,
 	       .select_cpu		= (void *)fifo_select_cpu,
 	       .enqueue		= (void *)fifo_enqueue,
 	       .dispatch		= (void *)fifo_dispatch,
 	       .running		= (void *)fifo_running,
 	       .stopping		= (void *)fifo_stopping,
+	       .update_idle		= (void *)fifo_update_idle,
 	       .enable		= (void *)fifo_enable,
 	       .init_task		= (void *)fifo_init_task,
 	       .init			= (void *)fifo_init,
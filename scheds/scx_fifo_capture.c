@@ -1,6 +1,22 @@
 /* SPDX-License-Identifier: GPL-2.0 */
 /*
  * Userspace loader for scx_fifo.
+ *
+ * With -t, scheduler events are streamed to a trace file; each -u adds a
+ * load generator binary whose USDT probes (loadtest_usdt.h) are attached
+ * and merged into the same stream.
+ *
+ * -C writes paired CLOCK_MONOTONIC_RAW / CLOCK_MONOTONIC samples at start,
+ * every second and at exit, in the generators' sidecar format
+ * (loadtest_clock.h); clockjoin.py uses both sidecars to map the loadtest
+ * log onto the trace's timeline.
+ *
+ * Tracing cost is bounded in two ways. -r samples event types (1 in N),
+ * and -b declares an overhead budget, a percentage of all CPUs' time.
+ * Every second the loader estimates the tracing cost as the records
+ * emitted times the per-record cost (-E), plus its own CPU time. While
+ * that is over budget, or the ring buffer drops records, it samples
+ * harder; with plenty of headroom it goes back toward the -r rates.
  */
 #include <stdio.h>
 #include <unistd.h>
@@ -8,8 +24,14 @@
 #include <libgen.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <stdlib.h>
+#include <sys/resource.h>
 #include <bpf/bpf.h>
 #include <scx/common.h>
+#include "scx_fifo_capture.h"
+#include "scx_stats.h"
 #include "scx_fifo.bpf.skel.h"
 
 #include <sys/stat.h>
@@ -18,11 +40,24 @@
 const char help_fmt[] =
 "A minimal global FIFO sched_ext scheduler.\n"
 "\n"
-"Usage: %s [-a] [-v]\n"
+"Usage: %s [-a] [-t TRACE [-u BINARY]... [-r TYPE=N,...] [-b PCT [-E NS]] [-F US]] [-C CLOCKS] [-v]\n"
 "\n"
 "  -a            Schedule all eligible tasks (full mode). Default is partial\n"
 "                mode (SCX_OPS_SWITCH_PARTIAL), which schedules only\n"
 "                SCHED_EXT tasks.\n"
+"  -t TRACE      Write enqueue/running/stopping events to TRACE (binary,\n"
+"                see scx_fifo_capture.h)\n"
+"  -u BINARY     Also trace the loadtest USDT probes of BINARY (repeatable)\n"
+"                (e.g. bin/loadtest)\n"
+"  -r TYPE=N,..  Keep 1 in N events of TYPE (N rounded up to a power of 2).\n"
+"                Types: enqueue, running, stopping, idle, dispatch,\n"
+"                job_release, loop_start, slice, job_end\n"
+"  -b PCT        Overhead budget in percent of all CPUs' time; sampling is\n"
+"                adjusted every second to stay within it\n"
+"  -E NS         Assumed in-kernel cost of one trace record (default: 300)\n"
+"  -F US         Submit a CPU's batch of scheduler events once its oldest\n"
+"                event is this old (default: 10000, 0: no batching)\n"
+"  -C CLOCKS     Write paired RAW/MONOTONIC clock samples to CLOCKS (CSV)\n"
 "  -v            Print libbpf debug messages\n"
 "  -h            Display this help and exit\n";
 
@@ -66,17 +101,318 @@ static int pin_proc_stats_map(struct scx_fifo *skel)
 	return 0;
 }
 
+/* Entries of the per-cpu stats array, see the .bpf.c */
+#define NR_STATS 8
+
+#define MAX_USDT_BINS	8
+
+static __u64 clk_read(clockid_t id)
+{
+	struct timespec ts;
+
+	clock_gettime(id, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Same sampling as loadtest_clock.h: a MONOTONIC read bracketed by two
+ * MONOTONIC_RAW reads, tightest of 8 tries, error = half the bracket.
+ */
+static void clk_sample(FILE *out, const char *tag)
+{
+	__u64 best = ~0ULL, raw = 0, mono = 0;
+	int t;
+
+	if (!out)
+		return;
+	for (t = 0; t < 8; t++) {
+		__u64 r0 = clk_read(CLOCK_MONOTONIC_RAW);
+		__u64 m = clk_read(CLOCK_MONOTONIC);
+		__u64 r1 = clk_read(CLOCK_MONOTONIC_RAW);
+
+		if (r1 - r0 < best) {
+			best = r1 - r0;
+			raw = r0 + best / 2;
+			mono = m;
+		}
+	}
+	fprintf(out, "sched,%s,%llu,%llu,%llu\n", tag, (unsigned long long)raw,
+		(unsigned long long)mono, (unsigned long long)(best / 2 + 1));
+	fflush(out);
+}
+
+/* One event, or a batch of them from one CPU. */
+static int write_event(void *ctx, void *data, size_t size)
+{
+	FILE *out = ctx;
+
+	if (!size || size % sizeof(struct capture_event))
+		return 0;
+	return fwrite(data, size, 1, out) == 1 ? 0 : -EIO;
+}
+
+/* A CAP_EV_RATE / CAP_EV_LOST record, stamped on the BPF clock. */
+static void write_meta(FILE *out, __u16 type, __u64 a0, __u64 a1)
+{
+	struct capture_event ev = {
+		.ts_ns = clk_read(CLOCK_MONOTONIC),
+		.type = type,
+		.arg = { a0, a1 },
+	};
+
+	fwrite(&ev, sizeof(ev), 1, out);
+}
+
+/* Scheduler events still sitting in the per-CPU batches, once detached. */
+static void drain_batches(struct scx_fifo *skel, FILE *out)
+{
+	int nr_cpus = libbpf_num_possible_cpus(), cpu;
+	struct capture_batch *b = calloc(nr_cpus, sizeof(*b));
+	__u32 zero = 0;
+
+	if (!b)
+		return;
+	if (!bpf_map_lookup_elem(bpf_map__fd(skel->maps.batches), &zero, b)) {
+		for (cpu = 0; cpu < nr_cpus; cpu++)
+			if (b[cpu].nr && b[cpu].nr <= CAP_BATCH)
+				fwrite(b[cpu].ev, sizeof(b[cpu].ev[0]), b[cpu].nr, out);
+	}
+	free(b);
+}
+
+static const char *const trace_type_names[CAP_EV_MAX] = {
+	[CAP_EV_ENQUEUE]	= "enqueue",
+	[CAP_EV_RUNNING]	= "running",
+	[CAP_EV_STOPPING]	= "stopping",
+	[CAP_EV_IDLE]		= "idle",
+	[CAP_EV_DISPATCH]	= "dispatch",
+	[CAP_EV_JOB_RELEASE]	= "job_release",
+	[CAP_EV_LOOP_START]	= "loop_start",
+	[CAP_EV_SLICE]		= "slice",
+	[CAP_EV_JOB_END]	= "job_end",
+};
+
+/* "-r enqueue=4,running=4" into shifts[]; -EINVAL if malformed. */
+static int parse_rates(const char *arg, __u8 shifts[CAP_EV_MAX])
+{
+	char *buf = strdup(arg), *tok, *save = NULL;
+	int ret = 0;
+
+	if (!buf)
+		return -ENOMEM;
+	for (tok = strtok_r(buf, ",", &save); tok && !ret;
+	     tok = strtok_r(NULL, ",", &save)) {
+		char *val = strchr(tok, '='), *end;
+		unsigned long n;
+		int t, shift = 0;
+
+		ret = -EINVAL;
+		if (!val)
+			break;
+		*val++ = '\0';
+		n = strtoul(val, &end, 10);
+		if (!n || *end)
+			break;
+		while ((1UL << shift) < n && shift < CAP_MAX_SHIFT)
+			shift++;
+		for (t = 0; t < CAP_EV_MAX; t++) {
+			if (trace_type_names[t] && !strcmp(tok, trace_type_names[t])) {
+				shifts[t] = shift;
+				ret = 0;
+			}
+		}
+	}
+	free(buf);
+	return ret;
+}
+
+/* State of the overhead budget (-b); see the comment at the top. */
+struct trace_budget {
+	double			pct;		/* 0: fixed rates */
+	__u64			rec_cost_ns;
+	int			nr_cpus;
+	struct capture_trace_ctl ctl;
+	__u8			min_shift[CAP_EV_MAX];	/* the -r rates */
+	struct capture_type_cnt	prev[CAP_EV_MAX];
+	__u64			prev_self_ns;
+	__u64			prev_ts;
+};
+
+static __u64 self_cpu_ns(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+	       (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+}
+
+static int write_trace_ctl(struct scx_fifo *skel, const struct capture_trace_ctl *ctl)
+{
+	__u32 zero = 0;
+
+	return bpf_map_update_elem(bpf_map__fd(skel->maps.trace_ctl), &zero, ctl, BPF_ANY);
+}
+
+static void read_type_cnts(struct scx_fifo *skel, struct capture_type_cnt *out)
+{
+	int nr_cpus = libbpf_num_possible_cpus(), cpu;
+	struct capture_type_cnt cnts[nr_cpus];
+	__u32 t;
+
+	memset(out, 0, CAP_EV_MAX * sizeof(*out));
+	for (t = 0; t < CAP_EV_MAX; t++) {
+		if (bpf_map_lookup_elem(bpf_map__fd(skel->maps.trace_cnt), &t, cnts) < 0)
+			continue;
+		for (cpu = 0; cpu < nr_cpus; cpu++) {
+			out[t].emitted += cnts[cpu].emitted;
+			out[t].sampled_out += cnts[cpu].sampled_out;
+			out[t].dropped += cnts[cpu].dropped;
+		}
+	}
+}
+
+/*
+ * One budget step: record drops, estimate the overhead of the last
+ * interval and move the sampling rates. Over budget by a factor f, every
+ * type that produced events samples log2(f) steps harder at once; below
+ * a quarter of the budget they go back one step at a time.
+ */
+static void trace_budget_step(struct scx_fifo *skel, struct trace_budget *tb, FILE *out)
+{
+	struct capture_type_cnt cur[CAP_EV_MAX];
+	__u64 now = clk_read(CLOCK_MONOTONIC), self = self_cpu_ns();
+	__u64 emitted = 0, skipped = 0, dropped = 0, est_ns, budget_ns;
+	struct capture_trace_ctl old = tb->ctl;
+	int t, steps = 0;
+
+	read_type_cnts(skel, cur);
+	for (t = 0; t < CAP_EV_MAX; t++) {
+		__u64 d = cur[t].dropped - tb->prev[t].dropped;
+
+		if (d)
+			write_meta(out, CAP_EV_LOST, t, d);
+		emitted += cur[t].emitted - tb->prev[t].emitted;
+		skipped += cur[t].sampled_out - tb->prev[t].sampled_out;
+		dropped += d;
+	}
+
+	est_ns = emitted * tb->rec_cost_ns + (self - tb->prev_self_ns);
+	budget_ns = tb->pct / 100.0 * tb->nr_cpus * (now - tb->prev_ts);
+	printf("trace: records=%llu sampled_out=%llu drops=%llu overhead=%.3f%%",
+	       (unsigned long long)emitted, (unsigned long long)skipped,
+	       (unsigned long long)dropped,
+	       now > tb->prev_ts ? 100.0 * est_ns / ((double)tb->nr_cpus * (now - tb->prev_ts)) : 0.0);
+	if (tb->pct > 0)
+		printf(" budget=%.3f%%", tb->pct);
+
+	if (tb->pct > 0 && budget_ns) {
+		if (est_ns > budget_ns || dropped) {
+			double f = (double)est_ns / budget_ns;
+
+			for (steps = 1; f > 2.0 && steps < CAP_MAX_SHIFT; f /= 2.0)
+				steps++;
+		} else if (est_ns < budget_ns / 4) {
+			steps = -1;
+		}
+	}
+	for (t = 0; t < CAP_EV_MAX && steps; t++) {
+		int shift = tb->ctl.sample_shift[t];
+
+		if (steps > 0 && cur[t].emitted == tb->prev[t].emitted)
+			continue;
+		shift += steps;
+		if (shift > CAP_MAX_SHIFT)
+			shift = CAP_MAX_SHIFT;
+		if (shift < tb->min_shift[t])
+			shift = tb->min_shift[t];
+		tb->ctl.sample_shift[t] = shift;
+	}
+	if (memcmp(&old, &tb->ctl, sizeof(old))) {
+		if (write_trace_ctl(skel, &tb->ctl)) {
+			fprintf(stderr, "trace: failed to update sampling rates\n");
+			tb->ctl = old;
+		} else {
+			for (t = 0; t < CAP_EV_MAX; t++)
+				if (old.sample_shift[t] != tb->ctl.sample_shift[t])
+					write_meta(out, CAP_EV_RATE, t, 1ULL << tb->ctl.sample_shift[t]);
+		}
+	}
+	for (t = 0; t < CAP_EV_MAX; t++)
+		if (tb->ctl.sample_shift[t])
+			printf(" %s=1/%llu", trace_type_names[t] ? trace_type_names[t] : "?",
+			       1ULL << tb->ctl.sample_shift[t]);
+	printf("\n");
+
+	memcpy(tb->prev, cur, sizeof(cur));
+	tb->prev_self_ns = self;
+	tb->prev_ts = now;
+}
+
+static FILE *open_trace(const char *path)
+{
+	struct capture_trace_hdr hdr = {
+		.version = CAPTURE_TRACE_VERSION,
+		.rec_size = sizeof(struct capture_event),
+	};
+	FILE *out = fopen(path, "w");
+
+	if (!out)
+		return NULL;
+	memcpy(hdr.magic, CAPTURE_TRACE_MAGIC, sizeof(hdr.magic));
+	if (fwrite(&hdr, sizeof(hdr), 1, out) != 1) {
+		fclose(out);
+		return NULL;
+	}
+	return out;
+}
+
+/*
+ * Attach every loadtest probe found in binary. A generator without some
+ * probe (only loadtest_divided has "slice") is fine; one without any is
+ * an error. Returns the number of links added.
+ */
+static int attach_usdt(struct scx_fifo *skel, const char *binary,
+		       struct bpf_link **links)
+{
+	const struct {
+		struct bpf_program	*prog;
+		const char		*name;
+	} probes[] = {
+		{ skel->progs.lt_job_release,	"job_release" },
+		{ skel->progs.lt_loop_start,	"loop_start" },
+		{ skel->progs.lt_slice,		"slice" },
+		{ skel->progs.lt_job_end,	"job_end" },
+	};
+	int i, nr = 0;
+
+	for (i = 0; i < (int)(sizeof(probes) / sizeof(probes[0])); i++) {
+		struct bpf_link *l;
+
+		l = bpf_program__attach_usdt(probes[i].prog, -1, binary,
+					     "loadtest", probes[i].name, NULL);
+		if (!l) {
+			if (verbose)
+				fprintf(stderr, "%s: no loadtest:%s probe\n",
+					binary, probes[i].name);
+			continue;
+		}
+		links[nr++] = l;
+	}
+	return nr;
+}
+
 static void read_stats(struct scx_fifo *skel, __u64 *out)
 {
 	int nr_cpus = libbpf_num_possible_cpus();
-	__u64 cnts[2][nr_cpus];
+	__u64 cnts[NR_STATS][nr_cpus];
 	__u32 idx;
 
-	out[0] = out[1] = 0;
-
-	for (idx = 0; idx < 2; idx++) {
+	for (idx = 0; idx < NR_STATS; idx++) {
 		int ret, cpu;
 
+		out[idx] = 0;
+
 		ret = bpf_map_lookup_elem(bpf_map__fd(skel->maps.stats),
 					  &idx, cnts[idx]);
 		if (ret < 0)
@@ -91,20 +427,75 @@ int main(int argc, char **argv)
 	struct scx_fifo *skel;
 	struct bpf_link *link;
 	__u32 opt;
-	__u64 ecode;
+	__u64 ecode, v;
 	bool all_tasks = false;
+	const char *trace_path = NULL;
+	const char *usdt_bins[MAX_USDT_BINS];
+	struct bpf_link *usdt_links[MAX_USDT_BINS * 4];
+	int nr_usdt_bins = 0, nr_usdt_links = 0, i;
+	struct ring_buffer *rb = NULL;
+	FILE *trace = NULL, *clocks = NULL;
+	const char *clk_path = NULL, *rates = NULL;
+	struct trace_budget tb = {
+		.rec_cost_ns = 300,
+		.ctl.flush_ns = 10ULL * 1000ULL * 1000ULL,
+	};
+	time_t next_stats;
+	char *end;
+	int t;
 
 	libbpf_set_print(libbpf_print_fn);
 	signal(SIGINT, sigint_handler);
 	signal(SIGTERM, sigint_handler);
 restart:
+	/* per-run state; the trace and clock files stay open across restarts */
+	nr_usdt_links = 0;
+	rb = NULL;
+	memset(tb.ctl.sample_shift, 0, sizeof(tb.ctl.sample_shift));
+	memset(tb.prev, 0, sizeof(tb.prev));
 	skel = SCX_OPS_OPEN(fifo_ops, scx_fifo);
 
-	while ((opt = getopt(argc, argv, "avh")) != -1) {
+	while ((opt = getopt(argc, argv, "at:u:C:r:b:E:F:vh")) != -1) {
 		switch (opt) {
 		case 'a':
 			all_tasks = true;
 			break;
+		case 't':
+			trace_path = optarg;
+			break;
+		case 'C':
+			clk_path = optarg;
+			break;
+		case 'u':
+			if (nr_usdt_bins == MAX_USDT_BINS) {
+				fprintf(stderr, "At most %d -u binaries\n", MAX_USDT_BINS);
+				return 1;
+			}
+			usdt_bins[nr_usdt_bins++] = optarg;
+			break;
+		case 'r':
+			rates = optarg;
+			break;
+		case 'b':
+			tb.pct = strtod(optarg, &end);
+			if (*end || tb.pct <= 0.0 || tb.pct > 100.0) {
+				fprintf(stderr, "Invalid -b value: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'E':
+		case 'F':
+			errno = 0;
+			v = strtoull(optarg, &end, 10);
+			if (errno || *end || (opt == 'E' && !v)) {
+				fprintf(stderr, "Invalid -%c value: %s\n", opt, optarg);
+				return 1;
+			}
+			if (opt == 'E')
+				tb.rec_cost_ns = v;
+			else
+				tb.ctl.flush_ns = v * 1000ULL;
+			break;
 		case 'v':
 			verbose = true;
 			break;
@@ -113,6 +504,11 @@ restart:
 			return opt != 'h';
 		}
 	}
+	if (rates && parse_rates(rates, tb.ctl.sample_shift)) {
+		fprintf(stderr, "Invalid -r value: %s\n", rates);
+		return 1;
+	}
+	memcpy(tb.min_shift, tb.ctl.sample_shift, sizeof(tb.min_shift));
 
 	/* Enforce/adjust partial-switch mode per CLI. */
 	if (all_tasks)
@@ -120,27 +516,119 @@ restart:
 	else
 		skel->struct_ops.fifo_ops->flags |= SCX_OPS_SWITCH_PARTIAL;
 
+	if ((nr_usdt_bins || rates || tb.pct > 0) && !trace_path) {
+		fprintf(stderr, "-u, -r and -b need -t\n");
+		return 1;
+	}
+	skel->rodata->trace_enabled = trace_path != NULL;
+
 	SCX_OPS_LOAD(skel, fifo_ops, scx_fifo, uei);
 	/* Pin per-process stats so an external reader can consume them. */
 	if (pin_proc_stats_map(skel))
 		fprintf(stderr, "Warning: failed to pin proc_stats map\n");
+
+	if (trace_path) {
+		if (!trace)
+			trace = open_trace(trace_path);
+		if (!trace) {
+			fprintf(stderr, "Failed to open %s: %s\n", trace_path, strerror(errno));
+			return 1;
+		}
+		rb = ring_buffer__new(bpf_map__fd(skel->maps.events), write_event, trace, NULL);
+		if (!rb) {
+			fprintf(stderr, "Failed to create the trace ring buffer\n");
+			return 1;
+		}
+		if (write_trace_ctl(skel, &tb.ctl)) {
+			fprintf(stderr, "Failed to set the trace sampling rates\n");
+			return 1;
+		}
+		for (t = 0; t < CAP_EV_MAX; t++)
+			if (tb.ctl.sample_shift[t])
+				write_meta(trace, CAP_EV_RATE, t, 1ULL << tb.ctl.sample_shift[t]);
+		tb.nr_cpus = libbpf_num_possible_cpus();
+		tb.prev_self_ns = self_cpu_ns();
+		tb.prev_ts = clk_read(CLOCK_MONOTONIC);
+		for (i = 0; i < nr_usdt_bins; i++) {
+			int nr = attach_usdt(skel, usdt_bins[i], usdt_links + nr_usdt_links);
+
+			if (!nr) {
+				fprintf(stderr, "No loadtest USDT probes in %s\n", usdt_bins[i]);
+				return 1;
+			}
+			nr_usdt_links += nr;
+		}
+	}
+
+	if (clk_path && !clocks) {
+		clocks = fopen(clk_path, "w");
+		if (!clocks) {
+			fprintf(stderr, "Failed to open %s: %s\n", clk_path, strerror(errno));
+			return 1;
+		}
+		fprintf(clocks, "src,tag,raw_ns,mono_ns,err_ns\n");
+	}
+
 	link = SCX_OPS_ATTACH(skel, fifo_ops, scx_fifo);
+	scx_stats_pin(skel->maps.stats);
+	clk_sample(clocks, "begin");
 	printf("scx_fifo: mode=%s\n", all_tasks ? "full" : "partial");
 	printf("scx_fifo: per-process stats pinned at /sys/fs/bpf/scx_fifo/proc_stats\n");
+	if (trace) {
+		printf("scx_fifo: tracing to %s (%d USDT probes attached)\n",
+		       trace_path, nr_usdt_links);
+		if (tb.pct > 0)
+			printf("scx_fifo: trace overhead budget %.3f%% of %d CPUs, %lluns per record\n",
+			       tb.pct, tb.nr_cpus, (unsigned long long)tb.rec_cost_ns);
+	}
 
+	next_stats = 0;
 	while (!exit_req && !UEI_EXITED(skel, uei)) {
-		__u64 stats[2];
+		__u64 stats[NR_STATS];
+
+		if (rb) {
+			/* -EINTR on SIGINT; the loop condition handles it */
+			ring_buffer__poll(rb, 100);
+			if (time(NULL) < next_stats)
+				continue;
+		}
 		read_stats(skel, stats);
-		printf("local=%llu global=%llu\n", stats[0], stats[1]);
+		printf("local=%llu global=%llu idle_kicks=%llu no_idle=%llu queued_mean=%.1fus keep=%llu",
+		       stats[0], stats[1], stats[2], stats[3],
+		       stats[5] ? stats[4] / 1e3 / stats[5] : 0.0, stats[6]);
+		if (rb)
+			printf(" trace_drops=%llu", stats[7]);
+		printf("\n");
+		if (rb)
+			trace_budget_step(skel, &tb, trace);
 		fflush(stdout);
-		sleep(1);
+		clk_sample(clocks, "periodic");
+		if (rb)
+			next_stats = time(NULL) + 1;
+		else
+			sleep(1);
 	}
 
+	clk_sample(clocks, "end");
+	for (i = 0; i < nr_usdt_links; i++)
+		bpf_link__destroy(usdt_links[i]);
+	scx_stats_unpin();
 	bpf_link__destroy(link);
+	if (rb) {
+		/* drain what is left, then the partial batches nothing will flush */
+		ring_buffer__consume(rb);
+		ring_buffer__free(rb);
+		drain_batches(skel, trace);
+		fflush(trace);
+	}
 	ecode = UEI_REPORT(skel, uei);
 	scx_fifo__destroy(skel);
 
 	if (UEI_ECODE_RESTART(ecode))
 		goto restart;
+	if (clocks)
+		fclose(clocks);
+	if (trace)
+		fclose(trace);
 	return 0;
 }
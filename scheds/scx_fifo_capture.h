@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Definitions shared by scx_fifo_capture.bpf.c and its userspace side.
+ *
+ * Trace stream: scheduler events and the load generators' USDT probes
+ * (loadtest_usdt.h) go through one ring buffer and are stamped with the
+ * same clock (bpf_ktime_get_ns, CLOCK_MONOTONIC), so no cross-clock
+ * matching is needed to line them up.
+ *
+ * Trace file (-t): struct capture_trace_hdr followed by struct
+ * capture_event records in ring buffer order, all little endian.
+ * Scheduler events reach the ring buffer in per-CPU batches and the USDT
+ * ones one by one, so records are not ordered; sort by ts_ns to merge.
+ *
+ * Tracing is sampled per event type through the trace_ctl map (1 in
+ * 2^sample_shift), which the consumer adjusts at runtime to stay within
+ * its overhead budget. Every change is written to the file as a
+ * CAP_EV_RATE record, and ring buffer drops as CAP_EV_LOST records, so a
+ * reader knows which stretches of the trace are complete.
+ */
+#ifndef __SCX_FIFO_CAPTURE_H
+#define __SCX_FIFO_CAPTURE_H
+
+#ifndef __bpf__
+#include <linux/types.h>
+#endif
+
+#define CAPTURE_TRACE_MAGIC	"SCXTRACE"
+#define CAPTURE_TRACE_VERSION	1
+
+enum capture_event_type {
+	/*
+	 * scheduler, pid = task: arg[0] = enq_flags / runnable;
+	 * enqueue also has arg[1] = nr_cpus_allowed, arg[2] = CPUs 0-63
+	 * of the task's cpumask (traces before this have 0, "any CPU")
+	 */
+	CAP_EV_ENQUEUE		= 1,	/* queued on the shared DSQ */
+	CAP_EV_RUNNING		= 2,
+	CAP_EV_STOPPING		= 3,
+	/* scheduler, pid = 0 */
+	CAP_EV_IDLE		= 4,	/* ops.update_idle: arg[0] = idle */
+	CAP_EV_DISPATCH		= 5,	/* arg[0] = DSQ depth, arg[1] = consumed */
+	/*
+	 * written by the consumer, pid = 0, cpu = 0, ts_ns = CLOCK_MONOTONIC:
+	 *   rate: arg[0] = event type, arg[1] = 1-in-N sampling from ts_ns on
+	 *   lost: arg[0] = event type, arg[1] = records dropped since the
+	 *         previous lost record of that type (ring buffer full)
+	 */
+	CAP_EV_RATE		= 6,
+	CAP_EV_LOST		= 7,
+	/* generators (USDT): arg[0] = job (child_index) */
+	CAP_EV_JOB_RELEASE	= 16,	/* arg[1] = work_iters */
+	CAP_EV_LOOP_START	= 17,	/* arg[1] = work_iters */
+	CAP_EV_SLICE		= 18,	/* arg[1] = slice index, arg[2] = slice iters */
+	CAP_EV_JOB_END		= 19,	/* arg[1] = work_iters */
+	CAP_EV_MAX		= 32,	/* types are below this */
+};
+
+struct capture_event {
+	__u64	ts_ns;		/* bpf_ktime_get_ns() */
+	__u32	pid;		/* thread id of the task */
+	__u16	type;		/* enum capture_event_type */
+	__u16	cpu;
+	__u64	arg[3];
+};
+
+/* Sampling keeps at most 1 in 2^CAP_MAX_SHIFT events of a type. */
+#define CAP_MAX_SHIFT		16
+
+/*
+ * Single entry of the "trace_ctl" ARRAY map, written by the consumer.
+ * Task and USDT events are sampled by thread, so a sampled task's events
+ * stay complete; pid 0 events by per-CPU sequence.
+ */
+struct capture_trace_ctl {
+	__u8	sample_shift[CAP_EV_MAX];	/* keep 1 in 2^shift, 0: all */
+	__u64	flush_ns;	/* submit a partial batch once its oldest event is this old */
+};
+
+/* Per-cpu "trace_cnt" entry of each event type. */
+struct capture_type_cnt {
+	__u64	emitted;	/* accepted into the trace */
+	__u64	sampled_out;	/* skipped by sampling */
+	__u64	dropped;	/* emitted, but lost to a full ring buffer */
+};
+
+/*
+ * Scheduler events are collected per CPU and submitted CAP_BATCH at a
+ * time, one ring buffer reservation per batch. Whatever is left in the
+ * per-cpu "batches" map at exit is written by the consumer.
+ */
+#define CAP_BATCH		16
+
+struct capture_batch {
+	__u64			first_ts;	/* ts_ns of ev[0] */
+	__u32			nr;
+	__u32			seq[CAP_EV_MAX];	/* pid 0 events seen, for sampling */
+	struct capture_event	ev[CAP_BATCH];
+};
+
+struct capture_trace_hdr {
+	char	magic[8];	/* CAPTURE_TRACE_MAGIC, not NUL terminated */
+	__u32	version;
+	__u32	rec_size;	/* sizeof(struct capture_event) */
+};
+
+#endif /* __SCX_FIFO_CAPTURE_H */
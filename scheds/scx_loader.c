@@ -0,0 +1,745 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * One userspace loader for scx_fifo, scx_fifo_capture and scx_mlfq.
+ *
+ * All three skeletons are linked in. The standalone loaders stay as they
+ * are and keep the options this one leaves out (A/B partitions and the
+ * -T controller of scx_mlfq, the tracing of scx_fifo_capture); use this
+ * one to compare policies on one machine without restarting anything.
+ *
+ * The active policy is switched on
+ * command over a unix control socket: the next policy is opened and
+ * loaded (BPF verification and map creation, the slow part) while the
+ * current one is still attached, so the window in which tasks fall back
+ * to the fair class is only the kernel's disable + enable. That window
+ * is measured and reported for every switch.
+ *
+ *   sudo scx_loader -p fifo &
+ *   sudo scx_loader -x "switch mlfq"
+ *   sudo scx_loader -x status
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <libgen.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include <sched.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include <bpf/bpf.h>
+#include <scx/common.h>
+
+#include "scx_mlfq.h"
+#include "scx_stats.h"
+#include "scx_fifo.bpf.skel.h"
+#include "scx_fifo_capture.bpf.skel.h"
+#include "scx_mlfq.bpf.skel.h"
+
+#define CTL_PATH_DFL		"/run/scx_loader.sock"
+#define ATTACH_TIMEOUT_NS	(1000ULL * 1000ULL * 1000ULL)
+
+const char help_fmt[] =
+"Unified loader for the scx_fifo, scx_fifo_capture and scx_mlfq schedulers\n"
+"with in-place policy switching.\n"
+"\n"
+"Usage: %s [-p POLICY] [-a] [-s RR_SLICE_MS] [-P] [-S SOCKET] [-v]\n"
+"       %s [-S SOCKET] -x COMMAND\n"
+"\n"
+"  -p POLICY     Initial policy: fifo, fifo_capture or mlfq (default: fifo)\n"
+"  -a            Schedule all eligible tasks (full mode). Default is partial\n"
+"                mode (SCX_OPS_SWITCH_PARTIAL), which schedules only\n"
+"                SCHED_EXT tasks.\n"
+"  -s MS         scx_mlfq top-queue RR time slice in milliseconds (default: 50)\n"
+"  -P            scx_mlfq: preempt on slice expiry with a per-CPU timer instead\n"
+"                of the scheduler tick\n"
+"  -S PATH       Control socket (default: " CTL_PATH_DFL ")\n"
+"  -x COMMAND    Send COMMAND to a running loader and print the reply:\n"
+"                  switch POLICY   preload POLICY, then swap it in\n"
+"                  status          active policy and last switch timings\n"
+"                  list            available policies\n"
+"                  stop            detach and exit\n"
+"  -v            Print libbpf debug messages\n"
+"  -h            Display this help and exit\n";
+
+static bool verbose;
+static volatile int exit_req;
+
+static int libbpf_print_fn(enum libbpf_print_level level,
+			   const char *format, va_list args)
+{
+	if (level == LIBBPF_DEBUG && !verbose)
+		return 0;
+	return vfprintf(stderr, format, args);
+}
+
+static void sigint_handler(int dummy)
+{
+	exit_req = 1;
+}
+
+static __u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct loader_opts {
+	bool	all_tasks;
+	bool	timer_preempt;
+	__u64	rr_slice_ns;
+};
+
+/*
+ * One embedded scheduler. The skeleton is passed around as void * so the
+ * switch logic does not care which one it is.
+ */
+struct policy {
+	const char		*name;
+	const char *const	*stat_names;
+	int			nr_stats;
+	void			*(*open)(void);
+	void			(*configure)(void *skel, const struct loader_opts *o);
+	int			(*load)(void *skel);
+	int			(*attach)(void *skel, struct bpf_link **link);
+	bool			(*exited)(void *skel);
+	__u64			(*report)(void *skel);
+	void			(*destroy)(void *skel);
+	struct bpf_map		*(*stats_map)(void *skel);
+	/* optional: right after attach / right before detach */
+	void			(*attached)(void *skel);
+	void			(*detaching)(void *skel);
+};
+
+/*
+ * Per-skeleton glue. SCX_OPS_OPEN, SCX_OPS_LOAD and SCX_OPS_ATTACH exit
+ * on failure; they are open-coded here because a failed switch must leave
+ * the current scheduler attached, and attach must be able to retry while
+ * the previous scheduler is still being torn down.
+ */
+#define LOADER_SKEL_OPS(__scx, __ops)						\
+static void *__scx##_open(void)							\
+{										\
+	struct __scx *s = __scx##__open();					\
+										\
+	if (s)									\
+		s->struct_ops.__ops->hotplug_seq = scx_hotplug_seq();		\
+	return s;								\
+}										\
+										\
+static void __scx##_set_mode(struct __scx *skel, bool all_tasks)		\
+{										\
+	if (all_tasks)								\
+		skel->struct_ops.__ops->flags &= ~SCX_OPS_SWITCH_PARTIAL;	\
+	else									\
+		skel->struct_ops.__ops->flags |= SCX_OPS_SWITCH_PARTIAL;	\
+}										\
+										\
+static int __scx##_load(void *skel)						\
+{										\
+	struct __scx *s = skel;							\
+										\
+	UEI_SET_SIZE(s, __ops, uei);						\
+	return __scx##__load(s);						\
+}										\
+										\
+static int __scx##_attach(void *skel, struct bpf_link **link)		\
+{										\
+	struct __scx *s = skel;							\
+	int ret;								\
+										\
+	ret = __scx##__attach(s);						\
+	if (ret)								\
+		return ret;							\
+	*link = bpf_map__attach_struct_ops(s->maps.__ops);			\
+	return *link ? 0 : -errno;						\
+}										\
+										\
+static bool __scx##_exited(void *skel)						\
+{										\
+	struct __scx *s = skel;							\
+										\
+	return UEI_EXITED(s, uei);						\
+}										\
+										\
+static __u64 __scx##_report(void *skel)						\
+{										\
+	struct __scx *s = skel;							\
+										\
+	return UEI_REPORT(s, uei);						\
+}										\
+										\
+static void __scx##_destroy(void *skel)						\
+{										\
+	__scx##__destroy(skel);							\
+}										\
+										\
+static struct bpf_map *__scx##_stats_map(void *skel)				\
+{										\
+	return ((struct __scx *)skel)->maps.stats;				\
+}
+
+LOADER_SKEL_OPS(scx_fifo, fifo_ops)
+LOADER_SKEL_OPS(scx_fifo_capture, fifo_ops)
+LOADER_SKEL_OPS(scx_mlfq, mlfq_ops)
+
+static void scx_fifo_configure(void *skel, const struct loader_opts *o)
+{
+	scx_fifo_set_mode(skel, o->all_tasks);
+}
+
+static void scx_fifo_capture_configure(void *skel, const struct loader_opts *o)
+{
+	scx_fifo_capture_set_mode(skel, o->all_tasks);
+}
+
+static void scx_mlfq_configure(void *skel, const struct loader_opts *o)
+{
+	struct scx_mlfq *s = skel;
+
+	s->rodata->rr_slice_ns = o->rr_slice_ns;
+	s->rodata->timer_preempt = o->timer_preempt;
+	/* per-cpu run state (and timer with -P): one slot per possible cpu */
+	bpf_map__set_max_entries(s->maps.cpu_ctx_stor, libbpf_num_possible_cpus());
+	scx_mlfq_set_mode(s, o->all_tasks);
+}
+
+#define PROC_STATS_DIR		"/sys/fs/bpf/scx_fifo"
+#define PROC_STATS_PIN		PROC_STATS_DIR "/proc_stats"
+
+/* Same pin as scx_fifo_capture, so scx_fifo_stats works unchanged. */
+static void scx_fifo_capture_attached(void *skel)
+{
+	struct scx_fifo_capture *s = skel;
+
+	if (mkdir(PROC_STATS_DIR, 0755) && errno != EEXIST)
+		goto err;
+	/* a pin left by an earlier instance would hide this map */
+	unlink(PROC_STATS_PIN);
+	if (bpf_map__pin(s->maps.proc_stats, PROC_STATS_PIN))
+		goto err;
+	return;
+err:
+	fprintf(stderr, "Warning: failed to pin proc_stats map\n");
+}
+
+static void scx_fifo_capture_detaching(void *skel)
+{
+	struct scx_fifo_capture *s = skel;
+
+	bpf_map__unpin(s->maps.proc_stats, PROC_STATS_PIN);
+}
+
+/* Runtime tunables of scx_mlfq, as the standalone loader pins them. */
+static void scx_mlfq_attached(void *skel)
+{
+	struct scx_mlfq *s = skel;
+
+	if (mkdir(MLFQ_PIN_DIR, 0755) && errno != EEXIST)
+		goto err;
+	unlink(MLFQ_TUNABLES_PIN);
+	if (bpf_map__pin(s->maps.tunables, MLFQ_TUNABLES_PIN))
+		goto err;
+	return;
+err:
+	fprintf(stderr, "Warning: failed to pin tunables map\n");
+}
+
+static void scx_mlfq_detaching(void *skel)
+{
+	struct scx_mlfq *s = skel;
+
+	bpf_map__unpin(s->maps.tunables, MLFQ_TUNABLES_PIN);
+}
+
+static const char *const fifo_stat_names[] = {
+	"local", "global", "idle_kicks", "no_idle", "keep",
+};
+static const char *const fifo_capture_stat_names[] = {
+	"local", "global", "idle_kicks", "no_idle", "queued_ns", "queued_runs",
+	"keep", "trace_drops",
+};
+static const char *const mlfq_stat_names[NR_MLFQ_STATS] = {
+	[MLFQ_STAT_LOCAL]	= "local",
+	[MLFQ_STAT_RR]		= "rr",
+	[MLFQ_STAT_FIFO]	= "fifo",
+	[MLFQ_STAT_EXPIRED]	= "expired",
+	[MLFQ_STAT_TIMER_ARMED]	= "timer_armed",
+	[MLFQ_STAT_TIMER_KICK]	= "timer_kick",
+	[MLFQ_STAT_IDLE_KICK]	= "idle_kicks",
+	[MLFQ_STAT_NO_IDLE]	= "no_idle",
+	[MLFQ_STAT_QUEUED_NS]	= "queued_ns",
+	[MLFQ_STAT_QUEUED_RUNS]	= "queued_runs",
+	[MLFQ_STAT_KEEP]	= "keep",
+	[MLFQ_STAT_ADMIT_QUEUED] = "admit_queued",
+	[MLFQ_STAT_ADMIT_WAIT_NS] = "admit_wait_ns",
+	[MLFQ_STAT_ADMITTED]	= "admitted",
+};
+
+static const struct policy policies[] = {
+	{
+		.name		= "fifo",
+		.stat_names	= fifo_stat_names,
+		.nr_stats	= 5,
+		.open		= scx_fifo_open,
+		.configure	= scx_fifo_configure,
+		.load		= scx_fifo_load,
+		.attach		= scx_fifo_attach,
+		.exited		= scx_fifo_exited,
+		.report		= scx_fifo_report,
+		.destroy	= scx_fifo_destroy,
+		.stats_map	= scx_fifo_stats_map,
+	},
+	{
+		.name		= "fifo_capture",
+		.stat_names	= fifo_capture_stat_names,
+		.nr_stats	= 8,
+		.open		= scx_fifo_capture_open,
+		.configure	= scx_fifo_capture_configure,
+		.load		= scx_fifo_capture_load,
+		.attach		= scx_fifo_capture_attach,
+		.exited		= scx_fifo_capture_exited,
+		.report		= scx_fifo_capture_report,
+		.destroy	= scx_fifo_capture_destroy,
+		.stats_map	= scx_fifo_capture_stats_map,
+		.attached	= scx_fifo_capture_attached,
+		.detaching	= scx_fifo_capture_detaching,
+	},
+	{
+		.name		= "mlfq",
+		.stat_names	= mlfq_stat_names,
+		.nr_stats	= NR_MLFQ_STATS,
+		.open		= scx_mlfq_open,
+		.configure	= scx_mlfq_configure,
+		.load		= scx_mlfq_load,
+		.attach		= scx_mlfq_attach,
+		.exited		= scx_mlfq_exited,
+		.report		= scx_mlfq_report,
+		.destroy	= scx_mlfq_destroy,
+		.stats_map	= scx_mlfq_stats_map,
+		.attached	= scx_mlfq_attached,
+		.detaching	= scx_mlfq_detaching,
+	},
+};
+
+#define NR_POLICIES	(sizeof(policies) / sizeof(policies[0]))
+
+static const struct policy *find_policy(const char *name)
+{
+	for (size_t i = 0; i < NR_POLICIES; i++) {
+		if (!strcmp(policies[i].name, name))
+			return &policies[i];
+	}
+	return NULL;
+}
+
+struct switch_times {
+	__u64	preload_ns;	/* open + load of the next policy */
+	__u64	detach_ns;	/* bpf_link__destroy() of the current one */
+	__u64	attach_ns;	/* from detach done to next attached */
+	__u64	gap_ns;		/* no sched_ext policy attached */
+	int	busy_retries;	/* attach saw -EBUSY (previous still disabling) */
+};
+
+struct loader {
+	struct loader_opts	opts;
+	const struct policy	*cur;
+	void			*skel;
+	struct bpf_link		*link;
+	int			nr_switches;
+	struct switch_times	last;
+};
+
+static void read_stats(const struct policy *pol, void *skel, __u64 *out)
+{
+	int nr_cpus = libbpf_num_possible_cpus();
+	int fd = bpf_map__fd(pol->stats_map(skel));
+	__u64 cnts[nr_cpus];
+	__u32 idx;
+
+	for (idx = 0; idx < (__u32)pol->nr_stats; idx++) {
+		int cpu;
+
+		out[idx] = 0;
+		if (bpf_map_lookup_elem(fd, &idx, cnts) < 0)
+			continue;
+		for (cpu = 0; cpu < nr_cpus; cpu++)
+			out[idx] += cnts[cpu];
+	}
+}
+
+static void print_stats(struct loader *ld)
+{
+	__u64 st[NR_MLFQ_STATS];
+
+	read_stats(ld->cur, ld->skel, st);
+	printf("[%s]", ld->cur->name);
+	for (int i = 0; i < ld->cur->nr_stats; i++)
+		printf(" %s=%llu", ld->cur->stat_names[i], (unsigned long long)st[i]);
+	printf("\n");
+	fflush(stdout);
+}
+
+static int attach_retry(const struct policy *pol, void *skel, struct bpf_link **link,
+			int *busy_retries)
+{
+	__u64 deadline = now_ns() + ATTACH_TIMEOUT_NS;
+	int ret;
+
+	/* the kernel may still be disabling the previous scheduler */
+	while ((ret = pol->attach(skel, link)) == -EBUSY && now_ns() < deadline) {
+		(*busy_retries)++;
+		sched_yield();
+	}
+	return ret;
+}
+
+/*
+ * Make next the active policy. The current one keeps running until next
+ * is loaded, and stays attached if next cannot be opened or loaded; if
+ * next then fails to attach, the previous policy is loaded again from
+ * scratch.
+ */
+static int switch_policy(struct loader *ld, const struct policy *next)
+{
+	const struct policy *prev = ld->cur;
+	void *prev_skel = ld->skel, *skel;
+	struct switch_times t = {};
+	struct bpf_link *link = NULL;
+	__u64 t0, t1, t2;
+	int ret;
+
+	t0 = now_ns();
+	skel = next->open();
+	if (!skel) {
+		ret = -errno;
+		fprintf(stderr, "scx_loader: failed to open %s (%d)\n", next->name, ret);
+		return ret ? ret : -ENOMEM;
+	}
+	next->configure(skel, &ld->opts);
+	ret = next->load(skel);
+	if (ret) {
+		fprintf(stderr, "scx_loader: failed to load %s (%d)\n", next->name, ret);
+		next->destroy(skel);
+		return ret;
+	}
+	t1 = now_ns();
+	t.preload_ns = t1 - t0;
+
+	if (ld->link) {
+		scx_stats_unpin();
+		if (prev->detaching)
+			prev->detaching(prev_skel);
+		bpf_link__destroy(ld->link);
+		ld->link = NULL;
+	}
+	t2 = now_ns();
+	t.detach_ns = t2 - t1;
+
+	ret = attach_retry(next, skel, &link, &t.busy_retries);
+	t.attach_ns = now_ns() - t2;
+	t.gap_ns = prev ? t.detach_ns + t.attach_ns : 0;
+
+	if (prev) {
+		prev->report(prev_skel);
+		prev->destroy(prev_skel);
+		ld->skel = NULL;
+	}
+
+	if (ret) {
+		fprintf(stderr, "scx_loader: failed to attach %s (%d)\n", next->name, ret);
+		next->destroy(skel);
+		ld->cur = NULL;
+		if (prev && prev != next)
+			switch_policy(ld, prev);
+		return ret;
+	}
+
+	ld->cur = next;
+	ld->skel = skel;
+	ld->link = link;
+	scx_stats_pin(next->stats_map(skel));
+	if (next->attached)
+		next->attached(skel);
+	if (prev)
+		ld->nr_switches++;
+	ld->last = t;
+
+	printf("scx_loader: %s%s%s: preload=%.3fms detach=%.1fus attach=%.1fus gap=%.1fus busy_retries=%d\n",
+	       prev ? prev->name : "", prev ? " -> " : "attached ", next->name,
+	       t.preload_ns / 1e6, t.detach_ns / 1e3, t.attach_ns / 1e3,
+	       t.gap_ns / 1e3, t.busy_retries);
+	fflush(stdout);
+	return 0;
+}
+
+static void detach_current(struct loader *ld)
+{
+	if (!ld->cur)
+		return;
+	scx_stats_unpin();
+	if (ld->cur->detaching)
+		ld->cur->detaching(ld->skel);
+	bpf_link__destroy(ld->link);
+	ld->link = NULL;
+}
+
+/* Control socket */
+
+static int ctl_listen(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0)
+		return -errno;
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    chmod(path, 0600) || listen(fd, 4)) {
+		int ret = -errno;
+
+		close(fd);
+		return ret;
+	}
+	return fd;
+}
+
+static void ctl_reply(int fd, const char *fmt, ...)
+{
+	char buf[512];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	if (len > (int)sizeof(buf) - 1)
+		len = sizeof(buf) - 1;
+	if (write(fd, buf, len) < 0)
+		return;
+}
+
+/* One command per connection: read a line, act, reply, close. */
+static void ctl_handle(struct loader *ld, int lfd)
+{
+	char cmd[128], *nl, *arg;
+	struct pollfd pfd;
+	ssize_t len;
+	int fd;
+
+	fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	pfd = (struct pollfd){ .fd = fd, .events = POLLIN };
+	if (poll(&pfd, 1, 1000) <= 0)
+		goto out;
+	len = read(fd, cmd, sizeof(cmd) - 1);
+	if (len <= 0)
+		goto out;
+	cmd[len] = '\0';
+	nl = strchr(cmd, '\n');
+	if (nl)
+		*nl = '\0';
+	arg = strchr(cmd, ' ');
+	if (arg)
+		*arg++ = '\0';
+
+	if (!strcmp(cmd, "switch")) {
+		const struct policy *next = arg ? find_policy(arg) : NULL;
+		struct switch_times *t = &ld->last;
+
+		if (!next) {
+			ctl_reply(fd, "error: unknown policy %s\n", arg ? arg : "(none)");
+		} else if (switch_policy(ld, next)) {
+			ctl_reply(fd, "error: switch to %s failed, active: %s\n",
+				  next->name, ld->cur ? ld->cur->name : "none");
+			if (!ld->cur)
+				exit_req = 1;
+		} else {
+			ctl_reply(fd, "ok %s preload_ms=%.3f detach_us=%.1f attach_us=%.1f gap_us=%.1f busy_retries=%d\n",
+				  ld->cur->name, t->preload_ns / 1e6, t->detach_ns / 1e3,
+				  t->attach_ns / 1e3, t->gap_ns / 1e3, t->busy_retries);
+		}
+	} else if (!strcmp(cmd, "status")) {
+		ctl_reply(fd, "%s switches=%d last_gap_us=%.1f\n",
+			  ld->cur ? ld->cur->name : "none", ld->nr_switches,
+			  ld->last.gap_ns / 1e3);
+	} else if (!strcmp(cmd, "list")) {
+		for (size_t i = 0; i < NR_POLICIES; i++)
+			ctl_reply(fd, "%s%s\n", policies[i].name,
+				  &policies[i] == ld->cur ? " *" : "");
+	} else if (!strcmp(cmd, "stop")) {
+		ctl_reply(fd, "ok\n");
+		exit_req = 1;
+	} else {
+		ctl_reply(fd, "error: unknown command %s\n", cmd);
+	}
+out:
+	close(fd);
+}
+
+static int ctl_send(const char *path, const char *cmd)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	char buf[512] = "";
+	ssize_t len;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n", path);
+		return 1;
+	}
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		fprintf(stderr, "connect(%s): %s\n", path, strerror(errno));
+		return 1;
+	}
+	if (dprintf(fd, "%s\n", cmd) < 0) {
+		fprintf(stderr, "write(%s): %s\n", path, strerror(errno));
+		close(fd);
+		return 1;
+	}
+	while ((len = read(fd, buf, sizeof(buf))) > 0)
+		fwrite(buf, 1, len, stdout);
+	close(fd);
+	return strncmp(buf, "error", 5) ? 0 : 1;
+}
+
+static int parse_u64(const char *s, __u64 *out)
+{
+	char *end = NULL;
+	unsigned long long v;
+
+	errno = 0;
+	v = strtoull(s, &end, 10);
+	if (errno || !end || *end != '\0')
+		return -EINVAL;
+	*out = (__u64)v;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct loader ld = { .opts = { .rr_slice_ns = 50ULL * 1000ULL * 1000ULL } };
+	const char *ctl_path = CTL_PATH_DFL, *client_cmd = NULL;
+	const struct policy *initial = &policies[0];
+	__u64 rr_ms = 50, next_stats;
+	int lfd, opt;
+
+	libbpf_set_print(libbpf_print_fn);
+	signal(SIGINT, sigint_handler);
+	signal(SIGTERM, sigint_handler);
+	signal(SIGPIPE, SIG_IGN);
+
+	while ((opt = getopt(argc, argv, "p:as:PS:x:vh")) != -1) {
+		switch (opt) {
+		case 'p':
+			initial = find_policy(optarg);
+			if (!initial) {
+				fprintf(stderr, "Unknown policy: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'a':
+			ld.opts.all_tasks = true;
+			break;
+		case 's':
+			if (parse_u64(optarg, &rr_ms)) {
+				fprintf(stderr, "Invalid -s value: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'P':
+			ld.opts.timer_preempt = true;
+			break;
+		case 'S':
+			ctl_path = optarg;
+			break;
+		case 'x':
+			client_cmd = optarg;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			fprintf(stderr, help_fmt, basename(argv[0]), basename(argv[0]));
+			return opt != 'h';
+		}
+	}
+
+	if (client_cmd)
+		return ctl_send(ctl_path, client_cmd);
+
+	ld.opts.rr_slice_ns = rr_ms * 1000ULL * 1000ULL;
+
+	lfd = ctl_listen(ctl_path);
+	if (lfd < 0) {
+		fprintf(stderr, "Failed to listen on %s: %s\n", ctl_path, strerror(-lfd));
+		return 1;
+	}
+
+	if (switch_policy(&ld, initial)) {
+		unlink(ctl_path);
+		return 1;
+	}
+	printf("scx_loader: mode=%s preempt=%s control=%s\n",
+	       ld.opts.all_tasks ? "full" : "partial",
+	       ld.opts.timer_preempt ? "timer" : "tick", ctl_path);
+
+	next_stats = now_ns();
+	while (!exit_req) {
+		struct pollfd pfd = { .fd = lfd, .events = POLLIN };
+		__u64 now = now_ns();
+		int timeout;
+
+		if (ld.cur->exited(ld.skel)) {
+			const struct policy *pol = ld.cur;
+			__u64 ecode;
+
+			/* the scheduler exited on its own; old link is dead */
+			detach_current(&ld);
+			ecode = pol->report(ld.skel);
+			pol->destroy(ld.skel);
+			ld.cur = NULL;
+			ld.skel = NULL;
+			if (!UEI_ECODE_RESTART(ecode) || switch_policy(&ld, pol))
+				break;
+			continue;
+		}
+
+		if (now >= next_stats) {
+			print_stats(&ld);
+			next_stats = now + 1000ULL * 1000ULL * 1000ULL;
+		}
+		timeout = (int)((next_stats - now) / 1000000ULL) + 1;
+		if (poll(&pfd, 1, timeout) > 0)
+			ctl_handle(&ld, lfd);
+	}
+
+	if (ld.cur) {
+		detach_current(&ld);
+		ld.cur->report(ld.skel);
+		ld.cur->destroy(ld.skel);
+	}
+	close(lfd);
+	unlink(ctl_path);
+	return 0;
+}
@@ -0,0 +1,187 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * scx_lockstat: lock contention collector to run next to a sched_ext
+ * scheduler.
+ *
+ * The shared DSQs (FIFO_DSQ in scx_fifo, RR_DSQ/FIFO_DSQ in scx_mlfq) are
+ * each protected by one spinlock that every CPU takes to queue and to
+ * consume, and moving tasks between CPUs takes remote runqueue locks. This
+ * attaches to the lock:contention_begin/end tracepoints and sums the time
+ * spent waiting, keyed by the waiter's kernel stack and the kind of lock.
+ *
+ * It is not a scheduler; it only observes, whatever policy is loaded.
+ */
+#include <scx/common.bpf.h>
+#include <bpf/usdt.bpf.h>
+
+#include "scx_lockstat.h"
+
+char _license[] SEC("license") = "GPL";
+
+/* Set by userspace before load */
+const volatile u32 nr_cpus = 1;
+
+extern struct rq runqueues __ksym;
+
+/* In-flight waits, keyed by wait_key() */
+struct wait_start {
+	u64 ts;
+	u64 lock;
+	s32 stackid;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, 16384);
+	__type(key, u32);
+	__type(value, struct wait_start);
+} starts SEC(".maps");
+
+/* Lock address -> enum lockstat_kind, filled by init_locks */
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, 1);		/* resized by userspace */
+	__type(key, u64);
+	__type(value, u32);
+} lock_kinds SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_STACK_TRACE);
+	__uint(max_entries, 8192);
+	__uint(key_size, sizeof(u32));
+	__uint(value_size, LOCKSTAT_STACK_DEPTH * sizeof(u64));
+} stacks SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, 16384);
+	__type(key, struct lockstat_key);
+	__type(value, struct lockstat_val);
+} contention SEC(".maps");
+
+/* enum lockstat_counter */
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(key_size, sizeof(u32));
+	__uint(value_size, sizeof(u64));
+	__uint(max_entries, NR_LOCKSTAT_COUNTERS);
+} counters SEC(".maps");
+
+static __always_inline void cnt_inc(u32 idx)
+{
+	u64 *cnt_p = bpf_map_lookup_elem(&counters, &idx);
+	if (cnt_p)
+		(*cnt_p)++;
+}
+
+/*
+ * Waits are per thread; the idle tasks all have pid 0, so those are keyed
+ * by CPU instead (top bit set, cannot collide with a pid).
+ */
+static __always_inline u32 wait_key(void)
+{
+	u32 pid = (u32)bpf_get_current_pid_tgid();
+
+	return pid ? pid : 0x80000000 | bpf_get_smp_processor_id();
+}
+
+static __always_inline u32 lock_kind(u64 lock)
+{
+	u32 *kind = bpf_map_lookup_elem(&lock_kinds, &lock);
+
+	return kind ? *kind : LOCK_KIND_OTHER;
+}
+
+static __always_inline void set_kind(u64 lock, u32 kind)
+{
+	bpf_map_update_elem(&lock_kinds, &lock, &kind, BPF_ANY);
+}
+
+/* Run once by userspace (BPF_PROG_RUN) before attaching. */
+SEC("syscall")
+int init_locks(void *ctx)
+{
+	s32 cpu;
+
+	bpf_for(cpu, 0, nr_cpus) {
+		struct rq *rq = bpf_per_cpu_ptr(&runqueues, cpu);
+
+		if (!rq)
+			continue;
+		set_kind((u64)&rq->__lock, LOCK_KIND_RQ);
+		set_kind((u64)&rq->scx.local_dsq.lock, LOCK_KIND_LOCAL_DSQ);
+	}
+	return 0;
+}
+
+/*
+ * Only the outermost wait of a thread is timed: a spinlock contended
+ * inside a mutex slowpath is part of the mutex wait, and contention_end
+ * of the inner lock must not close the outer one (checked by address).
+ */
+SEC("tp_btf/contention_begin")
+int BPF_PROG(lock_begin, void *lock, unsigned int flags)
+{
+	struct wait_start ws = { .lock = (u64)lock };
+	u32 key = wait_key();
+
+	if (bpf_map_lookup_elem(&starts, &key)) {
+		cnt_inc(LOCKSTAT_NESTED);
+		return 0;
+	}
+	ws.stackid = bpf_get_stackid(ctx, &stacks, 0);
+	if (ws.stackid < 0)
+		cnt_inc(LOCKSTAT_NO_STACK);
+	/* after the stack walk, which is not part of the wait */
+	ws.ts = bpf_ktime_get_ns();
+	bpf_map_update_elem(&starts, &key, &ws, BPF_ANY);
+	return 0;
+}
+
+SEC("tp_btf/contention_end")
+int BPF_PROG(lock_end, void *lock, int ret)
+{
+	struct lockstat_val zero = {}, *v;
+	struct lockstat_key lk;
+	struct wait_start *ws;
+	u32 key = wait_key();
+	u64 delta;
+
+	ws = bpf_map_lookup_elem(&starts, &key);
+	if (!ws || ws->lock != (u64)lock)
+		return 0;
+	delta = bpf_ktime_get_ns() - ws->ts;
+	lk.stackid = ws->stackid;
+	lk.kind = lock_kind(ws->lock);
+	bpf_map_delete_elem(&starts, &key);
+
+	v = bpf_map_lookup_elem(&contention, &lk);
+	if (!v) {
+		bpf_map_update_elem(&contention, &lk, &zero, BPF_NOEXIST);
+		v = bpf_map_lookup_elem(&contention, &lk);
+		if (!v)
+			return 0;
+	}
+	__sync_fetch_and_add(&v->wait_ns, delta);
+	__sync_fetch_and_add(&v->count, 1);
+	/* racy, a lost update only understates the max */
+	if (delta > v->max_ns)
+		v->max_ns = delta;
+	return 0;
+}
+
+SEC("tp_btf/sched_switch")
+int BPF_PROG(lock_switch, bool preempt, struct task_struct *prev,
+	     struct task_struct *next)
+{
+	cnt_inc(LOCKSTAT_CTXSW);
+	return 0;
+}
+
+/* loadtest_usdt.h job_end; attached per generator binary by userspace. */
+SEC("usdt")
+int BPF_USDT(lt_job_end, int job, u64 work)
+{
+	cnt_inc(LOCKSTAT_JOBS);
+	return 0;
+}
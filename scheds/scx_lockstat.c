@@ -0,0 +1,512 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Userspace side of scx_lockstat.
+ *
+ * Every second prints the policy's throughput (context switches, and
+ * loadtest jobs finished with -u) next to the lock wait of that second,
+ * split into runqueue locks, DSQ locks and the rest. On exit prints the
+ * callers that waited longest.
+ *
+ * Attribution: runqueue and local DSQ locks are known by address. Any
+ * other lock whose caller (first stack frame above the locking code) is
+ * sched_ext DSQ code is counted as a DSQ lock; that is where the shared
+ * DSQs of the schedulers in this directory are locked.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <libgen.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include "scx_lockstat.h"
+#include "scx_lockstat.bpf.skel.h"
+
+const char help_fmt[] =
+"Lock contention collector for sched_ext schedulers.\n"
+"\n"
+"Runs next to a scheduler and reports, per second, the time spent waiting\n"
+"on runqueue locks, DSQ locks and other locks, with the throughput.\n"
+"\n"
+"Usage: %s [-u BINARY]... [-o CSV] [-n TOPN] [-v]\n"
+"\n"
+"  -u BINARY     Count loadtest jobs finished (USDT job_end) in BINARY\n"
+"                (repeatable, e.g. bin/loadtest)\n"
+"  -o CSV        Also write the per-second numbers to CSV\n"
+"  -n TOPN       Callers to list on exit (default: 10)\n"
+"  -v            Print libbpf debug messages\n"
+"  -h            Display this help and exit\n";
+
+static bool verbose;
+static volatile int exit_req;
+
+static int libbpf_print_fn(enum libbpf_print_level level,
+			   const char *format, va_list args)
+{
+	if (level == LIBBPF_DEBUG && !verbose)
+		return 0;
+	return vfprintf(stderr, format, args);
+}
+
+static void sigint_handler(int dummy)
+{
+	exit_req = 1;
+}
+
+#define MAX_USDT_BINS	8
+#define MAX_STACKS	8192	/* max_entries of the stacks map */
+
+enum category {
+	CAT_RQ,
+	CAT_DSQ,
+	CAT_OTHER,
+	NR_CATS,
+};
+
+static const char *cat_names[NR_CATS] = { "rq", "dsq", "other" };
+
+struct ksym {
+	__u64	addr;
+	char	*name;
+};
+
+static struct ksym *ksyms;
+static size_t nr_ksyms;
+
+static int ksym_cmp(const void *a, const void *b)
+{
+	const struct ksym *ka = a, *kb = b;
+
+	return ka->addr < kb->addr ? -1 : ka->addr > kb->addr;
+}
+
+static int load_ksyms(void)
+{
+	FILE *f = fopen("/proc/kallsyms", "r");
+	size_t cap = 0;
+	char line[512];
+
+	if (!f)
+		return -errno;
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long long addr;
+		char type, name[256];
+
+		if (sscanf(line, "%llx %c %255s", &addr, &type, name) != 3)
+			continue;
+		if (type != 't' && type != 'T')
+			continue;
+		if (nr_ksyms == cap) {
+			cap = cap ? cap * 2 : 65536;
+			ksyms = realloc(ksyms, cap * sizeof(*ksyms));
+			if (!ksyms) {
+				fclose(f);
+				return -ENOMEM;
+			}
+		}
+		ksyms[nr_ksyms].addr = addr;
+		ksyms[nr_ksyms].name = strdup(name);
+		nr_ksyms++;
+	}
+	fclose(f);
+	qsort(ksyms, nr_ksyms, sizeof(*ksyms), ksym_cmp);
+	return nr_ksyms ? 0 : -ENOENT;
+}
+
+static const char *ksym_name(__u64 addr)
+{
+	size_t lo = 0, hi = nr_ksyms;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+
+		if (ksyms[mid].addr <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo ? ksyms[lo - 1].name : NULL;
+}
+
+/* Frames of the tracing and locking code itself, skipped to find the caller */
+static bool is_lock_frame(const char *name)
+{
+	static const char *prefixes[] = {
+		"bpf_prog_", "bpf_trace_run", "__bpf_trace_", "__traceiter_",
+		"trace_contention", "_raw_", "raw_spin_rq_", "do_raw_",
+		"queued_", "native_queued_", "__pv_queued_", "pv_",
+		"__mutex_lock", "mutex_lock", "__rt_mutex", "rt_mutex",
+		"rwsem_", "down_", "__down", "osq_", "lock_acquire",
+		"__lock_acquire", "double_rq_lock", "double_lock_balance",
+		"_double_lock_balance", "task_rq_lock", "__task_rq_lock",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++)
+		if (!strncmp(name, prefixes[i], strlen(prefixes[i])))
+			return true;
+	return false;
+}
+
+/*
+ * kernel/sched/ext.c functions that lock a DSQ (or inline one that does).
+ * An explicit list: other ext.c callers take the rq or cgroup locks.
+ */
+static bool is_dsq_caller(const char *name)
+{
+	static const char *names[] = {
+		"do_enqueue_task", "direct_dispatch", "dispatch_enqueue",
+		"dispatch_dequeue", "ops_dequeue", "task_unlink_from_dsq",
+		"consume_dispatch_q", "consume_remote_task",
+		"move_remote_task_to_local_dsq", "move_local_task_to_local_dsq",
+		"move_task_between_dsqs", "unlink_dsq_and_lock_src_rq",
+		"dispatch_to_local_dsq", "finish_dispatch", "flush_dispatch_buf",
+		"balance_one", "process_ddsp_deferred_locals", "destroy_dsq",
+		"scx_bpf_consume", "scx_bpf_dsq_move_to_local",
+		"scx_dispatch_from_dsq", "scx_dsq_move",
+	};
+	/* ignore compiler suffixes such as .isra.0 or .constprop.0 */
+	size_t len = strcspn(name, "."), i;
+
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+		if (strlen(names[i]) == len && !strncmp(name, names[i], len))
+			return true;
+	return false;
+}
+
+/* Caller and category per stack id, resolved once */
+struct stack_info {
+	bool		resolved;
+	bool		dsq_caller;
+	char		caller[64];
+};
+
+static struct stack_info stack_infos[MAX_STACKS];
+
+static struct stack_info *stack_info(int stacks_fd, __s32 stackid)
+{
+	__u64 ips[LOCKSTAT_STACK_DEPTH] = {};
+	struct stack_info *si;
+	__u32 id = stackid;
+	int i;
+
+	if (stackid < 0 || stackid >= MAX_STACKS)
+		return NULL;
+	si = &stack_infos[stackid];
+	if (si->resolved)
+		return si;
+
+	si->resolved = true;
+	snprintf(si->caller, sizeof(si->caller), "[unknown]");
+	if (bpf_map_lookup_elem(stacks_fd, &id, ips))
+		return si;
+	for (i = 0; i < LOCKSTAT_STACK_DEPTH && ips[i]; i++) {
+		const char *name = ksym_name(ips[i]);
+
+		if (!name) {
+			snprintf(si->caller, sizeof(si->caller), "0x%llx",
+				 (unsigned long long)ips[i]);
+			break;
+		}
+		if (is_lock_frame(name))
+			continue;
+		snprintf(si->caller, sizeof(si->caller), "%s", name);
+		si->dsq_caller = is_dsq_caller(name);
+		break;
+	}
+	return si;
+}
+
+static enum category classify(const struct lockstat_key *k, struct stack_info *si)
+{
+	switch (k->kind) {
+	case LOCK_KIND_RQ:
+		return CAT_RQ;
+	case LOCK_KIND_LOCAL_DSQ:
+		return CAT_DSQ;
+	default:
+		return si && si->dsq_caller ? CAT_DSQ : CAT_OTHER;
+	}
+}
+
+static void read_counters(struct scx_lockstat *skel, __u64 *out)
+{
+	int nr_cpus = libbpf_num_possible_cpus();
+	__u64 cnts[nr_cpus];
+	__u32 idx;
+
+	for (idx = 0; idx < NR_LOCKSTAT_COUNTERS; idx++) {
+		int cpu;
+
+		out[idx] = 0;
+		if (bpf_map_lookup_elem(bpf_map__fd(skel->maps.counters),
+					&idx, cnts) < 0)
+			continue;
+		for (cpu = 0; cpu < nr_cpus; cpu++)
+			out[idx] += cnts[cpu];
+	}
+}
+
+/* Cumulative wait and count per category */
+static void read_contention(struct scx_lockstat *skel, __u64 *wait_ns, __u64 *count)
+{
+	int fd = bpf_map__fd(skel->maps.contention);
+	int stacks_fd = bpf_map__fd(skel->maps.stacks);
+	struct lockstat_key key, next;
+	struct lockstat_val v;
+	int c, ret;
+
+	for (c = 0; c < NR_CATS; c++)
+		wait_ns[c] = count[c] = 0;
+
+	ret = bpf_map_get_next_key(fd, NULL, &next);
+	while (!ret) {
+		key = next;
+		if (!bpf_map_lookup_elem(fd, &key, &v)) {
+			c = classify(&key, stack_info(stacks_fd, key.stackid));
+			wait_ns[c] += v.wait_ns;
+			count[c] += v.count;
+		}
+		ret = bpf_map_get_next_key(fd, &key, &next);
+	}
+}
+
+struct caller_row {
+	char		caller[64];
+	enum category	cat;
+	__u64		wait_ns;
+	__u64		count;
+	__u64		max_ns;
+};
+
+static int cmp_wait_desc(const void *a, const void *b)
+{
+	const struct caller_row *ra = a, *rb = b;
+
+	if (ra->wait_ns < rb->wait_ns)
+		return 1;
+	if (ra->wait_ns > rb->wait_ns)
+		return -1;
+	return 0;
+}
+
+static void print_callers(struct scx_lockstat *skel, int topn)
+{
+	int fd = bpf_map__fd(skel->maps.contention);
+	int stacks_fd = bpf_map__fd(skel->maps.stacks);
+	struct caller_row *rows = NULL;
+	size_t cap = 0, cnt = 0, i;
+	struct lockstat_key key, next;
+	struct lockstat_val v;
+	int ret;
+
+	ret = bpf_map_get_next_key(fd, NULL, &next);
+	while (!ret) {
+		struct stack_info *si;
+		const char *caller;
+		enum category cat;
+
+		key = next;
+		ret = bpf_map_get_next_key(fd, &key, &next);
+		if (bpf_map_lookup_elem(fd, &key, &v))
+			continue;
+		si = stack_info(stacks_fd, key.stackid);
+		cat = classify(&key, si);
+		caller = si ? si->caller : "[no stack]";
+
+		/* stacks differing below the caller are merged */
+		for (i = 0; i < cnt; i++)
+			if (rows[i].cat == cat && !strcmp(rows[i].caller, caller))
+				break;
+		if (i == cnt) {
+			if (cnt == cap) {
+				cap = cap ? cap * 2 : 64;
+				rows = realloc(rows, cap * sizeof(*rows));
+				if (!rows)
+					return;
+			}
+			memset(&rows[cnt], 0, sizeof(rows[cnt]));
+			snprintf(rows[cnt].caller, sizeof(rows[cnt].caller), "%s", caller);
+			rows[cnt].cat = cat;
+			cnt++;
+		}
+		rows[i].wait_ns += v.wait_ns;
+		rows[i].count += v.count;
+		if (v.max_ns > rows[i].max_ns)
+			rows[i].max_ns = v.max_ns;
+	}
+
+	if (!cnt) {
+		printf("No lock contention recorded.\n");
+		free(rows);
+		return;
+	}
+	qsort(rows, cnt, sizeof(*rows), cmp_wait_desc);
+
+	printf("\n%-40s %6s %12s %10s %10s %10s\n",
+	       "CALLER", "LOCK", "WAIT(ms)", "COUNT", "AVG(us)", "MAX(us)");
+	for (i = 0; i < cnt && (int)i < topn; i++) {
+		const struct caller_row *r = &rows[i];
+
+		printf("%-40s %6s %12.3f %10llu %10.2f %10.2f\n",
+		       r->caller, cat_names[r->cat], r->wait_ns / 1e6,
+		       (unsigned long long)r->count,
+		       r->count ? r->wait_ns / 1e3 / r->count : 0.0,
+		       r->max_ns / 1e3);
+	}
+	free(rows);
+}
+
+static int init_locks(struct scx_lockstat *skel)
+{
+	LIBBPF_OPTS(bpf_test_run_opts, opts);
+	int ret;
+
+	ret = bpf_prog_test_run_opts(bpf_program__fd(skel->progs.init_locks), &opts);
+	if (ret)
+		return ret;
+	return opts.retval;
+}
+
+int main(int argc, char **argv)
+{
+	struct scx_lockstat *skel;
+	struct bpf_link *usdt_links[MAX_USDT_BINS];
+	const char *usdt_bins[MAX_USDT_BINS];
+	int nr_usdt_bins = 0, i, opt, topn = 10;
+	int nr_cpus = libbpf_num_possible_cpus();
+	const char *csv_path = NULL;
+	FILE *csv = NULL;
+	__u64 prev_cnt[NR_LOCKSTAT_COUNTERS] = {};
+	__u64 prev_wait[NR_CATS] = {}, prev_count[NR_CATS] = {};
+	unsigned long sec = 0;
+
+	libbpf_set_print(libbpf_print_fn);
+	signal(SIGINT, sigint_handler);
+	signal(SIGTERM, sigint_handler);
+
+	while ((opt = getopt(argc, argv, "u:o:n:vh")) != -1) {
+		switch (opt) {
+		case 'u':
+			if (nr_usdt_bins == MAX_USDT_BINS) {
+				fprintf(stderr, "At most %d -u binaries\n", MAX_USDT_BINS);
+				return 1;
+			}
+			usdt_bins[nr_usdt_bins++] = optarg;
+			break;
+		case 'o':
+			csv_path = optarg;
+			break;
+		case 'n':
+			topn = strtol(optarg, NULL, 10);
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			fprintf(stderr, help_fmt, basename(argv[0]));
+			return opt != 'h';
+		}
+	}
+
+	if (load_ksyms())
+		fprintf(stderr, "Warning: no /proc/kallsyms, callers are not resolved\n");
+
+	skel = scx_lockstat__open();
+	if (!skel) {
+		fprintf(stderr, "Failed to open the BPF object\n");
+		return 1;
+	}
+	skel->rodata->nr_cpus = nr_cpus;
+	/* rq->__lock and rq->scx.local_dsq.lock of every CPU */
+	bpf_map__set_max_entries(skel->maps.lock_kinds, 2 * nr_cpus);
+
+	if (scx_lockstat__load(skel)) {
+		fprintf(stderr, "Failed to load (needs lock:contention_* tracepoints)\n");
+		goto err;
+	}
+	if (init_locks(skel)) {
+		fprintf(stderr, "Failed to resolve the runqueue locks\n");
+		goto err;
+	}
+	if (scx_lockstat__attach(skel)) {
+		fprintf(stderr, "Failed to attach\n");
+		goto err;
+	}
+	for (i = 0; i < nr_usdt_bins; i++) {
+		usdt_links[i] = bpf_program__attach_usdt(skel->progs.lt_job_end, -1,
+							 usdt_bins[i], "loadtest",
+							 "job_end", NULL);
+		if (!usdt_links[i]) {
+			fprintf(stderr, "No loadtest:job_end probe in %s\n", usdt_bins[i]);
+			nr_usdt_bins = i;
+			goto err;
+		}
+	}
+
+	if (csv_path) {
+		csv = fopen(csv_path, "w");
+		if (!csv) {
+			fprintf(stderr, "Failed to open %s: %s\n", csv_path, strerror(errno));
+			goto err;
+		}
+		fprintf(csv, "sec,ctxsw,jobs");
+		for (i = 0; i < NR_CATS; i++)
+			fprintf(csv, ",%s_wait_ns,%s_count", cat_names[i], cat_names[i]);
+		fprintf(csv, "\n");
+	}
+
+	while (!exit_req) {
+		__u64 cnt[NR_LOCKSTAT_COUNTERS], wait[NR_CATS], count[NR_CATS];
+
+		sleep(1);
+		read_counters(skel, cnt);
+		read_contention(skel, wait, count);
+		sec++;
+
+		printf("ctxsw/s=%llu", cnt[LOCKSTAT_CTXSW] - prev_cnt[LOCKSTAT_CTXSW]);
+		if (nr_usdt_bins)
+			printf(" jobs/s=%llu", cnt[LOCKSTAT_JOBS] - prev_cnt[LOCKSTAT_JOBS]);
+		for (i = 0; i < NR_CATS; i++)
+			printf(" %s=%.3fms/%llu", cat_names[i],
+			       (wait[i] - prev_wait[i]) / 1e6,
+			       count[i] - prev_count[i]);
+		printf("\n");
+		fflush(stdout);
+
+		if (csv) {
+			fprintf(csv, "%lu,%llu,%llu", sec,
+				cnt[LOCKSTAT_CTXSW] - prev_cnt[LOCKSTAT_CTXSW],
+				cnt[LOCKSTAT_JOBS] - prev_cnt[LOCKSTAT_JOBS]);
+			for (i = 0; i < NR_CATS; i++)
+				fprintf(csv, ",%llu,%llu", wait[i] - prev_wait[i],
+					count[i] - prev_count[i]);
+			fprintf(csv, "\n");
+			fflush(csv);
+		}
+
+		memcpy(prev_cnt, cnt, sizeof(cnt));
+		memcpy(prev_wait, wait, sizeof(wait));
+		memcpy(prev_count, count, sizeof(count));
+	}
+
+	print_callers(skel, topn);
+	printf("nested=%llu no_stack=%llu\n",
+	       prev_cnt[LOCKSTAT_NESTED], prev_cnt[LOCKSTAT_NO_STACK]);
+	if (csv)
+		fclose(csv);
+	for (i = 0; i < nr_usdt_bins; i++)
+		bpf_link__destroy(usdt_links[i]);
+	scx_lockstat__destroy(skel);
+	return 0;
+
+err:
+	for (i = 0; i < nr_usdt_bins; i++)
+		bpf_link__destroy(usdt_links[i]);
+	scx_lockstat__destroy(skel);
+	return 1;
+}
@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Definitions shared by scx_lockstat.bpf.c and its userspace side.
+ *
+ * Contention is aggregated per (kernel stack, lock kind). The BPF side can
+ * only tell runqueue locks apart by address; waits on any other lock are
+ * LOCK_KIND_OTHER and userspace attributes them to DSQ locks when the
+ * caller is sched_ext DSQ code (see classify() in scx_lockstat.c).
+ */
+#ifndef __SCX_LOCKSTAT_H
+#define __SCX_LOCKSTAT_H
+
+#ifndef __bpf__
+#include <linux/types.h>
+#endif
+
+#define LOCKSTAT_STACK_DEPTH	32
+
+enum lockstat_kind {
+	LOCK_KIND_RQ,		/* rq->__lock */
+	LOCK_KIND_LOCAL_DSQ,	/* rq->scx.local_dsq.lock */
+	LOCK_KIND_OTHER,	/* shared/user DSQs and everything else */
+	NR_LOCK_KINDS,
+};
+
+struct lockstat_key {
+	__s32	stackid;	/* kernel stack at contention_begin, <0 if lost */
+	__u32	kind;		/* enum lockstat_kind */
+};
+
+struct lockstat_val {
+	__u64	wait_ns;
+	__u64	count;
+	__u64	max_ns;
+};
+
+/* Per-cpu counters, the per-second throughput next to the lock numbers */
+enum lockstat_counter {
+	LOCKSTAT_CTXSW,		/* sched_switch */
+	LOCKSTAT_JOBS,		/* loadtest:job_end (-u) */
+	LOCKSTAT_NO_STACK,	/* bpf_get_stackid() failed */
+	LOCKSTAT_NESTED,	/* inner wait while an outer one is timed */
+	NR_LOCKSTAT_COUNTERS,
+};
+
+#endif /* __SCX_LOCKSTAT_H */
@@ -12,18 +12,48 @@
  *   - Uses two shared DSQs: RR_DSQ (top) and FIFO_DSQ (bottom).
  *   - Per-task storage tracks whether the task has already run once at the
  *     top level and what its current level is.
- *   - Dispatch always prefers RR_DSQ over FIFO_DSQ.
+ *   - Dispatch always prefers RR_DSQ over FIFO_DSQ. With both empty, a
+ *     still-runnable prev gets a fresh slice for its level and keeps the
+ *     CPU instead of a round trip through the shared DSQ.
  *   - Uses SCX_OPS_SWITCH_PARTIAL by default.
+ *   - Slices and the number of levels can be changed at runtime through the
+ *     "tunables" map (see scx_mlfq.h); the rodata values are the defaults.
+ *   - Enqueue-to-run wait times feed a log2 histogram for userspace.
+ *   - Queueing to a shared DSQ kicks an idle CPU, if there is one, so work
+ *     never sits queued while CPUs idle.
+ *   - Admission control (tunables.max_active = K): at most K bottom-level
+ *     tasks hold an admission slot at once. A task takes a slot when it is
+ *     queued at the bottom level and gives it back when it blocks or
+ *     leaves, so K batch jobs share the CPUs and the rest wait in ADMIT_DSQ
+ *     in arrival order. The top level is never held back, so short jobs
+ *     still get through.
+ *   - Slices are normally enforced by the scheduler tick, which rounds
+ *     anything shorter up to a whole tick. With timer_preempt set, running
+ *     arms a per-CPU bpf_timer for the slice and its callback kicks the
+ *     CPU (SCX_KICK_PREEMPT), so sub-tick quanta are honored. How far each
+ *     expired run overshot its slice is recorded in a second histogram.
+ *   - A/B mode (nr_parts = 2): userspace splits the CPUs into two
+ *     partitions through cpu_part. Each partition has its own three DSQs,
+ *     tunables entry, admission slots, stats and histograms, and a CPU only
+ *     consumes its own partition's DSQs, so two policy configurations run
+ *     side by side under the same background noise. A task belongs to the
+ *     partition of the first CPU in its affinity mask; tasks are expected
+ *     to be confined to one partition (loadtest -O pins them).
  */
 #include <scx/common.bpf.h>
 
+#include "scx_mlfq.h"
+
 char _license[] SEC("license") = "GPL";
 
 UEI_DEFINE(uei);
 
+/* Per partition; partition N uses N * NR_PART_DSQS + these. */
 enum {
 	RR_DSQ		= 0,
 	FIFO_DSQ	= 1,
+	ADMIT_DSQ	= 2,	/* bottom-level tasks waiting for a slot */
+	NR_PART_DSQS	= 3,
 };
 
 enum {
@@ -40,11 +70,32 @@ const volatile u64 rr_slice_ns = 50ULL * 1000ULL * 1000ULL;
 /* Bottom queue slice (ns). Default: SCX_SLICE_DFL. */
 const volatile u64 fifo_slice_ns = 200ULL * 1000ULL * 1000ULL;
 
+/* End slices with a per-CPU timer instead of waiting for the tick. */
+const volatile bool timer_preempt;
+
+/* Number of CPU partitions, 2 in A/B mode (see cpu_part). */
+const volatile u32 nr_parts = 1;
+
 struct task_ctx {
 	u8	level;
 	u8	ran_top; /* set once when the task first starts running in LVL_RR */
+	u64	enq_ts;	 /* when the task became runnable, 0 once it ran */
+	u8	queued;	 /* enq_ts is from a shared DSQ, not a direct dispatch */
+	u8	admitted; /* holds an admission slot */
+	u64	admit_ts; /* when parked on ADMIT_DSQ, 0 if not waiting */
+	u8	part;	  /* partition whose slot/wait counts the task is in */
 };
 
+/*
+ * Admission slots in use, and tasks waiting for one, per partition; read
+ * by userspace.
+ */
+u32 nr_admitted[MLFQ_MAX_PARTS];
+u32 nr_admit_waiting[MLFQ_MAX_PARTS];
+
+/* Lost compare-and-swap races admit_slot() retries while a slot is free. */
+#define ADMIT_CAS_TRIES	16
+
 struct {
 	__uint(type, BPF_MAP_TYPE_TASK_STORAGE);
 	__uint(map_flags, BPF_F_NO_PREALLOC);
@@ -52,29 +103,231 @@ struct {
 	__type(value, struct task_ctx);
 } task_ctx_stor SEC(".maps");
 
-/* stats: [0]=local dispatches, [1]=enqueued to RR, [2]=enqueued to FIFO */
+/* stats: indexed by partition * NR_MLFQ_STATS + enum mlfq_stat */
 struct {
 	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
 	__uint(key_size, sizeof(u32));
 	__uint(value_size, sizeof(u64));
-	__uint(max_entries, 3);
+	__uint(max_entries, MLFQ_MAX_PARTS * NR_MLFQ_STATS);
 } stats SEC(".maps");
 
-static __always_inline void stat_inc(u32 idx)
+/*
+ * Written by userspace (controller, scx_tune), one entry per partition;
+ * zero fields use rodata.
+ */
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, MLFQ_MAX_PARTS);
+	__type(key, u32);
+	__type(value, struct mlfq_tunables);
+} tunables SEC(".maps");
+
+/*
+ * Per-CPU run state. Timers can't live in per-cpu maps, so this is an
+ * ARRAY indexed by cpu id; userspace sizes it to the number of cpu ids.
+ */
+struct cpu_ctx {
+	struct bpf_timer	timer;
+	u64			run_start;	/* 0 when idle */
+	u64			slice;		/* slice the current run started with */
+	u32			armed;		/* timer pending for the current run */
+	u32			part;		/* partition of this CPU */
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, u32);
+	__type(value, struct cpu_ctx);
+} cpu_ctx_stor SEC(".maps");
+
+/* A/B mode: cpu id -> partition, sized and filled by userspace before attach. */
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, u32);
+	__type(value, u32);
+} cpu_part SEC(".maps");
+
+/* Overshoot of runs that used up their slice, bucket = log2(ran - slice) */
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(key_size, sizeof(u32));
+	__uint(value_size, sizeof(u64));
+	__uint(max_entries, MLFQ_MAX_PARTS * MLFQ_HIST_BUCKETS);
+} quantum_hist SEC(".maps");
+
+/* Wait-time histogram, bucket = log2(wait_ns) */
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(key_size, sizeof(u32));
+	__uint(value_size, sizeof(u64));
+	__uint(max_entries, MLFQ_MAX_PARTS * MLFQ_HIST_BUCKETS);
+} wait_hist SEC(".maps");
+
+static __always_inline void stat_add(u32 part, u32 idx, u64 v)
 {
-	u64 *cnt_p = bpf_map_lookup_elem(&stats, &idx);
+	u32 key = part * NR_MLFQ_STATS + idx;
+	u64 *cnt_p = bpf_map_lookup_elem(&stats, &key);
+	if (cnt_p)
+		(*cnt_p) += v;
+}
+
+static __always_inline void stat_inc(u32 part, u32 idx)
+{
+	stat_add(part, idx, 1);
+}
+
+static __always_inline u32 part_of_cpu(u32 cpu)
+{
+	u32 *part;
+
+	if (nr_parts < 2)
+		return 0;
+	part = bpf_map_lookup_elem(&cpu_part, &cpu);
+	return (part && *part < MLFQ_MAX_PARTS) ? *part : 0;
+}
+
+/* Partition of the first CPU the task may run on. */
+static __always_inline u32 task_part(struct task_struct *p)
+{
+	if (nr_parts < 2)
+		return 0;
+	return part_of_cpu(bpf_cpumask_first(p->cpus_ptr));
+}
+
+static __always_inline u64 part_dsq(u32 part, u64 dsq)
+{
+	return part * NR_PART_DSQS + dsq;
+}
+
+static __always_inline struct mlfq_tunables *get_tunables(u32 part)
+{
+	return bpf_map_lookup_elem(&tunables, &part);
+}
+
+static __always_inline u64 slice_for_level(u8 lvl, u32 part)
+{
+	struct mlfq_tunables *tn = get_tunables(part);
+	u64 slice = 0;
+
+	if (tn)
+		slice = (lvl == LVL_RR) ? tn->rr_slice_ns : tn->fifo_slice_ns;
+	if (!slice)
+		slice = (lvl == LVL_RR) ? rr_slice_ns : fifo_slice_ns;
+	return slice;
+}
+
+static __always_inline u32 nr_levels(u32 part)
+{
+	struct mlfq_tunables *tn = get_tunables(part);
+
+	return (tn && tn->nr_levels) ? tn->nr_levels : 2;
+}
+
+static __always_inline u32 max_active(u32 part)
+{
+	struct mlfq_tunables *tn = get_tunables(part);
+
+	return tn ? tn->max_active : 0;
+}
+
+static __always_inline u32 log2_u64(u64 v)
+{
+	u32 r = 0, shift;
+
+	/* binary search: shifts of 32, 16, 8, 4, 2, 1 */
+	for (shift = 32; shift; shift >>= 1) {
+		if (v >> shift) {
+			v >>= shift;
+			r += shift;
+		}
+	}
+	return r;
+}
+
+static __always_inline void hist_inc(void *hist, u32 part, u64 v)
+{
+	u32 idx = part * MLFQ_HIST_BUCKETS + log2_u64(v);
+	u64 *cnt_p = bpf_map_lookup_elem(hist, &idx);
+
 	if (cnt_p)
 		(*cnt_p)++;
 }
 
-static __always_inline u64 slice_for_level(u8 lvl)
+static __always_inline struct cpu_ctx *get_cctx(void)
+{
+	u32 cpu = bpf_get_smp_processor_id();
+
+	return bpf_map_lookup_elem(&cpu_ctx_stor, &cpu);
+}
+
+static int preempt_timerfn(void *map, int *key, struct cpu_ctx *cctx)
+{
+	/*
+	 * Timers aren't cancelled when a run ends early (bpf_timer_cancel
+	 * can't be called from the scheduling path), stopping just clears
+	 * armed. A stale expiry finds it clear and does nothing.
+	 */
+	if (cctx->armed) {
+		cctx->armed = 0;
+		stat_inc(cctx->part, MLFQ_STAT_TIMER_KICK);
+		scx_bpf_kick_cpu(*key, SCX_KICK_PREEMPT);
+	}
+	return 0;
+}
+
+/*
+ * Shared DSQs are only drained from dispatch; claim an idle CPU and kick
+ * it so the task doesn't wait for that CPU's next wakeup.
+ */
+static __always_inline void kick_idle_cpu(struct task_struct *p, u32 part)
+{
+	s32 cpu = scx_bpf_pick_idle_cpu(p->cpus_ptr, 0);
+
+	if (cpu >= 0) {
+		stat_inc(part, MLFQ_STAT_IDLE_KICK);
+		scx_bpf_kick_cpu(cpu, SCX_KICK_IDLE);
+	} else {
+		stat_inc(part, MLFQ_STAT_NO_IDLE);
+	}
+}
+
+/* Start of a run (or of a refilled slice) on this CPU. */
+static __always_inline void run_begin(struct cpu_ctx *cctx, u64 slice, u64 now)
+{
+	cctx->run_start = now;
+	cctx->slice = slice;
+	if (timer_preempt && slice &&
+	    !bpf_timer_start(&cctx->timer, slice, BPF_F_TIMER_CPU_PIN)) {
+		cctx->armed = 1;
+		stat_inc(cctx->part, MLFQ_STAT_TIMER_ARMED);
+	}
+}
+
+/*
+ * End of a run. If the slice was used up (by the tick or the timer),
+ * record how far it was overshot.
+ */
+static __always_inline void run_end(struct cpu_ctx *cctx, struct task_struct *p,
+				    bool runnable, u64 now)
 {
-	return (lvl == LVL_RR) ? rr_slice_ns : fifo_slice_ns;
+	if (!cctx->run_start)
+		return;
+	if (runnable && !p->scx.slice) {
+		u64 ran = now - cctx->run_start;
+
+		stat_inc(cctx->part, MLFQ_STAT_EXPIRED);
+		hist_inc(&quantum_hist, cctx->part,
+			 ran > cctx->slice ? ran - cctx->slice : 0);
+	}
+	cctx->run_start = 0;
+	cctx->armed = 0;
 }
 
-static __always_inline u64 dsq_for_level(u8 lvl)
+static __always_inline u64 dsq_for_level(u8 lvl, u32 part)
 {
-	return (lvl == LVL_RR) ? RR_DSQ : FIFO_DSQ;
+	return part_dsq(part, (lvl == LVL_RR) ? RR_DSQ : FIFO_DSQ);
 }
 
 static __always_inline struct task_ctx *get_tctx(struct task_struct *p)
@@ -82,23 +335,112 @@ static __always_inline struct task_ctx *get_tctx(struct task_struct *p)
 	return bpf_task_storage_get(&task_ctx_stor, p, 0, 0);
 }
 
+static __always_inline u32 tctx_part(struct task_ctx *tctx)
+{
+	return tctx->part < MLFQ_MAX_PARTS ? tctx->part : 0;
+}
+
+/*
+ * Follow the task's affinity into the partition it now runs in, unless it
+ * holds or waits for a slot, which must be given back where it was taken.
+ */
+static __always_inline u32 update_part(struct task_struct *p, struct task_ctx *tctx)
+{
+	if (!tctx->admitted && !tctx->admit_ts)
+		tctx->part = task_part(p);
+	return tctx_part(tctx);
+}
+
+/*
+ * After the task has executed once in the RR queue, demote permanently to
+ * the FIFO queue (even if it blocks). This matches the requested behavior.
+ */
+static __always_inline void maybe_demote(struct task_ctx *tctx)
+{
+	if (tctx->level == LVL_RR && tctx->ran_top && nr_levels(tctx_part(tctx)) > 1)
+		tctx->level = LVL_FIFO;
+}
+
+/* Level the task is queued at; with a single level everything stays on top. */
+static __always_inline u8 task_level(struct task_ctx *tctx)
+{
+	return nr_levels(tctx_part(tctx)) > 1 ? tctx->level : LVL_RR;
+}
+
+/*
+ * Take an admission slot for a bottom-level task. Without a limit (K = 0)
+ * this always succeeds; the count is still kept so release() stays
+ * balanced if K is set later. With a limit, a compare-and-swap lost to
+ * another CPU is retried while a slot is free; only after ADMIT_CAS_TRIES
+ * lost races in a row does the task go through ADMIT_DSQ, where dispatch
+ * admits it as soon as a slot is free.
+ */
+static __always_inline bool admit_slot(u32 part)
+{
+	u32 k, cur, old;
+	int i;
+
+	if (part >= MLFQ_MAX_PARTS)
+		return false;
+	k = max_active(part);
+	if (!k) {
+		__sync_fetch_and_add(&nr_admitted[part], 1);
+		return true;
+	}
+	cur = READ_ONCE(nr_admitted[part]);
+	for (i = 0; i < ADMIT_CAS_TRIES && cur < k; i++) {
+		old = __sync_val_compare_and_swap(&nr_admitted[part], cur, cur + 1);
+		if (old == cur)
+			return true;
+		cur = old;
+	}
+	return false;
+}
+
+static __always_inline bool admit(struct task_ctx *tctx)
+{
+	if (tctx->admitted || task_level(tctx) != LVL_FIFO)
+		return true;
+	if (!admit_slot(tctx_part(tctx)))
+		return false;
+	tctx->admitted = 1;
+	return true;
+}
+
+static __always_inline void release(struct task_ctx *tctx)
+{
+	if (tctx->admitted) {
+		tctx->admitted = 0;
+		__sync_fetch_and_sub(&nr_admitted[tctx_part(tctx)], 1);
+	}
+}
+
 s32 BPF_STRUCT_OPS(mlfq_select_cpu, struct task_struct *p, s32 prev_cpu,
 			  u64 wake_flags)
 {
 	struct task_ctx *tctx;
 	bool is_idle = false;
+	u32 part;
 	s32 cpu;
 
 	cpu = scx_bpf_select_cpu_dfl(p, prev_cpu, wake_flags, &is_idle);
 	if (!is_idle)
 		return cpu;
 
-	/* If we're dispatching directly to local, use the task's current level. */
+	/*
+	 * If we're dispatching directly to local, use the task's current level.
+	 * A bottom-level task without an admission slot goes through enqueue.
+	 */
 	tctx = get_tctx(p);
-	if (tctx) {
-		u64 slice = slice_for_level(tctx->level);
+	if (!tctx)
+		return cpu;
+	part = update_part(p, tctx);
+	if (admit(tctx)) {
+		u64 slice = slice_for_level(task_level(tctx), part);
 
-		stat_inc(0);
+		tctx->enq_ts = bpf_ktime_get_ns();
+		tctx->queued = 0;
+		stat_inc(part, MLFQ_STAT_LOCAL);
 		scx_bpf_dispatch(p, SCX_DSQ_LOCAL, slice, 0);
 	}
 
@@ -110,50 +452,178 @@ void BPF_STRUCT_OPS(mlfq_enqueue, struct task_struct *p, u64 enq_flags)
 	struct task_ctx *tctx = get_tctx(p);
 	u8 lvl = LVL_RR;
 	u64 dsq, slice;
+	u32 part;
 
-	/* If we don't have ctx for some reason, keep the task in the top queue. */
-	if (tctx)
-		lvl = tctx->level;
+	/*
+	 * If we don't have ctx for some reason, keep the task in the top queue.
+	 * With a single level everything stays there.
+	 */
+	if (tctx) {
+		part = update_part(p, tctx);
+		lvl = task_level(tctx);
+		tctx->enq_ts = bpf_ktime_get_ns();
+		tctx->queued = 1;
+	} else {
+		part = task_part(p);
+	}
 
-	dsq = dsq_for_level(lvl);
-	slice = slice_for_level(lvl);
+	dsq = dsq_for_level(lvl, part);
+	slice = slice_for_level(lvl, part);
+
+	/*
+	 * No free slot: wait in arrival order until dispatch admits it. Only
+	 * dispatch can run it, so there is no idle CPU worth kicking.
+	 */
+	if (tctx && !admit(tctx)) {
+		if (!tctx->admit_ts && part < MLFQ_MAX_PARTS) {
+			tctx->admit_ts = tctx->enq_ts;
+			__sync_fetch_and_add(&nr_admit_waiting[part], 1);
+		}
+		stat_inc(part, MLFQ_STAT_ADMIT_QUEUED);
+		scx_bpf_dispatch(p, part_dsq(part, ADMIT_DSQ), slice, enq_flags);
+		return;
+	}
 
 	if (lvl == LVL_RR)
-		stat_inc(1);
+		stat_inc(part, MLFQ_STAT_RR);
 	else
-		stat_inc(2);
+		stat_inc(part, MLFQ_STAT_FIFO);
 
 	/* FIFO order within each DSQ. RR behavior comes from the time slice. */
 	scx_bpf_dispatch(p, dsq, slice, enq_flags);
+	kick_idle_cpu(p, part);
 }
 
 void BPF_STRUCT_OPS(mlfq_dispatch, s32 cpu, struct task_struct *prev)
 {
-	/* Always prefer top-level RR tasks. */
-	if (scx_bpf_consume(RR_DSQ))
+	struct cpu_ctx *cctx = get_cctx();
+	u32 part = cctx ? cctx->part : 0;
+	struct task_ctx *tctx;
+	u8 lvl = LVL_RR;
+	u64 now;
+
+	if (part >= MLFQ_MAX_PARTS)
+		return;
+
+	/* Only this CPU's partition. Always prefer top-level RR tasks. */
+	if (scx_bpf_consume(part_dsq(part, RR_DSQ)))
+		return;
+
+	/*
+	 * Admit the oldest waiter if a slot is free. The slot goes into the
+	 * task's storage as soon as the task is moved here, so it is given
+	 * back by stopping or disable whatever happens to the task before it
+	 * runs. Losing the task to another CPU gives the slot back at once.
+	 */
+	if (READ_ONCE(nr_admit_waiting[part])) {
+		struct task_struct *p;
+
+		bpf_for_each(scx_dsq, p, part_dsq(part, ADMIT_DSQ), 0) {
+			struct task_ctx *wctx = get_tctx(p);
+
+			if (!wctx || !admit_slot(part))
+				break;
+			if (scx_bpf_dispatch_from_dsq(BPF_FOR_EACH_ITER, p,
+						      SCX_DSQ_LOCAL, 0)) {
+				wctx->admitted = 1;
+				return;
+			}
+			__sync_fetch_and_sub(&nr_admitted[part], 1);
+		}
+	}
+
+	if (scx_bpf_consume(part_dsq(part, FIFO_DSQ)))
 		return;
-	scx_bpf_consume(FIFO_DSQ);
+
+	/*
+	 * Nothing queued at any level, so prev would be enqueued and consumed
+	 * right back. Refill its slice instead; the kernel keeps running a
+	 * still-queued prev with a non-zero slice. Demote it first as stopping
+	 * would have, so it gets the slice of the level it would requeue at.
+	 * Left with no slice, SCX_OPS_ENQ_LAST makes the kernel hand prev to
+	 * enqueue rather than refill it with SCX_SLICE_DFL.
+	 */
+	if (!prev || !(prev->scx.flags & SCX_TASK_QUEUED))
+		return;
+
+	tctx = get_tctx(prev);
+	if (tctx) {
+		maybe_demote(tctx);
+		/* just demoted and no slot: enqueue parks it on ADMIT_DSQ */
+		if (!admit(tctx))
+			return;
+		lvl = task_level(tctx);
+	}
+
+	now = bpf_ktime_get_ns();
+	if (cctx)
+		run_end(cctx, prev, true, now);
+	prev->scx.slice = slice_for_level(lvl, part);
+	if (cctx)
+		run_begin(cctx, prev->scx.slice, now);
+	stat_inc(part, MLFQ_STAT_KEEP);
 }
 
 void BPF_STRUCT_OPS(mlfq_running, struct task_struct *p)
 {
 	struct task_ctx *tctx = get_tctx(p);
+	struct cpu_ctx *cctx = get_cctx();
+	u64 now = bpf_ktime_get_ns();
+	u32 part;
+
+	if (cctx)
+		run_begin(cctx, p->scx.slice, now);
+
+	if (!tctx)
+		return;
+	part = tctx_part(tctx);
+
+	if (tctx->enq_ts) {
+		hist_inc(&wait_hist, part, now - tctx->enq_ts);
+		if (tctx->queued) {
+			stat_add(part, MLFQ_STAT_QUEUED_NS, now - tctx->enq_ts);
+			stat_inc(part, MLFQ_STAT_QUEUED_RUNS);
+		}
+		tctx->enq_ts = 0;
+		tctx->queued = 0;
+	}
+
+	/*
+	 * Came off ADMIT_DSQ with the slot dispatch took for it. The wait is
+	 * counted in the task's partition, the only one whose dispatch moves
+	 * tasks off its ADMIT_DSQ.
+	 */
+	if (tctx->admit_ts) {
+		stat_add(part, MLFQ_STAT_ADMIT_WAIT_NS, now - tctx->admit_ts);
+		stat_inc(part, MLFQ_STAT_ADMITTED);
+		__sync_fetch_and_sub(&nr_admit_waiting[part], 1);
+		tctx->admit_ts = 0;
+	}
 
 	/* Mark first execution in the top queue. */
-	if (tctx && tctx->level == LVL_RR && !tctx->ran_top)
+	if (tctx->level == LVL_RR && !tctx->ran_top)
 		tctx->ran_top = 1;
 }
 
 void BPF_STRUCT_OPS(mlfq_stopping, struct task_struct *p, bool runnable)
 {
 	struct task_ctx *tctx = get_tctx(p);
+	struct cpu_ctx *cctx = get_cctx();
 
+	if (cctx)
+		run_end(cctx, p, runnable, bpf_ktime_get_ns());
+	if (!tctx)
+		return;
+	maybe_demote(tctx);
 	/*
-	 * After the task has executed once in the RR queue, demote permanently to
-	 * the FIFO queue (even if it blocks). This matches the requested behavior.
+	 * Blocking (or exiting) gives the admission slot back. This CPU's
+	 * dispatch has already run, so have it look again for a waiter.
 	 */
-	if (tctx && tctx->level == LVL_RR && tctx->ran_top)
-		tctx->level = LVL_FIFO;
+	if (!runnable && tctx->admitted) {
+		release(tctx);
+		if (READ_ONCE(nr_admit_waiting[tctx_part(tctx)]))
+			scx_bpf_kick_cpu(bpf_get_smp_processor_id(), 0);
+	}
 }
 
 void BPF_STRUCT_OPS(mlfq_enable, struct task_struct *p)
@@ -164,6 +634,25 @@ void BPF_STRUCT_OPS(mlfq_enable, struct task_struct *p)
 	if (tctx) {
 		tctx->level = LVL_RR;
 		tctx->ran_top = 0;
+		tctx->enq_ts = 0;
+		tctx->queued = 0;
+		tctx->admitted = 0;
+		tctx->admit_ts = 0;
+		tctx->part = task_part(p);
+	}
+}
+
+void BPF_STRUCT_OPS(mlfq_disable, struct task_struct *p)
+{
+	struct task_ctx *tctx = get_tctx(p);
+
+	/* Leaving sched_ext (or exiting) while holding or waiting for a slot. */
+	if (!tctx)
+		return;
+	release(tctx);
+	if (tctx->admit_ts) {
+		tctx->admit_ts = 0;
+		__sync_fetch_and_sub(&nr_admit_waiting[tctx_part(tctx)], 1);
 	}
 }
 
@@ -179,13 +668,41 @@ s32 BPF_STRUCT_OPS(mlfq_init_task, struct task_struct *p,
 
 s32 BPF_STRUCT_OPS_SLEEPABLE(mlfq_init)
 {
+	u32 cpu, part;
 	s32 ret;
 
-	ret = scx_bpf_create_dsq(RR_DSQ, -1);
-	if (ret)
-		return ret;
+	bpf_for(cpu, 0, scx_bpf_nr_cpu_ids()) {
+		struct cpu_ctx *cctx;
+
+		cctx = bpf_map_lookup_elem(&cpu_ctx_stor, &cpu);
+		if (!cctx)
+			return -ENOENT;
+		cctx->part = part_of_cpu(cpu);
+		if (!timer_preempt)
+			continue;
+		ret = bpf_timer_init(&cctx->timer, &cpu_ctx_stor,
+				     CLOCK_MONOTONIC);
+		if (ret)
+			return ret;
+		ret = bpf_timer_set_callback(&cctx->timer, preempt_timerfn);
+		if (ret)
+			return ret;
+	}
+
+	bpf_for(part, 0, nr_parts) {
+		ret = scx_bpf_create_dsq(part_dsq(part, RR_DSQ), -1);
+		if (ret)
+			return ret;
 
-	return scx_bpf_create_dsq(FIFO_DSQ, -1);
+		ret = scx_bpf_create_dsq(part_dsq(part, FIFO_DSQ), -1);
+		if (ret)
+			return ret;
+
+		ret = scx_bpf_create_dsq(part_dsq(part, ADMIT_DSQ), -1);
+		if (ret)
+			return ret;
+	}
+	return 0;
 }
 
 void BPF_STRUCT_OPS(mlfq_exit, struct scx_exit_info *ei)
@@ -194,13 +711,14 @@ void BPF_STRUCT_OPS(mlfq_exit, struct scx_exit_info *ei)
 }
 
 SCX_OPS_DEFINE(mlfq_ops,
-	       .flags			= SCX_OPS_SWITCH_PARTIAL,
+	       .flags			= SCX_OPS_SWITCH_PARTIAL | SCX_OPS_ENQ_LAST,
 	       .select_cpu		= (void *)mlfq_select_cpu,
 	       .enqueue		= (void *)mlfq_enqueue,
 	       .dispatch		= (void *)mlfq_dispatch,
 	       .running		= (void *)mlfq_running,
 	       .stopping		= (void *)mlfq_stopping,
 	       .enable		= (void *)mlfq_enable,
+	       .disable		= (void *)mlfq_disable,
 	       .init_task		= (void *)mlfq_init_task,
 	       .init			= (void *)mlfq_init,
 	       .exit			= (void *)mlfq_exit,
@@ -1,6 +1,25 @@
 /* SPDX-License-Identifier: GPL-2.0 */
 /*
  * Userspace loader for scx_mlfq.
+ *
+ * With -T, it also runs a closed-loop controller: every interval the p99
+ * of the in-kernel wait histogram is compared against the target and the
+ * slices are rescaled through the tunables map.
+ *
+ * With -P, slices are ended by a per-CPU BPF timer rather than the tick,
+ * which makes quanta below the tick period (-S) meaningful. Each stats
+ * line then also reports how far expired runs overshot their slice.
+ *
+ * With -K, at most K demoted (batch) tasks are admitted to run at once;
+ * the rest wait in arrival order. K lives in the tunables map, so it can
+ * be changed while the scheduler runs.
+ *
+ * With -X, the CPUs are split into partition A and partition B (the -X
+ * CPUs), each with its own DSQs and tunables (-B overrides B's), so two
+ * configurations can be compared under the same background noise. Feed
+ * both with loadtest -O, which pins a copy of every job to each side.
+ * Every stats line is then printed per partition, followed by the two
+ * sides' wait percentiles over the same interval.
  */
 #include <stdio.h>
 #include <unistd.h>
@@ -9,10 +28,19 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
 
 #include <bpf/bpf.h>
 #include <scx/common.h>
 
+#include "scx_mlfq.h"
+#include "scx_mlfq_tunables.h"
+#include "scx_stats.h"
 #include "scx_mlfq.bpf.skel.h"
 
 const char help_fmt[] =
@@ -23,12 +51,29 @@ const char help_fmt[] =
 "  - After a task runs once in the top queue, it is demoted to bottom.\n"
 "  - Bottom: FIFO.\n"
 "\n"
-"Usage: %s [-a] [-s RR_SLICE_MS] [-v]\n"
+"Usage: %s [-a] [-s RR_SLICE_MS | -S RR_SLICE_US] [-P] [-K MAX_ACTIVE] [-T P99_US [-i MS] [-l US] [-u US] [-g GAIN] [-L]]\n"
+"          [-X B_CPUS [-B KEY=VAL,...]] [-v]\n"
 "\n"
 "  -a            Schedule all eligible tasks (full mode). Default is partial\n"
 "                mode (SCX_OPS_SWITCH_PARTIAL), which schedules only\n"
 "                SCHED_EXT tasks.\n"
 "  -s MS         Set top-queue RR time slice in milliseconds (default: 50).\n"
+"  -S US         Set top-queue RR time slice in microseconds (overrides -s)\n"
+"  -K N          Admit at most N bottom-level tasks at once; the rest wait\n"
+"                in FIFO order (default: 0, no limit)\n"
+"  -P            Preempt on slice expiry with a per-CPU timer instead of the\n"
+"                scheduler tick (needed for slices shorter than a tick)\n"
+"  -T US         Controller: tune the slices toward this p99 wait (microseconds)\n"
+"  -i MS         Controller interval in milliseconds (default: 1000)\n"
+"  -l US         Lower bound of the RR slice in microseconds (default: 500)\n"
+"  -u US         Upper bound of the RR slice in microseconds (default: 200000)\n"
+"  -g GAIN       Damping, 0 < GAIN <= 1: fraction of the correction applied\n"
+"                per interval (default: 0.5)\n"
+"  -L            Let the controller switch between 1 and 2 levels\n"
+"  -X CPUS       A/B mode: CPUs of partition B (e.g. 4-7); the rest are A.\n"
+"                The options above configure A; not with -T\n"
+"  -B KEY=VAL,.. Partition B tunables, default same as A. Keys: rr_us,\n"
+"                rr_ns, fifo_us, fifo_ns, levels (1 or 2), max_active\n"
 "  -v            Print libbpf debug messages\n"
 "  -h            Display this help and exit\n";
 
@@ -48,26 +93,44 @@ static void sigint_handler(int dummy)
 	exit_req = 1;
 }
 
-static void read_stats(struct scx_mlfq *skel, __u64 out[3])
+static __u64 now_ns(void)
 {
-	int nr_cpus = libbpf_num_possible_cpus();
-	__u64 cnts[3][nr_cpus];
-	__u32 idx;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
 
-	out[0] = out[1] = out[2] = 0;
+/* Sum entries first..first+nr-1 of a per-cpu u64 array map into out[]. */
+static void read_percpu(int fd, __u32 first, __u64 *out, __u32 nr)
+{
+	int nr_cpus = libbpf_num_possible_cpus();
+	__u64 cnts[nr_cpus];
+	__u32 i;
 
-	for (idx = 0; idx < 3; idx++) {
-		int ret, cpu;
+	for (i = 0; i < nr; i++) {
+		__u32 idx = first + i;
+		int cpu;
 
-		ret = bpf_map_lookup_elem(bpf_map__fd(skel->maps.stats),
-					  &idx, cnts[idx]);
-		if (ret < 0)
+		out[i] = 0;
+		if (bpf_map_lookup_elem(fd, &idx, cnts) < 0)
 			continue;
 		for (cpu = 0; cpu < nr_cpus; cpu++)
-			out[idx] += cnts[idx][cpu];
+			out[i] += cnts[cpu];
 	}
 }
 
+static void read_stats(struct scx_mlfq *skel, __u32 part, __u64 out[NR_MLFQ_STATS])
+{
+	read_percpu(bpf_map__fd(skel->maps.stats), part * NR_MLFQ_STATS,
+		    out, NR_MLFQ_STATS);
+}
+
+static void read_hist(struct bpf_map *map, __u32 part, __u64 out[MLFQ_HIST_BUCKETS])
+{
+	read_percpu(bpf_map__fd(map), part * MLFQ_HIST_BUCKETS, out, MLFQ_HIST_BUCKETS);
+}
+
 static int parse_u64(const char *s, __u64 *out)
 {
 	char *end = NULL;
@@ -81,14 +144,272 @@ static int parse_u64(const char *s, __u64 *out)
 	return 0;
 }
 
+static int ensure_dir(const char *path)
+{
+	if (!mkdir(path, 0755) || errno == EEXIST)
+		return 0;
+	return -errno;
+}
+
+/* Pin the tunables so scx_tune and friends can retune a running instance. */
+static int pin_tunables_map(struct scx_mlfq *skel)
+{
+	int ret;
+
+	ret = ensure_dir(MLFQ_PIN_DIR);
+	if (ret)
+		return ret;
+
+	/* a pin left by an earlier instance would hide this map */
+	unlink(MLFQ_TUNABLES_PIN);
+	return bpf_map__pin(skel->maps.tunables, MLFQ_TUNABLES_PIN);
+}
+
+static int write_tunables(struct scx_mlfq *skel, __u32 part,
+			  const struct mlfq_tunables *tn)
+{
+	return bpf_map_update_elem(bpf_map__fd(skel->maps.tunables), &part, tn, BPF_ANY);
+}
+
+/* Mark the CPUs of a list like "4-7,12" in cpus[]; -EINVAL if malformed. */
+static int parse_cpulist(const char *s, bool *cpus, int nr_cpus)
+{
+	int n = 0;
+
+	while (*s) {
+		char *end;
+		long lo, hi, c;
+
+		lo = hi = strtol(s, &end, 10);
+		if (end == s || lo < 0)
+			return -EINVAL;
+		if (*end == '-') {
+			s = end + 1;
+			hi = strtol(s, &end, 10);
+			if (end == s || hi < lo)
+				return -EINVAL;
+		}
+		if (hi >= nr_cpus)
+			return -EINVAL;
+		for (c = lo; c <= hi; c++, n++)
+			cpus[c] = true;
+		s = end;
+		if (*s == ',')
+			s++;
+		else if (*s)
+			return -EINVAL;
+	}
+	return n ? 0 : -EINVAL;
+}
+
+struct controller {
+	bool			enabled;
+	bool			levels;		/* may change nr_levels */
+	__u64			target_ns;
+	__u64			interval_ns;
+	__u64			min_slice_ns;
+	__u64			max_slice_ns;
+	double			gain;
+	double			fifo_ratio;	/* fifo_slice / rr_slice, kept constant */
+	struct mlfq_tunables	tn;
+	__u64			prev_hist[MLFQ_HIST_BUCKETS];
+};
+
+/* Fewer waits than this in an interval say nothing about the p99. */
+#define CTL_MIN_SAMPLES		50
+/* Ignore errors within +-10% of the target. */
+#define CTL_DEADBAND		0.10
+/* Never change the slice by more than 2x in one interval. */
+#define CTL_MAX_STEP		2.0
+
+/*
+ * Value below which a fraction q of the samples fall. Bucket i holds
+ * [2^i, 2^(i+1)); interpolate linearly inside the bucket.
+ */
+static double hist_quantile(const __u64 *hist, __u64 total, double q)
+{
+	double want = q * total, seen = 0, lo = 1.0;
+	int i;
+
+	for (i = 0; i < MLFQ_HIST_BUCKETS; i++, lo *= 2.0) {
+		if (!hist[i])
+			continue;
+		if (seen + hist[i] >= want)
+			return lo * (1.0 + (want - seen) / hist[i]);
+		seen += hist[i];
+	}
+	return lo;
+}
+
+static double clamp(double v, double lo, double hi)
+{
+	return v < lo ? lo : v > hi ? hi : v;
+}
+
+/* Overshoot of expired runs since the previous call, as p50/p99. */
+static void print_quantum(struct scx_mlfq *skel, __u32 part, const char *pfx,
+			  __u64 *prev)
+{
+	__u64 hist[MLFQ_HIST_BUCKETS], total = 0;
+	int i;
+
+	read_hist(skel->maps.quantum_hist, part, hist);
+	for (i = 0; i < MLFQ_HIST_BUCKETS; i++) {
+		__u64 cur = hist[i];
+
+		hist[i] -= prev[i];
+		prev[i] = cur;
+		total += hist[i];
+	}
+	if (!total)
+		return;
+	printf("%soverrun: runs=%llu p50=%.1fus p99=%.1fus\n",
+	       pfx, (unsigned long long)total,
+	       hist_quantile(hist, total, 0.50) / 1e3,
+	       hist_quantile(hist, total, 0.99) / 1e3);
+}
+
+/*
+ * One control step. The slice moves toward slice * target / p99, but only
+ * by the gain fraction of the way so one noisy interval cannot swing it,
+ * and by at most CTL_MAX_STEP per step, within [min, max].
+ */
+static void controller_step(struct scx_mlfq *skel, struct controller *c)
+{
+	__u64 hist[MLFQ_HIST_BUCKETS], delta[MLFQ_HIST_BUCKETS], total = 0;
+	struct mlfq_tunables old = c->tn;
+	double p99, err, ratio, slice;
+	int i;
+
+	read_hist(skel->maps.wait_hist, 0, hist);
+	for (i = 0; i < MLFQ_HIST_BUCKETS; i++) {
+		delta[i] = hist[i] - c->prev_hist[i];
+		c->prev_hist[i] = hist[i];
+		total += delta[i];
+	}
+	if (total < CTL_MIN_SAMPLES)
+		return;
+
+	p99 = hist_quantile(delta, total, 0.99);
+	err = (double)c->target_ns / p99;
+	if (err > 1.0 - CTL_DEADBAND && err < 1.0 + CTL_DEADBAND)
+		return;
+
+	ratio = clamp(1.0 + c->gain * (err - 1.0), 1.0 / CTL_MAX_STEP, CTL_MAX_STEP);
+	slice = clamp(c->tn.rr_slice_ns * ratio, c->min_slice_ns, c->max_slice_ns);
+	c->tn.rr_slice_ns = (__u64)slice;
+	c->tn.fifo_slice_ns = (__u64)(slice * c->fifo_ratio);
+
+	/*
+	 * Slices pinned at a bound and still off target: change the structure.
+	 * Two levels put new arrivals ahead of demoted work (lower wait); a
+	 * single RR level shares the CPU evenly once there is headroom.
+	 */
+	if (c->levels) {
+		if (err < 1.0 && c->tn.rr_slice_ns <= c->min_slice_ns && c->tn.nr_levels == 1)
+			c->tn.nr_levels = 2;
+		else if (err > 2.0 && c->tn.rr_slice_ns >= c->max_slice_ns && c->tn.nr_levels == 2)
+			c->tn.nr_levels = 1;
+	}
+
+	if (!memcmp(&old, &c->tn, sizeof(old)))
+		return;
+	if (write_tunables(skel, 0, &c->tn)) {
+		fprintf(stderr, "ctl: failed to update tunables\n");
+		c->tn = old;
+		return;
+	}
+	printf("ctl: samples=%llu p99=%.1fus target=%.1fus rr_slice=%.1f->%.1fus fifo_slice=%.1f->%.1fus levels=%u->%u\n",
+	       (unsigned long long)total, p99 / 1e3, c->target_ns / 1e3,
+	       old.rr_slice_ns / 1e3, c->tn.rr_slice_ns / 1e3,
+	       old.fifo_slice_ns / 1e3, c->tn.fifo_slice_ns / 1e3,
+	       old.nr_levels, c->tn.nr_levels);
+}
+
+static void print_stats(struct scx_mlfq *skel, __u32 part, const char *pfx,
+			__u64 *prev_quantum)
+{
+	__u64 st[NR_MLFQ_STATS];
+
+	read_stats(skel, part, st);
+	printf("%slocal=%llu rr=%llu fifo=%llu expired=%llu timer_kicks=%llu/%llu\n",
+	       pfx,
+	       (unsigned long long)st[MLFQ_STAT_LOCAL],
+	       (unsigned long long)st[MLFQ_STAT_RR],
+	       (unsigned long long)st[MLFQ_STAT_FIFO],
+	       (unsigned long long)st[MLFQ_STAT_EXPIRED],
+	       (unsigned long long)st[MLFQ_STAT_TIMER_KICK],
+	       (unsigned long long)st[MLFQ_STAT_TIMER_ARMED]);
+	printf("%sidle_kicks=%llu no_idle=%llu queued_mean=%.1fus keep=%llu\n",
+	       pfx,
+	       (unsigned long long)st[MLFQ_STAT_IDLE_KICK],
+	       (unsigned long long)st[MLFQ_STAT_NO_IDLE],
+	       st[MLFQ_STAT_QUEUED_RUNS] ?
+	       st[MLFQ_STAT_QUEUED_NS] / 1e3 / st[MLFQ_STAT_QUEUED_RUNS] : 0.0,
+	       (unsigned long long)st[MLFQ_STAT_KEEP]);
+	printf("%sadmit: active=%u waiting=%u admitted=%llu wait_mean=%.1fus\n",
+	       pfx, skel->bss->nr_admitted[part], skel->bss->nr_admit_waiting[part],
+	       (unsigned long long)st[MLFQ_STAT_ADMITTED],
+	       st[MLFQ_STAT_ADMITTED] ?
+	       st[MLFQ_STAT_ADMIT_WAIT_NS] / 1e3 / st[MLFQ_STAT_ADMITTED] : 0.0);
+	print_quantum(skel, part, pfx, prev_quantum);
+}
+
+/*
+ * A/B mode: both partitions' waits over the same interval, side by side.
+ * The difference is the policy's, not the machine's background load.
+ */
+static void print_ab_waits(struct scx_mlfq *skel,
+			   __u64 prev[MLFQ_MAX_PARTS][MLFQ_HIST_BUCKETS])
+{
+	double q[MLFQ_MAX_PARTS][3];
+	__u64 total[MLFQ_MAX_PARTS];
+	__u32 part;
+	int i;
+
+	for (part = 0; part < MLFQ_MAX_PARTS; part++) {
+		__u64 hist[MLFQ_HIST_BUCKETS];
+
+		read_hist(skel->maps.wait_hist, part, hist);
+		total[part] = 0;
+		for (i = 0; i < MLFQ_HIST_BUCKETS; i++) {
+			__u64 cur = hist[i];
+
+			hist[i] -= prev[part][i];
+			prev[part][i] = cur;
+			total[part] += hist[i];
+		}
+		q[part][0] = total[part] ? hist_quantile(hist, total[part], 0.50) / 1e3 : 0.0;
+		q[part][1] = total[part] ? hist_quantile(hist, total[part], 0.90) / 1e3 : 0.0;
+		q[part][2] = total[part] ? hist_quantile(hist, total[part], 0.99) / 1e3 : 0.0;
+	}
+	printf("ab: waits A=%llu B=%llu p50=%.1f/%.1fus p90=%.1f/%.1fus p99=%.1f/%.1fus\n",
+	       (unsigned long long)total[0], (unsigned long long)total[1],
+	       q[0][0], q[1][0], q[0][1], q[1][1], q[0][2], q[1][2]);
+}
+
 int main(int argc, char **argv)
 {
+	struct controller ctl = {
+		.interval_ns = 1000ULL * 1000ULL * 1000ULL,
+		.min_slice_ns = 500ULL * 1000ULL,
+		.max_slice_ns = 200ULL * 1000ULL * 1000ULL,
+		.gain = 0.5,
+	};
 	struct scx_mlfq *skel;
 	struct bpf_link *link;
 	__u32 opt;
 	__u64 ecode;
-	bool all_tasks = false;
-	__u64 rr_ms = 50;
+	bool all_tasks = false, timer_preempt = false;
+	__u64 rr_slice_ns = 50ULL * 1000ULL * 1000ULL, max_active = 0, v;
+	__u64 next_stats, next_ctl;
+	__u64 prev_quantum[MLFQ_MAX_PARTS][MLFQ_HIST_BUCKETS];
+	__u64 prev_wait[MLFQ_MAX_PARTS][MLFQ_HIST_BUCKETS];
+	const char *ab_cpus = NULL, *ab_tunables = NULL;
+	struct mlfq_tunables tn_b;
+	bool *part_b = NULL;
+	__u32 nr_parts = 1;
+	int nr_cpus, cpu;
 
 	libbpf_set_print(libbpf_print_fn);
 	signal(SIGINT, sigint_handler);
@@ -97,17 +418,63 @@ int main(int argc, char **argv)
 restart:
 	skel = SCX_OPS_OPEN(mlfq_ops, scx_mlfq);
 
-	while ((opt = getopt(argc, argv, "as:vh")) != -1) {
+	while ((opt = getopt(argc, argv, "as:S:PK:T:i:l:u:g:LX:B:vh")) != -1) {
 		switch (opt) {
 		case 'a':
 			all_tasks = true;
 			break;
 		case 's':
-			if (parse_u64(optarg, &rr_ms)) {
-				fprintf(stderr, "Invalid -s value: %s\n", optarg);
+		case 'S':
+			if (parse_u64(optarg, &v) || !v) {
+				fprintf(stderr, "Invalid -%c value: %s\n", opt, optarg);
+				return 1;
+			}
+			rr_slice_ns = v * (opt == 's' ? 1000ULL * 1000ULL : 1000ULL);
+			break;
+		case 'P':
+			timer_preempt = true;
+			break;
+		case 'K':
+			if (parse_u64(optarg, &max_active) || (__u32)max_active != max_active) {
+				fprintf(stderr, "Invalid -K value: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'T':
+		case 'i':
+		case 'l':
+		case 'u':
+			if (parse_u64(optarg, &v) || !v) {
+				fprintf(stderr, "Invalid -%c value: %s\n", opt, optarg);
+				return 1;
+			}
+			if (opt == 'T') {
+				ctl.enabled = true;
+				ctl.target_ns = v * 1000ULL;
+			} else if (opt == 'i') {
+				ctl.interval_ns = v * 1000ULL * 1000ULL;
+			} else if (opt == 'l') {
+				ctl.min_slice_ns = v * 1000ULL;
+			} else {
+				ctl.max_slice_ns = v * 1000ULL;
+			}
+			break;
+		case 'g':
+			ctl.gain = strtod(optarg, NULL);
+			if (ctl.gain <= 0.0 || ctl.gain > 1.0) {
+				fprintf(stderr, "Invalid -g value: %s\n", optarg);
 				return 1;
 			}
 			break;
+		case 'L':
+			ctl.levels = true;
+			break;
+		case 'X':
+			ab_cpus = optarg;
+			break;
+		case 'B':
+			ab_tunables = optarg;
+			break;
 		case 'v':
 			verbose = true;
 			break;
@@ -116,9 +483,50 @@ restart:
 			return opt != 'h';
 		}
 	}
+	if (ctl.min_slice_ns > ctl.max_slice_ns) {
+		fprintf(stderr, "-l must not exceed -u\n");
+		return 1;
+	}
+	if (ab_tunables && !ab_cpus) {
+		fprintf(stderr, "-B requires -X\n");
+		return 1;
+	}
+	/* the controller would retune A only, skewing the comparison */
+	if (ab_cpus && ctl.enabled) {
+		fprintf(stderr, "-X cannot be combined with -T\n");
+		return 1;
+	}
 
 	/* Set the RR slice (ns) for the top queue. */
-	skel->rodata->rr_slice_ns = rr_ms * 1000ULL * 1000ULL;
+	skel->rodata->rr_slice_ns = rr_slice_ns;
+
+	/* One timer slot per possible cpu. */
+	nr_cpus = libbpf_num_possible_cpus();
+	if (nr_cpus <= 0) {
+		fprintf(stderr, "Failed to get the number of cpus\n");
+		return 1;
+	}
+	skel->rodata->timer_preempt = timer_preempt;
+	bpf_map__set_max_entries(skel->maps.cpu_ctx_stor, nr_cpus);
+
+	if (ab_cpus) {
+		int nr_b = 0;
+
+		part_b = calloc(nr_cpus, sizeof(*part_b));
+		if (!part_b || parse_cpulist(ab_cpus, part_b, nr_cpus)) {
+			fprintf(stderr, "Invalid -X value: %s\n", ab_cpus);
+			return 1;
+		}
+		for (cpu = 0; cpu < nr_cpus; cpu++)
+			nr_b += part_b[cpu];
+		if (nr_b == nr_cpus) {
+			fprintf(stderr, "-X leaves no CPUs for partition A\n");
+			return 1;
+		}
+		nr_parts = 2;
+		skel->rodata->nr_parts = nr_parts;
+		bpf_map__set_max_entries(skel->maps.cpu_part, nr_cpus);
+	}
 
 	/* Enforce/adjust partial-switch mode per CLI. */
 	if (all_tasks)
@@ -127,27 +535,104 @@ restart:
 		skel->struct_ops.mlfq_ops->flags |= SCX_OPS_SWITCH_PARTIAL;
 
 	SCX_OPS_LOAD(skel, mlfq_ops, scx_mlfq, uei);
+
+	/* Start from the load-time values; the controller works from here. */
+	ctl.tn.rr_slice_ns = skel->rodata->rr_slice_ns;
+	ctl.tn.fifo_slice_ns = skel->rodata->fifo_slice_ns;
+	ctl.tn.nr_levels = 2;
+	ctl.tn.max_active = max_active;
+	ctl.fifo_ratio = (double)ctl.tn.fifo_slice_ns / ctl.tn.rr_slice_ns;
+	memset(ctl.prev_hist, 0, sizeof(ctl.prev_hist));
+	memset(prev_quantum, 0, sizeof(prev_quantum));
+	memset(prev_wait, 0, sizeof(prev_wait));
+	if (write_tunables(skel, 0, &ctl.tn))
+		fprintf(stderr, "Warning: failed to initialize tunables\n");
+
+	/* The partition map is read by ops.init, so it must be set before attach. */
+	if (part_b) {
+		tn_b = ctl.tn;
+		if (ab_tunables && parse_part_tunables(ab_tunables, &tn_b)) {
+			fprintf(stderr, "Invalid -B value: %s\n", ab_tunables);
+			return 1;
+		}
+		for (cpu = 0; cpu < nr_cpus; cpu++) {
+			__u32 key = cpu, part = part_b[cpu];
+
+			if (bpf_map_update_elem(bpf_map__fd(skel->maps.cpu_part),
+						&key, &part, BPF_ANY)) {
+				fprintf(stderr, "Failed to set the partition of cpu %d\n", cpu);
+				return 1;
+			}
+		}
+		if (write_tunables(skel, 1, &tn_b)) {
+			fprintf(stderr, "Failed to set partition B tunables\n");
+			return 1;
+		}
+	}
+	if (pin_tunables_map(skel))
+		fprintf(stderr, "Warning: failed to pin tunables map\n");
+
 	link = SCX_OPS_ATTACH(skel, mlfq_ops, scx_mlfq);
+	scx_stats_pin(skel->maps.stats);
 
-	printf("scx_mlfq: rr_slice_ms=%llu mode=%s\n",
-	       (unsigned long long)rr_ms,
-	       all_tasks ? "full" : "partial");
+	printf("scx_mlfq: rr_slice_us=%llu mode=%s preempt=%s max_active=%llu\n",
+	       (unsigned long long)(rr_slice_ns / 1000ULL),
+	       all_tasks ? "full" : "partial",
+	       timer_preempt ? "timer" : "tick",
+	       (unsigned long long)max_active);
+	if (part_b)
+		printf("scx_mlfq: A/B partitions, B=%s rr_slice_us=%llu/%llu fifo_slice_us=%llu/%llu levels=%u/%u max_active=%u/%u\n",
+		       ab_cpus,
+		       (unsigned long long)(ctl.tn.rr_slice_ns / 1000ULL),
+		       (unsigned long long)(tn_b.rr_slice_ns / 1000ULL),
+		       (unsigned long long)(ctl.tn.fifo_slice_ns / 1000ULL),
+		       (unsigned long long)(tn_b.fifo_slice_ns / 1000ULL),
+		       ctl.tn.nr_levels, tn_b.nr_levels,
+		       ctl.tn.max_active, tn_b.max_active);
+	if (ctl.enabled)
+		printf("scx_mlfq: controller target_p99=%.1fus interval=%llums slice=[%.1f, %.1f]us gain=%.2f levels=%s\n",
+		       ctl.target_ns / 1e3,
+		       (unsigned long long)(ctl.interval_ns / 1000000ULL),
+		       ctl.min_slice_ns / 1e3, ctl.max_slice_ns / 1e3, ctl.gain,
+		       ctl.levels ? "auto" : "fixed");
 
+	next_stats = next_ctl = now_ns();
 	while (!exit_req && !UEI_EXITED(skel, uei)) {
-		__u64 st[3];
+		__u64 now = now_ns(), wake;
+
+		if (now >= next_stats) {
+			__u32 part;
+
+			for (part = 0; part < nr_parts; part++)
+				print_stats(skel, part, nr_parts < 2 ? "" : part ? "[B] " : "[A] ",
+					    prev_quantum[part]);
+			if (nr_parts > 1)
+				print_ab_waits(skel, prev_wait);
+			fflush(stdout);
+			next_stats = now + 1000ULL * 1000ULL * 1000ULL;
+		}
+		if (ctl.enabled && now >= next_ctl) {
+			controller_step(skel, &ctl);
+			fflush(stdout);
+			next_ctl = now + ctl.interval_ns;
+		}
 
-		read_stats(skel, st);
-		printf("local=%llu rr=%llu fifo=%llu\n",
-		       (unsigned long long)st[0],
-		       (unsigned long long)st[1],
-		       (unsigned long long)st[2]);
-		fflush(stdout);
-		sleep(1);
+		wake = next_stats;
+		if (ctl.enabled && next_ctl < wake)
+			wake = next_ctl;
+		now = now_ns();
+		if (wake > now)
+			usleep((wake - now) / 1000);
 	}
 
+	scx_stats_unpin();
 	bpf_link__destroy(link);
+	unlink(MLFQ_TUNABLES_PIN);
 	ecode = UEI_REPORT(skel, uei);
 	scx_mlfq__destroy(skel);
+	free(part_b);
+	part_b = NULL;
+	nr_parts = 1;
 
 	if (UEI_ECODE_RESTART(ecode))
 		goto restart;
@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Definitions shared by scx_mlfq.bpf.c and its userspace tools.
+ */
+#ifndef __SCX_MLFQ_H
+#define __SCX_MLFQ_H
+
+#ifndef __bpf__
+#include <linux/types.h>
+#endif
+
+/* Pinned by the loader so tools can retune a running scheduler. */
+#define MLFQ_PIN_DIR		"/sys/fs/bpf/scx_mlfq"
+#define MLFQ_TUNABLES_PIN	MLFQ_PIN_DIR "/tunables"
+
+/*
+ * A/B mode: the CPUs are split into this many partitions, each with its
+ * own DSQs, tunables, admission slots, stats and histograms. Partition 0
+ * is the only one outside A/B mode.
+ */
+#define MLFQ_MAX_PARTS		2
+
+/*
+ * Runtime tunables, one entry of the "tunables" ARRAY map per partition
+ * (key 0 outside A/B mode). A zero field means "use the load-time
+ * default" (rodata), so an untouched map keeps the scheduler's original
+ * behavior.
+ */
+struct mlfq_tunables {
+	__u64	rr_slice_ns;	/* top queue slice */
+	__u64	fifo_slice_ns;	/* bottom queue slice */
+	__u32	nr_levels;	/* 1: no demotion (plain RR), 2: RR + FIFO */
+	__u32	max_active;	/* admitted bottom-level tasks, 0: no limit */
+};
+
+/*
+ * Indices of the per-cpu "stats" array; partition N's counters are at
+ * N * NR_MLFQ_STATS + stat.
+ */
+enum mlfq_stat {
+	MLFQ_STAT_LOCAL,	/* dispatched straight to a local DSQ */
+	MLFQ_STAT_RR,		/* enqueued to RR_DSQ */
+	MLFQ_STAT_FIFO,		/* enqueued to FIFO_DSQ */
+	MLFQ_STAT_EXPIRED,	/* runs that used up their slice */
+	MLFQ_STAT_TIMER_ARMED,	/* preemption timers started */
+	MLFQ_STAT_TIMER_KICK,	/* ... that fired and kicked their CPU */
+	MLFQ_STAT_IDLE_KICK,	/* idle CPUs kicked for a queued task */
+	MLFQ_STAT_NO_IDLE,	/* queued with no idle CPU to kick */
+	MLFQ_STAT_QUEUED_NS,	/* total ns spent on RR_DSQ/FIFO_DSQ */
+	MLFQ_STAT_QUEUED_RUNS,	/* number of such waits */
+	MLFQ_STAT_KEEP,		/* prev's slice refilled in dispatch, no switch */
+	MLFQ_STAT_ADMIT_QUEUED,	/* bottom-level enqueues parked on ADMIT_DSQ */
+	MLFQ_STAT_ADMIT_WAIT_NS, /* total ns spent on ADMIT_DSQ until admitted */
+	MLFQ_STAT_ADMITTED,	/* tasks admitted from ADMIT_DSQ */
+	NR_MLFQ_STATS,
+};
+
+/*
+ * Per-cpu log2 histograms, bucket i counts values in [2^i, 2^(i+1)) ns:
+ *   wait_hist     enqueue to running
+ *   quantum_hist  run time past the slice, for runs that used it all up
+ * Partition N's buckets are at N * MLFQ_HIST_BUCKETS + i.
+ */
+#define MLFQ_HIST_BUCKETS	64
+
+#endif /* __SCX_MLFQ_H */
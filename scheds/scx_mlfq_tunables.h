@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Text form of struct mlfq_tunables, shared by scx_mlfq -B and scx_tune.
+ *
+ *   rr_us=2000,levels=1
+ *
+ * Keys: rr_us, rr_ns, fifo_us, fifo_ns, levels (1 or 2), max_active.
+ * Fields not named keep their value. 0 restores the load-time default,
+ * as a zero field does in the tunables map.
+ */
+#ifndef __SCX_MLFQ_TUNABLES_H
+#define __SCX_MLFQ_TUNABLES_H
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scx_mlfq.h"
+
+/* Apply comma-separated KEY=VAL overrides to tn. Returns 0 or -errno. */
+static inline int parse_part_tunables(const char *arg, struct mlfq_tunables *tn)
+{
+	char *buf = strdup(arg), *tok, *save = NULL;
+	int ret = 0;
+
+	if (!buf)
+		return -ENOMEM;
+	for (tok = strtok_r(buf, ",", &save); tok && !ret;
+	     tok = strtok_r(NULL, ",", &save)) {
+		char *val = strchr(tok, '='), *end = NULL;
+		unsigned long long v;
+
+		if (!val) {
+			ret = -EINVAL;
+			break;
+		}
+		*val++ = '\0';
+		errno = 0;
+		v = strtoull(val, &end, 10);
+		if (errno || end == val || *end != '\0') {
+			ret = -EINVAL;
+			break;
+		}
+		if (!strcmp(tok, "rr_us"))
+			tn->rr_slice_ns = v * 1000ULL;
+		else if (!strcmp(tok, "rr_ns"))
+			tn->rr_slice_ns = v;
+		else if (!strcmp(tok, "fifo_us"))
+			tn->fifo_slice_ns = v * 1000ULL;
+		else if (!strcmp(tok, "fifo_ns"))
+			tn->fifo_slice_ns = v;
+		else if (!strcmp(tok, "levels") && v <= 2)
+			tn->nr_levels = v;
+		else if (!strcmp(tok, "max_active") && (__u32)v == v)
+			tn->max_active = v;
+		else
+			ret = -EINVAL;
+	}
+	free(buf);
+	return ret;
+}
+
+#endif /* __SCX_MLFQ_TUNABLES_H */
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Pin of the active scheduler's per-cpu "stats" array.
+ *
+ * Every loader (scx_fifo, scx_fifo_capture, scx_mlfq, scx_loader) pins
+ * its stats map at the same path while attached. Only one sched_ext
+ * scheduler can be attached at a time, so workload tools (e.g.
+ * loadtest_storm -S) can read callback counts without knowing which
+ * policy runs. Index meanings are per policy: see the stats comments in
+ * scx_fifo.bpf.c / scx_fifo_capture.bpf.c and enum mlfq_stat.
+ */
+#ifndef __SCX_STATS_H
+#define __SCX_STATS_H
+
+#include <stdio.h>
+#include <unistd.h>
+#include <bpf/libbpf.h>
+
+#define SCX_STATS_PIN		"/sys/fs/bpf/scx_stats"
+
+static inline void scx_stats_pin(struct bpf_map *map)
+{
+	/* a pin left by an earlier instance would hide this map */
+	unlink(SCX_STATS_PIN);
+	if (bpf_map__pin(map, SCX_STATS_PIN))
+		fprintf(stderr, "Warning: failed to pin stats map at %s\n", SCX_STATS_PIN);
+}
+
+static inline void scx_stats_unpin(void)
+{
+	unlink(SCX_STATS_PIN);
+}
+
+#endif /* __SCX_STATS_H */
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Read or change the tunables of a running scx_mlfq (or scx_loader with
+ * the mlfq policy) through the map pinned at MLFQ_TUNABLES_PIN.
+ *
+ *   sudo scx_tune                      print partition 0's tunables
+ *   sudo scx_tune rr_us=2000 fifo_us=20000
+ *   sudo scx_tune -p 1 levels=1        partition B in A/B mode (-X)
+ *
+ * Fields not named keep their value. A value of 0 means "the scheduler's
+ * load-time default", as in the map itself. The entry is replaced with
+ * one update, so the scheduler never sees a half-written set. Note that
+ * scx_mlfq -T also writes partition 0 every interval.
+ */
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <bpf/bpf.h>
+
+#include "scx_mlfq.h"
+#include "scx_mlfq_tunables.h"
+
+const char help_fmt[] =
+"Read or change the tunables of a running scx_mlfq.\n"
+"\n"
+"Usage: %s [-p PART] [KEY=VAL[,KEY=VAL...] ...]\n"
+"\n"
+"  -p PART       Partition (0 = A, 1 = B in A/B mode; default: 0)\n"
+"  -h            Display this help and exit\n"
+"\n"
+"Keys: rr_us, rr_ns, fifo_us, fifo_ns, levels (1 or 2), max_active.\n"
+"0 restores the load-time default. Without KEY=VAL, print the tunables.\n";
+
+static int parse_u64(const char *s, __u64 *out)
+{
+	char *end = NULL;
+	unsigned long long v;
+
+	errno = 0;
+	v = strtoull(s, &end, 10);
+	if (errno || !end || end == s || *end != '\0')
+		return -EINVAL;
+	*out = (__u64)v;
+	return 0;
+}
+
+static void print_tunables(__u32 part, const struct mlfq_tunables *tn)
+{
+	printf("partition %u:\n", part);
+	if (tn->rr_slice_ns)
+		printf("  rr_ns      %llu\n", (unsigned long long)tn->rr_slice_ns);
+	else
+		printf("  rr_ns      default\n");
+	if (tn->fifo_slice_ns)
+		printf("  fifo_ns    %llu\n", (unsigned long long)tn->fifo_slice_ns);
+	else
+		printf("  fifo_ns    default\n");
+	if (tn->nr_levels)
+		printf("  levels     %u\n", tn->nr_levels);
+	else
+		printf("  levels     default\n");
+	printf("  max_active %u%s\n", tn->max_active, tn->max_active ? "" : " (no limit)");
+}
+
+int main(int argc, char **argv)
+{
+	struct mlfq_tunables tn;
+	__u32 part = 0;
+	__u64 v;
+	int fd, opt, i;
+
+	while ((opt = getopt(argc, argv, "p:h")) != -1) {
+		switch (opt) {
+		case 'p':
+			if (parse_u64(optarg, &v) || v >= MLFQ_MAX_PARTS) {
+				fprintf(stderr, "Invalid -p value: %s\n", optarg);
+				return 1;
+			}
+			part = v;
+			break;
+		default:
+			fprintf(stderr, help_fmt, argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	fd = bpf_obj_get(MLFQ_TUNABLES_PIN);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open %s: %s\nIs scx_mlfq running?\n",
+			MLFQ_TUNABLES_PIN, strerror(errno));
+		return 1;
+	}
+	if (bpf_map_lookup_elem(fd, &part, &tn)) {
+		fprintf(stderr, "Failed to read partition %u: %s\n", part, strerror(errno));
+		close(fd);
+		return 1;
+	}
+
+	if (optind == argc) {
+		print_tunables(part, &tn);
+		close(fd);
+		return 0;
+	}
+
+	for (i = optind; i < argc; i++) {
+		if (parse_part_tunables(argv[i], &tn)) {
+			fprintf(stderr, "Invalid setting: %s\n", argv[i]);
+			close(fd);
+			return 1;
+		}
+	}
+	if (bpf_map_update_elem(fd, &part, &tn, BPF_ANY)) {
+		fprintf(stderr, "Failed to update partition %u: %s\n", part, strerror(errno));
+		close(fd);
+		return 1;
+	}
+	close(fd);
+	return 0;
+}
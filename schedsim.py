@@ -0,0 +1,223 @@
+"""
+ctypes front-end for bin/libschedsim.so (see sim/pyapi.c and sim/sim.h).
+
+Runs the offline scheduler models (fifo, rr, mlfq, cfs, eevdf) on job
+lists held in numpy arrays. Inputs are passed to C as pointers into the
+numpy buffers (int64, C-contiguous arrays are not copied) and results are
+written by C into numpy columns named like the loadtest CSV, so
+run_frame() output can go straight into plot.py's helpers.
+
+ctypes releases the GIL for the duration of each call; sweep() runs the
+whole parameter grid on native threads.
+
+    import schedsim
+    jobs = schedsim.generate(seed=2)
+    cols = schedsim.run(jobs["arrive_ns"], jobs["work_iters"], policy="mlfq")
+    grid = schedsim.sweep(jobs["arrive_ns"], jobs["work_iters"],
+                          policy=["fifo", "mlfq"], rr_slice_ns=[10e6, 50e6])
+"""
+import ctypes
+import itertools
+import os
+
+import numpy as np
+
+COLUMNS = ("pid", "child_index", "arrive_ns", "start_ns",
+           "end_ns", "duration_ns", "work_iters")
+GENERATORS = ("loadtest", "divided", "sleepmid")
+
+_LIB_PATH = os.environ.get(
+    "SCHEDSIM_LIB",
+    os.path.join(os.path.dirname(os.path.abspath(__file__)), "bin", "libschedsim.so"),
+)
+_lib = None
+_i64p = np.ctypeslib.ndpointer(dtype=np.int64, flags="C_CONTIGUOUS")
+_u64p = np.ctypeslib.ndpointer(dtype=np.uint64, flags="C_CONTIGUOUS")
+_i32p = np.ctypeslib.ndpointer(dtype=np.int32, flags="C_CONTIGUOUS")
+_f64p = np.ctypeslib.ndpointer(dtype=np.float64, flags="C_CONTIGUOUS")
+
+
+def _load_lib():
+    global _lib
+    if _lib is not None:
+        return _lib
+    if not os.path.exists(_LIB_PATH):
+        raise RuntimeError(f"schedsim library not found at {_LIB_PATH} (run 'make sim')")
+    lib = ctypes.CDLL(_LIB_PATH)
+    for name in ("schedsim_nr_params", "schedsim_nr_summary", "schedsim_nr_policies"):
+        getattr(lib, name).argtypes = []
+        getattr(lib, name).restype = ctypes.c_int
+    for name in ("schedsim_param_name", "schedsim_summary_name", "schedsim_policy_name"):
+        getattr(lib, name).argtypes = [ctypes.c_int]
+        getattr(lib, name).restype = ctypes.c_char_p
+    lib.schedsim_param_defaults.argtypes = [_u64p]
+    lib.schedsim_param_defaults.restype = None
+    lib.schedsim_run.argtypes = [ctypes.c_int, _u64p, _i64p, _i64p, ctypes.c_void_p,
+                                 ctypes.c_long, ctypes.c_double,
+                                 ctypes.POINTER(ctypes.c_void_p)]
+    lib.schedsim_run.restype = ctypes.c_long
+    lib.schedsim_generate.argtypes = [ctypes.c_int, ctypes.c_uint, ctypes.c_int, ctypes.c_int,
+                                      ctypes.c_int64, ctypes.c_int64,
+                                      _i64p, _i64p, _i64p, ctypes.c_long]
+    lib.schedsim_generate.restype = ctypes.c_long
+    lib.schedsim_sweep.argtypes = [ctypes.c_int, _i32p, _u64p, _i64p, _i64p,
+                                   ctypes.c_long, ctypes.c_double, ctypes.c_int, _f64p]
+    lib.schedsim_sweep.restype = ctypes.c_int
+    _lib = lib
+    return lib
+
+
+def _names(count_fn, name_fn):
+    lib = _load_lib()
+    return tuple(getattr(lib, name_fn)(i).decode()
+                 for i in range(getattr(lib, count_fn)()))
+
+
+def available():
+    try:
+        _load_lib()
+    except RuntimeError:
+        return False
+    return True
+
+
+def policies():
+    return _names("schedsim_nr_policies", "schedsim_policy_name")
+
+
+def params():
+    """Tunable names, as the fields of struct sim_params."""
+    return _names("schedsim_nr_params", "schedsim_param_name")
+
+
+def defaults():
+    """sim_params_default() as a dict (times in ns, fair tunables unscaled)."""
+    names = params()
+    vals = np.zeros(len(names), dtype=np.uint64)
+    _load_lib().schedsim_param_defaults(vals)
+    return dict(zip(names, (int(v) for v in vals)))
+
+
+def _param_vector(overrides):
+    names = params()
+    vals = np.zeros(len(names), dtype=np.uint64)
+    _load_lib().schedsim_param_defaults(vals)
+    for key, value in overrides.items():
+        if key not in names:
+            raise KeyError(f"unknown parameter {key!r}, expected one of {names}")
+        vals[names.index(key)] = int(value)
+    return vals
+
+
+def _policy_id(policy):
+    names = policies()
+    if policy not in names:
+        raise KeyError(f"unknown policy {policy!r}, expected one of {names}")
+    return names.index(policy)
+
+
+def _jobs(arrive_ns, work_iters):
+    arrive = np.ascontiguousarray(arrive_ns, dtype=np.int64)
+    work = np.ascontiguousarray(work_iters, dtype=np.int64)
+    if arrive.shape != work.shape or arrive.ndim != 1:
+        raise ValueError("arrive_ns and work_iters must be 1-D arrays of the same length")
+    return arrive, work
+
+
+def generate(seed=2, max_procs=20, max_start_delay_ms=10,
+             min_iters=1000000, max_iters=5000000, gen="loadtest"):
+    """
+    Job list of a generator run (same values as the binaries with -s seed).
+    Returns a dict of int64 arrays: arrive_ns, work_iters, child_index.
+    """
+    lib = _load_lib()
+    cap = max(1, int(max_procs))
+    out = {k: np.empty(cap, dtype=np.int64) for k in ("arrive_ns", "work_iters", "child_index")}
+    n = lib.schedsim_generate(GENERATORS.index(gen), int(seed), int(max_procs),
+                              int(max_start_delay_ms), int(min_iters), int(max_iters),
+                              out["arrive_ns"], out["work_iters"], out["child_index"], cap)
+    if n < 0:
+        raise OSError(-n, os.strerror(-n))
+    return {k: v[:n] for k, v in out.items()}
+
+
+def run(arrive_ns, work_iters, policy="fifo", ns_per_iter=3.0, child_index=None, **overrides):
+    """
+    Simulate one job list. overrides are sim_params fields (ns), e.g.
+    rr_slice_ns=10_000_000. Returns a dict of int64 columns named like the
+    loadtest CSV, one row per input job in input order.
+    """
+    lib = _load_lib()
+    arrive, work = _jobs(arrive_ns, work_iters)
+    n = len(arrive)
+    idx = None
+    if child_index is not None:
+        idx = np.ascontiguousarray(child_index, dtype=np.int64)
+        if idx.shape != arrive.shape:
+            raise ValueError("child_index must match arrive_ns")
+
+    cols = {name: np.empty(n, dtype=np.int64) for name in COLUMNS}
+    ptrs = (ctypes.c_void_p * len(COLUMNS))(*(cols[name].ctypes.data for name in COLUMNS))
+    got = lib.schedsim_run(_policy_id(policy), _param_vector(overrides), arrive, work,
+                           None if idx is None else idx.ctypes.data, n,
+                           float(ns_per_iter), ptrs)
+    if got < 0:
+        raise OSError(-got, os.strerror(-got))
+    return cols
+
+
+def run_frame(arrive_ns, work_iters, policy="fifo", ns_per_iter=3.0, child_index=None,
+              **overrides):
+    """run() as a pandas DataFrame (same columns as fastlog.read_frame())."""
+    import pandas as pd
+
+    return pd.DataFrame(run(arrive_ns, work_iters, policy=policy, ns_per_iter=ns_per_iter,
+                            child_index=child_index, **overrides), copy=False)
+
+
+def sweep(arrive_ns, work_iters, policy=("fifo", "mlfq"), ns_per_iter=3.0, threads=0,
+          **grid):
+    """
+    Simulate one job list over the cartesian product of policy and every
+    parameter in grid (scalars or sequences), e.g.
+
+        sweep(a, w, policy=["rr", "mlfq"], rr_slice_ns=[5e6, 10e6, 50e6],
+              tick_ns=[1e6, 4e6])
+
+    The grid runs in C on `threads` threads (0 = all cpus) with the GIL
+    released. Returns a dict of numpy arrays, one entry per grid point:
+    policy, the swept parameters, and mean/p99 wait and turnaround,
+    makespan, switches, wakeup_preempt and lost (times in ns).
+    """
+    lib = _load_lib()
+    arrive, work = _jobs(arrive_ns, work_iters)
+    pols = [policy] if isinstance(policy, str) else list(policy)
+    keys = list(grid)
+    axes = [[v] if np.isscalar(v) else list(v) for v in grid.values()]
+    names = params()
+    for key in keys:
+        if key not in names:
+            raise KeyError(f"unknown parameter {key!r}, expected one of {names}")
+
+    points = list(itertools.product(pols, *axes))
+    base = _param_vector({})
+    vals = np.tile(base, (len(points), 1))
+    pol_ids = np.empty(len(points), dtype=np.int32)
+    for i, (pol, *values) in enumerate(points):
+        pol_ids[i] = _policy_id(pol)
+        for key, value in zip(keys, values):
+            vals[i, names.index(key)] = int(value)
+
+    nr_summary = lib.schedsim_nr_summary()
+    summary = np.zeros((len(points), nr_summary), dtype=np.float64)
+    err = lib.schedsim_sweep(len(points), pol_ids, np.ascontiguousarray(vals), arrive, work,
+                             len(arrive), float(ns_per_iter), int(threads), summary)
+    if err < 0:
+        raise OSError(-err, os.strerror(-err))
+
+    out = {"policy": np.array([p[0] for p in points])}
+    for key in keys:
+        out[key] = vals[:, names.index(key)].copy()
+    for j, name in enumerate(_names("schedsim_nr_summary", "schedsim_summary_name")):
+        out[name] = summary[:, j]
+    return out
@@ -1,15 +1,44 @@
+/*
+ * scx_fifo_stats: per-process view of scx_fifo_capture's proc_stats map.
+ *
+ * Besides printing the live pinned map, it can save it to a snapshot file
+ * (-s), print a saved snapshot (-l) and diff two snapshots, or a snapshot
+ * and the live map (-d), as per-process rates over the interval between
+ * them. Snapshots outlive the scheduler, so a before/after comparison of
+ * a deployment only needs one taken on each side, e.g. from cron:
+ *
+ *   scx_fifo_stats -s /var/lib/scx/$(date +%s).snap
+ *   scx_fifo_stats -d before.snap after.snap -n 20
+ *
+ * The live map is read with one bpf_map_lookup_batch() call where the
+ * kernel supports it (key by key otherwise).
+ *
+ * Snapshot file: struct snap_hdr, then nr_rows records of struct snap_row
+ * followed by nr_buckets u64 wait histogram buckets, all little endian.
+ * Timestamps are CLOCK_MONOTONIC, which restarts at boot; boot_id tells
+ * whether two snapshots can be compared.
+ */
 #include <bpf/bpf.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifndef PATH_MAX
 #define PATH_MAX 4096
 #endif
 
+#define COMM_LEN	16
+/* Wait histogram buckets of the current scx_fifo_capture.bpf.c */
+#define MAX_BUCKETS	32
+
+#define SNAP_MAGIC	"SCXSNAP"
+#define SNAP_VERSION	1
+
 struct proc_stats_val {
 	__u64 total_wait_ns;
 	__u64 wait_events;
@@ -17,22 +46,54 @@ struct proc_stats_val {
 	__u64 cpu_ns;
 };
 
+/* Offset of comm in the current map value, after the wait histogram. */
+#define VAL_COMM_OFF	(sizeof(struct proc_stats_val) + MAX_BUCKETS * sizeof(__u64))
+
+struct snap_hdr {
+	char	magic[8];	/* SNAP_MAGIC, NUL padded */
+	__u32	version;
+	__u32	nr_rows;
+	__u32	nr_buckets;	/* wait histogram buckets per row, 0: none */
+	__u32	pad;
+	__u64	mono_ns;	/* CLOCK_MONOTONIC at the read */
+	__u64	real_ns;	/* CLOCK_REALTIME, for display only */
+	char	boot_id[40];	/* /proc/sys/kernel/random/boot_id */
+};
+
+struct snap_row {
+	__u32			tgid;
+	char			comm[COMM_LEN];
+	__u32			pad;
+	struct proc_stats_val	v;
+};
+
 struct row {
 	__u32 tgid;
 	struct proc_stats_val v;
-	char comm[64];
+	__u64 hist[MAX_BUCKETS];
+	char comm[COMM_LEN];
+};
+
+struct snapshot {
+	struct snap_hdr hdr;
+	struct row *rows;
+	size_t cnt;
 };
 
 static void usage(const char *prog)
 {
 	fprintf(stderr,
-		"Usage: %s [-p PIN_PATH] [-n TOPN]\n\n"
+		"Usage: %s [-p PIN_PATH] [-n TOPN] [-s FILE | -l FILE | -d OLD [NEW]]\n\n"
 		"  -p PIN_PATH   Pinned map path (default: /sys/fs/bpf/scx_fifo_capture/proc_stats)\n"
-		"  -n TOPN       Print top N processes by CPU time (default: all)\n",
+		"  -n TOPN       Print top N processes by CPU time (default: all)\n"
+		"  -s FILE       Save a snapshot of the pinned map to FILE instead of printing it\n"
+		"  -l FILE       Print the snapshot in FILE instead of the pinned map\n"
+		"  -d OLD [NEW]  Per-process rates between snapshot OLD and NEW (default: the\n"
+		"                pinned map now)\n",
 		prog);
 }
 
-static void read_comm(__u32 tgid, char out[64])
+static void read_comm(__u32 tgid, char out[COMM_LEN])
 {
 	char path[PATH_MAX];
 	FILE *f;
@@ -40,15 +101,35 @@ static void read_comm(__u32 tgid, char out[64])
 	snprintf(path, sizeof(path), "/proc/%u/comm", tgid);
 	f = fopen(path, "r");
 	if (!f) {
-		snprintf(out, 64, "?");
+		snprintf(out, COMM_LEN, "?");
 		return;
 	}
-	if (!fgets(out, 64, f))
-		snprintf(out, 64, "?");
+	if (!fgets(out, COMM_LEN, f))
+		snprintf(out, COMM_LEN, "?");
 	fclose(f);
 	out[strcspn(out, "\n")] = '\0';
 }
 
+static void read_boot_id(char out[40])
+{
+	FILE *f = fopen("/proc/sys/kernel/random/boot_id", "r");
+
+	memset(out, 0, 40);
+	if (!f)
+		return;
+	if (fgets(out, 40, f))
+		out[strcspn(out, "\n")] = '\0';
+	fclose(f);
+}
+
+static __u64 clock_ns(clockid_t id)
+{
+	struct timespec ts;
+
+	clock_gettime(id, &ts);
+	return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 static int cmp_cpu_desc(const void *a, const void *b)
 {
 	const struct row *ra = a;
@@ -65,26 +146,69 @@ static double ns_to_ms(__u64 ns)
 	return (double)ns / 1e6;
 }
 
-int main(int argc, char **argv)
+/* Value below which a fraction q of the waits fall, bucket i = [2^i, 2^(i+1)). */
+static double hist_quantile(const __u64 *hist, int nr, double q)
 {
-	const char *pin_path = "/sys/fs/bpf/scx_fifo_capture/proc_stats";
-	long topn = -1;
-	int opt;
-	int fd;
+	__u64 total = 0;
+	double want, seen = 0, lo = 1.0;
+	int i;
 
-	while ((opt = getopt(argc, argv, "p:n:h")) != -1) {
-		switch (opt) {
-		case 'p':
-			pin_path = optarg;
-			break;
-		case 'n':
-			topn = strtol(optarg, NULL, 10);
-			break;
-		default:
-			usage(argv[0]);
-			return opt != 'h';
-		}
+	for (i = 0; i < nr; i++)
+		total += hist[i];
+	if (!total)
+		return 0.0;
+	want = q * total;
+	for (i = 0; i < nr; i++, lo *= 2.0) {
+		if (!hist[i])
+			continue;
+		if (seen + hist[i] >= want)
+			return lo * (1.0 + (want - seen) / hist[i]);
+		seen += hist[i];
 	}
+	return lo;
+}
+
+static int add_row(struct snapshot *s, size_t *cap, __u32 tgid, const void *val,
+		   __u32 nr_buckets, bool has_comm)
+{
+	struct row *r;
+
+	if (s->cnt == *cap) {
+		struct row *n;
+
+		*cap = *cap ? *cap * 2 : 128;
+		n = realloc(s->rows, *cap * sizeof(*n));
+		if (!n)
+			return -ENOMEM;
+		s->rows = n;
+	}
+	r = &s->rows[s->cnt++];
+	memset(r, 0, sizeof(*r));
+	r->tgid = tgid;
+	memcpy(&r->v, val, sizeof(r->v));
+	memcpy(r->hist, (const char *)val + sizeof(r->v), nr_buckets * sizeof(__u64));
+	if (has_comm) {
+		memcpy(r->comm, (const char *)val + VAL_COMM_OFF, COMM_LEN);
+		r->comm[COMM_LEN - 1] = '\0';
+	}
+	return 0;
+}
+
+/*
+ * Read the whole pinned map. The value layout is taken from the map, so
+ * maps from before the wait histogram (value = 4 counters) or before comm
+ * was captured still load; their comm comes from /proc, which only knows
+ * processes still alive.
+ */
+static int read_live(const char *pin_path, struct snapshot *s)
+{
+	struct bpf_map_info info = {};
+	__u32 info_len = sizeof(info), count, batch, i, key, next_key;
+	__u32 *keys = NULL;
+	char *vals = NULL;
+	size_t cap = 0;
+	bool has_comm;
+	int fd, ret;
 
 	fd = bpf_obj_get(pin_path);
 	if (fd < 0) {
@@ -92,43 +216,140 @@ int main(int argc, char **argv)
 			"Failed to open pinned map at %s: %s\n"
 			"Make sure the scheduler is running and has pinned the map.\n",
 			pin_path, strerror(errno));
-		return 1;
+		return -1;
+	}
+	if (bpf_obj_get_info_by_fd(fd, &info, &info_len) ||
+	    info.key_size != sizeof(__u32) || info.value_size < sizeof(struct proc_stats_val)) {
+		fprintf(stderr, "%s is not a proc_stats map\n", pin_path);
+		close(fd);
+		return -1;
 	}
 
-	struct row *rows = NULL;
-	size_t cap = 0, cnt = 0;
-	__u32 key, next_key;
-	int ret;
-
-	ret = bpf_map_get_next_key(fd, NULL, &next_key);
-	while (ret == 0) {
-		struct proc_stats_val v;
-
-		key = next_key;
-		if (bpf_map_lookup_elem(fd, &key, &v) == 0) {
-			if (cnt == cap) {
-				cap = cap ? cap * 2 : 128;
-				rows = realloc(rows, cap * sizeof(*rows));
-				if (!rows) {
-					fprintf(stderr, "Out of memory\n");
-					close(fd);
-					return 1;
-				}
-			}
-			rows[cnt].tgid = key;
-			rows[cnt].v = v;
-			read_comm(key, rows[cnt].comm);
-			cnt++;
+	memset(s, 0, sizeof(*s));
+	memcpy(s->hdr.magic, SNAP_MAGIC, sizeof(SNAP_MAGIC));
+	s->hdr.version = SNAP_VERSION;
+	has_comm = info.value_size >= VAL_COMM_OFF + COMM_LEN;
+	s->hdr.nr_buckets = (info.value_size - sizeof(struct proc_stats_val)) / sizeof(__u64);
+	if (s->hdr.nr_buckets > MAX_BUCKETS)
+		s->hdr.nr_buckets = MAX_BUCKETS;
+	read_boot_id(s->hdr.boot_id);
+
+	keys = calloc(info.max_entries, sizeof(*keys));
+	vals = calloc(info.max_entries, info.value_size);
+	if (!keys || !vals) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/* one batch covers the whole map; ENOENT means it reached the end */
+	count = info.max_entries;
+	s->hdr.mono_ns = clock_ns(CLOCK_MONOTONIC);
+	ret = bpf_map_lookup_batch(fd, NULL, &batch, keys, vals, &count, NULL);
+	if (!ret || errno == ENOENT) {
+		ret = 0;
+		for (i = 0; i < count && !ret; i++)
+			ret = add_row(s, &cap, keys[i], vals + (size_t)i * info.value_size,
+				      s->hdr.nr_buckets, has_comm);
+	} else {
+		/* no batch ops (old kernel): key by key */
+		ret = bpf_map_get_next_key(fd, NULL, &next_key);
+		while (ret == 0) {
+			key = next_key;
+			if (bpf_map_lookup_elem(fd, &key, vals) == 0 &&
+			    add_row(s, &cap, key, vals, s->hdr.nr_buckets, has_comm))
+				break;
+			ret = bpf_map_get_next_key(fd, &key, &next_key);
 		}
+		ret = 0;
+	}
+	s->hdr.real_ns = clock_ns(CLOCK_REALTIME);
+	s->hdr.nr_rows = s->cnt;
+	for (i = 0; i < s->cnt; i++) {
+		if (!s->rows[i].comm[0])
+			read_comm(s->rows[i].tgid, s->rows[i].comm);
+	}
+out:
+	if (ret)
+		fprintf(stderr, "Failed to read %s: %s\n", pin_path, strerror(-ret));
+	free(keys);
+	free(vals);
+	close(fd);
+	return ret ? -1 : 0;
+}
+
+static int save_snapshot(const char *path, const struct snapshot *s)
+{
+	FILE *f = fopen(path, "w");
+	size_t i;
+
+	if (!f) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	fwrite(&s->hdr, sizeof(s->hdr), 1, f);
+	for (i = 0; i < s->cnt; i++) {
+		struct snap_row sr = { .tgid = s->rows[i].tgid, .v = s->rows[i].v };
+
+		memcpy(sr.comm, s->rows[i].comm, COMM_LEN);
+		fwrite(&sr, sizeof(sr), 1, f);
+		fwrite(s->rows[i].hist, sizeof(__u64), s->hdr.nr_buckets, f);
+	}
+	if (fclose(f)) {
+		fprintf(stderr, "Failed to write %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static int load_snapshot(const char *path, struct snapshot *s)
+{
+	FILE *f = fopen(path, "r");
+	size_t cap = 0;
+	__u32 i;
 
-		ret = bpf_map_get_next_key(fd, &key, &next_key);
+	memset(s, 0, sizeof(*s));
+	if (!f) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (fread(&s->hdr, sizeof(s->hdr), 1, f) != 1 ||
+	    memcmp(s->hdr.magic, SNAP_MAGIC, sizeof(SNAP_MAGIC)) ||
+	    s->hdr.version != SNAP_VERSION || s->hdr.nr_buckets > MAX_BUCKETS) {
+		fprintf(stderr, "%s: not a version %d snapshot\n", path, SNAP_VERSION);
+		fclose(f);
+		return -1;
+	}
+	s->hdr.boot_id[sizeof(s->hdr.boot_id) - 1] = '\0';
+	for (i = 0; i < s->hdr.nr_rows; i++) {
+		char val[sizeof(struct proc_stats_val) + MAX_BUCKETS * sizeof(__u64)];
+		struct snap_row sr;
+
+		if (fread(&sr, sizeof(sr), 1, f) != 1 ||
+		    fread(val + sizeof(sr.v), sizeof(__u64), s->hdr.nr_buckets, f) != s->hdr.nr_buckets) {
+			fprintf(stderr, "%s: truncated after %u of %u rows\n", path, i, s->hdr.nr_rows);
+			break;
+		}
+		memcpy(val, &sr.v, sizeof(sr.v));
+		if (add_row(s, &cap, sr.tgid, val, s->hdr.nr_buckets, false)) {
+			fprintf(stderr, "Out of memory\n");
+			break;
+		}
+		memcpy(s->rows[s->cnt - 1].comm, sr.comm, COMM_LEN);
+		s->rows[s->cnt - 1].comm[COMM_LEN - 1] = '\0';
 	}
+	fclose(f);
+	return 0;
+}
+
+static void print_table(struct snapshot *s, const char *src, long topn)
+{
+	struct row *rows = s->rows;
+	size_t cnt = s->cnt;
+	int nb = s->hdr.nr_buckets;
 
 	if (cnt == 0) {
 		printf("No FIFO stats yet.\n");
-		free(rows);
-		close(fd);
-		return 0;
+		return;
 	}
 
 	qsort(rows, cnt, sizeof(*rows), cmp_cpu_desc);
@@ -146,15 +367,15 @@ int main(int argc, char **argv)
 		overall_avg_wait_ms = ns_to_ms(sum_wait_ns / sum_wait_ev);
 
 	printf("FIFO statistics (per process)\n");
-	printf("Pinned map: %s\n\n", pin_path);
+	printf("Source: %s\n\n", src);
 	printf("Overall average waiting time: %.3f ms (events=%" PRIu64 ")\n",
 		overall_avg_wait_ms, (uint64_t)sum_wait_ev);
 	printf("Total CPU time: %.3f ms | Total context switches (in): %" PRIu64 "\n\n",
 		ns_to_ms(sum_cpu_ns), (uint64_t)sum_cs);
 
-	printf("%-8s %12s %8s %12s %14s %12s\n",
-		"TGID", "CPU(ms)", "CPU%", "CS(in)", "AvgWait(ms)", "WaitEv");
-	printf("-----------------------------------------------------------------\n");
+	printf("%-8s %-16s %12s %8s %12s %14s %12s %12s\n",
+		"TGID", "COMM", "CPU(ms)", "CPU%", "CS(in)", "AvgWait(ms)", "WaitEv", "P99Wait(ms)");
+	printf("----------------------------------------------------------------------------------------------------\n");
 
 	long limit = (topn > 0 && (size_t)topn < cnt) ? topn : (long)cnt;
 	for (long i = 0; i < limit; i++) {
@@ -165,14 +386,159 @@ int main(int argc, char **argv)
 		if (r->v.wait_events)
 			avg_wait_ms = ns_to_ms(r->v.total_wait_ns / r->v.wait_events);
 
-		printf("%-8u %12.3f %7.2f%% %12" PRIu64 " %14.3f %12" PRIu64 "\n",
-			r->tgid, cpu_ms, cpu_pct,
+		printf("%-8u %-16s %12.3f %7.2f%% %12" PRIu64 " %14.3f %12" PRIu64,
+			r->tgid, r->comm, cpu_ms, cpu_pct,
 			(uint64_t)r->v.cs_in,
 			avg_wait_ms,
 			(uint64_t)r->v.wait_events);
+		if (nb)
+			printf(" %12.3f\n", hist_quantile(r->hist, nb, 0.99) / 1e6);
+		else
+			printf(" %12s\n", "-");
+	}
+}
+
+/* Row of the same process in old: same tgid and comm (tgids get reused). */
+static const struct row *find_row(const struct snapshot *old, const struct row *r)
+{
+	for (size_t i = 0; i < old->cnt; i++)
+		if (old->rows[i].tgid == r->tgid && !strcmp(old->rows[i].comm, r->comm))
+			return &old->rows[i];
+	return NULL;
+}
+
+/*
+ * Per-process change from old to new, as rates over the interval. A
+ * process only in new started in between and is counted from zero.
+ */
+static int print_diff(const struct snapshot *old, struct snapshot *new,
+		      const char *old_src, const char *new_src, long topn)
+{
+	double secs = (double)(new->hdr.mono_ns - old->hdr.mono_ns) / 1e9;
+	int nb = new->hdr.nr_buckets < old->hdr.nr_buckets ?
+		 new->hdr.nr_buckets : old->hdr.nr_buckets;
+	size_t cnt = 0, gone = old->cnt, started = 0;
+	struct row *d;
+
+	if (strcmp(old->hdr.boot_id, new->hdr.boot_id)) {
+		fprintf(stderr, "%s and %s are from different boots\n", old_src, new_src);
+		return 1;
+	}
+	if (new->hdr.mono_ns <= old->hdr.mono_ns) {
+		fprintf(stderr, "%s is not older than %s\n", old_src, new_src);
+		return 1;
 	}
 
-	free(rows);
-	close(fd);
+	d = calloc(new->cnt ? new->cnt : 1, sizeof(*d));
+	if (!d) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	for (size_t i = 0; i < new->cnt; i++) {
+		const struct row *r = &new->rows[i], *o = find_row(old, r);
+		struct row *x = &d[cnt];
+
+		*x = *r;
+		if (o) {
+			gone--;
+			/* counters only grow; anything else is a recycled tgid */
+			if (r->v.cpu_ns < o->v.cpu_ns || r->v.wait_events < o->v.wait_events)
+				o = NULL;
+		}
+		if (o) {
+			x->v.total_wait_ns -= o->v.total_wait_ns;
+			x->v.wait_events -= o->v.wait_events;
+			x->v.cs_in -= o->v.cs_in;
+			x->v.cpu_ns -= o->v.cpu_ns;
+			for (int b = 0; b < nb; b++)
+				x->hist[b] -= o->hist[b];
+		} else {
+			started++;
+		}
+		if (x->v.cpu_ns || x->v.wait_events || x->v.cs_in)
+			cnt++;
+	}
+	qsort(d, cnt, sizeof(*d), cmp_cpu_desc);
+
+	printf("FIFO statistics diff: %s -> %s\n", old_src, new_src);
+	printf("Interval: %.3f s, active processes: %zu (new: %zu, gone: %zu)\n\n",
+	       secs, cnt, started, gone);
+	printf("%-8s %-16s %10s %8s %10s %10s %12s %12s\n",
+		"TGID", "COMM", "dCPU(ms)", "CPUs", "CS/s", "Waits/s", "AvgWait(ms)", "P99Wait(ms)");
+	printf("-------------------------------------------------------------------------------------------\n");
+
+	long limit = (topn > 0 && (size_t)topn < cnt) ? topn : (long)cnt;
+	for (long i = 0; i < limit; i++) {
+		const struct row *r = &d[i];
+
+		printf("%-8u %-16s %10.3f %8.3f %10.1f %10.1f %12.3f",
+			r->tgid, r->comm, ns_to_ms(r->v.cpu_ns),
+			r->v.cpu_ns / 1e9 / secs,
+			r->v.cs_in / secs, r->v.wait_events / secs,
+			r->v.wait_events ? ns_to_ms(r->v.total_wait_ns / r->v.wait_events) : 0.0);
+		if (nb)
+			printf(" %12.3f\n", hist_quantile(r->hist, nb, 0.99) / 1e6);
+		else
+			printf(" %12s\n", "-");
+	}
+	free(d);
 	return 0;
 }
+
+int main(int argc, char **argv)
+{
+	const char *pin_path = "/sys/fs/bpf/scx_fifo_capture/proc_stats";
+	const char *save_path = NULL, *load_path = NULL, *diff_path = NULL;
+	struct snapshot cur, old;
+	long topn = -1;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "p:n:s:l:d:h")) != -1) {
+		switch (opt) {
+		case 'p':
+			pin_path = optarg;
+			break;
+		case 'n':
+			topn = strtol(optarg, NULL, 10);
+			break;
+		case 's':
+			save_path = optarg;
+			break;
+		case 'l':
+			load_path = optarg;
+			break;
+		case 'd':
+			diff_path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+	if (!!save_path + !!load_path + !!diff_path > 1 ||
+	    (optind < argc && !diff_path) || argc - optind > 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	/* -d OLD NEW compares two files, -l prints one, else the live map */
+	if (diff_path && optind < argc)
+		load_path = argv[optind];
+	if (load_path ? load_snapshot(load_path, &cur) : read_live(pin_path, &cur))
+		return 1;
+
+	if (save_path) {
+		ret = save_snapshot(save_path, &cur) ? 1 : 0;
+	} else if (diff_path) {
+		if (load_snapshot(diff_path, &old))
+			ret = 1;
+		else
+			ret = print_diff(&old, &cur, diff_path, load_path ? load_path : pin_path, topn);
+		free(old.rows);
+	} else {
+		print_table(&cur, load_path ? load_path : pin_path, topn);
+	}
+
+	free(cur.rows);
+	return ret;
+}
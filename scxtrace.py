@@ -0,0 +1,110 @@
+"""
+Reader for the scx_fifo_capture trace files (scx_fifo_capture -t, format in
+scheds/scx_fifo_capture.h).
+
+Scheduler events and the generators' USDT probes share one clock
+(CLOCK_MONOTONIC, bpf_ktime_get_ns), so the records only need sorting.
+
+    import scxtrace
+    ev = scxtrace.read("log/trace.bin")
+    releases = ev[ev["type"] == scxtrace.JOB_RELEASE]
+
+    python3 scxtrace.py log/trace.bin      # event counts per type
+
+Sampled traces (scx_fifo_capture -r/-b) carry RATE records; weights(ev)
+gives each record the 1-in-N rate its type was sampled at, so counts can
+be scaled back up. LOST records count ring buffer drops.
+"""
+import argparse
+import sys
+
+import numpy as np
+
+MAGIC = b"SCXTRACE"
+VERSION = 1
+
+ENQUEUE, RUNNING, STOPPING, IDLE, DISPATCH = 1, 2, 3, 4, 5
+RATE, LOST = 6, 7
+JOB_RELEASE, LOOP_START, SLICE, JOB_END = 16, 17, 18, 19
+TYPE_NAMES = {
+    ENQUEUE: "enqueue", RUNNING: "running", STOPPING: "stopping",
+    IDLE: "idle", DISPATCH: "dispatch", RATE: "rate", LOST: "lost",
+    JOB_RELEASE: "job_release", LOOP_START: "loop_start",
+    SLICE: "slice", JOB_END: "job_end",
+}
+
+HEADER = np.dtype([("magic", "S8"), ("version", "<u4"), ("rec_size", "<u4")])
+EVENT = np.dtype([("ts_ns", "<u8"), ("pid", "<u4"), ("type", "<u2"),
+                  ("cpu", "<u2"), ("arg", "<u8", (3,))])
+
+
+def read(path, sort=True):
+    """All records as a structured array (ts_ns, pid, type, cpu, arg[3])."""
+    with open(path, "rb") as f:
+        raw = f.read()
+    if len(raw) < HEADER.itemsize:
+        raise ValueError(f"{path}: too short for a trace header")
+    hdr = np.frombuffer(raw, dtype=HEADER, count=1)[0]
+    if hdr["magic"] != MAGIC or hdr["version"] != VERSION:
+        raise ValueError(f"{path}: not a version {VERSION} scx_fifo_capture trace")
+    if hdr["rec_size"] != EVENT.itemsize:
+        raise ValueError(f"{path}: record size {hdr['rec_size']}, expected {EVENT.itemsize}")
+    body = raw[HEADER.itemsize:]
+    nr = len(body) // EVENT.itemsize  # a torn last record is dropped
+    ev = np.frombuffer(body, dtype=EVENT, count=nr)
+    if sort:
+        ev = ev[np.argsort(ev["ts_ns"], kind="stable")]
+    return ev
+
+
+def weights(ev):
+    """Sampling rate (1 in N) in effect for each record; 0 for RATE/LOST."""
+    w = np.ones(len(ev), dtype=np.int64)
+    meta = (ev["type"] == RATE) | (ev["type"] == LOST)
+    w[meta] = 0
+    rates = ev[ev["type"] == RATE]
+    for t in np.unique(rates["arg"][:, 0]):
+        r = rates[rates["arg"][:, 0] == t]
+        of_type = np.flatnonzero(ev["type"] == t)
+        # the last rate record at or before each event of the type
+        k = np.searchsorted(r["ts_ns"], ev["ts_ns"][of_type], side="right") - 1
+        w[of_type[k >= 0]] = r["arg"][k[k >= 0], 1].astype(np.int64)
+    return w
+
+
+def lost(ev):
+    """Dropped records per event type, from the LOST records."""
+    rec = ev[ev["type"] == LOST]
+    out = {}
+    for t, n in zip(rec["arg"][:, 0], rec["arg"][:, 1]):
+        out[int(t)] = out.get(int(t), 0) + int(n)
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Summarize an scx_fifo_capture trace")
+    ap.add_argument("trace")
+    args = ap.parse_args()
+
+    ev = read(args.trace)
+    if not len(ev):
+        print("empty trace")
+        return 0
+    span = (int(ev["ts_ns"][-1]) - int(ev["ts_ns"][0])) / 1e9
+    print(f"{len(ev)} events over {span:.3f}s")
+    w = weights(ev)
+    drops = lost(ev)
+    types, counts = np.unique(ev["type"], return_counts=True)
+    for t, n in zip(types, counts):
+        line = f"  {TYPE_NAMES.get(int(t), str(int(t))):12s} {n}"
+        est = int(w[ev["type"] == t].sum())
+        if t not in (RATE, LOST) and est != n:
+            line += f" (~{est} before sampling)"
+        if drops.get(int(t)):
+            line += f", {drops[int(t)]} lost"
+        print(line)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
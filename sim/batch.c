@@ -0,0 +1,432 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * batch.c - lockstep simulation of many seeds for the sched_ext policies.
+ *
+ * A single-seed run is a few dozen small, branchy events, so sweeping
+ * seeds through sim_run() mostly pays for allocation, indirect policy
+ * calls and pointer chasing. Here SIM_BATCH_LANES seeds advance together,
+ * one event per lane and step, with all state in lane-major arrays:
+ *
+ *   per lane      now[l], cur[l], cur_rem[l], deadline[l], ...
+ *   per job slot  x[j * SIM_BATCH_LANES + l]
+ *
+ * A step makes three passes over the lanes:
+ *
+ *   1. release arrivals and pick the next task (queue operations, scalar)
+ *   2. advance every lane to its next event; a branch-free kernel over
+ *      contiguous u64 arrays that the compiler vectorizes
+ *   3. retire completed tasks and requeue the ones whose slice expired
+ *
+ * For fifo/rr/mlfq the remaining budget only depends on the time run, so
+ * the tick-rounded expiry is fixed when a task is picked (deadline[l]) and
+ * pass 2 needs no division. Batches are spread over threads.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#define L		SIM_BATCH_LANES
+#define NO_TASK		(-1)
+
+enum batch_kind {
+	BATCH_FIFO,
+	BATCH_RR,
+	BATCH_MLFQ,
+};
+
+enum {
+	LVL_RR		= 0,
+	LVL_FIFO	= 1,
+};
+
+struct batch {
+	int		cap;		/* job slots per lane (max_procs) */
+
+	/* per job slot, [j * L + l] */
+	uint64_t	*arrive;
+	uint64_t	*rem;
+	uint64_t	*start;
+	uint64_t	*last_run;
+	uint8_t		*level;
+
+	/* per level ring of job indices, [lvl][pos * L + l] */
+	int16_t		*q[2];
+	int		qhead[2][L], qtail[2][L];
+
+	/* per lane */
+	uint64_t	now[L];
+	uint64_t	next_arr[L];	/* arrival of jobs[next], or SIM_TIME_INF */
+	uint64_t	deadline[L];	/* tick-rounded slice expiry of cur */
+	uint64_t	cur_rem[L];
+	uint8_t		expire[L];
+	int		cur[L], last[L];
+	int		nr[L], next[L], done[L];
+	bool		finished[L];
+	struct sim_batch_result	res[L];
+};
+
+struct batch_work {
+	const struct sim_gen_params	*gp;
+	const unsigned int		*seeds;
+	int				nr_seeds;
+	const struct sim_params		*par;
+	enum batch_kind			kind;
+	struct sim_batch_result		*out;
+	int				next_batch;	/* atomic */
+	int				err;
+};
+
+static uint64_t tick_roundup(uint64_t t, uint64_t tick_ns)
+{
+	if (!tick_ns)
+		return t;
+	return (t + tick_ns - 1) / tick_ns * tick_ns;
+}
+
+static void q_push(struct batch *b, int lvl, int l, int j)
+{
+	b->q[lvl][(b->qtail[lvl][l] % b->cap) * L + l] = (int16_t)j;
+	b->qtail[lvl][l]++;
+}
+
+static int q_peek(struct batch *b, int lvl, int l)
+{
+	if (b->qhead[lvl][l] == b->qtail[lvl][l])
+		return NO_TASK;
+	return b->q[lvl][(b->qhead[lvl][l] % b->cap) * L + l];
+}
+
+static int q_pop(struct batch *b, int lvl, int l)
+{
+	int j = q_peek(b, lvl, l);
+
+	if (j != NO_TASK)
+		b->qhead[lvl][l]++;
+	return j;
+}
+
+static int batch_alloc(struct batch *b, int cap)
+{
+	size_t n = (size_t)cap * L;
+
+	memset(b, 0, sizeof(*b));
+	b->cap = cap;
+	b->arrive = calloc(n, sizeof(*b->arrive));
+	b->rem = calloc(n, sizeof(*b->rem));
+	b->start = calloc(n, sizeof(*b->start));
+	b->last_run = calloc(n, sizeof(*b->last_run));
+	b->level = calloc(n, sizeof(*b->level));
+	b->q[0] = calloc(n, sizeof(*b->q[0]));
+	b->q[1] = calloc(n, sizeof(*b->q[1]));
+	if (!b->arrive || !b->rem || !b->start || !b->last_run || !b->level ||
+	    !b->q[0] || !b->q[1])
+		return -ENOMEM;
+	return 0;
+}
+
+static void batch_free(struct batch *b)
+{
+	free(b->arrive);
+	free(b->rem);
+	free(b->start);
+	free(b->last_run);
+	free(b->level);
+	free(b->q[0]);
+	free(b->q[1]);
+}
+
+/* Load the job lists of seeds[0..nr_lanes-1]; unused lanes start finished. */
+static int batch_load(struct batch *b, const struct sim_gen_params *gp,
+		      const unsigned int *seeds, int nr_lanes)
+{
+	struct sim_gen_params g = *gp;
+
+	for (int lvl = 0; lvl < 2; lvl++) {
+		memset(b->qhead[lvl], 0, sizeof(b->qhead[lvl]));
+		memset(b->qtail[lvl], 0, sizeof(b->qtail[lvl]));
+	}
+	memset(b->res, 0, sizeof(b->res));
+
+	for (int l = 0; l < L; l++) {
+		struct sim_job *jobs;
+		int nr;
+
+		b->now[l] = 0;
+		b->cur[l] = NO_TASK;
+		b->last[l] = NO_TASK;
+		b->next[l] = 0;
+		b->done[l] = 0;
+		b->nr[l] = 0;
+		b->finished[l] = true;
+		if (l >= nr_lanes)
+			continue;
+
+		g.seed = seeds[l];
+		nr = sim_jobs_generate(&g, &jobs);
+		if (nr < 0)
+			return nr;
+		for (int j = 0; j < nr; j++) {
+			b->arrive[j * L + l] = jobs[j].arrive_ns;
+			b->rem[j * L + l] = jobs[j].work_ns ? jobs[j].work_ns : 1;
+			b->level[j * L + l] = LVL_RR;
+		}
+		free(jobs);
+		b->nr[l] = nr;
+		b->finished[l] = !nr;
+		b->res[l].seed = seeds[l];
+		b->res[l].nr_jobs = nr;
+	}
+	return 0;
+}
+
+/* at least 1ns, like sim_run(), so a zero slice still moves time */
+static uint64_t batch_slice(const struct sim_params *par, enum batch_kind kind, int lvl)
+{
+	uint64_t slice;
+
+	switch (kind) {
+	case BATCH_FIFO:
+		slice = par->dfl_slice_ns;
+		break;
+	case BATCH_RR:
+		slice = par->rr_slice_ns;
+		break;
+	case BATCH_MLFQ:
+	default:
+		slice = lvl == LVL_RR ? par->rr_slice_ns : par->fifo_slice_ns;
+		break;
+	}
+	return slice ? slice : 1;
+}
+
+/* pass 1: arrivals and picks, until every live lane has a running task */
+static void batch_pick(struct batch *b, const struct sim_params *par, enum batch_kind kind)
+{
+	for (int l = 0; l < L; l++) {
+		if (b->finished[l])
+			continue;
+
+		for (;;) {
+			int j;
+
+			while (b->next[l] < b->nr[l] &&
+			       b->arrive[b->next[l] * L + l] <= b->now[l]) {
+				j = b->next[l]++;
+				b->last_run[j * L + l] = b->arrive[j * L + l];
+				q_push(b, LVL_RR, l, j);	/* new tasks start at the top */
+			}
+			b->next_arr[l] = b->next[l] < b->nr[l] ?
+					 b->arrive[b->next[l] * L + l] : SIM_TIME_INF;
+			if (b->cur[l] != NO_TASK)
+				break;
+
+			/* mlfq aging: FIFO queue is in wait order, check the head */
+			if (kind == BATCH_MLFQ && par->mlfq_age_ns) {
+				while ((j = q_peek(b, LVL_FIFO, l)) != NO_TASK &&
+				       b->now[l] - b->last_run[j * L + l] >= par->mlfq_age_ns) {
+					q_pop(b, LVL_FIFO, l);
+					b->level[j * L + l] = LVL_RR;
+					q_push(b, LVL_RR, l, j);
+				}
+			}
+			j = q_pop(b, LVL_RR, l);
+			if (j == NO_TASK)
+				j = q_pop(b, LVL_FIFO, l);
+
+			if (j == NO_TASK) {
+				if (b->next[l] >= b->nr[l]) {
+					b->finished[l] = true;	/* cannot happen: no lost tasks */
+					break;
+				}
+				b->now[l] = b->next_arr[l];
+				continue;
+			}
+
+			if (b->last[l] != j) {
+				b->res[l].nr_switches++;
+				b->now[l] += par->cs_ns;
+			}
+			if (b->start[j * L + l] == SIM_TIME_INF)
+				b->start[j * L + l] = b->now[l];
+			b->cur[l] = j;
+			b->last[l] = j;
+			b->cur_rem[l] = b->rem[j * L + l];
+			b->deadline[l] = tick_roundup(b->now[l] +
+						      batch_slice(par, kind, b->level[j * L + l]),
+						      par->tick_ns);
+			break;
+		}
+	}
+}
+
+/*
+ * pass 2: run every lane up to its next event. Lanes without a task have
+ * cur_rem == 0 and deadline == now, so they do not move.
+ */
+static void batch_advance(struct batch *b)
+{
+	uint64_t *restrict now = b->now, *restrict rem = b->cur_rem;
+	const uint64_t *restrict dl = b->deadline, *restrict na = b->next_arr;
+	uint8_t *restrict expire = b->expire;
+
+	for (int l = 0; l < L; l++) {
+		uint64_t lim = dl[l] - now[l];
+		uint64_t arr = na[l] > now[l] ? na[l] - now[l] : 0;
+		uint64_t run = lim < rem[l] ? lim : rem[l];
+		uint8_t exp = lim < rem[l];
+
+		exp = arr < run ? 0 : exp;
+		run = arr < run ? arr : run;
+		now[l] += run;
+		rem[l] -= run;
+		expire[l] = exp;
+	}
+}
+
+/* pass 3: completions and slice expiry */
+static int batch_retire(struct batch *b, enum batch_kind kind)
+{
+	int live = 0;
+
+	for (int l = 0; l < L; l++) {
+		int j = b->cur[l];
+
+		if (b->finished[l])
+			continue;
+		live++;
+		if (j == NO_TASK)
+			continue;
+
+		if (!b->cur_rem[l]) {
+			struct sim_batch_result *r = &b->res[l];
+			uint64_t wait = b->start[j * L + l] - b->arrive[j * L + l];
+			uint64_t tat = b->now[l] - b->arrive[j * L + l];
+
+			r->sum_wait_ns += wait;
+			r->sum_tat_ns += tat;
+			if (wait > r->max_wait_ns)
+				r->max_wait_ns = wait;
+			if (tat > r->max_tat_ns)
+				r->max_tat_ns = tat;
+			b->cur[l] = NO_TASK;
+			b->cur_rem[l] = 0;
+			b->deadline[l] = b->now[l];
+			if (++b->done[l] == b->nr[l]) {
+				r->makespan_ns = b->now[l];
+				b->finished[l] = true;
+				live--;
+			}
+		} else if (b->expire[l]) {
+			b->rem[j * L + l] = b->cur_rem[l];
+			b->last_run[j * L + l] = b->now[l];
+			/* mlfq: demoted after its first run in the top queue */
+			if (kind == BATCH_MLFQ)
+				b->level[j * L + l] = LVL_FIFO;
+			q_push(b, b->level[j * L + l], l, j);
+			b->cur[l] = NO_TASK;
+			b->cur_rem[l] = 0;
+			b->deadline[l] = b->now[l];
+		}
+	}
+	return live;
+}
+
+static void batch_simulate(struct batch *b, const struct sim_params *par, enum batch_kind kind)
+{
+	for (size_t i = 0; i < (size_t)b->cap * L; i++)
+		b->start[i] = SIM_TIME_INF;
+	for (int l = 0; l < L; l++) {
+		b->cur_rem[l] = 0;
+		b->deadline[l] = 0;
+	}
+
+	do {
+		batch_pick(b, par, kind);
+		batch_advance(b);
+	} while (batch_retire(b, kind));
+}
+
+static void *batch_worker(void *arg)
+{
+	struct batch_work *w = arg;
+	struct batch *b;
+	int nr_batches = (w->nr_seeds + L - 1) / L;
+	int err = 0, k;
+
+	b = malloc(sizeof(*b));
+	if (!b || batch_alloc(b, w->gp->max_procs < 1 ? 1 : w->gp->max_procs)) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	while ((k = __atomic_fetch_add(&w->next_batch, 1, __ATOMIC_RELAXED)) < nr_batches) {
+		int first = k * L;
+		int nr = w->nr_seeds - first < L ? w->nr_seeds - first : L;
+
+		err = batch_load(b, w->gp, w->seeds + first, nr);
+		if (err)
+			break;
+		batch_simulate(b, w->par, w->kind);
+		memcpy(w->out + first, b->res, nr * sizeof(*b->res));
+	}
+out:
+	if (err)
+		__atomic_store_n(&w->err, err, __ATOMIC_RELAXED);
+	if (b)
+		batch_free(b);
+	free(b);
+	return NULL;
+}
+
+int sim_batch_run(const struct sim_gen_params *gp, const unsigned int *seeds, int nr_seeds,
+		  const struct sim_params *par, const struct sim_policy *pol,
+		  int nr_threads, struct sim_batch_result *out)
+{
+	struct batch_work w = {
+		.gp = gp, .seeds = seeds, .nr_seeds = nr_seeds,
+		.par = par, .out = out,
+	};
+	pthread_t *tids;
+	int nr_batches = (nr_seeds + L - 1) / L, started = 0;
+
+	if (pol == &sim_policy_fifo)
+		w.kind = BATCH_FIFO;
+	else if (pol == &sim_policy_rr)
+		w.kind = BATCH_RR;
+	else if (pol == &sim_policy_mlfq)
+		w.kind = BATCH_MLFQ;
+	else
+		return -EINVAL;
+	/* queue entries are int16_t */
+	if (gp->max_procs > INT16_MAX)
+		return -EINVAL;
+
+	if (nr_threads <= 0)
+		nr_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads > nr_batches)
+		nr_threads = nr_batches;
+	if (nr_threads <= 1) {
+		batch_worker(&w);
+		return w.err;
+	}
+
+	tids = calloc(nr_threads, sizeof(*tids));
+	if (!tids)
+		return -ENOMEM;
+	for (int i = 0; i < nr_threads; i++) {
+		if (pthread_create(&tids[i], NULL, batch_worker, &w))
+			break;
+		started++;
+	}
+	/* whatever started drains the remaining batches */
+	if (!started)
+		batch_worker(&w);
+	for (int i = 0; i < started; i++)
+		pthread_join(tids[i], NULL);
+	free(tids);
+	return w.err;
+}
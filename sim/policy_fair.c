@@ -0,0 +1,270 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * policy_fair.c - reference models of the kernel's fair class, used to
+ * compare the sched_ext policies against SCHED_OTHER.
+ *
+ * All jobs are nice 0, so weights cancel and vruntime advances 1:1 with
+ * CPU time. The tunables in sim_params are expected to be scaled already
+ * (the kernel multiplies them by 1 + ilog2(min(ncpus, 8))).
+ *
+ * cfs (pre-6.6 kernel/sched/fair.c):
+ *   - pick the runnable task with the smallest vruntime,
+ *   - new tasks are placed at min_vruntime + sched_vslice() (START_DEBIT),
+ *   - tick preemption (check_preempt_tick): once the task ran its ideal
+ *     slice, or ran min_granularity and is ideal_runtime ahead of the
+ *     leftmost task,
+ *   - wakeup preemption when curr->vruntime - p->vruntime > wakeup_gran.
+ *
+ * eevdf (6.6+):
+ *   - a task is eligible when its vruntime is not ahead of the average
+ *     vruntime V of the runnable tasks (lag >= 0),
+ *   - pick the eligible task with the earliest virtual deadline,
+ *   - deadline = vruntime + base_slice, renewed when the task reaches it,
+ *   - new tasks are placed with zero lag at V and half a slice
+ *     (PLACE_DEADLINE_INITIAL),
+ *   - RUN_TO_PARITY: the running task is not preempted by wakeups before
+ *     it reaches its deadline.
+ */
+#include "sim.h"
+
+static uint64_t min_u64(uint64_t a, uint64_t b)
+{
+	return a < b ? a : b;
+}
+
+static uint64_t max_u64(uint64_t a, uint64_t b)
+{
+	return a > b ? a : b;
+}
+
+static struct sim_task *fair_leftmost(struct sim *s)
+{
+	struct sim_task *best = NULL;
+
+	for (struct sim_task *t = s->q[0].head; t; t = t->next) {
+		if (!best || t->vruntime < best->vruntime)
+			best = t;
+	}
+	return best;
+}
+
+static void fair_update_min_vruntime(struct sim *s)
+{
+	struct sim_task *left = fair_leftmost(s);
+	uint64_t v;
+
+	if (s->curr && left)
+		v = min_u64(s->curr->vruntime, left->vruntime);
+	else if (s->curr)
+		v = s->curr->vruntime;
+	else if (left)
+		v = left->vruntime;
+	else
+		return;
+	s->min_vruntime = max_u64(s->min_vruntime, v);
+}
+
+static void fair_update_curr(struct sim *s, struct sim_task *t, uint64_t delta_ns)
+{
+	t->vruntime += delta_ns;
+	t->sum_exec_ns += delta_ns;
+	fair_update_min_vruntime(s);
+}
+
+static void fair_stopping(struct sim *s, struct sim_task *t, bool runnable)
+{
+	fair_update_min_vruntime(s);
+}
+
+/* cfs */
+
+static uint64_t cfs_period(const struct sim_params *par, int nr)
+{
+	uint64_t nr_latency = par->cfs_latency_ns / par->cfs_min_gran_ns;
+
+	if ((uint64_t)nr > nr_latency)
+		return (uint64_t)nr * par->cfs_min_gran_ns;
+	return par->cfs_latency_ns;
+}
+
+/* sched_slice() with equal weights */
+static uint64_t cfs_slice(struct sim *s)
+{
+	int nr = s->nr_runnable > 0 ? s->nr_runnable : 1;
+
+	return cfs_period(s->par, nr) / nr;
+}
+
+static void cfs_enqueue(struct sim *s, struct sim_task *t, unsigned int flags)
+{
+	if ((flags & SIM_ENQ_WAKEUP) && !t->started)
+		t->vruntime = s->min_vruntime + cfs_slice(s);	/* START_DEBIT */
+	sim_list_push_tail(&s->q[0], t);
+}
+
+static struct sim_task *cfs_pick_next(struct sim *s)
+{
+	struct sim_task *t = fair_leftmost(s);
+
+	if (t) {
+		sim_list_remove(&s->q[0], t);
+		t->prev_sum_exec_ns = t->sum_exec_ns;
+	}
+	return t;
+}
+
+static void cfs_running(struct sim *s, struct sim_task *t)
+{
+	t->slice_ns = cfs_slice(s);
+}
+
+static uint64_t cfs_runtime_left(struct sim *s, struct sim_task *curr)
+{
+	const struct sim_params *par = s->par;
+	uint64_t ideal, delta_exec, left;
+	struct sim_task *first;
+
+	if (s->nr_runnable <= 1)
+		return SIM_TIME_INF;
+
+	ideal = cfs_slice(s);
+	delta_exec = curr->sum_exec_ns - curr->prev_sum_exec_ns;
+	left = ideal > delta_exec ? ideal - delta_exec : 0;
+
+	/* ran min_granularity and is more than ideal ahead of the leftmost */
+	first = fair_leftmost(s);
+	if (first) {
+		uint64_t gran = par->cfs_min_gran_ns > delta_exec ?
+				par->cfs_min_gran_ns - delta_exec : 0;
+		uint64_t target = first->vruntime + ideal + 1;
+		uint64_t ahead = target > curr->vruntime ? target - curr->vruntime : 0;
+
+		left = min_u64(left, max_u64(gran, ahead));
+	}
+	return left;
+}
+
+static bool cfs_wakeup_preempt(struct sim *s, struct sim_task *curr, struct sim_task *p)
+{
+	return curr->vruntime > p->vruntime + s->par->cfs_wakeup_gran_ns;
+}
+
+const struct sim_policy sim_policy_cfs = {
+	.name		= "cfs",
+	.enqueue	= cfs_enqueue,
+	.pick_next	= cfs_pick_next,
+	.running	= cfs_running,
+	.stopping	= fair_stopping,
+	.update_curr	= fair_update_curr,
+	.runtime_left	= cfs_runtime_left,
+	.wakeup_preempt	= cfs_wakeup_preempt,
+};
+
+/* eevdf */
+
+/* sum and count of the vruntimes of all runnable tasks, curr included */
+static void eevdf_load(struct sim *s, unsigned __int128 *sum, uint64_t *nr)
+{
+	*sum = 0;
+	*nr = 0;
+	if (s->curr) {
+		*sum += s->curr->vruntime;
+		(*nr)++;
+	}
+	for (struct sim_task *t = s->q[0].head; t; t = t->next) {
+		*sum += t->vruntime;
+		(*nr)++;
+	}
+}
+
+/* vruntime <= V, without dividing */
+static bool eevdf_eligible(const struct sim_task *t, unsigned __int128 sum, uint64_t nr)
+{
+	return (unsigned __int128)t->vruntime * nr <= sum;
+}
+
+static struct sim_task *eevdf_best(struct sim *s, bool with_curr)
+{
+	struct sim_task *best = NULL;
+	unsigned __int128 sum;
+	uint64_t nr;
+
+	eevdf_load(s, &sum, &nr);
+	if (with_curr && s->curr && eevdf_eligible(s->curr, sum, nr))
+		best = s->curr;
+	for (struct sim_task *t = s->q[0].head; t; t = t->next) {
+		if (!eevdf_eligible(t, sum, nr))
+			continue;
+		if (!best || t->deadline < best->deadline)
+			best = t;
+	}
+	/* cannot happen with exact arithmetic, keep the model total anyway */
+	if (!best)
+		best = fair_leftmost(s);
+	return best;
+}
+
+static void eevdf_enqueue(struct sim *s, struct sim_task *t, unsigned int flags)
+{
+	if ((flags & SIM_ENQ_WAKEUP) && !t->started) {
+		unsigned __int128 sum;
+		uint64_t nr;
+
+		/* zero lag: place at the current average vruntime */
+		eevdf_load(s, &sum, &nr);
+		t->vruntime = nr ? (uint64_t)(sum / nr) : s->min_vruntime;
+		t->deadline = t->vruntime + s->par->eevdf_base_slice_ns / 2;
+	}
+	sim_list_push_tail(&s->q[0], t);
+}
+
+static struct sim_task *eevdf_pick_next(struct sim *s)
+{
+	struct sim_task *t;
+
+	if (!s->q[0].head)
+		return NULL;
+	t = eevdf_best(s, false);
+	sim_list_remove(&s->q[0], t);
+	t->prev_sum_exec_ns = t->sum_exec_ns;
+	t->protect = s->par->eevdf_run_to_parity;
+	return t;
+}
+
+static void eevdf_running(struct sim *s, struct sim_task *t)
+{
+	t->slice_ns = s->par->eevdf_base_slice_ns;
+}
+
+static void eevdf_stopping(struct sim *s, struct sim_task *t, bool runnable)
+{
+	/* update_deadline(): slice used up, request a new one */
+	if (runnable && t->vruntime >= t->deadline) {
+		t->deadline = t->vruntime + s->par->eevdf_base_slice_ns;
+		t->protect = false;
+	}
+	fair_update_min_vruntime(s);
+}
+
+static uint64_t eevdf_runtime_left(struct sim *s, struct sim_task *curr)
+{
+	return curr->deadline > curr->vruntime ? curr->deadline - curr->vruntime : 0;
+}
+
+static bool eevdf_wakeup_preempt(struct sim *s, struct sim_task *curr, struct sim_task *p)
+{
+	if (curr->protect)
+		return false;
+	return eevdf_best(s, true) == p;
+}
+
+const struct sim_policy sim_policy_eevdf = {
+	.name		= "eevdf",
+	.enqueue	= eevdf_enqueue,
+	.pick_next	= eevdf_pick_next,
+	.running	= eevdf_running,
+	.stopping	= eevdf_stopping,
+	.update_curr	= fair_update_curr,
+	.runtime_left	= eevdf_runtime_left,
+	.wakeup_preempt	= eevdf_wakeup_preempt,
+};
@@ -0,0 +1,151 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * policy_scx.c - models of the sched_ext policies in scheds/.
+ *
+ *   fifo: scx_fifo.bpf.c, one shared FIFO DSQ, SCX_SLICE_DFL slices.
+ *   rr:   the same queue with a configurable slice (rr_slice_ns).
+ *   mlfq: scx_mlfq.bpf.c, RR_DSQ (top) and FIFO_DSQ (bottom); a task is
+ *         demoted once it has run in the top queue; dispatch prefers RR_DSQ.
+ *         With mlfq_age_ns set, FIFO-level tasks that waited that long are
+ *         promoted back to the top queue (aging; the BPF scheduler has none).
+ *
+ * sched_ext only preempts on slice expiry (nothing kicks the CPU on
+ * enqueue), so none of these implement wakeup_preempt.
+ */
+#include "sim.h"
+
+enum {
+	LVL_RR		= 0,
+	LVL_FIFO	= 1,
+};
+
+static void scx_update_curr(struct sim *s, struct sim_task *t, uint64_t delta_ns)
+{
+	t->slice_used_ns += delta_ns;
+}
+
+static uint64_t scx_runtime_left(struct sim *s, struct sim_task *curr)
+{
+	return curr->slice_used_ns < curr->slice_ns ?
+	       curr->slice_ns - curr->slice_used_ns : 0;
+}
+
+static void scx_stopping_nop(struct sim *s, struct sim_task *t, bool runnable)
+{
+}
+
+/* fifo / rr: single shared DSQ */
+
+static void fifo_enqueue(struct sim *s, struct sim_task *t, unsigned int flags)
+{
+	sim_list_push_tail(&s->q[0], t);
+}
+
+static struct sim_task *fifo_pick_next(struct sim *s)
+{
+	return sim_list_pop_head(&s->q[0]);
+}
+
+static void fifo_running(struct sim *s, struct sim_task *t)
+{
+	t->slice_ns = s->par->dfl_slice_ns;
+	t->slice_used_ns = 0;
+}
+
+static void rr_running(struct sim *s, struct sim_task *t)
+{
+	t->slice_ns = s->par->rr_slice_ns;
+	t->slice_used_ns = 0;
+}
+
+const struct sim_policy sim_policy_fifo = {
+	.name		= "fifo",
+	.hard_slice	= true,
+	.enqueue	= fifo_enqueue,
+	.pick_next	= fifo_pick_next,
+	.running	= fifo_running,
+	.stopping	= scx_stopping_nop,
+	.update_curr	= scx_update_curr,
+	.runtime_left	= scx_runtime_left,
+};
+
+const struct sim_policy sim_policy_rr = {
+	.name		= "rr",
+	.hard_slice	= true,
+	.enqueue	= fifo_enqueue,
+	.pick_next	= fifo_pick_next,
+	.running	= rr_running,
+	.stopping	= scx_stopping_nop,
+	.update_curr	= scx_update_curr,
+	.runtime_left	= scx_runtime_left,
+};
+
+/* mlfq: two levels */
+
+static uint64_t mlfq_slice_for_level(struct sim *s, uint8_t lvl)
+{
+	return (lvl == LVL_RR) ? s->par->rr_slice_ns : s->par->fifo_slice_ns;
+}
+
+static void mlfq_enqueue(struct sim *s, struct sim_task *t, unsigned int flags)
+{
+	/* all tasks enter the top queue (mlfq_enable) */
+	if (flags & SIM_ENQ_WAKEUP && !t->started) {
+		t->level = LVL_RR;
+		t->ran_top = 0;
+	}
+	sim_list_push_tail(&s->q[t->level], t);
+}
+
+/* aging: FIFO_DSQ is in wait order, so only the head needs checking */
+static void mlfq_age(struct sim *s)
+{
+	struct sim_task *t;
+
+	while ((t = s->q[LVL_FIFO].head) &&
+	       s->now - t->last_run_ns >= s->par->mlfq_age_ns) {
+		sim_list_remove(&s->q[LVL_FIFO], t);
+		t->level = LVL_RR;
+		t->ran_top = 0;
+		sim_list_push_tail(&s->q[LVL_RR], t);
+	}
+}
+
+static struct sim_task *mlfq_pick_next(struct sim *s)
+{
+	struct sim_task *t;
+
+	if (s->par->mlfq_age_ns)
+		mlfq_age(s);
+
+	t = sim_list_pop_head(&s->q[LVL_RR]);
+	if (!t)
+		t = sim_list_pop_head(&s->q[LVL_FIFO]);
+	return t;
+}
+
+static void mlfq_running(struct sim *s, struct sim_task *t)
+{
+	if (t->level == LVL_RR && !t->ran_top)
+		t->ran_top = 1;
+	t->slice_ns = mlfq_slice_for_level(s, t->level);
+	t->slice_used_ns = 0;
+}
+
+static void mlfq_stopping(struct sim *s, struct sim_task *t, bool runnable)
+{
+	/* demote permanently after the first run in the top queue */
+	if (t->level == LVL_RR && t->ran_top)
+		t->level = LVL_FIFO;
+}
+
+const struct sim_policy sim_policy_mlfq = {
+	.name		= "mlfq",
+	.hard_slice	= true,
+	.enqueue	= mlfq_enqueue,
+	.pick_next	= mlfq_pick_next,
+	.running	= mlfq_running,
+	.stopping	= mlfq_stopping,
+	.update_curr	= scx_update_curr,
+	.runtime_left	= scx_runtime_left,
+};
@@ -0,0 +1,389 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * pyapi.c - flat C interface of bin/libschedsim.so for schedsim.py.
+ *
+ * Only plain arrays cross the boundary: the job list comes in as int64
+ * columns (numpy buffers, read in place), parameters as a uint64 vector
+ * in the order of schedsim_param_name(), and results go straight into
+ * caller-allocated columns laid out like the loadtest CSV.
+ *
+ * ctypes drops the GIL around every call, so schedsim_sweep() running a
+ * grid on its own threads does not block the interpreter.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+static const struct {
+	const char	*name;
+	size_t		off;
+	bool		is_bool;
+} params[] = {
+#define P(f)	{ #f, offsetof(struct sim_params, f), false }
+	P(tick_ns),
+	P(cs_ns),
+	P(dfl_slice_ns),
+	P(rr_slice_ns),
+	P(fifo_slice_ns),
+	P(mlfq_age_ns),
+	P(cfs_latency_ns),
+	P(cfs_min_gran_ns),
+	P(cfs_wakeup_gran_ns),
+	P(eevdf_base_slice_ns),
+#undef P
+	{ "eevdf_run_to_parity", offsetof(struct sim_params, eevdf_run_to_parity), true },
+};
+
+#define NR_PARAMS	((int)(sizeof(params) / sizeof(params[0])))
+
+/* per-point summary columns of schedsim_sweep() */
+enum {
+	SUM_MEAN_WAIT_NS,
+	SUM_P99_WAIT_NS,
+	SUM_MEAN_TAT_NS,
+	SUM_P99_TAT_NS,
+	SUM_MAKESPAN_NS,
+	SUM_SWITCHES,
+	SUM_WAKEUP_PREEMPT,
+	SUM_LOST,
+	NR_SUMMARY,
+};
+
+static const char *const summary_names[NR_SUMMARY] = {
+	"mean_wait_ns", "p99_wait_ns", "mean_tat_ns", "p99_tat_ns",
+	"makespan_ns", "switches", "wakeup_preempt", "lost",
+};
+
+/* CSV columns written by schedsim_run() */
+enum {
+	COL_PID,
+	COL_CHILD_INDEX,
+	COL_ARRIVE_NS,
+	COL_START_NS,
+	COL_END_NS,
+	COL_DURATION_NS,
+	COL_WORK_ITERS,
+	NR_COLS,
+};
+
+static const struct sim_policy *const policies[] = {
+	&sim_policy_fifo,
+	&sim_policy_rr,
+	&sim_policy_mlfq,
+	&sim_policy_cfs,
+	&sim_policy_eevdf,
+};
+
+#define NR_POLICIES	((int)(sizeof(policies) / sizeof(policies[0])))
+
+int schedsim_nr_params(void)
+{
+	return NR_PARAMS;
+}
+
+const char *schedsim_param_name(int i)
+{
+	return i >= 0 && i < NR_PARAMS ? params[i].name : NULL;
+}
+
+void schedsim_param_defaults(uint64_t *vals)
+{
+	struct sim_params par;
+
+	sim_params_default(&par);
+	for (int i = 0; i < NR_PARAMS; i++) {
+		const char *p = (const char *)&par + params[i].off;
+
+		vals[i] = params[i].is_bool ? *(const bool *)p : *(const uint64_t *)p;
+	}
+}
+
+int schedsim_nr_summary(void)
+{
+	return NR_SUMMARY;
+}
+
+const char *schedsim_summary_name(int i)
+{
+	return i >= 0 && i < NR_SUMMARY ? summary_names[i] : NULL;
+}
+
+int schedsim_nr_policies(void)
+{
+	return NR_POLICIES;
+}
+
+const char *schedsim_policy_name(int i)
+{
+	return i >= 0 && i < NR_POLICIES ? policies[i]->name : NULL;
+}
+
+/* Returns 0, or -EINVAL if sim_params_check() rejects the values. */
+static int params_from_vals(struct sim_params *par, const uint64_t *vals)
+{
+	sim_params_default(par);
+	for (int i = 0; i < NR_PARAMS; i++) {
+		char *p = (char *)par + params[i].off;
+
+		if (params[i].is_bool)
+			*(bool *)p = vals[i] != 0;
+		else
+			*(uint64_t *)p = vals[i];
+	}
+	return sim_params_check(par);
+}
+
+static int cmp_job_arrival(const void *a, const void *b)
+{
+	const struct sim_job *ja = a, *jb = b;
+
+	if (ja->arrive_ns != jb->arrive_ns)
+		return ja->arrive_ns < jb->arrive_ns ? -1 : 1;
+	return ja->id - jb->id;
+}
+
+/* sim_job list sorted by arrival; job.id is the row in the input columns */
+static struct sim_job *jobs_from_cols(const int64_t *arrive_ns, const int64_t *work_iters,
+				      long nr, double ns_per_iter)
+{
+	struct sim_job *jobs = calloc(nr > 0 ? nr : 1, sizeof(*jobs));
+
+	if (!jobs)
+		return NULL;
+	for (long i = 0; i < nr; i++) {
+		jobs[i].id = (int)i;
+		jobs[i].arrive_ns = arrive_ns[i] > 0 ? (uint64_t)arrive_ns[i] : 0;
+		jobs[i].work_iters = work_iters[i] > 0 ? (uint64_t)work_iters[i] : 0;
+		jobs[i].work_ns = (uint64_t)((double)jobs[i].work_iters * ns_per_iter);
+	}
+	qsort(jobs, nr, sizeof(*jobs), cmp_job_arrival);
+	return jobs;
+}
+
+/*
+ * Simulate one job list. child_index may be NULL (row number is used).
+ * cols[NR_COLS] receive pid, child_index, arrive_ns, start_ns, end_ns,
+ * duration_ns and work_iters per input row; a NULL column is skipped.
+ * Returns nr, or -errno.
+ */
+long schedsim_run(int policy, const uint64_t *vals, const int64_t *arrive_ns,
+		  const int64_t *work_iters, const int64_t *child_index, long nr,
+		  double ns_per_iter, int64_t *const *cols)
+{
+	struct sim_job_result *res;
+	struct sim_params par;
+	struct sim_job *jobs;
+
+	if (policy < 0 || policy >= NR_POLICIES || nr < 0 || nr > INT32_MAX)
+		return -EINVAL;
+	if (params_from_vals(&par, vals))
+		return -EINVAL;
+	jobs = jobs_from_cols(arrive_ns, work_iters, nr, ns_per_iter);
+	res = calloc(nr > 0 ? nr : 1, sizeof(*res));
+	if (!jobs || !res || sim_run(jobs, (int)nr, &par, policies[policy], res,
+				     NULL, NULL, NULL)) {
+		free(jobs);
+		free(res);
+		return -ENOMEM;
+	}
+
+	for (long k = 0; k < nr; k++) {
+		long row = jobs[k].id;
+		int64_t idx = child_index ? child_index[row] : row;
+		int64_t v[NR_COLS] = {
+			[COL_PID]		= idx + 1,
+			[COL_CHILD_INDEX]	= idx,
+			[COL_ARRIVE_NS]		= (int64_t)jobs[k].arrive_ns,
+			[COL_START_NS]		= (int64_t)res[k].start_ns,
+			[COL_END_NS]		= (int64_t)res[k].end_ns,
+			[COL_DURATION_NS]	= (int64_t)(res[k].end_ns - res[k].start_ns),
+			[COL_WORK_ITERS]	= (int64_t)jobs[k].work_iters,
+		};
+
+		for (int c = 0; c < NR_COLS; c++) {
+			if (cols[c])
+				cols[c][row] = v[c];
+		}
+	}
+	free(jobs);
+	free(res);
+	return nr;
+}
+
+/*
+ * Reproduce a generator's job list into caller columns of size cap.
+ * gen: 0 loadtest, 1 divided, 2 sleepmid. Returns the number of jobs
+ * (which may exceed cap: call again with a larger buffer), or -errno.
+ */
+long schedsim_generate(int gen, unsigned int seed, int max_procs, int max_start_delay_ms,
+		       int64_t min_iters, int64_t max_iters, int64_t *arrive_ns,
+		       int64_t *work_iters, int64_t *child_index, long cap)
+{
+	struct sim_gen_params gp = {
+		.gen = (enum sim_gen)gen,
+		.max_procs = max_procs,
+		.seed = seed,
+		.max_start_delay_ms = max_start_delay_ms,
+		.min_work_iters = min_iters > 0 ? (uint64_t)min_iters : 0,
+		.max_work_iters = max_iters > 0 ? (uint64_t)max_iters : 0,
+		.ns_per_iter = 1.0,
+	};
+	struct sim_job *jobs;
+	int nr = sim_jobs_generate(&gp, &jobs);
+
+	if (nr < 0)
+		return nr;
+	for (long i = 0; i < nr && i < cap; i++) {
+		arrive_ns[i] = (int64_t)jobs[i].arrive_ns;
+		work_iters[i] = (int64_t)jobs[i].work_iters;
+		child_index[i] = jobs[i].id;
+	}
+	free(jobs);
+	return nr;
+}
+
+struct sweep_work {
+	int			nr_points;
+	const int32_t		*point_policy;
+	const uint64_t		*point_vals;	/* nr_points x NR_PARAMS */
+	const struct sim_job	*jobs;
+	int			nr_jobs;
+	double			*summary;	/* nr_points x NR_SUMMARY */
+	int			next;		/* atomic */
+	int			err;
+};
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile (0 < p <= 1), as schedsim's pct_ms(). */
+static double pct(uint64_t *v, int n, double p)
+{
+	int rank;
+
+	if (n <= 0)
+		return 0.0;
+	qsort(v, n, sizeof(*v), cmp_u64);
+	rank = (int)(p * n);
+	if (rank < p * n)
+		rank++;
+	if (rank < 1)
+		rank = 1;
+	if (rank > n)
+		rank = n;
+	return (double)v[rank - 1];
+}
+
+static void *sweep_worker(void *arg)
+{
+	struct sweep_work *w = arg;
+	int n = w->nr_jobs, k;
+	struct sim_job_result *res = calloc(n > 0 ? n : 1, sizeof(*res));
+	uint64_t *wait = calloc(n > 0 ? n : 1, sizeof(*wait));
+	uint64_t *tat = calloc(n > 0 ? n : 1, sizeof(*tat));
+
+	if (!res || !wait || !tat) {
+		__atomic_store_n(&w->err, -ENOMEM, __ATOMIC_RELAXED);
+		goto out;
+	}
+
+	while ((k = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED)) < w->nr_points) {
+		double *out = w->summary + (size_t)k * NR_SUMMARY;
+		int pol = w->point_policy[k], done = 0;
+		double sum_wait = 0, sum_tat = 0;
+		struct sim_params par;
+		struct sim_stats st;
+
+		memset(out, 0, NR_SUMMARY * sizeof(*out));
+		if (pol < 0 || pol >= NR_POLICIES) {
+			__atomic_store_n(&w->err, -EINVAL, __ATOMIC_RELAXED);
+			continue;
+		}
+		if (params_from_vals(&par, w->point_vals + (size_t)k * NR_PARAMS)) {
+			__atomic_store_n(&w->err, -EINVAL, __ATOMIC_RELAXED);
+			continue;
+		}
+		if (sim_run(w->jobs, n, &par, policies[pol], res, NULL, NULL, &st)) {
+			__atomic_store_n(&w->err, -ENOMEM, __ATOMIC_RELAXED);
+			continue;
+		}
+		for (int i = 0; i < n; i++) {
+			if (!res[i].end_ns)
+				continue;
+			wait[done] = res[i].start_ns - w->jobs[i].arrive_ns;
+			tat[done] = res[i].end_ns - w->jobs[i].arrive_ns;
+			sum_wait += wait[done];
+			sum_tat += tat[done];
+			done++;
+		}
+		out[SUM_MEAN_WAIT_NS] = done ? sum_wait / done : 0.0;
+		out[SUM_P99_WAIT_NS] = pct(wait, done, 0.99);
+		out[SUM_MEAN_TAT_NS] = done ? sum_tat / done : 0.0;
+		out[SUM_P99_TAT_NS] = pct(tat, done, 0.99);
+		out[SUM_MAKESPAN_NS] = (double)st.makespan_ns;
+		out[SUM_SWITCHES] = (double)st.nr_switches;
+		out[SUM_WAKEUP_PREEMPT] = (double)st.nr_wakeup_preempt;
+		out[SUM_LOST] = n - done;
+	}
+out:
+	free(res);
+	free(wait);
+	free(tat);
+	return NULL;
+}
+
+/*
+ * Simulate one job list under nr_points (policy, params) combinations on
+ * nr_threads threads (0 = online cpus). summary receives NR_SUMMARY values
+ * per point. Returns 0 or -errno.
+ */
+int schedsim_sweep(int nr_points, const int32_t *point_policy, const uint64_t *point_vals,
+		   const int64_t *arrive_ns, const int64_t *work_iters, long nr,
+		   double ns_per_iter, int nr_threads, double *summary)
+{
+	struct sweep_work w = {
+		.nr_points = nr_points, .point_policy = point_policy,
+		.point_vals = point_vals, .nr_jobs = (int)nr, .summary = summary,
+	};
+	struct sim_job *jobs;
+	pthread_t *tids;
+	int started = 0;
+
+	if (nr < 0 || nr > INT32_MAX || nr_points < 0)
+		return -EINVAL;
+	jobs = jobs_from_cols(arrive_ns, work_iters, nr, ns_per_iter);
+	if (!jobs)
+		return -ENOMEM;
+	w.jobs = jobs;
+
+	if (nr_threads <= 0)
+		nr_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads > nr_points)
+		nr_threads = nr_points;
+	tids = calloc(nr_threads > 0 ? nr_threads : 1, sizeof(*tids));
+	if (!tids) {
+		free(jobs);
+		return -ENOMEM;
+	}
+	for (int i = 1; i < nr_threads; i++) {
+		if (pthread_create(&tids[i], NULL, sweep_worker, &w))
+			break;
+		started++;
+	}
+	sweep_worker(&w);	/* the calling thread takes points too */
+	for (int i = 1; i <= started; i++)
+		pthread_join(tids[i], NULL);
+
+	free(tids);
+	free(jobs);
+	return w.err;
+}
@@ -0,0 +1,450 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * schedsim - offline what-if runs of the scheds/ policies and of the
+ * kernel's fair class on the job lists produced by the load generators.
+ *
+ * Build:
+ *   make sim
+ *
+ * Example runs:
+ *   # same jobs as "make run_fifo" (seed 2), all policies
+ *   ./bin/schedsim -m 20 -s 2 -d 10 -w 1000000 -W 5000000 -p fifo,mlfq,cfs,eevdf
+ *
+ *   # replay a recorded log under MLFQ and write a loadtest-style CSV
+ *   ./bin/schedsim -i log/out.csv -p mlfq -o log/sim_mlfq.csv
+ *
+ *   # check the CFS/EEVDF models against a SCHED_OTHER run (loadtest -n)
+ *   ./bin/schedsim -V log/sched_other.csv -p cfs,eevdf
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#define MAX_POLICIES 8
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-p POLICIES] [-g GEN] [-m max_procs] [-s seed] [-d max_start_delay_ms]\n"
+		"          [-w min_iters] [-W max_iters] [-i log.csv] [-k ns_per_iter]\n"
+		"          [-t tick_us] [-x cs_ns] [-r rr_slice_ms] [-f fifo_slice_ms]\n"
+		"          [-F factor] [-E] [-o out.csv] [-S] [-V measured.csv]\n\n"
+		"  -p POLICIES   Comma separated: fifo,rr,mlfq,cfs,eevdf (default: fifo,mlfq)\n"
+		"  -g GEN        Job list of loadtest, divided or sleepmid (default: loadtest)\n"
+		"  -m/-s/-d/-w/-W  Generator parameters, as for the loadtest binaries\n"
+		"  -i log.csv    Take the job list from a recorded log instead\n"
+		"  -k NS         CPU time per work iteration (default: 3.0, or calibrated from -V)\n"
+		"  -t US         Scheduler tick in microseconds, 0 = exact slices (default: 4000)\n"
+		"  -x NS         Context switch cost (default: 0)\n"
+		"  -r/-f MS      scx_mlfq RR and FIFO slices (default: 50 / 200); -r is also the rr slice\n"
+		"  -F FACTOR     CFS/EEVDF tunable scaling (default: 1 + ilog2(min(online cpus, 8)))\n"
+		"  -E            EEVDF without RUN_TO_PARITY\n"
+		"  -o out.csv    Write the simulated log (single policy only)\n"
+		"  -S            With -o, write one row per CPU segment (like loadtest_divided)\n"
+		"  -V log.csv    Replay a measured run and report the per-job model error\n",
+		prog);
+}
+
+struct job_stat {
+	int		id;
+	uint64_t	arrive_ns;
+	uint64_t	start_ns;
+	uint64_t	end_ns;
+	uint64_t	busy_ns;
+	uint64_t	work_iters;
+};
+
+/* Per-child view of a measured log (first run only). */
+static int load_measured(const char *path, struct job_stat **out)
+{
+	struct job_stat *js = NULL;
+	int nr = 0, cap = 0, headers = 0;
+	char line[512];
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long long arrive, start, end, dur, iters;
+		int pid, idx, j;
+
+		if (!strncmp(line, "pid,", 4)) {
+			if (headers++)
+				break;
+			continue;
+		}
+		if (sscanf(line, "%d,%d,%llu,%llu,%llu,%llu,%llu",
+			   &pid, &idx, &arrive, &start, &end, &dur, &iters) != 7)
+			continue;
+		for (j = 0; j < nr; j++) {
+			if (js[j].id == idx)
+				break;
+		}
+		if (j == nr) {
+			if (nr == cap) {
+				struct job_stat *n;
+
+				cap = cap ? cap * 2 : 64;
+				n = realloc(js, cap * sizeof(*js));
+				if (!n) {
+					free(js);
+					fclose(f);
+					return -ENOMEM;
+				}
+				js = n;
+			}
+			js[nr] = (struct job_stat){ .id = idx, .arrive_ns = arrive,
+						    .start_ns = start, .end_ns = end };
+			nr++;
+		}
+		if (arrive < js[j].arrive_ns)
+			js[j].arrive_ns = arrive;
+		if (start < js[j].start_ns)
+			js[j].start_ns = start;
+		if (end > js[j].end_ns)
+			js[j].end_ns = end;
+		js[j].busy_ns += dur;
+		js[j].work_iters += iters;
+	}
+	fclose(f);
+	*out = js;
+	return nr;
+}
+
+/*
+ * CPU cost of one iteration: the least disturbed job (smallest busy time
+ * per iteration) is the best estimate of uncontended speed.
+ */
+static double calibrate_ns_per_iter(const struct job_stat *js, int nr)
+{
+	double best = 0.0;
+
+	for (int i = 0; i < nr; i++) {
+		double v;
+
+		if (!js[i].work_iters || !js[i].busy_ns)
+			continue;
+		v = (double)js[i].busy_ns / (double)js[i].work_iters;
+		if (best == 0.0 || v < best)
+			best = v;
+	}
+	return best;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile (0 < p <= 1), as loadtest_loop.h lt_pct(). */
+static double pct_ms(uint64_t *v, int n, double p)
+{
+	int rank;
+
+	if (n <= 0)
+		return 0.0;
+	qsort(v, n, sizeof(*v), cmp_u64);
+	rank = (int)(p * n);
+	if (rank < p * n)
+		rank++;
+	if (rank < 1)
+		rank = 1;
+	if (rank > n)
+		rank = n;
+	return (double)v[rank - 1] / 1e6;
+}
+
+static void print_summary(const char *name, const struct sim_job *jobs, int nr,
+			  const struct sim_job_result *res, const struct sim_stats *st)
+{
+	uint64_t *wait = calloc(nr ? nr : 1, sizeof(*wait));
+	uint64_t *tat = calloc(nr ? nr : 1, sizeof(*tat));
+	double sum_wait = 0, sum_tat = 0;
+	int done = 0;
+
+	if (!wait || !tat) {
+		free(wait);
+		free(tat);
+		return;
+	}
+	/* lost jobs have no latency: leave them out and report them apart */
+	for (int i = 0; i < nr; i++) {
+		if (!res[i].end_ns)
+			continue;
+		wait[done] = res[i].start_ns - jobs[i].arrive_ns;
+		tat[done] = res[i].end_ns - jobs[i].arrive_ns;
+		sum_wait += wait[done];
+		sum_tat += tat[done];
+		done++;
+	}
+	printf("%-6s %5d %12.3f %12.3f %12.3f %12.3f %12.3f %9llu %9llu",
+	       name, nr,
+	       done ? sum_wait / done / 1e6 : 0.0, pct_ms(wait, done, 0.99),
+	       done ? sum_tat / done / 1e6 : 0.0, pct_ms(tat, done, 0.99),
+	       (double)st->makespan_ns / 1e6,
+	       (unsigned long long)st->nr_switches,
+	       (unsigned long long)st->nr_wakeup_preempt);
+	if (done < nr)
+		printf("  (%d lost jobs!)", nr - done);
+	printf("\n");
+	free(wait);
+	free(tat);
+}
+
+static void print_header(void)
+{
+	printf("%-6s %5s %12s %12s %12s %12s %12s %9s %9s\n",
+	       "policy", "jobs", "wait(ms)", "p99wait(ms)", "tat(ms)",
+	       "p99tat(ms)", "makespan", "switches", "wakepre");
+}
+
+/* Mean absolute per-job error of the model vs the measured run. */
+static void print_validation(const char *name, const struct sim_job *jobs, int nr,
+			     const struct sim_job_result *res,
+			     const struct job_stat *js, int nr_meas)
+{
+	double err_wait = 0, err_tat = 0, sum_tat = 0;
+	int n = 0;
+
+	for (int i = 0; i < nr; i++) {
+		for (int j = 0; j < nr_meas; j++) {
+			double mw, mt, sw, st;
+
+			if (js[j].id != jobs[i].id)
+				continue;
+			mw = (double)(js[j].start_ns - js[j].arrive_ns);
+			mt = (double)(js[j].end_ns - js[j].arrive_ns);
+			sw = (double)(res[i].start_ns - jobs[i].arrive_ns);
+			st = (double)(res[i].end_ns - jobs[i].arrive_ns);
+			err_wait += mw > sw ? mw - sw : sw - mw;
+			err_tat += mt > st ? mt - st : st - mt;
+			sum_tat += mt;
+			n++;
+			break;
+		}
+	}
+	if (!n)
+		return;
+	printf("  %-6s vs measured: %d jobs, wait MAE %.3f ms, turnaround MAE %.3f ms (%.1f%% of mean)\n",
+	       name, n, err_wait / n / 1e6, err_tat / n / 1e6,
+	       sum_tat > 0 ? 100.0 * err_tat / sum_tat : 0.0);
+}
+
+struct csv_out {
+	FILE			*f;
+	const struct sim_job	*jobs;
+	double			ns_per_iter;
+};
+
+static void csv_segment(void *ctx, const struct sim_segment *seg)
+{
+	struct csv_out *o = ctx;
+	const struct sim_job *j = &o->jobs[seg->job];
+	uint64_t dur = seg->end_ns - seg->start_ns;
+	uint64_t iters = o->ns_per_iter > 0 ? (uint64_t)((double)dur / o->ns_per_iter) : 0;
+
+	fprintf(o->f, "%d,%d,%llu,%llu,%llu,%llu,%llu\n",
+		j->id + 1, j->id,
+		(unsigned long long)j->arrive_ns,
+		(unsigned long long)seg->start_ns,
+		(unsigned long long)seg->end_ns,
+		(unsigned long long)dur,
+		(unsigned long long)iters);
+}
+
+static void write_csv(FILE *f, const struct sim_job *jobs, int nr,
+		      const struct sim_job_result *res)
+{
+	for (int i = 0; i < nr; i++) {
+		fprintf(f, "%d,%d,%llu,%llu,%llu,%llu,%llu\n",
+			jobs[i].id + 1, jobs[i].id,
+			(unsigned long long)jobs[i].arrive_ns,
+			(unsigned long long)res[i].start_ns,
+			(unsigned long long)res[i].end_ns,
+			(unsigned long long)(res[i].end_ns - res[i].start_ns),
+			(unsigned long long)jobs[i].work_iters);
+	}
+}
+
+/* kernel: SCHED_TUNABLESCALING_LOG over min(online cpus, 8) */
+static unsigned int default_factor(void)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int factor = 1;
+
+	if (ncpus > 8)
+		ncpus = 8;
+	while (ncpus > 1) {
+		ncpus >>= 1;
+		factor++;
+	}
+	return factor;
+}
+
+int main(int argc, char **argv)
+{
+	struct sim_gen_params gp = {
+		.gen = SIM_GEN_LOADTEST,
+		.max_procs = 20,
+		.seed = 2,
+		.max_start_delay_ms = 10,
+		.min_work_iters = 1000000ULL,
+		.max_work_iters = 5000000ULL,
+		.ns_per_iter = 0.0,
+	};
+	const struct sim_policy *pols[MAX_POLICIES];
+	const char *policies = "fifo,mlfq";
+	const char *input = NULL, *out_path = NULL, *measured = NULL;
+	struct job_stat *js = NULL;
+	struct sim_params par;
+	struct sim_job *jobs = NULL;
+	struct sim_job_result *res;
+	unsigned int factor = default_factor();
+	bool segments = false;
+	int nr_pols = 0, nr, nr_meas = 0, opt;
+	char *list, *tok, *save = NULL;
+
+	sim_params_default(&par);
+
+	while ((opt = getopt(argc, argv, "p:g:m:s:d:w:W:i:k:t:x:r:f:F:Eo:SV:h")) != -1) {
+		switch (opt) {
+		case 'p': policies = optarg; break;
+		case 'g':
+			if (!strcmp(optarg, "loadtest"))
+				gp.gen = SIM_GEN_LOADTEST;
+			else if (!strcmp(optarg, "divided"))
+				gp.gen = SIM_GEN_DIVIDED;
+			else if (!strcmp(optarg, "sleepmid"))
+				gp.gen = SIM_GEN_SLEEPMID;
+			else {
+				fprintf(stderr, "Unknown generator: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'm': gp.max_procs = atoi(optarg); break;
+		case 's': gp.seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+		case 'd': gp.max_start_delay_ms = atoi(optarg); break;
+		case 'w': gp.min_work_iters = strtoull(optarg, NULL, 10); break;
+		case 'W': gp.max_work_iters = strtoull(optarg, NULL, 10); break;
+		case 'i': input = optarg; break;
+		case 'k': gp.ns_per_iter = strtod(optarg, NULL); break;
+		case 't': par.tick_ns = strtoull(optarg, NULL, 10) * 1000ULL; break;
+		case 'x': par.cs_ns = strtoull(optarg, NULL, 10); break;
+		case 'r': par.rr_slice_ns = strtoull(optarg, NULL, 10) * SIM_NS_PER_MS; break;
+		case 'f': par.fifo_slice_ns = strtoull(optarg, NULL, 10) * SIM_NS_PER_MS; break;
+		case 'F': factor = (unsigned int)strtoul(optarg, NULL, 10); break;
+		case 'E': par.eevdf_run_to_parity = false; break;
+		case 'o': out_path = optarg; break;
+		case 'S': segments = true; break;
+		case 'V': measured = optarg; break;
+		default:
+			usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+
+	if (sim_params_check(&par)) {
+		fprintf(stderr, "-r and -f must be at least 1 ms\n");
+		return 1;
+	}
+	if (!factor)
+		factor = 1;
+	par.cfs_latency_ns *= factor;
+	par.cfs_min_gran_ns *= factor;
+	par.cfs_wakeup_gran_ns *= factor;
+	par.eevdf_base_slice_ns *= factor;
+
+	list = strdup(policies);
+	for (tok = strtok_r(list, ",", &save); tok && nr_pols < MAX_POLICIES;
+	     tok = strtok_r(NULL, ",", &save)) {
+		pols[nr_pols] = sim_policy_find(tok);
+		if (!pols[nr_pols]) {
+			fprintf(stderr, "Unknown policy: %s\n", tok);
+			free(list);
+			return 1;
+		}
+		nr_pols++;
+	}
+	free(list);
+	if (out_path && nr_pols != 1) {
+		fprintf(stderr, "-o needs exactly one policy\n");
+		return 1;
+	}
+
+	if (measured) {
+		nr_meas = load_measured(measured, &js);
+		if (nr_meas <= 0) {
+			fprintf(stderr, "No jobs in %s\n", measured);
+			return 1;
+		}
+		if (gp.ns_per_iter <= 0.0)
+			gp.ns_per_iter = calibrate_ns_per_iter(js, nr_meas);
+		if (!input)
+			input = measured;
+	}
+	if (gp.ns_per_iter <= 0.0)
+		gp.ns_per_iter = 3.0;
+
+	if (input)
+		nr = sim_jobs_load_csv(input, gp.ns_per_iter, &jobs);
+	else
+		nr = sim_jobs_generate(&gp, &jobs);
+	if (nr < 0) {
+		fprintf(stderr, "Failed to build job list: %s\n", strerror(-nr));
+		return 1;
+	}
+
+	res = calloc(nr ? nr : 1, sizeof(*res));
+	if (!res) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	printf("schedsim: %d jobs (%s), ns_per_iter=%.3f tick=%lluus fair_factor=%u\n",
+	       nr, input ? input : "generated", gp.ns_per_iter,
+	       (unsigned long long)(par.tick_ns / 1000), factor);
+	print_header();
+
+	for (int p = 0; p < nr_pols; p++) {
+		struct csv_out co = { .jobs = jobs, .ns_per_iter = gp.ns_per_iter };
+		struct sim_stats st;
+		FILE *f = NULL;
+
+		if (out_path) {
+			f = fopen(out_path, "w");
+			if (!f) {
+				fprintf(stderr, "open(%s): %s\n", out_path, strerror(errno));
+				return 1;
+			}
+			fputs("pid,child_index,arrive_ns,start_ns,end_ns,duration_ns,work_iters\n", f);
+			co.f = f;
+		}
+
+		if (sim_run(jobs, nr, &par, pols[p], res,
+			    (f && segments) ? csv_segment : NULL, &co, &st)) {
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+		print_summary(pols[p]->name, jobs, nr, res, &st);
+		if (measured)
+			print_validation(pols[p]->name, jobs, nr, res, js, nr_meas);
+
+		if (f) {
+			if (!segments)
+				write_csv(f, jobs, nr, res);
+			fclose(f);
+		}
+	}
+
+	free(res);
+	free(jobs);
+	free(js);
+	return 0;
+}
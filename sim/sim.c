@@ -0,0 +1,405 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * sim.c - event loop, job lists and helpers of the offline scheduler model.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+void sim_list_push_tail(struct sim_list *l, struct sim_task *t)
+{
+	t->next = NULL;
+	t->prev = l->tail;
+	if (l->tail)
+		l->tail->next = t;
+	else
+		l->head = t;
+	l->tail = t;
+	l->nr++;
+	t->queued = true;
+}
+
+void sim_list_remove(struct sim_list *l, struct sim_task *t)
+{
+	if (t->prev)
+		t->prev->next = t->next;
+	else
+		l->head = t->next;
+	if (t->next)
+		t->next->prev = t->prev;
+	else
+		l->tail = t->prev;
+	t->next = t->prev = NULL;
+	l->nr--;
+	t->queued = false;
+}
+
+struct sim_task *sim_list_pop_head(struct sim_list *l)
+{
+	struct sim_task *t = l->head;
+
+	if (t)
+		sim_list_remove(l, t);
+	return t;
+}
+
+void sim_params_default(struct sim_params *par)
+{
+	memset(par, 0, sizeof(*par));
+	par->tick_ns = 4 * SIM_NS_PER_MS;		/* HZ=250 */
+	par->cs_ns = 0;
+	par->dfl_slice_ns = 20 * SIM_NS_PER_MS;		/* SCX_SLICE_DFL */
+	par->rr_slice_ns = 50 * SIM_NS_PER_MS;		/* scx_mlfq defaults */
+	par->fifo_slice_ns = 200 * SIM_NS_PER_MS;
+	/* CFS/EEVDF values before the (1 + ilog2(ncpus)) scaling */
+	par->cfs_latency_ns = 6 * SIM_NS_PER_MS;
+	par->cfs_min_gran_ns = 750000ULL;
+	par->cfs_wakeup_gran_ns = 1 * SIM_NS_PER_MS;
+	par->eevdf_base_slice_ns = 750000ULL;
+	par->eevdf_run_to_parity = true;
+}
+
+/*
+ * A zero slice expires the moment it starts; sim_run() then crawls along
+ * 1ns per segment. Callers reject it up front. Returns 0 or -EINVAL.
+ */
+int sim_params_check(const struct sim_params *par)
+{
+	if (!par->dfl_slice_ns || !par->rr_slice_ns || !par->fifo_slice_ns)
+		return -EINVAL;
+	return 0;
+}
+
+static const struct sim_policy *const all_policies[] = {
+	&sim_policy_fifo,
+	&sim_policy_rr,
+	&sim_policy_mlfq,
+	&sim_policy_cfs,
+	&sim_policy_eevdf,
+};
+
+const struct sim_policy *sim_policy_find(const char *name)
+{
+	for (size_t i = 0; i < sizeof(all_policies) / sizeof(all_policies[0]); i++) {
+		if (!strcmp(all_policies[i]->name, name))
+			return all_policies[i];
+	}
+	return NULL;
+}
+
+static void emit_segment(struct sim *s, struct sim_task *t, bool done)
+{
+	struct sim_segment seg;
+
+	if (!s->trace || s->now == t->seg_start_ns)
+		return;
+	seg.job = t->idx;
+	seg.start_ns = t->seg_start_ns;
+	seg.end_ns = s->now;
+	seg.slice_ns = t->slice_ns;
+	seg.level = t->level;
+	seg.done = done;
+	s->trace(s->trace_ctx, &seg);
+}
+
+/* curr leaves the CPU but stays runnable */
+static void put_prev(struct sim *s)
+{
+	struct sim_task *t = s->curr;
+
+	emit_segment(s, t, false);
+	s->pol->stopping(s, t, true);
+	t->last_run_ns = s->now;
+	s->curr = NULL;
+	s->pol->enqueue(s, t, 0);
+}
+
+static uint64_t tick_roundup(uint64_t t, uint64_t tick_ns)
+{
+	if (!tick_ns)
+		return t;
+	return (t + tick_ns - 1) / tick_ns * tick_ns;
+}
+
+int sim_run(const struct sim_job *jobs, int nr_jobs, const struct sim_params *par,
+	    const struct sim_policy *pol, struct sim_job_result *res,
+	    sim_trace_fn trace, void *trace_ctx, struct sim_stats *stats)
+{
+	struct sim s;
+	struct sim_task *last = NULL;
+	int next = 0, done = 0;
+
+	memset(&s, 0, sizeof(s));
+	s.par = par;
+	s.pol = pol;
+	s.trace = trace;
+	s.trace_ctx = trace_ctx;
+	s.nr_tasks = nr_jobs;
+	s.tasks = calloc(nr_jobs > 0 ? nr_jobs : 1, sizeof(*s.tasks));
+	if (!s.tasks)
+		return -ENOMEM;
+
+	for (int i = 0; i < nr_jobs; i++) {
+		s.tasks[i].idx = i;
+		s.tasks[i].job = &jobs[i];
+		s.tasks[i].remaining_ns = jobs[i].work_ns ? jobs[i].work_ns : 1;
+		memset(&res[i], 0, sizeof(res[i]));
+	}
+	if (pol->init)
+		pol->init(&s);
+
+	while (done < nr_jobs) {
+		struct sim_task *curr;
+		uint64_t left, run;
+		bool expire = false;
+
+		/* release arrivals */
+		while (next < nr_jobs && jobs[next].arrive_ns <= s.now) {
+			struct sim_task *t = &s.tasks[next++];
+
+			t->last_run_ns = t->job->arrive_ns;
+			s.nr_runnable++;
+			pol->enqueue(&s, t, SIM_ENQ_WAKEUP);
+			if (s.curr && pol->wakeup_preempt &&
+			    pol->wakeup_preempt(&s, s.curr, t)) {
+				s.stats.nr_wakeup_preempt++;
+				put_prev(&s);
+			}
+		}
+
+		if (!s.curr) {
+			struct sim_task *t = pol->pick_next(&s);
+
+			if (!t) {
+				if (next >= nr_jobs)
+					break;	/* lost tasks; caller sees end_ns == 0 */
+				s.now = jobs[next].arrive_ns;
+				continue;
+			}
+			if (last != t) {
+				s.stats.nr_switches++;
+				s.now += par->cs_ns;
+			}
+			if (!t->started) {
+				t->started = true;
+				res[t->idx].start_ns = s.now;
+			}
+			res[t->idx].nr_runs++;
+			t->seg_start_ns = s.now;
+			s.curr = t;
+			last = t;
+			pol->running(&s, t);
+		}
+		curr = s.curr;
+
+		/* next decision point: completion, slice expiry or arrival */
+		run = curr->remaining_ns;
+		left = pol->runtime_left(&s, curr);
+		if (left < run) {
+			/* run at least 1ns, so a used-up slice still moves time */
+			uint64_t end = tick_roundup(s.now + (left ? left : 1), par->tick_ns);
+
+			if (end - s.now < run) {
+				run = end - s.now;
+				expire = true;
+			}
+		}
+		if (next < nr_jobs && jobs[next].arrive_ns < s.now + run) {
+			/* may already be due when a switch cost pushed now past it */
+			run = jobs[next].arrive_ns > s.now ? jobs[next].arrive_ns - s.now : 0;
+			expire = false;
+		}
+
+		s.now += run;
+		s.stats.busy_ns += run;
+		curr->remaining_ns -= run;
+		pol->update_curr(&s, curr, run);
+
+		if (!curr->remaining_ns) {
+			emit_segment(&s, curr, true);
+			res[curr->idx].end_ns = s.now;
+			res[curr->idx].level = curr->level;
+			pol->stopping(&s, curr, false);
+			s.curr = NULL;
+			s.nr_runnable--;
+			done++;
+		} else if (expire) {
+			put_prev(&s);
+		}
+	}
+
+	s.stats.makespan_ns = s.now;
+	if (stats)
+		*stats = s.stats;
+	free(s.tasks);
+	return 0;
+}
+
+static int cmp_job_arrival(const void *a, const void *b)
+{
+	const struct sim_job *ja = a, *jb = b;
+
+	if (ja->arrive_ns != jb->arrive_ns)
+		return ja->arrive_ns < jb->arrive_ns ? -1 : 1;
+	return ja->id - jb->id;
+}
+
+static int gen_rand(struct random_data *rd)
+{
+	int32_t r;
+
+	random_r(rd, &r);
+	return r;
+}
+
+/*
+ * The generators use srand(seed)/rand(), and fork() copies the RNG state,
+ * so a child's first rand() returns the value the parent draws next. The
+ * job list is rebuilt here from the same libc sequence. glibc's rand() is
+ * random() on a TYPE_3 state; a private random_r() state of the same size
+ * yields the same numbers and keeps this callable from several threads.
+ */
+int sim_jobs_generate(const struct sim_gen_params *gp, struct sim_job **out)
+{
+	uint64_t min_iters = gp->min_work_iters ? gp->min_work_iters : 1;
+	uint64_t max_iters = gp->max_work_iters < min_iters ? min_iters : gp->max_work_iters;
+	int d = gp->max_start_delay_ms;
+	int max_procs = gp->max_procs < 1 ? 1 : gp->max_procs;
+	struct random_data rd;
+	char rstate[128];
+	struct sim_job *jobs;
+	uint64_t clock_ms = 0;
+	int nprocs;
+
+	memset(&rd, 0, sizeof(rd));
+	initstate_r(gp->seed, rstate, sizeof(rstate), &rd);
+	nprocs = 1 + (gen_rand(&rd) % max_procs);
+	jobs = calloc(nprocs, sizeof(*jobs));
+	if (!jobs)
+		return -ENOMEM;
+
+	/* loadtest_sleepmid: every child draws from the same post-fork state */
+	int shared_delay = 0, shared_r = 0;
+	if (gp->gen == SIM_GEN_SLEEPMID) {
+		shared_delay = (d > 0) ? (gen_rand(&rd) % (d + 1)) : 0;
+		shared_r = gen_rand(&rd);
+	}
+
+	/* lookahead: the child's rand() is the parent's next draw */
+	int peek = gen_rand(&rd);
+
+	for (int i = 0; i < nprocs; i++) {
+		uint64_t iters = min_iters;
+		int delay_ms, r;
+
+		switch (gp->gen) {
+		case SIM_GEN_SLEEPMID:
+			delay_ms = shared_delay;
+			r = shared_r;
+			jobs[i].arrive_ns = (uint64_t)delay_ms * SIM_NS_PER_MS;
+			break;
+		case SIM_GEN_DIVIDED:
+			/* parent draws both delay and work before forking */
+			delay_ms = 0;
+			if (d > 0) {
+				delay_ms = peek % (d + 1);
+				peek = gen_rand(&rd);
+			}
+			r = peek;
+			if (max_iters > min_iters)
+				peek = gen_rand(&rd);
+			clock_ms += delay_ms;
+			jobs[i].arrive_ns = clock_ms * SIM_NS_PER_MS;
+			break;
+		case SIM_GEN_LOADTEST:
+		default:
+			delay_ms = 0;
+			if (d > 0) {
+				delay_ms = peek % (d + 1);
+				peek = gen_rand(&rd);
+			}
+			r = peek;	/* child: rand() after fork, parent state unchanged */
+			clock_ms += delay_ms;
+			jobs[i].arrive_ns = clock_ms * SIM_NS_PER_MS;
+			break;
+		}
+
+		if (max_iters > min_iters)
+			iters = min_iters + (uint64_t)(r % (1 + (int)(max_iters - min_iters)));
+		jobs[i].id = i;
+		jobs[i].work_iters = iters;
+		jobs[i].work_ns = (uint64_t)((double)iters * gp->ns_per_iter);
+	}
+
+	qsort(jobs, nprocs, sizeof(*jobs), cmp_job_arrival);
+	*out = jobs;
+	return nprocs;
+}
+
+/*
+ * One job per child_index of the first run in the log. Microslice logs
+ * (loadtest_divided) have several rows per child: the work is summed and
+ * the arrival is the earliest arrive_ns.
+ */
+int sim_jobs_load_csv(const char *path, double ns_per_iter, struct sim_job **out)
+{
+	struct sim_job *jobs = NULL;
+	int nr = 0, cap = 0, headers = 0;
+	char line[512];
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long long arrive, start, end, dur, iters;
+		int pid, idx, j;
+
+		if (!strncmp(line, "pid,", 4)) {
+			if (headers++)
+				break;	/* next run */
+			continue;
+		}
+		if (sscanf(line, "%d,%d,%llu,%llu,%llu,%llu,%llu",
+			   &pid, &idx, &arrive, &start, &end, &dur, &iters) != 7)
+			continue;
+
+		for (j = 0; j < nr; j++) {
+			if (jobs[j].id == idx)
+				break;
+		}
+		if (j == nr) {
+			if (nr == cap) {
+				struct sim_job *n;
+
+				cap = cap ? cap * 2 : 64;
+				n = realloc(jobs, cap * sizeof(*jobs));
+				if (!n) {
+					free(jobs);
+					fclose(f);
+					return -ENOMEM;
+				}
+				jobs = n;
+			}
+			memset(&jobs[nr], 0, sizeof(jobs[nr]));
+			jobs[nr].id = idx;
+			jobs[nr].arrive_ns = arrive;
+			nr++;
+		}
+		if (arrive < jobs[j].arrive_ns)
+			jobs[j].arrive_ns = arrive;
+		jobs[j].work_iters += iters;
+	}
+	fclose(f);
+
+	for (int j = 0; j < nr; j++)
+		jobs[j].work_ns = (uint64_t)((double)jobs[j].work_iters * ns_per_iter);
+	if (nr)
+		qsort(jobs, nr, sizeof(*jobs), cmp_job_arrival);
+	*out = jobs;
+	return nr;
+}
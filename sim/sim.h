@@ -0,0 +1,231 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * sim.h - offline discrete-event model of the schedulers in scheds/.
+ *
+ * One CPU (the loadtest generators pin every child to a single core) runs
+ * a list of CPU-bound jobs. Policies plug in through struct sim_policy,
+ * whose callbacks mirror the sched_ext ops used by the BPF schedulers
+ * (enqueue / pick / running / stopping), so the FIFO and MLFQ models read
+ * like scheds/scx_fifo.bpf.c and scheds/scx_mlfq.bpf.c. CFS and EEVDF
+ * reference models use the same interface.
+ *
+ * Time only advances to the next interesting point: an arrival, the
+ * completion of the running job, or the moment the policy wants to
+ * reschedule. With tick_ns set, slice expiry is only noticed at the next
+ * scheduler tick, like the kernel does without hrtick.
+ */
+#ifndef SCHEDSIM_SIM_H
+#define SCHEDSIM_SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIM_NS_PER_MS		1000000ULL
+#define SIM_TIME_INF		UINT64_MAX
+
+/* A job as released by the generator. */
+struct sim_job {
+	int		id;		/* child_index */
+	uint64_t	arrive_ns;
+	uint64_t	work_iters;
+	uint64_t	work_ns;	/* CPU time needed */
+};
+
+struct sim_params {
+	uint64_t	tick_ns;	/* 0: reschedule exactly on slice expiry */
+	uint64_t	cs_ns;		/* cost of switching to another task */
+
+	/* scx_fifo: SCX_SLICE_DFL */
+	uint64_t	dfl_slice_ns;
+	/* scx_mlfq (and plain RR, which uses rr_slice_ns) */
+	uint64_t	rr_slice_ns;
+	uint64_t	fifo_slice_ns;
+	/* model only: promote FIFO-level tasks that waited this long (0 = off) */
+	uint64_t	mlfq_age_ns;
+
+	/* CFS (already scaled by the tunable factor) */
+	uint64_t	cfs_latency_ns;
+	uint64_t	cfs_min_gran_ns;
+	uint64_t	cfs_wakeup_gran_ns;
+
+	/* EEVDF */
+	uint64_t	eevdf_base_slice_ns;
+	bool		eevdf_run_to_parity;
+};
+
+/* Per-job outcome, indexed like the job array. */
+struct sim_job_result {
+	uint64_t	start_ns;	/* first time on CPU */
+	uint64_t	end_ns;		/* completion */
+	uint64_t	nr_runs;	/* times it was put on the CPU */
+	int		level;		/* final MLFQ level (0 for other policies) */
+};
+
+/* A contiguous stretch of CPU time given to one job. */
+struct sim_segment {
+	int		job;		/* index into the job array */
+	uint64_t	start_ns;
+	uint64_t	end_ns;
+	uint64_t	slice_ns;	/* budget the policy granted for this run */
+	int		level;
+	bool		done;		/* job completed at end_ns */
+};
+
+typedef void (*sim_trace_fn)(void *ctx, const struct sim_segment *seg);
+
+struct sim_stats {
+	uint64_t	nr_switches;	/* task changes on the CPU */
+	uint64_t	nr_wakeup_preempt;
+	uint64_t	busy_ns;
+	uint64_t	makespan_ns;
+};
+
+/* Runtime state of a job inside the simulator. */
+struct sim_task {
+	int			idx;
+	const struct sim_job	*job;
+	uint64_t		remaining_ns;
+	bool			started;
+	uint64_t		seg_start_ns;
+
+	/* intrusive runqueue link, owned by the policy */
+	struct sim_task		*next, *prev;
+	bool			queued;
+
+	/* scx_mlfq */
+	uint8_t			level;
+	uint8_t			ran_top;
+	uint64_t		slice_ns;	/* budget of the current run */
+	uint64_t		slice_used_ns;
+	uint64_t		last_run_ns;	/* last time it left the CPU or arrived */
+
+	/* CFS / EEVDF */
+	uint64_t		vruntime;
+	uint64_t		deadline;
+	uint64_t		sum_exec_ns;
+	uint64_t		prev_sum_exec_ns;
+	bool			protect;	/* EEVDF RUN_TO_PARITY */
+};
+
+struct sim_list {
+	struct sim_task	*head, *tail;
+	int		nr;
+};
+
+struct sim;
+
+#define SIM_ENQ_WAKEUP	(1u << 0)	/* new arrival (or wakeup) */
+
+struct sim_policy {
+	const char	*name;
+	bool		hard_slice;	/* a run never exceeds slice_ns (+ one tick) */
+	void		(*init)(struct sim *s);
+	/* put a runnable task on the policy's queues */
+	void		(*enqueue)(struct sim *s, struct sim_task *t, unsigned int flags);
+	/* take the next task off the queues, NULL when empty */
+	struct sim_task	*(*pick_next)(struct sim *s);
+	void		(*running)(struct sim *s, struct sim_task *t);
+	/* t leaves the CPU; runnable is false when it completed */
+	void		(*stopping)(struct sim *s, struct sim_task *t, bool runnable);
+	/* CPU time consumed by the running task */
+	void		(*update_curr)(struct sim *s, struct sim_task *t, uint64_t delta_ns);
+	/* CPU time the running task may use before the policy reschedules */
+	uint64_t	(*runtime_left)(struct sim *s, struct sim_task *curr);
+	/* should a newly enqueued task preempt curr right away? (optional) */
+	bool		(*wakeup_preempt)(struct sim *s, struct sim_task *curr, struct sim_task *p);
+};
+
+struct sim {
+	const struct sim_params	*par;
+	const struct sim_policy	*pol;
+	struct sim_task		*tasks;
+	int			nr_tasks;
+	uint64_t		now;
+	struct sim_task		*curr;
+	int			nr_runnable;	/* queued + curr */
+
+	/* policy private queues */
+	struct sim_list		q[2];
+	uint64_t		min_vruntime;
+
+	sim_trace_fn		trace;
+	void			*trace_ctx;
+	struct sim_stats	stats;
+};
+
+/* runqueue helpers */
+void sim_list_push_tail(struct sim_list *l, struct sim_task *t);
+struct sim_task *sim_list_pop_head(struct sim_list *l);
+void sim_list_remove(struct sim_list *l, struct sim_task *t);
+
+/* policies */
+extern const struct sim_policy sim_policy_fifo;
+extern const struct sim_policy sim_policy_rr;
+extern const struct sim_policy sim_policy_mlfq;
+extern const struct sim_policy sim_policy_cfs;
+extern const struct sim_policy sim_policy_eevdf;
+
+const struct sim_policy *sim_policy_find(const char *name);
+void sim_params_default(struct sim_params *par);
+int sim_params_check(const struct sim_params *par);
+
+/*
+ * Run jobs[0..nr_jobs-1] (sorted by arrival) under pol. res must have room
+ * for nr_jobs entries. trace (optional) is called for every CPU segment.
+ * Returns 0, or -ENOMEM.
+ */
+int sim_run(const struct sim_job *jobs, int nr_jobs, const struct sim_params *par,
+	    const struct sim_policy *pol, struct sim_job_result *res,
+	    sim_trace_fn trace, void *trace_ctx, struct sim_stats *stats);
+
+/* job lists */
+enum sim_gen {
+	SIM_GEN_LOADTEST,	/* loadtest.c: parent sleeps between forks */
+	SIM_GEN_DIVIDED,	/* loadtest_divided.c: parent draws delay and work */
+	SIM_GEN_SLEEPMID,	/* loadtest_sleepmid.c: children draw delay and work */
+};
+
+struct sim_gen_params {
+	enum sim_gen	gen;
+	int		max_procs;
+	unsigned int	seed;
+	int		max_start_delay_ms;
+	uint64_t	min_work_iters;
+	uint64_t	max_work_iters;
+	double		ns_per_iter;
+};
+
+/* Reproduce a generator's job list. Returns the number of jobs, -errno on error. */
+int sim_jobs_generate(const struct sim_gen_params *gp, struct sim_job **out);
+/* Load the job list of a loadtest CSV log (one job per child_index). */
+int sim_jobs_load_csv(const char *path, double ns_per_iter, struct sim_job **out);
+
+/*
+ * Batched runs (batch.c): many generated job lists at once for the sched_ext
+ * policies (fifo, rr, mlfq), with struct-of-arrays state stepped in lockstep.
+ * Results match sim_run() on sim_jobs_generate() for every seed.
+ */
+#define SIM_BATCH_LANES		256	/* seeds per batch */
+
+struct sim_batch_result {
+	unsigned int	seed;
+	int		nr_jobs;
+	uint64_t	nr_switches;
+	uint64_t	makespan_ns;
+	uint64_t	sum_wait_ns;	/* start - arrival */
+	uint64_t	max_wait_ns;
+	uint64_t	sum_tat_ns;	/* completion - arrival */
+	uint64_t	max_tat_ns;
+};
+
+/*
+ * Simulate gp with seeds[0..nr_seeds-1] under pol on nr_threads threads
+ * (0 = online cpus). out must have room for nr_seeds entries.
+ * Returns 0, -EINVAL for policies without a batched model, or -ENOMEM.
+ */
+int sim_batch_run(const struct sim_gen_params *gp, const unsigned int *seeds, int nr_seeds,
+		  const struct sim_params *par, const struct sim_policy *pol,
+		  int nr_threads, struct sim_batch_result *out);
+
+#endif /* SCHEDSIM_SIM_H */
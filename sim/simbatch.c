@@ -0,0 +1,310 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * simbatch - seed sweeps of the sched_ext policy models.
+ *
+ * Runs the generator with seeds first..first+n-1 under fifo, rr and/or
+ * mlfq using the lockstep engine in batch.c, prints the distribution of
+ * the per-seed results and the simulation rate.
+ *
+ * Example runs:
+ *   # 100k seeds of the "make run_fifo" setup under both policies
+ *   ./bin/simbatch -n 100000 -p fifo,mlfq
+ *
+ *   # per-seed results for a notebook, cross-checked against schedsim's engine
+ *   ./bin/simbatch -n 10000 -p mlfq -o log/sweep_mlfq.csv -c
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#define MAX_POLICIES 3
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-p POLICIES] [-n seeds] [-s first_seed] [-j threads] [-g GEN]\n"
+		"          [-m max_procs] [-d max_start_delay_ms] [-w min_iters] [-W max_iters]\n"
+		"          [-k ns_per_iter] [-t tick_us] [-x cs_ns] [-r rr_slice_ms]\n"
+		"          [-f fifo_slice_ms] [-a age_ms] [-o out.csv] [-c]\n\n"
+		"  -p POLICIES   Comma separated: fifo,rr,mlfq (default: fifo,mlfq)\n"
+		"  -n N          Number of seeds (default: 100000)\n"
+		"  -s SEED       First seed (default: 1)\n"
+		"  -j N          Worker threads, 0 = online cpus (default: 0)\n"
+		"  -g/-m/-d/-w/-W/-k  Job lists, as for schedsim\n"
+		"  -t/-x/-r/-f   Tick, switch cost and slices, as for schedsim\n"
+		"  -a MS         MLFQ aging period (default: off)\n"
+		"  -o out.csv    Write one row per seed and policy\n"
+		"  -c            Check every seed against the single-seed engine\n",
+		prog);
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile (0 < p <= 1) of n sorted values. */
+static double pct(const double *v, int n, double p)
+{
+	int rank = (int)(p * n);
+
+	if (n <= 0)
+		return 0.0;
+	if (rank < p * n)
+		rank++;
+	if (rank < 1)
+		rank = 1;
+	if (rank > n)
+		rank = n;
+	return v[rank - 1];
+}
+
+static void print_header(void)
+{
+	printf("%-6s %9s %12s %12s %12s %12s %12s %12s\n",
+	       "policy", "seeds", "wait(ms)", "tat(ms)", "tat p50", "tat p99",
+	       "maxwait p99", "seeds/s");
+}
+
+/* mean over all jobs, spread over seeds of the per-seed mean turnaround */
+static void print_summary(const char *name, const struct sim_batch_result *r, int n,
+			  double secs)
+{
+	double *tat = calloc(n ? n : 1, sizeof(*tat));
+	double *maxw = calloc(n ? n : 1, sizeof(*maxw));
+	double sum_wait = 0, sum_tat = 0;
+	uint64_t jobs = 0;
+
+	if (!tat || !maxw) {
+		free(tat);
+		free(maxw);
+		return;
+	}
+	for (int i = 0; i < n; i++) {
+		sum_wait += r[i].sum_wait_ns;
+		sum_tat += r[i].sum_tat_ns;
+		jobs += r[i].nr_jobs;
+		tat[i] = r[i].nr_jobs ? (double)r[i].sum_tat_ns / r[i].nr_jobs / 1e6 : 0.0;
+		maxw[i] = (double)r[i].max_wait_ns / 1e6;
+	}
+	qsort(tat, n, sizeof(*tat), cmp_double);
+	qsort(maxw, n, sizeof(*maxw), cmp_double);
+	printf("%-6s %9d %12.3f %12.3f %12.3f %12.3f %12.3f %12.0f\n",
+	       name, n,
+	       jobs ? sum_wait / jobs / 1e6 : 0.0, jobs ? sum_tat / jobs / 1e6 : 0.0,
+	       pct(tat, n, 0.50), pct(tat, n, 0.99), pct(maxw, n, 0.99),
+	       secs > 0 ? n / secs : 0.0);
+	free(tat);
+	free(maxw);
+}
+
+/* Rerun every seed through sim_run() and compare. Returns the mismatches. */
+static int check_seeds(const struct sim_gen_params *gp, const struct sim_params *par,
+		       const struct sim_policy *pol, const struct sim_batch_result *r, int n)
+{
+	struct sim_gen_params g = *gp;
+	int bad = 0;
+
+	for (int i = 0; i < n; i++) {
+		struct sim_batch_result want = { .seed = r[i].seed };
+		struct sim_job_result *res;
+		struct sim_job *jobs;
+		struct sim_stats st;
+		int nr;
+
+		g.seed = r[i].seed;
+		nr = sim_jobs_generate(&g, &jobs);
+		if (nr < 0)
+			return -1;
+		res = calloc(nr ? nr : 1, sizeof(*res));
+		if (!res || sim_run(jobs, nr, par, pol, res, NULL, NULL, &st)) {
+			free(res);
+			free(jobs);
+			return -1;
+		}
+		want.nr_jobs = nr;
+		want.nr_switches = st.nr_switches;
+		want.makespan_ns = st.makespan_ns;
+		for (int j = 0; j < nr; j++) {
+			uint64_t wait = res[j].start_ns - jobs[j].arrive_ns;
+			uint64_t tat = res[j].end_ns - jobs[j].arrive_ns;
+
+			want.sum_wait_ns += wait;
+			want.sum_tat_ns += tat;
+			if (wait > want.max_wait_ns)
+				want.max_wait_ns = wait;
+			if (tat > want.max_tat_ns)
+				want.max_tat_ns = tat;
+		}
+		if (memcmp(&want, &r[i], sizeof(want))) {
+			if (bad++ < 5)
+				fprintf(stderr, "%s seed %u: batch makespan %llu tat %llu, sim_run makespan %llu tat %llu\n",
+					pol->name, r[i].seed,
+					(unsigned long long)r[i].makespan_ns,
+					(unsigned long long)r[i].sum_tat_ns,
+					(unsigned long long)want.makespan_ns,
+					(unsigned long long)want.sum_tat_ns);
+		}
+		free(res);
+		free(jobs);
+	}
+	return bad;
+}
+
+int main(int argc, char **argv)
+{
+	struct sim_gen_params gp = {
+		.gen = SIM_GEN_LOADTEST,
+		.max_procs = 20,
+		.max_start_delay_ms = 10,
+		.min_work_iters = 1000000ULL,
+		.max_work_iters = 5000000ULL,
+		.ns_per_iter = 3.0,
+	};
+	const struct sim_policy *pols[MAX_POLICIES];
+	const char *policies = "fifo,mlfq", *out_path = NULL;
+	struct sim_batch_result *res;
+	struct sim_params par;
+	unsigned int first = 1, *seeds;
+	int nr_seeds = 100000, nr_threads = 0, nr_pols = 0, opt, ret = 0;
+	bool check = false;
+	char *list, *tok, *save = NULL;
+	FILE *out = NULL;
+
+	sim_params_default(&par);
+
+	while ((opt = getopt(argc, argv, "p:n:s:j:g:m:d:w:W:k:t:x:r:f:a:o:ch")) != -1) {
+		switch (opt) {
+		case 'p': policies = optarg; break;
+		case 'n': nr_seeds = atoi(optarg); break;
+		case 's': first = (unsigned int)strtoul(optarg, NULL, 10); break;
+		case 'j': nr_threads = atoi(optarg); break;
+		case 'g':
+			if (!strcmp(optarg, "loadtest"))
+				gp.gen = SIM_GEN_LOADTEST;
+			else if (!strcmp(optarg, "divided"))
+				gp.gen = SIM_GEN_DIVIDED;
+			else if (!strcmp(optarg, "sleepmid"))
+				gp.gen = SIM_GEN_SLEEPMID;
+			else {
+				fprintf(stderr, "Unknown generator: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'm': gp.max_procs = atoi(optarg); break;
+		case 'd': gp.max_start_delay_ms = atoi(optarg); break;
+		case 'w': gp.min_work_iters = strtoull(optarg, NULL, 10); break;
+		case 'W': gp.max_work_iters = strtoull(optarg, NULL, 10); break;
+		case 'k': gp.ns_per_iter = strtod(optarg, NULL); break;
+		case 't': par.tick_ns = strtoull(optarg, NULL, 10) * 1000ULL; break;
+		case 'x': par.cs_ns = strtoull(optarg, NULL, 10); break;
+		case 'r': par.rr_slice_ns = strtoull(optarg, NULL, 10) * SIM_NS_PER_MS; break;
+		case 'f': par.fifo_slice_ns = strtoull(optarg, NULL, 10) * SIM_NS_PER_MS; break;
+		case 'a': par.mlfq_age_ns = strtoull(optarg, NULL, 10) * SIM_NS_PER_MS; break;
+		case 'o': out_path = optarg; break;
+		case 'c': check = true; break;
+		default:
+			usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+	if (sim_params_check(&par)) {
+		fprintf(stderr, "-r and -f must be at least 1 ms\n");
+		return 1;
+	}
+	if (nr_seeds < 1)
+		nr_seeds = 1;
+
+	list = strdup(policies);
+	for (tok = strtok_r(list, ",", &save); tok && nr_pols < MAX_POLICIES;
+	     tok = strtok_r(NULL, ",", &save)) {
+		pols[nr_pols] = sim_policy_find(tok);
+		if (!pols[nr_pols]) {
+			fprintf(stderr, "Unknown policy: %s\n", tok);
+			free(list);
+			return 1;
+		}
+		nr_pols++;
+	}
+	free(list);
+
+	seeds = calloc(nr_seeds, sizeof(*seeds));
+	res = calloc(nr_seeds, sizeof(*res));
+	if (!seeds || !res) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	for (int i = 0; i < nr_seeds; i++)
+		seeds[i] = first + (unsigned int)i;
+
+	if (out_path) {
+		out = fopen(out_path, "w");
+		if (!out) {
+			fprintf(stderr, "open(%s): %s\n", out_path, strerror(errno));
+			return 1;
+		}
+		fputs("policy,seed,jobs,switches,makespan_ns,sum_wait_ns,max_wait_ns,sum_tat_ns,max_tat_ns\n",
+		      out);
+	}
+
+	printf("simbatch: seeds %u..%u, max_procs=%d tick=%lluus lanes=%d\n",
+	       first, first + (unsigned int)nr_seeds - 1, gp.max_procs,
+	       (unsigned long long)(par.tick_ns / 1000), SIM_BATCH_LANES);
+	print_header();
+
+	for (int p = 0; p < nr_pols; p++) {
+		double t0 = now_sec(), secs;
+		int err;
+
+		err = sim_batch_run(&gp, seeds, nr_seeds, &par, pols[p], nr_threads, res);
+		secs = now_sec() - t0;
+		if (err) {
+			fprintf(stderr, "%s: %s\n", pols[p]->name,
+				err == -EINVAL ? "no batched model (fifo, rr, mlfq only)" :
+						 strerror(-err));
+			ret = 1;
+			break;
+		}
+		print_summary(pols[p]->name, res, nr_seeds, secs);
+
+		if (check) {
+			int bad = check_seeds(&gp, &par, pols[p], res, nr_seeds);
+
+			printf("  %-6s check vs sim_run: %s (%d mismatching seeds)\n",
+			       pols[p]->name, bad ? "FAILED" : "ok", bad);
+			if (bad)
+				ret = 1;
+		}
+
+		for (int i = 0; out && i < nr_seeds; i++)
+			fprintf(out, "%s,%u,%d,%llu,%llu,%llu,%llu,%llu,%llu\n",
+				pols[p]->name, res[i].seed, res[i].nr_jobs,
+				(unsigned long long)res[i].nr_switches,
+				(unsigned long long)res[i].makespan_ns,
+				(unsigned long long)res[i].sum_wait_ns,
+				(unsigned long long)res[i].max_wait_ns,
+				(unsigned long long)res[i].sum_tat_ns,
+				(unsigned long long)res[i].max_tat_ns);
+	}
+
+	if (out)
+		fclose(out);
+	free(seeds);
+	free(res);
+	return ret;
+}
@@ -0,0 +1,482 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * simfuzz - property-based fuzzing of the policy models in sim/.
+ *
+ * Random and adversarial job lists are run through each policy model and
+ * the resulting CPU timeline is checked against scheduler invariants:
+ *
+ *   lost      every job completes and receives exactly its CPU time
+ *   timeline  segments never overlap and never start before arrival
+ *   idle      the CPU is never idle while a job is runnable
+ *   slice     a run never exceeds its slice (+ one tick) for sched_ext
+ *             policies, which only preempt on slice expiry
+ *   level     MLFQ levels only go down (RR -> FIFO), except for an aging
+ *             promotion after waiting at least the aging period
+ *   wait      with aging enabled (or -b), no runnable job waits longer
+ *             than the bound
+ *
+ * A failing job list is shrunk (drop jobs, shrink work, pull arrivals
+ * earlier) while the same invariant keeps failing, then written as a
+ * loadtest-style CSV that replays with:  schedsim -i repro.csv -k 1
+ *
+ * Example:
+ *   ./bin/simfuzz -p mlfq -b 500            # finds FIFO_DSQ starvation
+ *   ./bin/simfuzz -p mlfq -a 100            # aging bounds the wait
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+enum violation {
+	V_NONE,
+	V_LOST,
+	V_TIMELINE,
+	V_IDLE,
+	V_SLICE,
+	V_LEVEL,
+	V_WAIT,
+};
+
+static const char *const violation_names[] = {
+	"none", "lost", "timeline", "idle", "slice", "level", "wait",
+};
+
+struct seg_buf {
+	struct sim_segment	*v;
+	size_t			nr, cap;
+	bool			oom;
+};
+
+struct check_ctx {
+	const struct sim_params	*par;
+	const struct sim_policy	*pol;
+	uint64_t		wait_bound_ns;	/* 0 = not checked */
+	char			msg[256];
+};
+
+static uint64_t rng_state;
+
+static uint64_t rng_next(void)
+{
+	/* xorshift64*: independent from the generators' rand() */
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 2685821657736338717ULL;
+}
+
+static uint64_t rng_range(uint64_t lo, uint64_t hi)
+{
+	if (hi <= lo)
+		return lo;
+	return lo + rng_next() % (hi - lo + 1);
+}
+
+static void seg_record(void *ctx, const struct sim_segment *seg)
+{
+	struct seg_buf *b = ctx;
+
+	if (b->nr == b->cap) {
+		size_t cap = b->cap ? b->cap * 2 : 256;
+		struct sim_segment *n = realloc(b->v, cap * sizeof(*n));
+
+		if (!n) {
+			b->oom = true;
+			return;
+		}
+		b->v = n;
+		b->cap = cap;
+	}
+	b->v[b->nr++] = *seg;
+}
+
+static int cmp_job_arrival(const void *a, const void *b)
+{
+	const struct sim_job *ja = a, *jb = b;
+
+	if (ja->arrive_ns != jb->arrive_ns)
+		return ja->arrive_ns < jb->arrive_ns ? -1 : 1;
+	return ja->id - jb->id;
+}
+
+/* Run jobs under the policy and return the first invariant violated. */
+static enum violation check(struct check_ctx *c, struct sim_job *jobs, int nr)
+{
+	const struct sim_params *par = c->par;
+	struct seg_buf b = { 0 };
+	struct sim_job_result *res;
+	uint64_t *got, *last_end;
+	int *last_level;
+	enum violation v = V_NONE;
+
+	qsort(jobs, nr, sizeof(*jobs), cmp_job_arrival);
+	res = calloc(nr, sizeof(*res));
+	got = calloc(nr, sizeof(*got));
+	last_end = calloc(nr, sizeof(*last_end));
+	last_level = calloc(nr, sizeof(*last_level));
+	if (!res || !got || !last_end || !last_level ||
+	    sim_run(jobs, nr, par, c->pol, res, seg_record, &b, NULL) || b.oom) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	for (int i = 0; i < nr; i++) {
+		last_end[i] = jobs[i].arrive_ns;
+		last_level[i] = 0;
+	}
+
+	for (size_t k = 0; k < b.nr && v == V_NONE; k++) {
+		const struct sim_segment *s = &b.v[k];
+		uint64_t len = s->end_ns - s->start_ns;
+		uint64_t waited = s->start_ns - last_end[s->job];
+
+		if (s->start_ns < jobs[s->job].arrive_ns ||
+		    (k && s->start_ns < b.v[k - 1].end_ns)) {
+			snprintf(c->msg, sizeof(c->msg),
+				 "job %d segment at %llu overlaps or precedes arrival",
+				 jobs[s->job].id, (unsigned long long)s->start_ns);
+			v = V_TIMELINE;
+			break;
+		}
+
+		/* idle gap: nothing may be runnable during it */
+		if (k && s->start_ns - b.v[k - 1].end_ns > par->cs_ns) {
+			uint64_t gap_start = b.v[k - 1].end_ns;
+			uint64_t gap_end = s->start_ns - par->cs_ns;
+
+			for (int i = 0; i < nr; i++) {
+				if (jobs[i].arrive_ns < gap_end && res[i].end_ns > gap_start &&
+				    got[i] < jobs[i].work_ns) {
+					snprintf(c->msg, sizeof(c->msg),
+						 "CPU idle in [%llu, %llu) while job %d was runnable",
+						 (unsigned long long)gap_start,
+						 (unsigned long long)gap_end, jobs[i].id);
+					v = V_IDLE;
+					break;
+				}
+			}
+			if (v)
+				break;
+		}
+
+		if (c->pol->hard_slice && len > s->slice_ns + par->tick_ns) {
+			snprintf(c->msg, sizeof(c->msg),
+				 "job %d ran %llu ns on a %llu ns slice",
+				 jobs[s->job].id, (unsigned long long)len,
+				 (unsigned long long)s->slice_ns);
+			v = V_SLICE;
+			break;
+		}
+
+		if (s->level < last_level[s->job] &&
+		    !(par->mlfq_age_ns && waited >= par->mlfq_age_ns)) {
+			snprintf(c->msg, sizeof(c->msg),
+				 "job %d promoted %d -> %d after waiting only %llu ns",
+				 jobs[s->job].id, last_level[s->job], s->level,
+				 (unsigned long long)waited);
+			v = V_LEVEL;
+			break;
+		}
+
+		if (c->wait_bound_ns && waited > c->wait_bound_ns) {
+			snprintf(c->msg, sizeof(c->msg),
+				 "job %d waited %.3f ms (bound %.3f ms) before running at %llu",
+				 jobs[s->job].id, waited / 1e6, c->wait_bound_ns / 1e6,
+				 (unsigned long long)s->start_ns);
+			v = V_WAIT;
+			break;
+		}
+
+		got[s->job] += len;
+		last_end[s->job] = s->end_ns;
+		last_level[s->job] = s->level;
+	}
+
+	for (int i = 0; i < nr && v == V_NONE; i++) {
+		if (!res[i].end_ns || got[i] != jobs[i].work_ns) {
+			snprintf(c->msg, sizeof(c->msg),
+				 "job %d got %llu of %llu ns (end=%llu)",
+				 jobs[i].id, (unsigned long long)got[i],
+				 (unsigned long long)jobs[i].work_ns,
+				 (unsigned long long)res[i].end_ns);
+			v = V_LOST;
+		}
+	}
+
+	free(b.v);
+	free(res);
+	free(got);
+	free(last_end);
+	free(last_level);
+	return v;
+}
+
+/* Job list generators */
+
+enum pattern {
+	PAT_RANDOM,
+	PAT_STARVE,	/* one long job, then short jobs arriving faster than they drain */
+	PAT_BURST,	/* bursts of simultaneous arrivals */
+	PAT_BOUNDARY,	/* work and arrivals on slice/tick multiples */
+	NR_PATTERNS,
+};
+
+static const char *const pattern_names[] = { "random", "starve", "burst", "boundary" };
+
+static int gen_jobs(enum pattern pat, const struct sim_params *par, int max_jobs,
+		    struct sim_job *jobs)
+{
+	int nr = (int)rng_range(1, max_jobs);
+	uint64_t t = 0;
+
+	for (int i = 0; i < nr; i++) {
+		jobs[i].id = i;
+		switch (pat) {
+		case PAT_STARVE:
+			if (i == 0) {
+				jobs[i].arrive_ns = 0;
+				jobs[i].work_ns = par->rr_slice_ns * rng_range(2, 20);
+			} else {
+				/* each short job fits in one RR slice, the gaps are shorter */
+				t += rng_range(1, par->rr_slice_ns);
+				jobs[i].arrive_ns = t;
+				jobs[i].work_ns = rng_range(par->rr_slice_ns / 2, par->rr_slice_ns);
+			}
+			break;
+		case PAT_BURST:
+			if (rng_range(0, 3) == 0)
+				t += rng_range(0, 10 * par->rr_slice_ns);
+			jobs[i].arrive_ns = t;
+			jobs[i].work_ns = rng_range(1, 4 * par->rr_slice_ns);
+			break;
+		case PAT_BOUNDARY: {
+			uint64_t unit = par->tick_ns ? par->tick_ns : par->rr_slice_ns;
+
+			t += unit * rng_range(0, 5);
+			jobs[i].arrive_ns = t;
+			jobs[i].work_ns = (rng_range(0, 1) ? par->rr_slice_ns : unit) *
+					  rng_range(1, 6);
+			break;
+		}
+		case PAT_RANDOM:
+		default:
+			t += rng_range(0, 3 * par->rr_slice_ns);
+			jobs[i].arrive_ns = t;
+			jobs[i].work_ns = rng_range(1, 6 * par->rr_slice_ns);
+			break;
+		}
+		jobs[i].work_iters = jobs[i].work_ns;
+	}
+	return nr;
+}
+
+/* Shrinking */
+
+static enum violation try_candidate(struct check_ctx *c, struct sim_job *cand, int nr,
+				    enum violation want)
+{
+	struct check_ctx tmp = *c;
+
+	return check(&tmp, cand, nr) == want ? want : V_NONE;
+}
+
+static int shrink(struct check_ctx *c, struct sim_job *jobs, int nr, enum violation want)
+{
+	struct sim_job *cand = malloc(nr * sizeof(*cand));
+	bool progress = true;
+
+	if (!cand)
+		return nr;
+
+	while (progress) {
+		progress = false;
+
+		/* drop chunks of jobs, halving the chunk size */
+		for (int chunk = nr / 2 > 0 ? nr / 2 : 1; chunk >= 1; chunk /= 2) {
+			for (int start = 0; start + chunk <= nr && nr > 1;) {
+				int m = 0;
+
+				for (int i = 0; i < nr; i++) {
+					if (i < start || i >= start + chunk)
+						cand[m++] = jobs[i];
+				}
+				if (m > 0 && try_candidate(c, cand, m, want)) {
+					memcpy(jobs, cand, m * sizeof(*jobs));
+					nr = m;
+					progress = true;
+				} else {
+					start += chunk;
+				}
+			}
+		}
+
+		/* shrink work and pull arrivals earlier, one job at a time */
+		for (int i = 0; i < nr; i++) {
+			for (int field = 0; field < 2; field++) {
+				for (;;) {
+					uint64_t *val;
+					uint64_t cur, lo = field ? 0 : 1;
+
+					memcpy(cand, jobs, nr * sizeof(*jobs));
+					val = field ? &cand[i].arrive_ns : &cand[i].work_ns;
+					cur = *val;
+					if (cur <= lo)
+						break;
+					*val = lo + (cur - lo) / 2;
+					cand[i].work_iters = cand[i].work_ns;
+					if (!try_candidate(c, cand, nr, want)) {
+						/* smaller steps */
+						memcpy(cand, jobs, nr * sizeof(*jobs));
+						val = field ? &cand[i].arrive_ns : &cand[i].work_ns;
+						*val = cur - (cur - lo) / 16 - 1;
+						cand[i].work_iters = cand[i].work_ns;
+						if (*val < lo || !try_candidate(c, cand, nr, want))
+							break;
+					}
+					memcpy(jobs, cand, nr * sizeof(*jobs));
+					progress = true;
+				}
+			}
+		}
+	}
+
+	/* renumber so the reproducer reads naturally */
+	qsort(jobs, nr, sizeof(*jobs), cmp_job_arrival);
+	for (int i = 0; i < nr; i++)
+		jobs[i].id = i;
+	free(cand);
+	return nr;
+}
+
+static int write_repro(const char *path, const struct sim_job *jobs, int nr)
+{
+	FILE *f = fopen(path, "w");
+
+	if (!f)
+		return -errno;
+	/* ns_per_iter = 1: work_iters is the CPU time in ns */
+	fputs("pid,child_index,arrive_ns,start_ns,end_ns,duration_ns,work_iters\n", f);
+	for (int i = 0; i < nr; i++)
+		fprintf(f, "%d,%d,%llu,0,0,0,%llu\n", i + 1, jobs[i].id,
+			(unsigned long long)jobs[i].arrive_ns,
+			(unsigned long long)jobs[i].work_ns);
+	fclose(f);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-p POLICY] [-n iterations] [-s seed] [-N max_jobs] [-a age_ms]\n"
+		"          [-b wait_bound_ms] [-r rr_slice_ms] [-f fifo_slice_ms] [-t tick_us]\n"
+		"          [-o repro.csv]\n\n"
+		"  -p POLICY     fifo, rr, mlfq, cfs or eevdf (default: mlfq)\n"
+		"  -n N          Number of generated cases (default: 2000)\n"
+		"  -s SEED       Fuzzer seed (default: 1)\n"
+		"  -N JOBS       Max jobs per case (default: 24)\n"
+		"  -a MS         Enable MLFQ aging with this period; implies a wait bound\n"
+		"  -b MS         Check this wait bound explicitly\n"
+		"  -o FILE       Where to write the shrunk reproducer (default: sim_repro.csv)\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *policy = "mlfq", *repro = "sim_repro.csv";
+	struct check_ctx c = { 0 };
+	struct sim_params par;
+	struct sim_job *jobs;
+	uint64_t bound_ms = 0;
+	long iters = 2000;
+	int max_jobs = 24, opt;
+
+	sim_params_default(&par);
+	rng_state = 1;
+
+	while ((opt = getopt(argc, argv, "p:n:s:N:a:b:r:f:t:o:h")) != -1) {
+		switch (opt) {
+		case 'p': policy = optarg; break;
+		case 'n': iters = strtol(optarg, NULL, 10); break;
+		case 's': rng_state = strtoull(optarg, NULL, 10) | 1; break;
+		case 'N': max_jobs = atoi(optarg); break;
+		case 'a': par.mlfq_age_ns = strtoull(optarg, NULL, 10) * SIM_NS_PER_MS; break;
+		case 'b': bound_ms = strtoull(optarg, NULL, 10); break;
+		case 'r': par.rr_slice_ns = strtoull(optarg, NULL, 10) * SIM_NS_PER_MS; break;
+		case 'f': par.fifo_slice_ns = strtoull(optarg, NULL, 10) * SIM_NS_PER_MS; break;
+		case 't': par.tick_ns = strtoull(optarg, NULL, 10) * 1000ULL; break;
+		case 'o': repro = optarg; break;
+		default:
+			usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+	if (sim_params_check(&par)) {
+		fprintf(stderr, "-r and -f must be at least 1 ms\n");
+		return 1;
+	}
+	if (max_jobs < 1)
+		max_jobs = 1;
+
+	c.par = &par;
+	c.pol = sim_policy_find(policy);
+	if (!c.pol) {
+		fprintf(stderr, "Unknown policy: %s\n", policy);
+		return 1;
+	}
+	if (bound_ms) {
+		c.wait_bound_ns = bound_ms * SIM_NS_PER_MS;
+	} else if (par.mlfq_age_ns && !strcmp(c.pol->name, "mlfq")) {
+		/*
+		 * After aging, a task waits behind at most every other job's RR
+		 * slice, plus the FIFO slice that may be running when it ages.
+		 */
+		c.wait_bound_ns = par.mlfq_age_ns + par.fifo_slice_ns + par.tick_ns +
+				  (uint64_t)max_jobs * (par.rr_slice_ns + par.tick_ns);
+	}
+
+	jobs = calloc(max_jobs, sizeof(*jobs));
+	if (!jobs) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	printf("simfuzz: policy=%s cases=%ld max_jobs=%d aging=%llums wait_bound=%.3fms\n",
+	       c.pol->name, iters, max_jobs,
+	       (unsigned long long)(par.mlfq_age_ns / SIM_NS_PER_MS),
+	       c.wait_bound_ns / 1e6);
+
+	for (long it = 0; it < iters; it++) {
+		enum pattern pat = (enum pattern)(it % NR_PATTERNS);
+		enum violation v;
+		int nr = gen_jobs(pat, &par, max_jobs, jobs);
+
+		v = check(&c, jobs, nr);
+		if (v == V_NONE)
+			continue;
+
+		printf("case %ld (%s, %d jobs): %s violation: %s\n",
+		       it, pattern_names[pat], nr, violation_names[v], c.msg);
+		nr = shrink(&c, jobs, nr, v);
+		check(&c, jobs, nr);
+		printf("shrunk to %d job(s): %s\n", nr, c.msg);
+		for (int i = 0; i < nr; i++)
+			printf("  job %d: arrive=%llu ns work=%llu ns\n", jobs[i].id,
+			       (unsigned long long)jobs[i].arrive_ns,
+			       (unsigned long long)jobs[i].work_ns);
+		if (write_repro(repro, jobs, nr))
+			fprintf(stderr, "Failed to write %s\n", repro);
+		else
+			printf("reproducer: %s (replay: schedsim -i %s -k 1 -p %s)\n",
+			       repro, repro, c.pol->name);
+		free(jobs);
+		return 2;
+	}
+
+	printf("no violations in %ld cases\n", iters);
+	free(jobs);
+	return 0;
+}
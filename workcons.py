@@ -0,0 +1,200 @@
+"""
+Work-conservation check over an scx_fifo_capture trace (scxtrace.py).
+
+Flags every interval in which a CPU was idle while a task allowed to run
+on it was queued on the shared DSQ. Average metrics hide these; a policy
+that forgets to kick an idle CPU, or dispatches from the wrong queue,
+shows up here as long violations.
+
+Reconstruction from the trace events:
+  - queued: from a task's enqueue (it went to the shared DSQ) until its
+    next running. Direct dispatches to a local DSQ never produce an
+    enqueue event, so they are never counted as queued.
+  - eligible CPUs: the cpumask recorded with the enqueue (CPUs 0-63; a
+    task allowed on more CPUs than the mask shows is taken to be allowed
+    on all CPUs above 63, and traces without a mask mean "any CPU").
+  - idle: ops.update_idle transitions. Traces without them fall back to
+    "idle from stopping until the next running on that CPU", which also
+    counts time the CPU spent on non-sched_ext tasks as idle.
+
+DSQ depth samples (the dispatch events) are used as a cross-check: a
+dispatch that saw a non-empty DSQ and consumed nothing means queued tasks
+could not run there (affinity), and a sample of depth 0 while the
+reconstruction has tasks queued means events were lost (trace_drops).
+Each violation also carries the last depth sample before it (-1: none).
+
+The reconstruction needs every event: a sampled trace (scx_fifo_capture
+-r/-b) or one with LOST records is analyzed anyway, with a warning.
+
+A CPU leaving idle takes a few microseconds after the kick even in a
+correct policy; --min-us hides violations shorter than that.
+
+    python3 workcons.py log/trace.bin --min-us 50 --top 20 --output log/violations.csv
+"""
+import argparse
+import sys
+
+import numpy as np
+
+import scxtrace
+
+
+def eligible_cpus(nr_allowed, mask, nr_cpus):
+    """CPUs a task may run on, from the enqueue event's arg[1] and arg[2]."""
+    if not mask:
+        return tuple(range(nr_cpus))
+    low = tuple(c for c in range(min(nr_cpus, 64)) if mask >> c & 1)
+    if nr_allowed > len(low):
+        low += tuple(range(64, nr_cpus))
+    return low
+
+
+def analyze(ev, nr_cpus=None, min_ns=0):
+    ts = ev["ts_ns"].astype(np.int64)
+    pids = ev["pid"].astype(np.int64)
+    types = ev["type"].astype(np.int64)
+    cpus = ev["cpu"].astype(np.int64)
+    args = ev["arg"].astype(np.uint64)
+
+    if nr_cpus is None:
+        nr_cpus = int(cpus.max()) + 1 if len(ev) else 1
+    have_idle = bool((types == scxtrace.IDLE).any())
+
+    idle = [False] * nr_cpus        # unknown until the first event: busy
+    eligible = [0] * nr_cpus        # queued tasks allowed on each CPU
+    queued = {}                     # pid -> (enqueue ts, eligible cpus)
+    open_at = [None] * nr_cpus      # violation start per CPU
+    open_info = [None] * nr_cpus    # (waiting pid, nr waiting, dsq depth)
+    last_depth = -1
+    violations = []
+    xcheck = {"missed_consume": 0, "depth_mismatch": 0, "dispatch_samples": 0}
+
+    def update(c, t):
+        v = idle[c] and eligible[c] > 0
+        if v and open_at[c] is None:
+            # oldest task waiting that this CPU could have run
+            waiting = [(q[0], p) for p, q in queued.items() if c in q[1]]
+            first = min(waiting)[1] if waiting else -1
+            open_at[c] = t
+            open_info[c] = (first, len(waiting), last_depth)
+        elif not v and open_at[c] is not None:
+            violations.append((c, open_at[c], t, False) + open_info[c])
+            open_at[c] = None
+
+    for i in range(len(ev)):
+        t, pid, typ, c = int(ts[i]), int(pids[i]), int(types[i]), int(cpus[i])
+        if c >= nr_cpus:
+            continue
+        if typ == scxtrace.ENQUEUE:
+            if pid in queued:
+                for qc in queued[pid][1]:
+                    eligible[qc] -= 1
+            elig = eligible_cpus(int(args[i][1]), int(args[i][2]), nr_cpus)
+            queued[pid] = (t, elig)
+            for qc in elig:
+                eligible[qc] += 1
+                update(qc, t)
+        elif typ == scxtrace.RUNNING:
+            if not have_idle:
+                idle[c] = False
+                update(c, t)
+            q = queued.pop(pid, None)
+            if q:
+                for qc in q[1]:
+                    eligible[qc] -= 1
+                    update(qc, t)
+        elif typ == scxtrace.STOPPING:
+            if not have_idle:
+                idle[c] = True
+                update(c, t)
+        elif typ == scxtrace.IDLE:
+            idle[c] = bool(args[i][0])
+            update(c, t)
+        elif typ == scxtrace.DISPATCH:
+            depth, consumed = int(args[i][0]), int(args[i][1])
+            last_depth = depth
+            xcheck["dispatch_samples"] += 1
+            if depth > 0 and not consumed:
+                xcheck["missed_consume"] += 1
+            if depth == 0 and queued:
+                xcheck["depth_mismatch"] += 1
+
+    end = int(ts[-1]) if len(ev) else 0
+    for c in range(nr_cpus):
+        if open_at[c] is not None:
+            violations.append((c, open_at[c], end, True) + open_info[c])
+
+    dtype = [("cpu", "i4"), ("start_ns", "i8"), ("end_ns", "i8"), ("truncated", "?"),
+             ("waiting_pid", "i8"), ("nr_waiting", "i4"), ("dsq_depth", "i4")]
+    v = np.array(violations, dtype=dtype)
+    if len(v):
+        v = v[(v["end_ns"] - v["start_ns"]) >= min_ns]
+        v = v[np.argsort(v["start_ns"], kind="stable")]
+    return v, nr_cpus, have_idle, xcheck
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Find idle CPUs next to runnable queued tasks")
+    ap.add_argument("trace", help="scx_fifo_capture -t trace")
+    ap.add_argument("--cpus", type=int, help="number of CPUs (default: highest seen + 1)")
+    ap.add_argument("--min-us", type=float, default=0.0,
+                    help="ignore violations shorter than this (default: 0)")
+    ap.add_argument("--top", type=int, default=10, help="worst violations to list")
+    ap.add_argument("--output", help="all violations as CSV")
+    args = ap.parse_args()
+
+    ev = scxtrace.read(args.trace)
+    if not len(ev):
+        print("empty trace")
+        return 0
+    sampled = ev[(ev["type"] == scxtrace.RATE) & (ev["arg"][:, 1] > 1)]
+    drops = scxtrace.lost(ev)
+    if len(sampled) or drops:
+        print(f"warning: incomplete trace ({len(sampled)} sampling changes, "
+              f"{sum(drops.values())} records lost), results are approximate")
+    t0 = int(ev["ts_ns"][0])
+    span_ns = int(ev["ts_ns"][-1]) - t0
+
+    v, nr_cpus, have_idle, xcheck = analyze(ev, args.cpus, int(args.min_us * 1e3))
+    dur = (v["end_ns"] - v["start_ns"]) if len(v) else np.zeros(0, dtype=np.int64)
+    total = int(dur.sum())
+
+    print(f"{len(ev)} events over {span_ns / 1e9:.3f}s, {nr_cpus} CPUs, "
+          f"idle from {'update_idle' if have_idle else 'stopping/running (approximate)'}")
+    print(f"violations: {len(v)} (>= {args.min_us:g}us), total {total / 1e6:.3f}ms "
+          f"= {100.0 * total / max(span_ns * nr_cpus, 1):.4f}% of CPU time")
+    if len(v):
+        print(f"duration (us): p50={np.percentile(dur, 50) / 1e3:.1f} "
+              f"p99={np.percentile(dur, 99) / 1e3:.1f} max={dur.max() / 1e3:.1f}")
+        print(f"\n{'CPU':>4} {'COUNT':>8} {'TOTAL(ms)':>10}")
+        for c in range(nr_cpus):
+            m = v["cpu"] == c
+            if m.any():
+                print(f"{c:>4} {int(m.sum()):>8} {dur[m].sum() / 1e6:>10.3f}")
+
+        print(f"\nworst {min(args.top, len(v))}:")
+        print(f"{'CPU':>4} {'START(s)':>12} {'START_NS':>20} {'DUR(us)':>10} "
+              f"{'WAITING':>8} {'NR_WAIT':>8} {'DEPTH':>6}")
+        for k in np.argsort(-dur, kind="stable")[:args.top]:
+            r = v[k]
+            print(f"{r['cpu']:>4} {(r['start_ns'] - t0) / 1e9:>12.6f} {r['start_ns']:>20} "
+                  f"{dur[k] / 1e3:>10.1f} {r['waiting_pid']:>8} {r['nr_waiting']:>8} "
+                  f"{r['dsq_depth']:>6}{' (trace end)' if r['truncated'] else ''}")
+
+    if xcheck["dispatch_samples"]:
+        print(f"\ndepth samples: {xcheck['dispatch_samples']}, "
+              f"non-empty DSQ but nothing consumed: {xcheck['missed_consume']}, "
+              f"empty DSQ while tasks reconstructed as queued: {xcheck['depth_mismatch']}")
+
+    if args.output:
+        import pandas as pd
+
+        df = pd.DataFrame(v)
+        df["duration_ns"] = dur
+        df["start_rel_ns"] = df["start_ns"] - t0
+        df.to_csv(args.output, index=False)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())